@@ -8,6 +8,8 @@ import logging
 import time
 import os
 import random 
+from decision_channel import DecisionChannel, pc_ids, CHAN_EDGE, TOKENS
+from native_sched import NativeSched, RestoredKeys, RestoredList
 
 logger = logging.getLogger(__name__)
 logger.setLevel(logging.DEBUG)
@@ -19,6 +21,8 @@ formatter    = logging.Formatter('%(levelname)s : %(name)s : %(message)s')
 file_handler.setFormatter(formatter)
 logger.addHandler(file_handler)
 MIRROR_PIPE_LOG = os.path.join(LOG_DIR, 'pipe_mirror.log')
+# pcpipe/myfifo directory; the orchestrator gives every lane its own
+PIPE_DIR = os.environ.get('MARCO_PIPE_DIR', '/tmp')
 
 # index of queue_count
 FZQID = 0
@@ -33,11 +37,15 @@ DEAD=1
 EXPLD=2
 # ceiling count of pc per node before EXPLD
 MAXPC=5000
+# seconds between snapshots of the persisted native graph
+SNAPSHOT_SECS=300
 
 def parse_args():
     p = argparse.ArgumentParser("")
     p.add_argument("-d", dest="hybrid_mode", type=int, default=0, help="0: vanilla mode; 1: fz attempt modeled")
     p.add_argument("-m", dest="sched_mode", type=int, default=2, help="0: fifo(deprecated); 1: full-fledged for unvisited mode only; 2: full-fledged; 3: MC mode, p is ratio, r is 0/1; 4: random flip one from last path; 5: CFG-directed")
+    p.add_argument("-n", dest="native", action="store_true", help="use the native scheduling engine (modes 1-3, see native/)")
+    p.add_argument("-p", dest="state_dir", default=os.environ.get("MARCO_STATE_DIR", ""), help="persist the native graph under <dir>/sched and resume from it on restart (needs -n)")
     return p.parse_args()
 
 class Node():
@@ -60,10 +68,12 @@ class Node():
         self.fz_latest_cycle = 0    # TODO: fz_latest_cycle
 
 class Gsched():
-    def __init__(self, hybrid_mode, sched_mode):
+    def __init__(self, hybrid_mode, sched_mode, native=False, state_dir=""):
         self.h_mode = hybrid_mode
         self.s_mode = sched_mode
         self.rnd = np.random.RandomState(7)
+        # native engine mirrors the graph and counters and does the ranking
+        self.native = NativeSched(sched_mode) if native and sched_mode in [1, 2, 3] else None
 
         if self.s_mode == 4:
             self.fifo_record = []
@@ -77,6 +87,7 @@ class Gsched():
         self.G = nk.Graph(1, weighted=True, directed=True)
         self.addr_nodeid = {"Root": 0}
         self.node_attrs = [Node("Root", self.rnd.beta(1, 1))]
+        self.last_snapshot = time.time()
 
         ''' --------- global housekeeping info -------- '''
         self.queue_count = [0, 0]                        # fzq, ceq count
@@ -115,6 +126,49 @@ class Gsched():
         self.sched_cost = 0.0
         self.update_cost = 0.0
 
+        if self.native and state_dir:
+            store = os.path.join(state_dir, "sched")
+            os.makedirs(state_dir, exist_ok=True)
+            if self.native.open_store(store) > 1:
+                self.restore_from_native()
+            logger.info("native graph persisted under %s" % store)
+
+    def restore_from_native(self):
+        ''' pick up the graph, keys and counters of a reopened store; nothing is
+        copied here, keys resolve through the engine and a node's Python-side
+        state is built the first time it is used. Solving queues are not
+        persisted and refill as traces come in '''
+        t1 = time.time()
+        st = self.native.stats()
+        self.G.addNodes(st.nodes - 1)
+        self.addr_nodeid = RestoredKeys(self.native, st.nodes)
+        self.node_attrs = RestoredList(st.nodes, self.restore_node)
+        self.ceq_decid = RestoredList(st.decisions, self.restore_decision)
+        logger.info("restored %d nodes, %d edges, %d decisions in %fs"%(
+            st.nodes, st.edges, st.decisions, time.time() - t1))
+
+    def restore_node(self, i):
+        info = self.native.node(i)
+        key = "0x%x_%d_0"%(info.addr, info.ctx)
+        if info.outcome:
+            key += "-%d"%(info.dir)
+        node = Node(key, 0 if self.s_mode == 5 else self.rnd.beta(1, 1))
+        node.visit, node.attempt, node.win, node.status = info.visit, info.attempt, info.win, info.status
+        return node
+
+    def restore_decision(self, i):
+        # an ENDNEW without a pick is recorded as -1, which the store keeps as 0xffffffff
+        d = self.native.decision(i)
+        return -1 if d == 0xffffffff else d
+
+    def snapshot(self, force=False):
+        if not self.native or (not force and time.time() - self.last_snapshot < SNAPSHOT_SECS):
+            return
+        t1 = time.time()
+        if self.native.snapshot():
+            logger.info("graph snapshot in %fs"%(time.time() - t1))
+        self.last_snapshot = time.time()
+
 
     def log_progress(self):
 
@@ -135,6 +189,8 @@ class Gsched():
         logger.info("sched cost: %fs, update_cost: %fs"%(
             self.sched_cost, self.update_cost))
 
+        self.snapshot()
+
     def reset_for_new_trace(self):
         if self.last_queueid != self.cur_queueid and self.last_traceid != self.cur_traceid:
             self.total_traces += 1
@@ -153,6 +209,8 @@ class Gsched():
         if "UNSAT" in record:
             self.solve_unsat += 1
             self.node_attrs[self.latest_node_choice].status = DEAD
+            if self.native:
+                self.native.set_status(self.latest_node_choice, DEAD)
         if "DUP" in record:
             self.solve_duppp += 1
         if self.topo_changed():
@@ -160,9 +218,13 @@ class Gsched():
         return False
 
     def topo_changed(self):
-        cur_edgecnt = self.G.numberOfEdges()
-        cur_nodecnt = self.G.numberOfNodes()
-        cur_unvisited = len([i for i in self.G.iterNodes() if self.node_attrs[i].visit == 0])
+        if self.native:
+            st = self.native.stats()
+            cur_edgecnt, cur_nodecnt, cur_unvisited = st.edges, st.nodes, st.unvisited
+        else:
+            cur_edgecnt = self.G.numberOfEdges()
+            cur_nodecnt = self.G.numberOfNodes()
+            cur_unvisited = len([i for i in self.G.iterNodes() if self.node_attrs[i].visit == 0])
 
         if cur_nodecnt > self.last_graph_topo[NODECNT] or cur_unvisited > self.last_graph_topo[UNVICNT] or cur_edgecnt > self.last_graph_topo[EDGECNT]:
             self.last_graph_topo = [cur_edgecnt, cur_nodecnt, cur_unvisited]
@@ -181,15 +243,26 @@ class Gsched():
             self.node_attrs[nodeid].pcqueue.put((0, "#".join([PC_ids, extra])))
         else:
             self.node_attrs[nodeid].pcqueue.put((treedepth, "#".join([PC_ids, extra])))
+        if self.native:
+            self.native.set_actionable(nodeid, True)
 
         if (self.node_attrs[nodeid].attempt + self.node_attrs[nodeid].pcqueue.qsize()) >= MAXPC:
             self.node_attrs[nodeid].status = EXPLD
+            if self.native:
+                self.native.set_status(nodeid, EXPLD)
 
 
     def add_one(self, record):
         brc_ids, PC_ids = record.strip("\n").split("@")
         addr, ctxh, tkdir, label, self.cur_traceid, self.cur_queueid = [int(i) for i in brc_ids.replace(" ", "").strip("\n").split("-")]
+        self.add_branch(addr, ctxh, tkdir, label, PC_ids)
 
+    def add_edge(self, rec):
+        # binary twin of add_one for the shared-memory channel
+        self.cur_traceid, self.cur_queueid = rec.inputid, rec.queueid
+        self.add_branch(rec.pc, rec.ctx, rec.tkdir, rec.label, pc_ids(rec))
+
+    def add_branch(self, addr, ctxh, tkdir, label, PC_ids):
         # Note: label can be 0 (concrete branch) or non-zero (symbolic branch)
         # Concrete branches (label==0) are now also sent to scheduler to build complete graph
         # but they have PC_ids="none" so they won't be added to solving queue
@@ -207,6 +280,7 @@ class Gsched():
             return 
 
         ''' ---------- build the graph ---------- '''
+        pc = addr
         addr = "0x%x_%d_0"%(addr, ctxh)
 
         # brc triplet
@@ -233,12 +307,21 @@ class Gsched():
 
             self.new_calcNode += [Pnodeid, Tnodeid, Fnodeid]
 
-            # update edge in the graph, concrete edge
-            self.G.addEdge(self.cur_edgebeg, Pnodeid, w=1.0)
-            self.G.addEdge(Pnodeid, Tnodeid, w=1.0)
+            if not self.native:
+                # update edge in the graph, concrete edge
+                self.G.addEdge(self.cur_edgebeg, Pnodeid, w=1.0)
+                self.G.addEdge(Pnodeid, Tnodeid, w=1.0)
 
-            # update edge in the graph, symbolic edge
-            self.G.addEdge(Pnodeid, Fnodeid, w=0.0)
+                # update edge in the graph, symbolic edge
+                self.G.addEdge(Pnodeid, Fnodeid, w=0.0)
+            else:
+                # the engine holds the edges, networkit only tracks the node count
+                self.native.add_node(False, 0, pc, ctxh)
+                self.native.add_node(True, Pnodeid, pc, ctxh, tkdir)
+                self.native.add_node(True, Pnodeid, pc, ctxh, 1-tkdir)
+                self.native.add_edge(self.cur_edgebeg, Pnodeid, 1.0)
+                self.native.add_edge(Pnodeid, Tnodeid, 1.0)
+                self.native.add_edge(Pnodeid, Fnodeid, 0.0)
 
         else:
             Pnodeid = self.addr_nodeid[p_root]
@@ -246,8 +329,12 @@ class Gsched():
             Fnodeid = self.addr_nodeid[child_F]
 
             # update edge in the graph, concrete edge
-            self.G.increaseWeight(self.cur_edgebeg, Pnodeid, 1.0)
-            self.G.increaseWeight(Pnodeid, Tnodeid, 1.0)
+            if not self.native:
+                self.G.increaseWeight(self.cur_edgebeg, Pnodeid, 1.0)
+                self.G.increaseWeight(Pnodeid, Tnodeid, 1.0)
+            else:
+                self.native.increase_weight(self.cur_edgebeg, Pnodeid, 1.0)
+                self.native.increase_weight(Pnodeid, Tnodeid, 1.0)
 
             # feedback update for ceq seeds
             if self.cur_queueid == 1 and self.cur_traceid >= 0:
@@ -255,6 +342,8 @@ class Gsched():
                 # update win count, once per trace (only when visited);
                 if nodechoice == Tnodeid and self.node_check == False:
                     self.node_attrs[nodechoice].win += 1
+                    if self.native:
+                        self.native.bump(nodechoice, win=1)
                     self.node_check = True
                     # logger.info("win update node %d in trace (%d): win: %d, attempt: %d"%(
                     #     nodechoice, self.cur_traceid,
@@ -285,6 +374,9 @@ class Gsched():
             if self.cur_queueid == CEQID:
                 self.node_attrs[Pnodeid].visit += 1
                 self.node_attrs[Tnodeid].visit += 1
+                if self.native:
+                    self.native.bump(Pnodeid, visit=1)
+                    self.native.bump(Tnodeid, visit=1)
             else:
                 self.node_attrs[Pnodeid].fz_trace.add(self.cur_traceid)
                 self.node_attrs[Tnodeid].fz_trace.add(self.cur_traceid)
@@ -292,6 +384,9 @@ class Gsched():
         else:               # fzq are just extra corpus
             self.node_attrs[Pnodeid].visit += 1
             self.node_attrs[Tnodeid].visit += 1
+            if self.native:
+                self.native.bump(Pnodeid, visit=1)
+                self.native.bump(Tnodeid, visit=1)
 
         # reset edge begin node for next node
         self.cur_edgebeg = Tnodeid
@@ -354,12 +449,7 @@ class Gsched():
         PC_ids, extra = PC_ids.split("#")
         is_good, qid, self.pp_hash, treedepth, plen, conc_dir, tid, nid = [int(i) for i in PC_ids.replace(" ", "").strip("\n").split("-")]
         
-        extra = extra.replace(".", "#")
-        extra = extra.replace(",", ".")
-
-        res = "%d,%d,%d,%d,%d,%d,%s,\n"%(qid, tid, nid, conc_dir, plen, self.pp_hash, extra)
-        fifo.write(res)
-        fifo.flush()
+        self.send_decision(fifo, qid, tid, nid, conc_dir, plen, self.pp_hash, extra)
 
 
     def random_one(self, fifo):
@@ -385,19 +475,18 @@ class Gsched():
 
         PC_ids, extra = PC_ids.split("#")
         is_good, qid, self.pp_hash, treedepth, plen, conc_dir, tid, nid = [int(i) for i in PC_ids.replace(" ", "").strip("\n").split("-")]
-        extra = extra.replace(".", "#")
-        extra = extra.replace(",", ".")
-        res = "%d,%d,%d,%d,%d,%d,%s,\n"%(qid, tid, nid, conc_dir, plen, self.pp_hash, extra)
-        
-        fifo.write(res)
-        fifo.flush()        
+        self.send_decision(fifo, qid, tid, nid, conc_dir, plen, self.pp_hash, extra)
 
     def sched_one(self, fifo, rerank=True):
         self.sched_round_all += 1
 
         if rerank or not self.valid_old_queue():
-            edge_p_dict = self.graphUpdate()
-            self.latest_nodes_rank = self.pick_one(edge_p_dict)
+            if self.native:
+                self.compute_round += 1
+                self.latest_nodes_rank = self.native.rank(int(self.G.numberOfNodes() / 3))
+            else:
+                edge_p_dict = self.graphUpdate()
+                self.latest_nodes_rank = self.pick_one(edge_p_dict)
 
         if not self.latest_nodes_rank:      # FIXME: bug for early termination?
             logger.info("No valid node for scheduling!")
@@ -405,6 +494,8 @@ class Gsched():
 
         self.latest_node_choice, topNodeScore = self.latest_nodes_rank.pop(0)
         PC_ids = self.node_attrs[self.latest_node_choice].pcqueue.get()[1]
+        if self.native and self.node_attrs[self.latest_node_choice].pcqueue.empty():
+            self.native.set_actionable(self.latest_node_choice, False)
         PC_ids, extra = PC_ids.split("#")
         # PC_ids format after add_one: is_good-qid-pp_hash-treedepth-plen-conc_dir-tid-nid-cur_loc-tkdir-traceid-label
         # We need to extract only the first 8 fields for scheduling decision
@@ -422,12 +513,7 @@ class Gsched():
                 is_good, qid, self.pp_hash, treedepth, plen, conc_dir, tid, nid = 0, 0, 0, 0, 0, 0, 0, 0
         if is_good:
             self.sched_round_brc += 1
-        extra = extra.replace(".", "#")
-        extra = extra.replace(",", ".")
-
-        res = "%d,%d,%d,%d,%d,%d,%s,\n"%(qid, tid, nid, conc_dir, plen, self.pp_hash, extra)
-        fifo.write(res)
-        fifo.flush()
+        self.send_decision(fifo, qid, tid, nid, conc_dir, plen, self.pp_hash, extra)
 
         # log decision from leaf or interior
         if self.node_attrs[self.latest_node_choice].visit == 0:
@@ -435,6 +521,16 @@ class Gsched():
         else:
             self.intepick += 1
 
+    def send_decision(self, fifo, qid, tid, nid, conc_dir, plen, pp_hash, extra):
+        if isinstance(fifo, DecisionChannel):
+            fifo.send_decision(qid, tid, nid, conc_dir, plen, pp_hash, extra)
+            return
+        extra = extra.replace(".", "#")
+        extra = extra.replace(",", ".")
+        res = "%d,%d,%d,%d,%d,%d,%s,\n"%(qid, tid, nid, conc_dir, plen, pp_hash, extra)
+        fifo.write(res)
+        fifo.flush()
+
     def POT_iterative(self):
         s1 = []
         s2 = []
@@ -575,9 +671,13 @@ class Gsched():
 
 
     def run(self):
+        chan_path = os.environ.get("MARCO_CHANNEL", "")
+        if chan_path:
+            self.run_channel(chan_path)
+            return
         newdata = ""
-        with open("/tmp/pcpipe", "r") as fp:
-            with open("/tmp/myfifo", "w") as fifo:
+        with open(os.path.join(PIPE_DIR, "pcpipe"), "r") as fp:
+            with open(os.path.join(PIPE_DIR, "myfifo"), "w") as fifo:
                 while True:
                     newdata += fp.readline()
                     if len(newdata) == 0 or "@@" not in newdata:
@@ -600,135 +700,166 @@ class Gsched():
                                 t1 = time.time()
                                 self.add_one(record.replace("\n", " "))
                                 self.update_cost += (time.time() - t1)
-                            elif "ENDNEW" in record: # last pick resulted in a normal solving
-                                self.ceq_decid.append(self.latest_node_choice)
-                                self.node_attrs[self.latest_node_choice].attempt += 1
-                                parentKey = self.node_attrs[self.latest_node_choice].parentKey
-                                self.node_attrs[self.addr_nodeid[parentKey]].attempt += 1
-                                self.solve_normal += 1
-                                self.reset_for_new_trace()
-                                # Reset dummy_unblock_sent flag so we can send dummy decision if needed after next END@@
-                                self.dummy_unblock_sent = False
-                                # if random flipper, reset the record to include only the current trace
-                                if self.s_mode == 4:
-                                    # self.maxrecord = max(self.maxrecord, len(self.fifo_record))
-                                    # fail safe; 
-                                    self.fifo_record1 = self.fifo_record + self.fifo_record1
-                                    self.fifo_record1 = self.fifo_record1[:self.maxrecord]
-                                    # reset record 
-                                    logger.info("leng: %d"%(len(self.fifo_record)))
-                                    logger.info("leng1: %d"%(len(self.fifo_record1)))
-                                    self.fifo_record = [] 
-                                    # free disk space if not gonna pick that source seed for flipping 
-                                    self.free_space(self.fifo_record1[-1])
-                                # Note: After ENDNEW@@, FastGen will continue processing next file in queue
-                                # We should wait for the next END@@ (after FastGen processes next file) to check actionable nodes
-                                # So we don't check actionable nodes here - let the next END@@ handler do it                                  
-                                    
-                            elif not ("UNSAT" in record or "DUP" in record or "FIN" in record):
-                                # First END@@ after trace ingestion: check if we have actionable nodes
-                                # If yes, write scheduling decision to unblock FastGen
-                                # This handles the initial case where FastGen waits for first decision
-                                prev_traceid = self.cur_traceid
-                                prev_queueid = self.cur_queueid
-
-                                # Check if we have any actionable nodes (nodes with non-empty pcqueue)
-                                has_actionable = False
-                                actionable_count = 0
-                                total_nodes = 0
-                                nodes_with_pcqueue = 0
-                                for i in self.G.iterNodes():
-                                    total_nodes += 1
-                                    if i != 0 and "-" in self.node_attrs[i].key:
-                                        if not self.node_attrs[i].pcqueue.empty():
-                                            nodes_with_pcqueue += 1
-                                            has_actionable = True
-                                            actionable_count += 1
-                                
-                                # Debug logging
-                                logger.info("END@@ check: total_nodes=%d, nodes_with_pcqueue=%d, actionable_count=%d, has_actionable=%s" % 
-                                           (total_nodes, nodes_with_pcqueue, actionable_count, has_actionable))
-                                
-                                if has_actionable:
-                                    # Write first scheduling decision to unblock FastGen
-                                    t1 = time.time()
-                                    if self.s_mode == 4:                    # for random flipper
-                                        self.random_one(fifo)
-                                    elif self.s_mode == 5:
-                                        self.cfg_one(fifo)
-                                    else:                                   # for graph involved scheduler
-                                        self.sched_one(fifo, rerank=True)
-                                    self.sched_cost += (time.time() - t1)
-                                    if self.sched_round_all % 100 == 0:
-                                        self.log_progress()
-                                    self.dummy_unblock_sent = False
-                                    logger.info("Sent real scheduling decision (not dummy)")
-                                else:
-                                    if not self.dummy_unblock_sent:
-                                        logger.info("No actionable nodes, writing dummy decision to unblock FastGen")
-                                        dummy_tid = prev_traceid if prev_traceid >= 0 else self.last_traceid
-                                        dummy_qid = prev_queueid if prev_queueid >= 0 else self.last_queueid
-                                        if dummy_tid >= 0 and dummy_qid >= 0:
-                                            dummy_res = "%d,%d,%d,%d,%d,%d,,\n" % (dummy_qid, dummy_tid, 999999, 0, 0, 0)
-                                        else:
-                                            dummy_res = "0,0,999999,0,0,0,,\n"
-                                        fifo.write(dummy_res)
-                                        fifo.flush()
-                                        logger.info("Wrote dummy decision: %s" % dummy_res.strip())
-                                        self.dummy_unblock_sent = True
-                                    else:
-                                        logger.info("No actionable nodes and dummy already sent; skipping dummy decision")
-                                
-                                self.reset_for_new_trace()
-
-                            else: # prompt a new decision;
-                                # initial corpus done, start scheduling (ENDDUP / ENDUNSAT / ENDFIN)
-                                t1 = time.time()
+                            else:
+                                self.on_token(record, fifo)
+
+    def run_channel(self, path):
+        chan = DecisionChannel(path)
+        logger.info("attached to FastGen channel %s" % path)
+        while True:
+            rec = chan.recv_edge()
+            if rec is None:
+                logger.info("FastGen closed the channel")
+                self.snapshot(force=True)
+                break
+            if rec.kind == CHAN_EDGE:
+                t1 = time.time()
+                self.add_edge(rec)
+                self.update_cost += (time.time() - t1)
+            else:
+                self.on_token(TOKENS[rec.kind], chan)
+        chan.close()
+
+    def on_token(self, record, fifo):
+        if "ENDNEW" in record: # last pick resulted in a normal solving
+            self.ceq_decid.append(self.latest_node_choice)
+            if self.native:
+                self.native.add_decision(self.latest_node_choice)
+            self.node_attrs[self.latest_node_choice].attempt += 1
+            parentKey = self.node_attrs[self.latest_node_choice].parentKey
+            self.node_attrs[self.addr_nodeid[parentKey]].attempt += 1
+            if self.native:
+                self.native.bump(self.latest_node_choice, attempt=1)
+                self.native.bump(self.addr_nodeid[parentKey], attempt=1)
+            self.solve_normal += 1
+            self.reset_for_new_trace()
+            # Reset dummy_unblock_sent flag so we can send dummy decision if needed after next END@@
+            self.dummy_unblock_sent = False
+            # if random flipper, reset the record to include only the current trace
+            if self.s_mode == 4:
+                # self.maxrecord = max(self.maxrecord, len(self.fifo_record))
+                # fail safe; 
+                self.fifo_record1 = self.fifo_record + self.fifo_record1
+                self.fifo_record1 = self.fifo_record1[:self.maxrecord]
+                # reset record 
+                logger.info("leng: %d"%(len(self.fifo_record)))
+                logger.info("leng1: %d"%(len(self.fifo_record1)))
+                self.fifo_record = [] 
+                # free disk space if not gonna pick that source seed for flipping 
+                self.free_space(self.fifo_record1[-1])
+            # Note: After ENDNEW@@, FastGen will continue processing next file in queue
+            # We should wait for the next END@@ (after FastGen processes next file) to check actionable nodes
+            # So we don't check actionable nodes here - let the next END@@ handler do it                                  
+                
+        elif not ("UNSAT" in record or "DUP" in record or "FIN" in record):
+            # First END@@ after trace ingestion: check if we have actionable nodes
+            # If yes, write scheduling decision to unblock FastGen
+            # This handles the initial case where FastGen waits for first decision
+            prev_traceid = self.cur_traceid
+            prev_queueid = self.cur_queueid
+
+            # Check if we have any actionable nodes (nodes with non-empty pcqueue)
+            has_actionable = False
+            actionable_count = 0
+            total_nodes = 0
+            nodes_with_pcqueue = 0
+            if self.native:
+                st = self.native.stats()
+                total_nodes = st.nodes
+                nodes_with_pcqueue = actionable_count = st.actionable
+                has_actionable = st.actionable > 0
+            else:
+                for i in self.G.iterNodes():
+                    total_nodes += 1
+                    if i != 0 and "-" in self.node_attrs[i].key:
+                        if not self.node_attrs[i].pcqueue.empty():
+                            nodes_with_pcqueue += 1
+                            has_actionable = True
+                            actionable_count += 1
+            
+            # Debug logging
+            logger.info("END@@ check: total_nodes=%d, nodes_with_pcqueue=%d, actionable_count=%d, has_actionable=%s" % 
+                       (total_nodes, nodes_with_pcqueue, actionable_count, has_actionable))
+            
+            if has_actionable:
+                # Write first scheduling decision to unblock FastGen
+                t1 = time.time()
+                if self.s_mode == 4:                    # for random flipper
+                    self.random_one(fifo)
+                elif self.s_mode == 5:
+                    self.cfg_one(fifo)
+                else:                                   # for graph involved scheduler
+                    self.sched_one(fifo, rerank=True)
+                self.sched_cost += (time.time() - t1)
+                if self.sched_round_all % 100 == 0:
+                    self.log_progress()
+                self.dummy_unblock_sent = False
+                logger.info("Sent real scheduling decision (not dummy)")
+            else:
+                if not self.dummy_unblock_sent:
+                    logger.info("No actionable nodes, writing dummy decision to unblock FastGen")
+                    dummy_tid = prev_traceid if prev_traceid >= 0 else self.last_traceid
+                    dummy_qid = prev_queueid if prev_queueid >= 0 else self.last_queueid
+                    if dummy_tid < 0 or dummy_qid < 0:
+                        dummy_tid, dummy_qid = 0, 0
+                    self.send_decision(fifo, dummy_qid, dummy_tid, 999999, 0, 0, 0, "")
+                    logger.info("Wrote dummy decision: qid=%d tid=%d" % (dummy_qid, dummy_tid))
+                    self.dummy_unblock_sent = True
+                else:
+                    logger.info("No actionable nodes and dummy already sent; skipping dummy decision")
+            
+            self.reset_for_new_trace()
+
+        else: # prompt a new decision;
+            # initial corpus done, start scheduling (ENDDUP / ENDUNSAT / ENDFIN)
+            t1 = time.time()
+
+            # Update stats before scheduling
+            if self.s_mode == 4:
+                if "UNSAT" in record:
+                    self.solve_unsat += 1
+                if "DUP" in record:
+                    self.solve_duppp += 1
+
+            has_actionable = False
+            if self.native:
+                has_actionable = self.native.stats().actionable > 0
+            else:
+                for i in self.G.iterNodes():
+                    if i != 0 and "-" in self.node_attrs[i].key and not self.node_attrs[i].pcqueue.empty():
+                        has_actionable = True
+                        break
+
+            if has_actionable:
+                if self.s_mode == 4:                    # for random flipper
+                    self.random_one(fifo)
+                elif self.s_mode == 5:
+                    self.cfg_one(fifo)
+                else:                                   # for graph involved scheduler
+                    need_rerank = self.do_aftermath(record)
+                    self.sched_one(fifo, rerank=need_rerank)
+                self.dummy_unblock_sent = False
+            else:
+                if not self.dummy_unblock_sent:
+                    logger.info("No actionable nodes after ENDDUP/ENDUNSAT, writing dummy decision to unblock FastGen")
+                    if self.last_traceid >= 0 and self.last_queueid >= 0:
+                        dummy_tid, dummy_qid = self.last_traceid, self.last_queueid
+                    else:
+                        dummy_tid, dummy_qid = 0, 0
+                    self.send_decision(fifo, dummy_qid, dummy_tid, 999999, 0, 0, 0, "")
+                    logger.info("Wrote dummy decision: qid=%d tid=%d" % (dummy_qid, dummy_tid))
+                    self.dummy_unblock_sent = True
+                else:
+                    logger.info("No actionable nodes and dummy already sent; skipping dummy decision")
+            
+            self.sched_cost += (time.time() - t1)
 
-                                # Update stats before scheduling
-                                if self.s_mode == 4:
-                                    if "UNSAT" in record:
-                                        self.solve_unsat += 1
-                                    if "DUP" in record:
-                                        self.solve_duppp += 1
-
-                                has_actionable = False
-                                for i in self.G.iterNodes():
-                                    if i != 0 and "-" in self.node_attrs[i].key and not self.node_attrs[i].pcqueue.empty():
-                                        has_actionable = True
-                                        break
-
-                                if has_actionable:
-                                    if self.s_mode == 4:                    # for random flipper
-                                        self.random_one(fifo)
-                                    elif self.s_mode == 5:
-                                        self.cfg_one(fifo)
-                                    else:                                   # for graph involved scheduler
-                                        need_rerank = self.do_aftermath(record)
-                                        self.sched_one(fifo, rerank=need_rerank)
-                                    self.dummy_unblock_sent = False
-                                else:
-                                    if not self.dummy_unblock_sent:
-                                        logger.info("No actionable nodes after ENDDUP/ENDUNSAT, writing dummy decision to unblock FastGen")
-                                        if self.last_traceid >= 0 and self.last_queueid >= 0:
-                                            dummy_res = "%d,%d,%d,%d,%d,%d,,\n" % (self.last_queueid, self.last_traceid, 999999, 0, 0, 0)
-                                        else:
-                                            dummy_res = "0,0,999999,0,0,0,,\n"
-                                        fifo.write(dummy_res)
-                                        fifo.flush()
-                                        logger.info("Wrote dummy decision: %s" % dummy_res.strip())
-                                        self.dummy_unblock_sent = True
-                                    else:
-                                        logger.info("No actionable nodes and dummy already sent; skipping dummy decision")
-                                
-                                self.sched_cost += (time.time() - t1)
-
-                                self.reset_for_new_trace()
-                                if self.sched_round_all % 100 == 0:
-                                    self.log_progress()
+            self.reset_for_new_trace()
+            if self.sched_round_all % 100 == 0:
+                self.log_progress()
 
 
 if __name__ == "__main__":
     args = parse_args()
-    scheduler = Gsched(args.hybrid_mode, args.sched_mode)
+    scheduler = Gsched(args.hybrid_mode, args.sched_mode, args.native, args.state_dir)
     scheduler.run()
\ No newline at end of file
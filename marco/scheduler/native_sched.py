@@ -0,0 +1,218 @@
+#!/usr/bin/python3
+# ctypes wrapper for the native scheduling engine (native/sched_core.h).
+# Build it with: cmake -S native -B native/build && cmake --build native/build
+import ctypes
+import os
+
+ALIVE = 0
+DEAD = 1
+EXPLD = 2
+NONE = 0xffffffff
+
+# ranking is cheap natively, so ask for a short prefix and rerank more often
+RANK_CAP = 256
+
+_here = os.path.dirname(os.path.abspath(__file__))
+_candidates = [
+    os.environ.get("MARCO_SCHED_LIB", ""),
+    os.path.join(_here, "native", "build", "libmarco_sched.so"),
+    os.path.join(_here, "..", "src", "scheduler", "native", "build", "libmarco_sched.so"),
+]
+
+
+class SchedStats(ctypes.Structure):
+    _fields_ = [("nodes", ctypes.c_uint64),
+                ("edges", ctypes.c_uint64),
+                ("unvisited", ctypes.c_uint64),
+                ("actionable", ctypes.c_uint64),
+                ("rounds", ctypes.c_uint64),
+                ("last_recomputed", ctypes.c_uint64),
+                ("decisions", ctypes.c_uint64),
+                ("log_records", ctypes.c_uint64)]
+
+
+class SchedNodeInfo(ctypes.Structure):
+    _fields_ = [("addr", ctypes.c_uint64),
+                ("ctx", ctypes.c_uint64),
+                ("parent", ctypes.c_uint32),
+                ("visit", ctypes.c_uint32),
+                ("attempt", ctypes.c_uint32),
+                ("win", ctypes.c_uint32),
+                ("outcome", ctypes.c_int32),
+                ("dir", ctypes.c_int32),
+                ("status", ctypes.c_int32)]
+
+
+def _load():
+    for path in _candidates:
+        if path and os.path.exists(path):
+            lib = ctypes.CDLL(path)
+            break
+    else:
+        raise OSError("libmarco_sched.so not found, set MARCO_SCHED_LIB")
+    u32, u64, dbl, ptr = ctypes.c_uint32, ctypes.c_uint64, ctypes.c_double, ctypes.c_void_p
+    lib.msched_create.restype = ptr
+    lib.msched_create.argtypes = [ctypes.c_int, u64]
+    lib.msched_destroy.argtypes = [ptr]
+    lib.msched_add_node.restype = u32
+    lib.msched_open_store.restype = ctypes.c_int64
+    lib.msched_open_store.argtypes = [ptr, ctypes.c_char_p]
+    lib.msched_snapshot.restype = ctypes.c_int
+    lib.msched_snapshot.argtypes = [ptr]
+    lib.msched_add_node.argtypes = [ptr, ctypes.c_int, u32, u64, u64, ctypes.c_int]
+    lib.msched_add_edge.argtypes = [ptr, u32, u32, dbl]
+    lib.msched_increase_weight.argtypes = [ptr, u32, u32, dbl]
+    lib.msched_bump.argtypes = [ptr, u32, u32, u32, u32]
+    lib.msched_set_status.argtypes = [ptr, u32, ctypes.c_int]
+    lib.msched_set_actionable.argtypes = [ptr, u32, ctypes.c_int]
+    lib.msched_set_freeze.argtypes = [ptr, ctypes.c_int]
+    lib.msched_rank.restype = u32
+    lib.msched_rank.argtypes = [ptr, ctypes.POINTER(u32), ctypes.POINTER(dbl), u32]
+    lib.msched_score.restype = dbl
+    lib.msched_score.argtypes = [ptr, u32]
+    lib.msched_stats.argtypes = [ptr, ctypes.POINTER(SchedStats)]
+    lib.msched_add_decision.argtypes = [ptr, u32]
+    lib.msched_decision.restype = u32
+    lib.msched_decision.argtypes = [ptr, u32]
+    lib.msched_node.restype = ctypes.c_int
+    lib.msched_node.argtypes = [ptr, u32, ctypes.POINTER(SchedNodeInfo)]
+    lib.msched_find.restype = u32
+    lib.msched_find.argtypes = [ptr, ctypes.c_int, u64, u64, ctypes.c_int]
+    lib.msched_edge.restype = ctypes.c_int
+    lib.msched_edge.argtypes = [ptr, u32, ctypes.POINTER(u32), ctypes.POINTER(u32), ctypes.POINTER(dbl)]
+    return lib
+
+
+class NativeSched():
+    ''' node ids follow Gsched.addr_nodeid, the root is node 0 '''
+    def __init__(self, sched_mode, seed=7):
+        self.lib = _load()
+        self.s = self.lib.msched_create(sched_mode, seed)
+        # MARCO_SCHED_FREEZE=1 keeps clean candidates' samples between rounds
+        if os.environ.get("MARCO_SCHED_FREEZE", "0") not in ("", "0"):
+            self.lib.msched_set_freeze(self.s, 1)
+        self.rank_nodes = (ctypes.c_uint32 * RANK_CAP)()
+        self.rank_scores = (ctypes.c_double * RANK_CAP)()
+
+    def __del__(self):
+        if getattr(self, "s", None):
+            self.lib.msched_destroy(self.s)
+            self.s = None
+
+    def open_store(self, path):
+        ''' node count recovered from path (1 when fresh), raises if unusable '''
+        n = self.lib.msched_open_store(self.s, path.encode())
+        if n < 0:
+            raise OSError("cannot open scheduler store %s" % path)
+        return n
+
+    def snapshot(self):
+        return self.lib.msched_snapshot(self.s) == 0
+
+    def add_node(self, outcome, parent=0, addr=0, ctx=0, tkdir=0):
+        return self.lib.msched_add_node(self.s, 1 if outcome else 0, parent, addr, ctx, tkdir)
+
+    def add_edge(self, beg, end, w):
+        self.lib.msched_add_edge(self.s, beg, end, w)
+
+    def increase_weight(self, beg, end, w):
+        self.lib.msched_increase_weight(self.s, beg, end, w)
+
+    def bump(self, node, visit=0, attempt=0, win=0):
+        self.lib.msched_bump(self.s, node, visit, attempt, win)
+
+    def set_status(self, node, status):
+        self.lib.msched_set_status(self.s, node, status)
+
+    def set_actionable(self, node, actionable):
+        self.lib.msched_set_actionable(self.s, node, 1 if actionable else 0)
+
+    def rank(self, cap):
+        ''' [(nodeid, discounted score)], best first, like Gsched.pick_one '''
+        n = self.lib.msched_rank(self.s, self.rank_nodes, self.rank_scores, min(cap, RANK_CAP))
+        return [(self.rank_nodes[i], self.rank_scores[i]) for i in range(n)]
+
+    def score(self, node):
+        return self.lib.msched_score(self.s, node)
+
+    def stats(self):
+        st = SchedStats()
+        self.lib.msched_stats(self.s, ctypes.byref(st))
+        return st
+
+    def add_decision(self, node):
+        self.lib.msched_add_decision(self.s, node)
+
+    def decision(self, idx):
+        return self.lib.msched_decision(self.s, idx)
+
+    def node(self, node):
+        info = SchedNodeInfo()
+        self.lib.msched_node(self.s, node, ctypes.byref(info))
+        return info
+
+    def edge(self, edge):
+        beg, end, w = ctypes.c_uint32(), ctypes.c_uint32(), ctypes.c_double()
+        self.lib.msched_edge(self.s, edge, ctypes.byref(beg), ctypes.byref(end), ctypes.byref(w))
+        return beg.value, end.value, w.value
+
+    def find(self, key):
+        ''' node id of a Gsched key ("0x<addr>_<ctx>_0[-dir]"), None if unknown '''
+        if key == "Root":
+            return 0
+        branch, _, tkdir = key.partition("-")
+        addr, ctx, _ = branch.split("_")
+        n = self.lib.msched_find(self.s, 1 if tkdir else 0, int(addr, 16), int(ctx),
+                                 int(tkdir) if tkdir else 0)
+        return None if n == NONE else n
+
+
+class RestoredKeys():
+    ''' Gsched.addr_nodeid after a restart: keys of recovered nodes resolve
+    through the engine, keys added since are kept here '''
+    def __init__(self, native, count):
+        self.native = native
+        self.count = count
+        self.added = {}
+
+    def __contains__(self, key):
+        return key in self.added or self.native.find(key) is not None
+
+    def __getitem__(self, key):
+        n = self.added.get(key)
+        if n is None:
+            n = self.native.find(key)
+            if n is None:
+                raise KeyError(key)
+        return n
+
+    def __setitem__(self, key, n):
+        self.added[key] = n
+
+    def __len__(self):
+        return self.count + len(self.added)
+
+
+class RestoredList():
+    ''' Gsched.node_attrs / ceq_decid after a restart: the first count entries
+    are built by load(i) on first use, later ones are appended as usual '''
+    def __init__(self, count, load):
+        self.count = count
+        self.load = load
+        self.loaded = {}
+        self.added = []
+
+    def __getitem__(self, i):
+        if i < 0:
+            i += len(self)
+        if i >= self.count:
+            return self.added[i - self.count]
+        if i not in self.loaded:
+            self.loaded[i] = self.load(i)
+        return self.loaded[i]
+
+    def append(self, v):
+        self.added.append(v)
+
+    def __len__(self):
+        return self.count + len(self.added)
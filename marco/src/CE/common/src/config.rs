@@ -1,6 +1,8 @@
 // branch.rs
 pub const MAP_SIZE_POW2: usize = 20;
 pub const BRANCHES_SIZE: usize = 1 << MAP_SIZE_POW2;
+// entries of the per-run touch log, runs touching more fall back to a map scan
+pub const TOUCH_LOG_SIZE: usize = 1 << 16;
 pub const ENABLE_RANDOM_LEN: bool = false;
 pub const ENABLE_MICRO_RANDOM_LEN: bool = true;
 pub const TMOUT_SKIP: usize = 3;
@@ -8,6 +8,7 @@ pub static TRACK_OUTPUT_VAR: &str = "ANGORA_TRACK_OUTPUT";
 pub static COND_STMT_ENV_VAR: &str = "ANGORA_COND_STMT_SHM_ID";
 pub static BRANCHES_SHM_ENV_VAR: &str = "ANGORA_BRANCHES_SHM_ID";
 pub static PATH_HASH_SHM_ENV_VAR: &str = "PATH_HASH_SHM_ID";
+pub static TOUCH_LOG_SHM_ENV_VAR: &str = "ANGORA_TOUCH_LOG_SHM_ID";
 pub static LD_LIBRARY_PATH_VAR: &str = "LD_LIBRARY_PATH";
 pub static ASAN_OPTIONS_VAR: &str = "ASAN_OPTIONS";
 pub static MSAN_OPTIONS_VAR: &str = "MSAN_OPTIONS";
@@ -30,6 +31,9 @@ pub static GRADER_P_DIR: &str = "../grader-path/queue";
 // forksrv.rs
 pub static ENABLE_FORKSRV: &str = "ANGORA_ENABLE_FORKSRV";
 pub static FORKSRV_SOCKET_PATH_VAR: &str = "ANGORA_FORKSRV_SOCKET_PATH";
+pub static SYMFIT_FORKSRV_SOCKET_PATH_VAR: &str = "SYMFIT_FORKSRV_SOCKET_PATH";
+pub static DISABLE_TRACK_FORKSRV_VAR: &str = "MARCO_DISABLE_TRACK_FORKSRV";
+pub const FORKSRV_CONNECT_TIMEOUT: u64 = 10;
 
 // command.rs
 pub static ANGORA_DIR_NAME: &str = "angora";
@@ -1,6 +1,7 @@
 pub mod config;
 pub mod defs;
 pub mod shm;
+pub mod touch_log;
 
 
 #[no_mangle]
@@ -0,0 +1,43 @@
+// Indices of the branch map entries touched by one execution.
+//
+// Fast-mode instrumentation calls __angora_touch when an edge counter goes
+// from 0 to 1, so a run logs each entry it touched once (twice if two target
+// threads race on the same counter, which only double counts that edge). The
+// tracker then walks this log instead of the whole map, and clears only the
+// logged entries before the next run.
+//
+// `active` is set by the target runtime once it has attached the log. A
+// tracker that finds it unset (target built without the hook) or finds the
+// log overflowed falls back to scanning the whole map.
+use crate::config::TOUCH_LOG_SIZE;
+use std::sync::atomic::{AtomicU32, Ordering};
+
+#[repr(C)]
+pub struct TouchLog {
+    pub active: AtomicU32,
+    pub len: AtomicU32, // keeps counting past TOUCH_LOG_SIZE to flag overflow
+    pub idx: [u32; TOUCH_LOG_SIZE],
+}
+
+impl TouchLog {
+    // target side
+    pub unsafe fn push(log: *mut TouchLog, idx: u32) {
+        let n = (*log).len.fetch_add(1, Ordering::Relaxed) as usize;
+        if n < TOUCH_LOG_SIZE {
+            (*log).idx[n] = idx;
+        }
+    }
+
+    // tracker side: what the last run touched, None if the map must be scanned
+    pub fn touched(&self) -> Option<&[u32]> {
+        let n = self.len.load(Ordering::Relaxed) as usize;
+        if self.active.load(Ordering::Relaxed) == 0 || n > TOUCH_LOG_SIZE {
+            return None;
+        }
+        Some(&self.idx[..n])
+    }
+
+    pub fn reset(&self) {
+        self.len.store(0, Ordering::Relaxed);
+    }
+}
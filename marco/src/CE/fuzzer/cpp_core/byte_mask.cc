@@ -0,0 +1,158 @@
+#include "byte_mask.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#include <vector>
+
+#define BYTE_MASK_MAGIC 0x316b73614d7a4dULL // "MzMask1"
+#define BYTE_MASK_MAX_WEIGHT 0xffff
+#define BYTE_MASK_MAX_LEN 0xffff
+
+ByteMaskTable::ByteMaskTable()
+  : map_(nullptr), map_size_(0), slots_(nullptr), mask_(0), active_(false),
+    queue_id_(0), seed_id_(0), published_(0) {
+}
+
+ByteMaskTable::~ByteMaskTable() {
+  if (map_) munmap(map_, map_size_);
+}
+
+bool ByteMaskTable::open(const std::string &path, uint32_t slot_bits) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    fprintf(stderr, "[ByteMaskTable]cannot open %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  Header existing;
+  if (pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+      existing.magic == BYTE_MASK_MAGIC) {
+    slot_bits = existing.slot_bits;
+  }
+  size_t size = sizeof(Header) + ((size_t)1 << slot_bits) * sizeof(Slot);
+  struct stat st;
+  if (fstat(fd, &st) < 0 || ((size_t)st.st_size < size && ftruncate(fd, size) < 0)) {
+    fprintf(stderr, "[ByteMaskTable]cannot size %s: %s\n", path.c_str(), strerror(errno));
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "[ByteMaskTable]cannot map %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  Header *hdr = (Header *)map;
+  if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != BYTE_MASK_MAGIC) {
+    hdr->slot_bits = slot_bits;
+    hdr->max_runs = BYTE_MASK_MAX_RUNS;
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(&hdr->magic, &expected, BYTE_MASK_MAGIC, false,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+  }
+  map_ = map;
+  map_size_ = size;
+  slots_ = (Slot *)((uint8_t *)map + sizeof(Header));
+  mask_ = ((uint64_t)1 << slot_bits) - 1;
+  return true;
+}
+
+void ByteMaskTable::begin(uint32_t queue_id, uint32_t seed_id) {
+  if (active_ && queue_id == queue_id_ && seed_id == seed_id_) return;
+  publish();
+  active_ = true;
+  queue_id_ = queue_id;
+  seed_id_ = seed_id;
+}
+
+void ByteMaskTable::add_branch(const std::unordered_set<uint32_t> &deps, bool unsolved) {
+  if (!active_) return;
+  for (auto off : deps) {
+    uint32_t &w = weights_[off];
+    if (w == 0) w = 1;
+    if (unsolved && w < BYTE_MASK_MAX_WEIGHT) w++;
+  }
+}
+
+void ByteMaskTable::publish() {
+  if (!active_) return;
+  active_ = false;
+  if (!slots_ || weights_.empty()) {
+    weights_.clear();
+    return;
+  }
+
+  std::vector<std::pair<uint32_t, uint32_t>> offs(weights_.begin(), weights_.end());
+  weights_.clear();
+  std::sort(offs.begin(), offs.end());
+
+  std::vector<Run> runs;
+  for (auto &o : offs) {
+    if (!runs.empty()) {
+      Run &last = runs.back();
+      if (last.start + last.len == o.first && last.weight == o.second &&
+          last.len < BYTE_MASK_MAX_LEN) {
+        last.len++;
+        continue;
+      }
+    }
+    Run r = {o.first, 1, (uint16_t)o.second};
+    runs.push_back(r);
+  }
+
+  // too many runs: close the smallest gaps first, the merged run keeps the
+  // highest weight of its parts
+  if (runs.size() > BYTE_MASK_MAX_RUNS) {
+    std::vector<uint32_t> gaps(runs.size() - 1);
+    for (size_t i = 0; i + 1 < runs.size(); i++)
+      gaps[i] = runs[i + 1].start - (runs[i].start + runs[i].len);
+    std::vector<uint32_t> sorted(gaps);
+    size_t need = runs.size() - BYTE_MASK_MAX_RUNS;
+    std::nth_element(sorted.begin(), sorted.begin() + (need - 1), sorted.end());
+    uint32_t threshold = sorted[need - 1];
+    size_t below = std::count_if(gaps.begin(), gaps.end(),
+                                 [threshold](uint32_t g) { return g < threshold; });
+    size_t at_threshold = need - below;
+    std::vector<Run> merged;
+    merged.push_back(runs[0]);
+    for (size_t i = 0; i + 1 < runs.size(); i++) {
+      Run &last = merged.back();
+      const Run &next = runs[i + 1];
+      bool join = gaps[i] < threshold || (gaps[i] == threshold && at_threshold > 0);
+      uint32_t len = next.start + next.len - last.start;
+      if (join && len <= BYTE_MASK_MAX_LEN) {
+        if (gaps[i] == threshold) at_threshold--;
+        last.len = len;
+        last.weight = std::max(last.weight, next.weight);
+      } else {
+        merged.push_back(next);
+      }
+    }
+    runs.swap(merged);
+    if (runs.size() > BYTE_MASK_MAX_RUNS) runs.resize(BYTE_MASK_MAX_RUNS);
+  }
+
+  uint32_t total = 0;
+  for (auto &r : runs) total += (uint32_t)r.len * r.weight;
+
+  uint64_t key = ((uint64_t)queue_id_ << 32) | seed_id_;
+  Slot *s = &slots_[(key * 0x9e3779b97f4a7c15ULL >> 32) & mask_];
+  uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+  // somebody else is writing this slot, just skip
+  if ((seq & 1) || !__atomic_compare_exchange_n(&s->seq, &seq, seq + 1, false,
+                                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return;
+  s->queue_id = queue_id_;
+  s->seed_id = seed_id_;
+  s->nruns = runs.size();
+  s->flags = 1;
+  s->total = total;
+  memcpy(s->runs, runs.data(), runs.size() * sizeof(Run));
+  __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+  published_++;
+}
@@ -0,0 +1,72 @@
+#ifndef BYTE_MASK_H_
+#define BYTE_MASK_H_
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Per-seed byte relevance, published for the mutational fuzzers.
+//
+// While a trace is ingested, every symbolic branch adds its input offsets to
+// the mask of the traced seed. An offset that only feeds branches we have
+// already explored gets weight 1; each branch whose other side is still open
+// adds 1 more. At the end of the trace the mask is written as a list of runs
+// (consecutive offsets with the same weight) into a fixed-size, mmap-backed
+// table (MARCO_BYTE_MASK, <MARCO_PIPE_DIR>/marco_byte_mask by default), one
+// slot per (queue id, seed id). Slots use the same sequence counter scheme
+// as SolverCache, so a reader never sees a half-written mask.
+//
+// The layout is read by marco/src/afl_mutator/byte_mask_mutator.c; keep both
+// in sync.
+
+#define BYTE_MASK_MAX_RUNS 254
+
+class ByteMaskTable {
+public:
+  ByteMaskTable();
+  ~ByteMaskTable();
+
+  bool open(const std::string &path, uint32_t slot_bits);
+  bool is_open() const { return slots_ != nullptr; }
+
+  // start collecting for a seed, publishing the previous one if needed
+  void begin(uint32_t queue_id, uint32_t seed_id);
+  void add_branch(const std::unordered_set<uint32_t> &deps, bool unsolved);
+  void publish();
+
+  uint64_t published() const { return published_; }
+
+private:
+  struct Header {
+    uint64_t magic;
+    uint32_t slot_bits;
+    uint32_t max_runs;
+  };
+  struct Run {
+    uint32_t start;
+    uint16_t len;
+    uint16_t weight;
+  };
+  struct Slot {
+    uint32_t seq;      // odd while a writer owns the slot
+    uint32_t queue_id;
+    uint32_t seed_id;
+    uint16_t nruns;
+    uint16_t flags;    // bit 0: slot holds a mask
+    uint32_t total;    // sum of weight * len over all runs
+    uint32_t pad;
+    Run runs[BYTE_MASK_MAX_RUNS];
+  };
+
+  void *map_;
+  size_t map_size_;
+  Slot *slots_;
+  uint64_t mask_;
+  bool active_;
+  uint32_t queue_id_;
+  uint32_t seed_id_;
+  std::unordered_map<uint32_t, uint32_t> weights_;
+  uint64_t published_;
+};
+
+#endif
@@ -0,0 +1,307 @@
+#include "decision_channel.h"
+#include <sys/types.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/eventfd.h>
+#include <sys/syscall.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+static_assert(sizeof(ChanEdgeRecord) == 144, "edge record layout is shared with decision_channel.py");
+static_assert(sizeof(ChanDecisionRecord) == 112, "decision record layout is shared with decision_channel.py");
+static_assert(sizeof(ChanHeader) == 320, "header layout is shared with decision_channel.py");
+
+DecisionChannel::DecisionChannel()
+  : hdr_(nullptr), edges_(nullptr), decisions_(nullptr),
+    memfd_(-1), efd_edges_(-1), efd_decisions_(-1), sock_(-1) {
+}
+
+DecisionChannel::~DecisionChannel() {
+  close_channel();
+}
+
+void DecisionChannel::close_channel() {
+  if (hdr_) munmap(hdr_, CHAN_SEGMENT_SIZE);
+  hdr_ = nullptr;
+  edges_ = nullptr;
+  decisions_ = nullptr;
+  int *fds[] = {&memfd_, &efd_edges_, &efd_decisions_, &sock_};
+  for (int *fd : fds) {
+    if (*fd >= 0) close(*fd);
+    *fd = -1;
+  }
+}
+
+bool DecisionChannel::map_segment(int memfd) {
+  void *p = mmap(nullptr, CHAN_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, memfd, 0);
+  if (p == MAP_FAILED) {
+    fprintf(stderr, "[DecisionChannel]mmap failed: %s\n", strerror(errno));
+    return false;
+  }
+  hdr_ = (ChanHeader*)p;
+  edges_ = (uint8_t*)p + CHAN_EDGE_OFFSET;
+  decisions_ = (uint8_t*)p + CHAN_DECISION_OFFSET;
+  return true;
+}
+
+static bool fill_addr(const std::string &path, struct sockaddr_un &addr) {
+  if (path.size() >= sizeof(addr.sun_path)) {
+    fprintf(stderr, "[DecisionChannel]socket path too long: %s\n", path.c_str());
+    return false;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path.c_str());
+  return true;
+}
+
+bool DecisionChannel::serve(const std::string &path) {
+  struct sockaddr_un addr;
+  if (!fill_addr(path, addr)) return false;
+
+  memfd_ = syscall(SYS_memfd_create, "marco_chan", 0);
+  efd_edges_ = eventfd(0, EFD_CLOEXEC);
+  efd_decisions_ = eventfd(0, EFD_CLOEXEC);
+  if (memfd_ < 0 || efd_edges_ < 0 || efd_decisions_ < 0) {
+    fprintf(stderr, "[DecisionChannel]cannot create memfd/eventfd: %s\n", strerror(errno));
+    close_channel();
+    return false;
+  }
+  if (ftruncate(memfd_, CHAN_SEGMENT_SIZE) != 0 || !map_segment(memfd_)) {
+    close_channel();
+    return false;
+  }
+  memset(hdr_, 0, sizeof(ChanHeader));
+  hdr_->version = CHAN_VERSION;
+  hdr_->edge_slots = CHAN_EDGE_SLOTS;
+  hdr_->decision_slots = CHAN_DECISION_SLOTS;
+  hdr_->edge_size = sizeof(ChanEdgeRecord);
+  hdr_->decision_size = sizeof(ChanDecisionRecord);
+  __atomic_store_n(&hdr_->magic, CHAN_MAGIC, __ATOMIC_RELEASE);
+
+  int lsock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (lsock < 0) {
+    close_channel();
+    return false;
+  }
+  unlink(path.c_str());
+  if (bind(lsock, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(lsock, 1) != 0) {
+    fprintf(stderr, "[DecisionChannel]cannot listen on %s: %s\n", path.c_str(), strerror(errno));
+    close(lsock);
+    close_channel();
+    return false;
+  }
+  // like opening the FIFOs, this blocks until the scheduler shows up
+  do {
+    sock_ = accept4(lsock, nullptr, nullptr, SOCK_CLOEXEC);
+  } while (sock_ < 0 && errno == EINTR);
+  close(lsock);
+  unlink(path.c_str());
+  if (sock_ < 0) {
+    fprintf(stderr, "[DecisionChannel]accept failed: %s\n", strerror(errno));
+    close_channel();
+    return false;
+  }
+
+  int fds[3] = {memfd_, efd_edges_, efd_decisions_};
+  char tag = 'C';
+  struct iovec iov = {&tag, 1};
+  char cbuf[CMSG_SPACE(sizeof(fds))];
+  memset(cbuf, 0, sizeof(cbuf));
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = sizeof(cbuf);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  cmsg->cmsg_level = SOL_SOCKET;
+  cmsg->cmsg_type = SCM_RIGHTS;
+  cmsg->cmsg_len = CMSG_LEN(sizeof(fds));
+  memcpy(CMSG_DATA(cmsg), fds, sizeof(fds));
+  if (sendmsg(sock_, &msg, MSG_NOSIGNAL) != 1) {
+    fprintf(stderr, "[DecisionChannel]cannot pass descriptors: %s\n", strerror(errno));
+    close_channel();
+    return false;
+  }
+  return true;
+}
+
+bool DecisionChannel::attach(const std::string &path) {
+  struct sockaddr_un addr;
+  if (!fill_addr(path, addr)) return false;
+  sock_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (sock_ < 0) return false;
+  // FastGen may not be listening yet
+  while (connect(sock_, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+    if (errno != ENOENT && errno != ECONNREFUSED && errno != EINTR) {
+      fprintf(stderr, "[DecisionChannel]cannot connect to %s: %s\n", path.c_str(), strerror(errno));
+      close_channel();
+      return false;
+    }
+    usleep(10000);
+  }
+
+  int fds[3];
+  char tag;
+  struct iovec iov = {&tag, 1};
+  char cbuf[CMSG_SPACE(sizeof(fds))];
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = cbuf;
+  msg.msg_controllen = sizeof(cbuf);
+  ssize_t n;
+  do {
+    n = recvmsg(sock_, &msg, MSG_CMSG_CLOEXEC);
+  } while (n < 0 && errno == EINTR);
+  struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+  if (n != 1 || !cmsg || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(fds))) {
+    fprintf(stderr, "[DecisionChannel]no descriptors from %s\n", path.c_str());
+    close_channel();
+    return false;
+  }
+  memcpy(fds, CMSG_DATA(cmsg), sizeof(fds));
+  memfd_ = fds[0];
+  efd_edges_ = fds[1];
+  efd_decisions_ = fds[2];
+  if (!map_segment(memfd_)) {
+    close_channel();
+    return false;
+  }
+  if (__atomic_load_n(&hdr_->magic, __ATOMIC_ACQUIRE) != CHAN_MAGIC ||
+      hdr_->version != CHAN_VERSION ||
+      hdr_->edge_size != sizeof(ChanEdgeRecord) ||
+      hdr_->decision_size != sizeof(ChanDecisionRecord)) {
+    fprintf(stderr, "[DecisionChannel]segment layout mismatch\n");
+    close_channel();
+    return false;
+  }
+  return true;
+}
+
+// the socket carries no data after the handshake; readable means EOF
+bool DecisionChannel::peer_alive() {
+  struct pollfd pfd = {sock_, POLLIN, 0};
+  return poll(&pfd, 1, 0) == 0;
+}
+
+bool DecisionChannel::push(ChanRingCtl &ctl, uint8_t *base, uint32_t slots, size_t size,
+                           const void *rec, int efd, bool force_signal) {
+  uint64_t head = ctl.head; // producer owned
+  while (head - __atomic_load_n(&ctl.tail, __ATOMIC_ACQUIRE) >= slots) {
+    // ring full: the consumer is behind, give it a moment
+    if (!peer_alive()) return false;
+    usleep(100);
+  }
+  memcpy(base + (head & (slots - 1)) * size, rec, size);
+  __atomic_store_n(&ctl.head, head + 1, __ATOMIC_RELEASE);
+  // pairs with the fence in pop() between setting waiting and re-reading head
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (force_signal || __atomic_load_n(&ctl.waiting, __ATOMIC_RELAXED)) {
+    uint64_t one = 1;
+    if (write(efd, &one, sizeof(one)) != sizeof(one))
+      fprintf(stderr, "[DecisionChannel]eventfd write failed: %s\n", strerror(errno));
+  }
+  return true;
+}
+
+bool DecisionChannel::pop(ChanRingCtl &ctl, uint8_t *base, uint32_t slots, size_t size,
+                          void *rec, int efd) {
+  uint64_t tail = ctl.tail; // consumer owned
+  while (__atomic_load_n(&ctl.head, __ATOMIC_ACQUIRE) == tail) {
+    __atomic_store_n(&ctl.waiting, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ctl.head, __ATOMIC_ACQUIRE) == tail) {
+      struct pollfd pfds[2] = {{efd, POLLIN, 0}, {sock_, POLLIN, 0}};
+      int r = poll(pfds, 2, -1);
+      if (r < 0 && errno != EINTR) return false;
+      if (pfds[0].revents & POLLIN) {
+        uint64_t cnt;
+        if (read(efd, &cnt, sizeof(cnt)) < 0 && errno != EAGAIN && errno != EINTR)
+          return false;
+      } else if (pfds[1].revents) {
+        // peer gone; still hand out whatever it published before exiting
+        __atomic_store_n(&ctl.waiting, 0, __ATOMIC_RELAXED);
+        if (__atomic_load_n(&ctl.head, __ATOMIC_ACQUIRE) == tail) return false;
+      }
+    }
+    __atomic_store_n(&ctl.waiting, 0, __ATOMIC_RELAXED);
+  }
+  memcpy(rec, base + (tail & (slots - 1)) * size, size);
+  __atomic_store_n(&ctl.tail, tail + 1, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool DecisionChannel::send_edge(const ChanEdgeRecord &rec) {
+  if (!hdr_) return false;
+  return push(hdr_->edges, edges_, CHAN_EDGE_SLOTS, sizeof(ChanEdgeRecord),
+              &rec, efd_edges_, rec.kind != CHAN_EDGE);
+}
+
+bool DecisionChannel::send_token(uint32_t kind) {
+  ChanEdgeRecord rec;
+  memset(&rec, 0, sizeof(rec));
+  rec.kind = kind;
+  return send_edge(rec);
+}
+
+bool DecisionChannel::send_decision(const ChanDecisionRecord &rec) {
+  if (!hdr_) return false;
+  return push(hdr_->decisions, decisions_, CHAN_DECISION_SLOTS, sizeof(ChanDecisionRecord),
+              &rec, efd_decisions_, true);
+}
+
+bool DecisionChannel::recv_decision(ChanDecisionRecord &rec) {
+  if (!hdr_) return false;
+  return pop(hdr_->decisions, decisions_, CHAN_DECISION_SLOTS, sizeof(ChanDecisionRecord),
+             &rec, efd_decisions_);
+}
+
+bool DecisionChannel::recv_edge(ChanEdgeRecord &rec) {
+  if (!hdr_) return false;
+  return pop(hdr_->edges, edges_, CHAN_EDGE_SLOTS, sizeof(ChanEdgeRecord),
+             &rec, efd_edges_);
+}
+
+std::string chan_extra_string(const ChanDecisionRecord &rec) {
+  std::string extra;
+  for (uint32_t i = 0; i < rec.nextra && i < CHAN_MAX_EXTRA; i++)
+    extra += std::to_string(rec.extra[i * 2]) + "." + std::to_string(rec.extra[i * 2 + 1]) + "#";
+  return extra;
+}
+
+std::vector<std::pair<uint32_t, uint32_t>> parse_extra_pairs(const std::string &extra) {
+  std::vector<std::pair<uint32_t, uint32_t>> pairs;
+  size_t start = 0;
+  while (start < extra.size()) {
+    size_t end = extra.find_first_of("#@", start);
+    if (end == std::string::npos)
+      end = extra.size();
+    std::string entry = extra.substr(start, end - start);
+    start = end + 1;
+    // the comma form ("label,dir.") is what get_extra_tuple writes
+    size_t delim = entry.find(',');
+    if (delim == std::string::npos)
+      delim = entry.find('.');
+    if (delim == std::string::npos || delim == 0)
+      continue;
+    char *stop;
+    unsigned long label = strtoul(entry.c_str(), &stop, 10);
+    if (stop != entry.c_str() + delim)
+      continue;
+    const char *dir_str = entry.c_str() + delim + 1;
+    unsigned long dir = strtoul(dir_str, &stop, 10);
+    if (stop == dir_str)
+      continue;
+    pairs.emplace_back((uint32_t)label, (uint32_t)dir);
+  }
+  return pairs;
+}
@@ -0,0 +1,144 @@
+#ifndef DECISION_CHANNEL_H_
+#define DECISION_CHANNEL_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Binary replacement for the /tmp/pcpipe + /tmp/myfifo text protocol between
+// FastGen and the scheduler.
+//
+// FastGen creates a memfd-backed segment holding two single-producer /
+// single-consumer rings (edges FastGen -> scheduler, decisions scheduler ->
+// FastGen) and one eventfd per direction, then hands the three descriptors
+// to the scheduler over a unix socket (SCM_RIGHTS) at the path given in
+// MARCO_CHANNEL. The socket stays connected so either side notices when the
+// other one exits. The scheduler side is mirrored in decision_channel.py;
+// keep the layout below in sync with it.
+//
+// Wakeups: a consumer that finds its ring empty sets `waiting` and blocks on
+// the eventfd. Producers signal when `waiting` is set and always after an
+// END token / decision, so the record that completes a round never waits on
+// a missed wakeup.
+
+#define CHAN_MAGIC 0x314e4843 // "CHN1"
+#define CHAN_VERSION 1
+#define CHAN_EDGE_SLOTS (1 << 14)
+#define CHAN_DECISION_SLOTS (1 << 6)
+#define CHAN_MAX_EXTRA 10 // MAX_EXTRA_CONSTRAINTS in get_extra_tuple
+
+// record kinds on the edge ring; END* mirror the text tokens
+enum ChanKind {
+  CHAN_EDGE = 0,
+  CHAN_END = 1,
+  CHAN_ENDNEW = 2,
+  CHAN_ENDDUP = 3,
+  CHAN_ENDUNSAT = 4,
+};
+
+#define CHAN_EDGE_NOPC 0x1  // graph update only, not a solving candidate ("@none")
+#define CHAN_EDGE_FORCED 0x2 // concrete branch forced into the solving queue
+
+struct ChanEdgeRecord {
+  uint32_t kind;
+  uint32_t flags;
+  uint64_t pc;
+  uint64_t ctx;
+  uint32_t tkdir;
+  uint32_t label;
+  uint32_t inputid;
+  uint32_t queueid;
+  uint32_t is_good;
+  uint32_t depth;
+  uint64_t pp_hash;
+  uint32_t nextra;
+  uint32_t pad;
+  uint32_t extra[CHAN_MAX_EXTRA * 2]; // (label, dir) pairs
+};
+
+struct ChanDecisionRecord {
+  uint32_t qid;
+  uint32_t tid;
+  uint32_t nid;
+  uint32_t conc_dir;
+  uint32_t plen;
+  uint32_t nextra;
+  uint64_t pp_hash;
+  uint32_t extra[CHAN_MAX_EXTRA * 2];
+};
+
+// head is written by the producer only, tail and waiting by the consumer only;
+// each side gets its own cache line
+struct ChanRingCtl {
+  uint64_t head;
+  uint8_t pad0[56];
+  uint64_t tail;
+  uint32_t waiting;
+  uint8_t pad1[52];
+};
+
+struct ChanHeader {
+  uint32_t magic;
+  uint32_t version;
+  uint32_t edge_slots;
+  uint32_t decision_slots;
+  uint32_t edge_size;
+  uint32_t decision_size;
+  uint8_t pad[40];
+  ChanRingCtl edges;
+  ChanRingCtl decisions;
+};
+
+#define CHAN_EDGE_OFFSET 4096
+#define CHAN_DECISION_OFFSET (CHAN_EDGE_OFFSET + CHAN_EDGE_SLOTS * sizeof(ChanEdgeRecord))
+#define CHAN_SEGMENT_SIZE (CHAN_DECISION_OFFSET + CHAN_DECISION_SLOTS * sizeof(ChanDecisionRecord))
+
+class DecisionChannel {
+public:
+  DecisionChannel();
+  ~DecisionChannel();
+
+  // FastGen side: create the segment, listen on path and block until the
+  // scheduler connects
+  bool serve(const std::string &path);
+  // scheduler side: connect to path and map the segment
+  bool attach(const std::string &path);
+  bool is_open() const { return hdr_ != nullptr; }
+  void close_channel();
+
+  // FastGen -> scheduler; false once the peer is gone
+  bool send_edge(const ChanEdgeRecord &rec);
+  bool send_token(uint32_t kind);
+  // scheduler -> FastGen
+  bool send_decision(const ChanDecisionRecord &rec);
+
+  // blocking receives; false once the peer is gone
+  bool recv_decision(ChanDecisionRecord &rec);
+  bool recv_edge(ChanEdgeRecord &rec);
+
+private:
+  bool map_segment(int memfd);
+  bool push(ChanRingCtl &ctl, uint8_t *base, uint32_t slots, size_t size,
+            const void *rec, int efd, bool force_signal);
+  bool pop(ChanRingCtl &ctl, uint8_t *base, uint32_t slots, size_t size,
+           void *rec, int efd);
+  bool peer_alive();
+
+  ChanHeader *hdr_;
+  uint8_t *edges_;
+  uint8_t *decisions_;
+  int memfd_;
+  int efd_edges_;     // signalled when edges are published
+  int efd_decisions_; // signalled when decisions are published
+  int sock_;
+};
+
+// extra constraints of a decision in the text form the FIFO path carries,
+// "label.dir#label.dir#..."
+std::string chan_extra_string(const ChanDecisionRecord &rec);
+// split an extra string into (label, dir) pairs; entries are separated by '#'
+// (or '@') and written "label.dir" or "label,dir"; malformed entries are skipped
+std::vector<std::pair<uint32_t, uint32_t>> parse_extra_pairs(const std::string &extra);
+
+#endif
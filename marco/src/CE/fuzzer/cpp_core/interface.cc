@@ -2,6 +2,14 @@
 #include <unordered_set>
 #include <stdio.h>
 #include "util.h"
+#include "output_writer.h"
+#include "solution_filter.h"
+#include "solver_cache.h"
+#include "decision_channel.h"
+#include "prefix_store.h"
+#include "byte_mask.h"
+#include "trace_capture.h"
+#include "marco_metrics.h"
 #include "ctpl.h"
 #include "union_table.h"
 #include "rgd_op.h"
@@ -24,6 +32,7 @@
 #include <array>
 #include <cctype>
 #include <vector>
+#include <algorithm>
 
 #define B_FLIPPED 0x1
 #define THREAD_POOL_SIZE 1
@@ -37,7 +46,19 @@ static std::atomic<uint64_t> fid;      // depth of the current branch
 static std::atomic<uint64_t> ce_count; // output file id
 int named_pipe_fd;
 std::ifstream pcsetpipe;
+// binary replacement for /tmp/pcpipe and /tmp/myfifo, enabled by MARCO_CHANNEL
+static DecisionChannel decision_chan;
 static FILE* cxx_log_fp = NULL;
+// per-record logging on the ingest path; MARCO_TRACE_DEBUG=0 turns it off,
+// fastgen-replay only turns it on with MARCO_TRACE_DEBUG=1
+static bool trace_debug = true;
+
+// wp2/pcpipe/myfifo live in MARCO_PIPE_DIR (default /tmp), so that parallel
+// instances started by the orchestrator each get their own set
+static std::string pipe_path(const char *name) {
+  const char *dir = getenv("MARCO_PIPE_DIR");
+  return std::string(dir && dir[0] != '\0' ? dir : "/tmp") + "/" + name;
+}
 
 bool SAVING_WHOLE;
 
@@ -71,6 +92,8 @@ uint32_t total_pruned_ones = 0;
 // uint64_t init_count = 0;
 uint64_t untaken_update_ifsat = 0; // carry the pathprefix of untaken branch, in case of sat nested solving, mark it;
 std::string input_file = "/outroot/tmp/cur_input_2";
+// input_file as of the start of the trace being ingested
+static ParentFuture trace_parent;
 
 static dfsan_label_info *__union_table;
 
@@ -85,6 +108,27 @@ struct RGDSolution {
 
 moodycamel::ConcurrentQueue<RGDSolution> solution_queue;
 
+// all test case and tree dump I/O goes through the writer thread
+#define OUTPUT_QUEUE_CAP 1024
+static OutputWriter output_writer(OUTPUT_QUEUE_CAP);
+
+// 2^16 buckets x 4 fingerprints (4MB), kept for the whole FastGen lifetime
+#define SOLUTION_FILTER_BITS 16
+static SolutionFilter solution_filter(SOLUTION_FILTER_BITS);
+
+// verdicts shared by every FastGen on the host, 2^18 slots x 64B
+#define SOLVER_CACHE_BITS 18
+#define SOLVER_CACHE_DEFAULT_PATH "/tmp/marco_solver_cache"
+static QueryCanonicalizer query_canon;
+static SolverCache solver_cache;
+
+// per-seed relevant input bytes for the mutational fuzzers, 2^12 slots x 2KB
+#define BYTE_MASK_BITS 12
+static ByteMaskTable byte_mask;
+
+// MARCO_CAPTURE=<file> records traces and decisions for fastgen-replay
+static TraceCapture capture;
+
 
 // dependencies
 struct dedup_hash {
@@ -134,6 +178,58 @@ struct labeltuple_hash {
 
 typedef std::unordered_set<std::tuple<uint32_t, uint32_t>, labeltuple_hash> labeltuple_set_t;
 
+// union-find over input byte offsets, for independence partitioning of nested sets
+struct byte_union_find {
+  std::unordered_map<uint32_t, uint32_t> parent;
+  uint32_t find(uint32_t x) {
+    auto itr = parent.find(x);
+    if (itr == parent.end()) {
+      parent[x] = x;
+      return x;
+    }
+    uint32_t root = x;
+    while (parent[root] != root) root = parent[root];
+    while (parent[x] != root) {
+      uint32_t next = parent[x];
+      parent[x] = root;
+      x = next;
+    }
+    return root;
+  }
+  void unite(uint32_t a, uint32_t b) {
+    uint32_t ra = find(a), rb = find(b);
+    if (ra != rb) parent[rb] = ra;
+  }
+};
+
+// a parsed nested constraint, held back until its component is known
+struct nested_constraint_t {
+  uint32_t label;
+  uint32_t dir;
+  z3::expr cond;
+  std::unordered_set<uint32_t> inputs;
+};
+
+// per-component results for the trace currently loaded in the union table,
+// keyed by the sorted (label,dir) constraints of the component, target included
+struct component_result_t {
+  z3::check_result res;
+  std::unordered_map<uint32_t, uint8_t> sol;
+};
+static std::unordered_map<std::string, component_result_t> component_cache;
+static uint64_t component_cache_trace = (uint64_t)-1;
+uint32_t total_dropped_nested = 0;
+uint32_t total_component_hits = 0;
+
+// outcome of each solving request, by the mode that produced the input
+#define RELAX_TIME_BUDGET 2000 // ms per request for unsat-core relaxation
+uint32_t total_full_sat = 0;
+uint32_t total_relaxed_sat = 0;
+uint32_t total_opt_sat = 0;
+uint32_t total_unsat = 0;
+uint32_t total_relax_tries = 0;
+uint64_t total_relax_time = 0;
+
 // Extended constraint tuple: (label, tkdir, addr, ctx, path_prefix_hash) to identify source-level branch and execution path
 struct constraint_tuple_t {
   uint32_t label;
@@ -259,7 +355,8 @@ static void get_input_deps(dfsan_label label, std::unordered_set<uint32_t> &deps
       deps.insert(offset + i);
     }
     return;
-  } else if (info->op == DFSAN_ZEXT || info->op == DFSAN_SEXT || info->op == DFSAN_TRUNC || info->op == DFSAN_EXTRACT) {
+  } else if (info->op == DFSAN_ZEXT || info->op == DFSAN_SEXT || info->op == DFSAN_TRUNC || info->op == DFSAN_EXTRACT ||
+             info->op == DFSAN_BSWAP) {
     get_input_deps(info->l1, deps);
     return;
   } else if (info->op == DFSAN_NOT || info->op == DFSAN_NEG) {
@@ -282,7 +379,8 @@ static void get_input_deps(dfsan_label label, std::unordered_set<uint32_t> &deps
 // get the extra [label, dir] in the prefix for completing the nested set;
 // Improved filtering: allow multiple source-level branches (different labels) in path prefix,
 // but filter out duplicate constraints for the same label
-std::string get_extra_tuple(dfsan_label label, uint32_t tkdir, int ifmemorize) {
+std::string get_extra_tuple(dfsan_label label, uint32_t tkdir, int ifmemorize,
+                            std::vector<std::pair<uint32_t, uint32_t>> *pairs = nullptr) {
   std::string res = "";
   // deps of the label alone
   std::unordered_set<dfsan_label> inputs;
@@ -324,6 +422,7 @@ std::string get_extra_tuple(dfsan_label label, uint32_t tkdir, int ifmemorize) {
           for (auto &expr : deps->label_tuples) {
             if (added.insert(expr).second) {
               res += (std::to_string(std::get<0>(expr)) + "," + std::to_string(std::get<1>(expr)) + ".");
+              if (pairs) pairs->push_back(std::make_pair(std::get<0>(expr), std::get<1>(expr)));
               constraint_count++;
               if (constraint_count >= MAX_EXTRA_CONSTRAINTS) {
                 // Stop collecting more constraints once limit is reached
@@ -458,6 +557,31 @@ static z3::expr serialize(dfsan_label label, std::unordered_set<uint32_t> &deps)
     z3::expr e = serialize(info->l2, deps);
     info->tree_size = get_label_info(info->l2)->tree_size; // lazy init
     return cache_expr(label, -e, deps);
+  } else if (info->op == DFSAN_BSWAP) {
+    // op2 low bytes reversed, the lowest one ends up on top
+    z3::expr base = serialize(info->l1, deps);
+    uint32_t bytes = info->op2;
+    z3::expr out = base.extract(7, 0);
+    for (uint32_t i = 1; i < bytes; i++) {
+      out = z3::concat(out, base.extract(i * 8 + 7, i * 8));
+    }
+    if (bytes * 8 < info->size) {
+      out = z3::zext(out, info->size - bytes * 8);
+    }
+    info->tree_size = get_label_info(info->l1)->tree_size; // lazy init
+    return cache_expr(label, out, deps);
+  } else if (info->op == DFSAN_SELECT) {
+    // table lookup: l1 ? op1 : (l2 or op2), the taken side is always concrete
+    z3::expr cond = serialize(info->l1, deps);
+    z3::expr other = __z3_context.bv_val((uint64_t)info->op2, info->size);
+    if (info->l2 >= CONST_OFFSET) {
+      std::unordered_set<uint32_t> deps2;
+      other = serialize(info->l2, deps2);
+      deps.insert(deps2.begin(), deps2.end());
+    }
+    info->tree_size = get_label_info(info->l1)->tree_size +
+      get_label_info(info->l2)->tree_size; // lazy init
+    return cache_expr(label, z3::ite(cond, __z3_context.bv_val((uint64_t)info->op1, info->size), other), deps);
   }
   // common ops
   uint8_t size = info->size;
@@ -521,6 +645,13 @@ static z3::expr serialize(dfsan_label label, std::unordered_set<uint32_t> &deps)
     }
                   // concat
     case DFSAN_CONCAT:  return cache_expr(label, z3::concat(op2, op1), deps); // little endian
+                  // rotates and funnel shift, amounts modulo the width
+    case DFSAN_ROTL:    return cache_expr(label, z3::expr(__z3_context, Z3_mk_ext_rotate_left(__z3_context, op1, op2)), deps);
+    case DFSAN_ROTR:    return cache_expr(label, z3::expr(__z3_context, Z3_mk_ext_rotate_right(__z3_context, op1, op2)), deps);
+    case DFSAN_FSHR:    {
+      uint32_t ofs = info->op >> 8;
+      return cache_expr(label, z3::concat(op1, op2).extract(ofs + info->size - 1, ofs), deps);
+    }
     default:
                   printf("FATAL: unsupported op: %u\n", info->op);
                   // throw z3::exception("unsupported operator");
@@ -534,6 +665,28 @@ static z3::expr serialize(dfsan_label label, std::unordered_set<uint32_t> &deps)
 void init(bool saving_whole) {
   SAVING_WHOLE = saving_whole;
   __branch_deps = new std::vector<branch_dep_t*>(100000, nullptr);
+  output_writer.start();
+  // MARCO_SOLVER_CACHE=0 turns the shared verdict cache off
+  const char *cache_env = getenv("MARCO_SOLVER_CACHE");
+  if (!cache_env || strcmp(cache_env, "0") != 0) {
+    std::string cache_path = (cache_env && cache_env[0] != '\0') ? std::string(cache_env) : std::string(SOLVER_CACHE_DEFAULT_PATH);
+    if (!solver_cache.open(cache_path, SOLVER_CACHE_BITS))
+      std::cout << "[init] solver cache disabled, cannot open " << cache_path << std::endl;
+  }
+  // MARCO_BYTE_MASK=0 stops publishing byte masks
+  const char *mask_env = getenv("MARCO_BYTE_MASK");
+  if (!mask_env || strcmp(mask_env, "0") != 0) {
+    std::string mask_path = (mask_env && mask_env[0] != '\0') ? std::string(mask_env) : pipe_path("marco_byte_mask");
+    if (!byte_mask.open(mask_path, BYTE_MASK_BITS))
+      std::cout << "[init] byte masks disabled, cannot open " << mask_path << std::endl;
+  }
+  const char *debug_env = getenv("MARCO_TRACE_DEBUG");
+  trace_debug = !debug_env || strcmp(debug_env, "0") != 0;
+  const char *capture_env = getenv("MARCO_CAPTURE");
+  if (capture_env && capture_env[0] != '\0') {
+    if (capture.open(capture_env, sizeof(dfsan_label_info)))
+      std::cout << "[init] capturing traces to " << capture_env << std::endl;
+  }
 }
 
 void cleanup1();
@@ -542,6 +695,25 @@ int cleanup_deps();
 bool check_pp(uint64_t digest);
 void mark_pp(uint64_t digest);
 
+// hand a solution to the writer unless the same bytes were already emitted for this parent;
+// the duplicate check runs before a file id is taken, so fifo/queue ids stay contiguous.
+// The parent was requested from the writer before solving and is normally loaded by now.
+static bool emit_solution(std::unordered_map<uint32_t, uint8_t> &solu, const ParentFuture &parent, std::string &out_dir) {
+  ParentRef seed = parent.valid() ? parent.get() : nullptr;
+  if (!seed) {
+    std::cout << "parent seed unreadable, solution dropped" << std::endl;
+    return false;
+  }
+  if (!solution_filter.insert(*seed, solu)) {
+    std::cout << "duplicate solution for " << seed->path << ", dropped (total dups "
+              << solution_filter.hits() << ")" << std::endl;
+    return false;
+  }
+  output_writer.write_input(solu, seed, out_dir, ce_count+=1);
+  marco_count(MM_INPUTS_GENERATED, 1);
+  return true;
+}
+
 static void generate_solution(z3::model &m, std::unordered_map<uint32_t, uint8_t> &solu) {
   unsigned num_constants = m.num_consts();
   for(unsigned i = 0; i< num_constants; i++) {
@@ -561,6 +733,88 @@ static void generate_solution(z3::model &m, std::unordered_map<uint32_t, uint8_t
 }
 
 
+// check the assertions in solver, consulting the shared verdict cache first;
+// on sat, solu receives the model (relocated from the cache or taken from z3)
+static z3::check_result cached_check(z3::solver &solver, std::unordered_map<uint32_t, uint8_t> &solu) {
+  QueryKey key;
+  bool keyed = solver_cache.is_open() && query_canon.canonicalize(solver.assertions(), key);
+  if (keyed) {
+    SolverCache::Verdict v = solver_cache.lookup(key, query_canon.positions(), solu);
+    if (v != SolverCache::MISS) marco_count(MM_SOLVER_CACHE_HITS, 1);
+    if (v == SolverCache::UNSAT) return z3::unsat;
+    if (v == SolverCache::SAT) return z3::sat;
+  }
+  uint64_t check_start = marco_metrics_now();
+  z3::check_result res = solver.check();
+  marco_observe(MH_SOLVER_CHECK_US, marco_metrics_now() - check_start);
+  if (res == z3::sat) {
+    z3::model m = solver.get_model();
+    generate_solution(m, solu);
+    if (keyed) solver_cache.store_sat(key, query_canon.positions(), solu);
+  } else if (res == z3::unsat && keyed) {
+    solver_cache.store_unsat(key);
+  }
+  // unknown (timeout) is never cached, a later run may have more budget
+  return res;
+}
+
+// the nested query failed: guard each nested constraint with an assumption literal
+// and drop members of the unsat core one at a time (the back half on timeout) until
+// the rest is consistent with the target; keeps as many constraints as the budget allows
+static bool relax_nested(z3::expr const &target, std::vector<z3::expr> &kept,
+                         std::unordered_map<uint32_t, uint8_t> &solu) {
+  uint64_t start = getTimeStamp();
+  z3::solver relax(__z3_context, "QF_BV");
+  relax.add(target);
+  std::vector<z3::expr> lits;
+  for (size_t i = 0; i < kept.size(); i++) {
+    z3::expr p = __z3_context.bool_const(("relax_" + std::to_string(i)).c_str());
+    relax.add(z3::implies(p, kept[i]));
+    lits.push_back(p);
+  }
+
+  bool found = false;
+  while (!lits.empty()) {
+    uint64_t elapsed = (getTimeStamp() - start) / 1000;
+    if (elapsed >= RELAX_TIME_BUDGET) break;
+    relax.set("timeout", (unsigned)std::min<uint64_t>(1000, RELAX_TIME_BUDGET - elapsed));
+    z3::expr_vector assumptions(__z3_context);
+    for (auto &p : lits) assumptions.push_back(p);
+    z3::check_result r = relax.check(assumptions);
+    if (r == z3::sat) {
+      // only the input bytes, not the assumption literals
+      z3::model m = relax.get_model();
+      for (unsigned i = 0; i < m.num_consts(); i++) {
+        z3::func_decl decl = m.get_const_decl(i);
+        if (decl.name().kind() != Z3_INT_SYMBOL) continue;
+        solu[decl.name().to_int()] = (uint8_t)m.get_const_interp(decl).get_numeral_int();
+      }
+      found = true;
+      break;
+    } else if (r == z3::unsat) {
+      z3::expr_vector core = relax.unsat_core();
+      if (core.size() == 0) break; // the target alone is unsat
+      // drop the core member deepest in the prefix
+      size_t victim = lits.size();
+      for (unsigned c = 0; c < core.size(); c++) {
+        for (size_t i = 0; i < lits.size(); i++) {
+          if (lits[i].id() == core[c].id() && (victim == lits.size() || i > victim))
+            victim = i;
+        }
+      }
+      if (victim == lits.size()) break;
+      lits.erase(lits.begin() + victim);
+    } else {
+      lits.erase(lits.begin() + lits.size() / 2, lits.end());
+    }
+  }
+  total_relax_time += getTimeStamp() - start;
+  std::cout << "relax_nested: " << (found ? "sat" : "failed") << " keeping " << lits.size()
+            << " of " << kept.size() << " nested constraints" << std::endl;
+  // with nothing left it is just the optimistic solution
+  return found && !lits.empty();
+}
+
 // int build_nested_set(int extra, uint32_t label, uint32_t conc_dir, std::string src_tscs, std::string deps_file) {
 //   std::string entry;
 //   uint32_t e_label;
@@ -644,15 +898,7 @@ static void generate_solution(z3::model &m, std::unordered_map<uint32_t, uint8_t
 //   }
 // }
 
-int build_nested_set_old(std::string extra, uint32_t label, uint32_t conc_dir, std::string src_tscs) {
-  std::string entry;
-  uint32_t e_label;
-  uint32_t e_dir;
-
-  int token_index = 0;
-  size_t pos1 = 0;
-  size_t pos2 = 0;
-
+int build_nested_set_old(std::string extra, uint32_t label, uint32_t conc_dir, const ParentFuture &parent) {
   // get the opt set first.
   z3::expr result = __z3_context.bool_val(conc_dir);
   std::unordered_map<uint32_t, uint8_t> opt_sol;
@@ -706,7 +952,7 @@ int build_nested_set_old(std::string extra, uint32_t label, uint32_t conc_dir, s
     std::cout << "build_nested_set_old: about to check solver (opt set)" << std::endl;
     fflush(stdout);
     fflush(stderr);
-    z3::check_result res = __z3_solver.check();
+    z3::check_result res = cached_check(__z3_solver, opt_sol);
     const char* res_str = (res == z3::sat ? "sat" : (res == z3::unsat ? "unsat" : "unknown"));
     std::cerr << "build_nested_set_old: solver check result=" << res_str << std::endl;
     std::cout << "build_nested_set_old: solver check result=" << res_str << std::endl;
@@ -721,70 +967,13 @@ int build_nested_set_old(std::string extra, uint32_t label, uint32_t conc_dir, s
         fprintf(cxx_log_fp, "build_nested_set_old: opt sat, extra=\"%s\"\n", extra.c_str());
         fflush(cxx_log_fp);
       }
-      z3::model m_opt = __z3_solver.get_model();
       __z3_solver.push();
 
       // collect additional constraints
       std::vector<std::pair<uint32_t, uint32_t>> constraint_list; // Store all constraints for logging
-      auto append_extra_constraint = [&](const std::string& raw_entry) {
-        if (raw_entry.empty()) {
-          return;
-        }
-        auto trim_trailing = [](std::string s) {
-          while (!s.empty() && (s.back() == '#' || s.back() == '.' || s.back() == ',' || std::isspace(static_cast<unsigned char>(s.back())))) {
-            s.pop_back();
-          }
-          return s;
-        };
-        std::string entry = trim_trailing(raw_entry);
-        if (entry.empty()) {
-          return;
-        }
-        
-        // Support both formats:
-        // 1. "label,dir." (Marco original format from get_extra_tuple)
-        // 2. "label.dir" (converted format, possibly from scheduler)
-        size_t delim_pos = std::string::npos;
-        size_t comma_pos = entry.find(',');
-        size_t dot_pos = entry.find('.');
-        
-        // Prefer comma if present (Marco original format: "label,dir.")
-        if (comma_pos != std::string::npos) {
-          delim_pos = comma_pos;
-        } else if (dot_pos != std::string::npos) {
-          // Use dot if no comma (converted format: "label.dir")
-          delim_pos = dot_pos;
-        }
-        
-        if (delim_pos == std::string::npos) {
-          std::cerr << "build_nested_set_old: malformed extra entry \"" << entry << "\"" << std::endl;
-          if (cxx_log_fp) {
-            fprintf(cxx_log_fp, "build_nested_set_old: malformed extra entry \"%s\"\n", entry.c_str());
-            fflush(cxx_log_fp);
-          }
-          return;
-        }
-        
-        std::string label_part = entry.substr(0, delim_pos);
-        std::string dir_part = entry.substr(delim_pos + 1);
-        label_part = trim_trailing(label_part);
-        dir_part = trim_trailing(dir_part);
-        
-        // Remove trailing dot or comma from dir_part
-        while (!dir_part.empty() && (dir_part.back() == '.' || dir_part.back() == ',' || dir_part.back() == '#')) {
-          dir_part.pop_back();
-        }
-        
-        if (label_part.empty() || dir_part.empty()) {
-          std::cerr << "build_nested_set_old: empty label/dir in extra entry \"" << raw_entry << "\"" << std::endl;
-          if (cxx_log_fp) {
-            fprintf(cxx_log_fp, "build_nested_set_old: empty label/dir in extra entry \"%s\"\n", raw_entry.c_str());
-            fflush(cxx_log_fp);
-          }
-          return;
-        }
-        e_label = stoul(label_part);
-        e_dir = stoul(dir_part);
+      std::vector<nested_constraint_t> nested;
+      std::vector<z3::expr> kept;
+      auto append_extra_constraint = [&](uint32_t e_label, uint32_t e_dir) {
         constraint_list.push_back(std::make_pair(e_label, e_dir)); // Record constraint
           std::unordered_set<dfsan_label> e_inputs;
           z3::expr e_cond = serialize(e_label, e_inputs);
@@ -822,56 +1011,49 @@ int build_nested_set_old(std::string extra, uint32_t label, uint32_t conc_dir, s
         }
         
         z3::expr e_result = __z3_context.bool_val(e_dir);
-        __z3_solver.add(e_cond_bool == e_result);
+        nested.push_back(nested_constraint_t{e_label, e_dir, e_cond_bool == e_result, e_inputs});
       };
 
-      // Normalize SymFit scheduler encoding: only convert '@' to '#' as separator.
-      // Do NOT convert '.' to '#' because '.' is part of "label.dir" format.
-      // The scheduler already sends format like "label1.dir1#label2.dir2#..."
-      auto normalize_extra = [](const std::string& src) {
-        std::string normalized;
-        normalized.reserve(src.size());
-        for (size_t idx = 0; idx < src.size(); ++idx) {
-          char ch = src[idx];
-          if (ch == '@') {
-            normalized.push_back('#');
+      for (auto &pair : parse_extra_pairs(extra)) {
+        append_extra_constraint(pair.first, pair.second);
+      }
+      // independence partitioning: bytes outside the target's component keep their seed
+      // values, so the nested constraints over them hold already and need not be solved
+      size_t parsed_nested = constraint_list.size();
+      constraint_list.clear();
+      if (inputs.empty()) {
+        for (auto &nc : nested) {
+          __z3_solver.add(nc.cond);
+          kept.push_back(nc.cond);
+          constraint_list.push_back(std::make_pair(nc.label, nc.dir));
+        }
+      } else {
+        byte_union_find uf;
+        uint32_t first = *inputs.begin();
+        for (auto off : inputs) uf.unite(first, off);
+        for (auto &nc : nested) {
+          if (nc.inputs.empty()) continue;
+          uint32_t nc_first = *nc.inputs.begin();
+          for (auto off : nc.inputs) uf.unite(nc_first, off);
+        }
+        uint32_t target_root = uf.find(first);
+        for (auto &nc : nested) {
+          if (nc.inputs.empty() || uf.find(*nc.inputs.begin()) != target_root)
             continue;
-          }
-          // Keep '.' as is - it's part of "label.dir" format, not a separator
-          normalized.push_back(ch);
+          __z3_solver.add(nc.cond);
+          kept.push_back(nc.cond);
+          constraint_list.push_back(std::make_pair(nc.label, nc.dir));
         }
-        return normalized;
-      };
-      std::cerr << "build_nested_set_old: BEFORE normalize, extra=\"" << extra << "\"" << std::endl;
-      if (cxx_log_fp) {
-        fprintf(cxx_log_fp, "build_nested_set_old: BEFORE normalize, extra=\"%s\"\n", extra.c_str());
-        fflush(cxx_log_fp);
       }
-      std::string normalized_extra = normalize_extra(extra);
-      std::cerr << "build_nested_set_old: AFTER normalize, normalized_extra=\"" << normalized_extra << "\"" << std::endl;
+      total_dropped_nested += parsed_nested - constraint_list.size();
+      std::cerr << "build_nested_set_old: partitioned nested set: kept=" << constraint_list.size()
+                << " dropped=" << (parsed_nested - constraint_list.size()) << std::endl;
       if (cxx_log_fp) {
-        fprintf(cxx_log_fp, "build_nested_set_old: AFTER normalize, normalized_extra=\"%s\"\n", normalized_extra.c_str());
+        fprintf(cxx_log_fp, "build_nested_set_old: partitioned nested set: kept=%zu dropped=%zu\n",
+                constraint_list.size(), parsed_nested - constraint_list.size());
         fflush(cxx_log_fp);
       }
-      while ((pos1 = normalized_extra.find("#")) != std::string::npos) {
-        entry = normalized_extra.substr(0, pos1);
-        std::cerr << "build_nested_set_old: processing entry=\"" << entry << "\"" << std::endl;
-        if (cxx_log_fp) {
-          fprintf(cxx_log_fp, "build_nested_set_old: processing entry=\"%s\"\n", entry.c_str());
-          fflush(cxx_log_fp);
-        }
-        append_extra_constraint(entry);
-        normalized_extra.erase(0, pos1 + 1);
-      }
-      if (!normalized_extra.empty()) {
-        std::cerr << "build_nested_set_old: processing final entry=\"" << normalized_extra << "\"" << std::endl;
-        if (cxx_log_fp) {
-          fprintf(cxx_log_fp, "build_nested_set_old: processing final entry=\"%s\"\n", normalized_extra.c_str());
-          fflush(cxx_log_fp);
-        }
-        append_extra_constraint(normalized_extra);
-        normalized_extra.clear();
-      }
+
       // Log constraint summary before nested check
       std::cerr << "build_nested_set_old: nested constraint summary: total_constraints=" << constraint_list.size() << std::endl;
       std::cerr << "build_nested_set_old: constraint_list=[";
@@ -898,7 +1080,30 @@ int build_nested_set_old(std::string extra, uint32_t label, uint32_t conc_dir, s
                 constraint_list.size());
         fflush(cxx_log_fp);
       }
-      res = __z3_solver.check();
+      std::vector<std::pair<uint32_t, uint32_t>> component(constraint_list);
+      bool nothing_nested = component.empty();
+      // the target is one more constraint of its component (cond == !conc_dir), so the
+      // same constraint set hits the cache whichever of its branches is being flipped
+      component.push_back(std::make_pair(label, conc_dir ? 0u : 1u));
+      std::sort(component.begin(), component.end());
+      component.erase(std::unique(component.begin(), component.end()), component.end());
+      std::string component_key;
+      for (auto &c : component)
+        component_key += "#" + std::to_string(c.first) + "." + std::to_string(c.second);
+      auto comp_itr = component_cache.find(component_key);
+      if (nothing_nested) {
+        // nothing nested in the target's component, the optimistic model is the answer
+        res = z3::sat;
+        sol = opt_sol;
+      } else if (comp_itr != component_cache.end()) {
+        total_component_hits++;
+        res = comp_itr->second.res;
+        sol = comp_itr->second.sol;
+      } else {
+        res = cached_check(__z3_solver, sol);
+        if (res != z3::unknown)
+          component_cache[component_key] = component_result_t{res, sol};
+      }
       const char* nested_res_str = (res == z3::sat ? "sat" : (res == z3::unsat ? "unsat" : "unknown"));
       std::cerr << "build_nested_set_old: nested solver check result=" << nested_res_str << std::endl;
       if (cxx_log_fp) {
@@ -913,26 +1118,40 @@ int build_nested_set_old(std::string extra, uint32_t label, uint32_t conc_dir, s
           fflush(cxx_log_fp);
         }
         mark_pp(untaken_update_ifsat);
-        z3::model m = __z3_solver.get_model();
-        sol.clear();
-        generate_solution(m, sol);
         // write outputs under SYMCC_OUTPUT_DIR/fifo if provided
         const char* out_base_env1 = getenv("SYMCC_OUTPUT_DIR");
         std::string out_base1 = (out_base_env1 && out_base_env1[0] != '\0') ? std::string(out_base_env1) : std::string(".");
         std::string out_fifo_dir1 = out_base1 + "/fifo";
-        generate_input(sol, src_tscs, out_fifo_dir1.c_str(), ce_count+=1);
+        if (!emit_solution(sol, parent, out_fifo_dir1))
+          return -1; // same test case as an earlier one, report as dup
         std::cout << "(nested)new file id " << ce_count << std::endl;
+        total_full_sat++;
+        marco_count(MM_SOLVER_SAT, 1);
         return 1;
       } else {
         std::cout << "build_nested_set_old: nested unsat" << std::endl;
         __z3_solver.pop();
-        opt_sol.clear();
-        generate_solution(m_opt, opt_sol);
         const char* out_base_env2 = getenv("SYMCC_OUTPUT_DIR");
         std::string out_base2 = (out_base_env2 && out_base_env2[0] != '\0') ? std::string(out_base_env2) : std::string(".");
         std::string out_fifo_dir2 = out_base2 + "/fifo";
-        generate_input(opt_sol, src_tscs, out_fifo_dir2.c_str(), ce_count+=1);
+        // middle ground: keep the largest consistent part of the nested set
+        std::unordered_map<uint32_t, uint8_t> relaxed_sol;
+        if (kept.size() > 1) {
+          total_relax_tries++;
+          if (relax_nested(cond_bool != result, kept, relaxed_sol)) {
+            if (!emit_solution(relaxed_sol, parent, out_fifo_dir2))
+              return -1;
+            std::cout << "(relaxed)new file id " << ce_count << std::endl;
+            total_relaxed_sat++;
+            marco_count(MM_SOLVER_RELAXED, 1);
+            return 3; // relaxed sat
+          }
+        }
+        if (!emit_solution(opt_sol, parent, out_fifo_dir2))
+          return -1;
         std::cout << "(opt)new file id " << ce_count << std::endl;
+        total_opt_sat++;
+        marco_count(MM_SOLVER_OPTIMISTIC, 1);
         return 2; // optimistic sat
       }
     } else {
@@ -944,6 +1163,8 @@ int build_nested_set_old(std::string extra, uint32_t label, uint32_t conc_dir, s
         fflush(cxx_log_fp);
       }
       mark_pp(untaken_update_ifsat);
+      total_unsat++;
+      marco_count(MM_SOLVER_UNSAT, 1);
       return 0;
     }
   } catch (z3::exception e) {
@@ -996,7 +1217,18 @@ int gen_solve_pc(uint32_t queueid, uint32_t tree_id, uint32_t label, uint32_t co
   std::cout << "src_tscs: " << src_tscs << std::endl;
   std::string deps_file = "./deps/id:" + std::string(6-tree_idstr.size(),'0') + tree_idstr;
 
+  // component results are only meaningful for the labels of one trace
+  uint64_t trace_key = ((uint64_t)queueid << 32) | tree_id;
+  if (trace_key != component_cache_trace) {
+    component_cache.clear();
+    component_cache_trace = trace_key;
+  }
+
   // prep1: reinstate tree
+  // the tree (and a fifo/queue parent seed) may still be sitting in the writer queue
+  output_writer.flush();
+  // read by the writer thread while the tree is loaded and the constraints are built
+  ParentFuture parent = output_writer.load_parent(src_tscs);
   std::cout << "[gen_solve_pc] checking tree_file: " << tree_file << std::endl;
   if (cxx_log_fp) { fprintf(cxx_log_fp, "checking tree_file: %s\n", tree_file.c_str()); fflush(cxx_log_fp); }
   if (stat(tree_file.c_str(), &st) != 0) {
@@ -1032,6 +1264,12 @@ int gen_solve_pc(uint32_t queueid, uint32_t tree_id, uint32_t label, uint32_t co
   }
 
   total_reload_time += (getTimeStamp() - one_start);
+  marco_count(MM_TREE_READ_BYTES, sread);
+  marco_observe(MH_TREE_READ_US, getTimeStamp() - one_start);
+  if (capture.is_open()) {
+    capture.union_once(queueid, tree_id, __union_table, sread);
+    capture.seed_once(queueid, tree_id, src_tscs);
+  }
 
   // prep2: reset the max label tracker; upper bound is new max_label_
   max_label_per_session = 0;
@@ -1040,7 +1278,7 @@ int gen_solve_pc(uint32_t queueid, uint32_t tree_id, uint32_t label, uint32_t co
   // res = build_nested_set(extra, label, conc_dir, src_tscs, deps_file); // protobuf version
   std::cout << "[gen_solve_pc] about to call build_nested_set_old label=" << label << " conc_dir=" << conc_dir << " extra=\"" << extra << "\"" << std::endl;
   if (cxx_log_fp) { fprintf(cxx_log_fp, "about to call build_nested_set_old label=%u dir=%u extra=[%s]\n", label, conc_dir, extra.c_str()); fflush(cxx_log_fp); }
-  res = build_nested_set_old(extra, label, conc_dir, src_tscs); // string conversion
+  res = build_nested_set_old(extra, label, conc_dir, parent); // string conversion
   std::cout << "[gen_solve_pc] build_nested_set_old result=" << res << std::endl;
   if (cxx_log_fp) { fprintf(cxx_log_fp, "build_nested_set_old result=%d\n", res); fflush(cxx_log_fp); }
 
@@ -1052,6 +1290,41 @@ int gen_solve_pc(uint32_t queueid, uint32_t tree_id, uint32_t label, uint32_t co
   return res;
 }
 
+// one scheduler decision, from either the FIFO or the channel
+static int run_decision(uint32_t queueid, uint32_t tree_id, uint32_t node_id, uint32_t conc_dir,
+                        uint32_t cur_label_loc, std::string &extra) {
+  std::cout << "[generate_next_tscs] parsed qid=" << queueid
+            << " tree_id=" << tree_id
+            << " node_id=" << node_id
+            << " conc_dir=" << conc_dir
+            << " cur_label_loc=" << cur_label_loc
+            << " pp_hash=" << untaken_update_ifsat
+            << " extra=\"" << extra << "\"" << std::endl;
+  if (cxx_log_fp) {
+    fprintf(cxx_log_fp, "parsed qid=%u tid=%u nid=%u dir=%u cur=%u pp=%llu extra=[%s]\n",
+            queueid, tree_id, node_id, conc_dir, cur_label_loc,
+            (unsigned long long)untaken_update_ifsat, extra.c_str());
+    fflush(cxx_log_fp);
+  }
+  capture.decision(queueid, tree_id, node_id, conc_dir, cur_label_loc, untaken_update_ifsat, extra);
+  marco_count(MM_DECISIONS, 1);
+  // Marco original logic: check path-prefix deduplication
+  if (!BRC_MODE && !check_pp(untaken_update_ifsat)) {
+    marco_count(MM_DECISIONS_DUP, 1);
+    std::cout << "dup pp, skip! pp_hash=" << untaken_update_ifsat << std::endl;
+    if (cxx_log_fp) { fprintf(cxx_log_fp, "dup pp, skip! pp_hash=%llu\n", (unsigned long long)untaken_update_ifsat); fflush(cxx_log_fp); }
+    return -1; // skip it, query next one!
+  }
+  std::cout << "[generate_next_tscs] invoking gen_solve_pc() qid=" << queueid << " tid=" << tree_id << " label=" << node_id << " dir=" << conc_dir << " cur=" << cur_label_loc << std::endl;
+  if (cxx_log_fp) { fprintf(cxx_log_fp, "invoking gen_solve_pc qid=%u tid=%u label=%u dir=%u cur=%u\n", queueid, tree_id, node_id, conc_dir, cur_label_loc); fflush(cxx_log_fp); }
+  uint64_t solve_start = marco_metrics_now();
+  int ret = gen_solve_pc(queueid, tree_id, node_id, conc_dir, cur_label_loc, extra);
+  marco_observe(MH_SOLVE_US, marco_metrics_now() - solve_start);
+  std::cout << "[generate_next_tscs] gen_solve_pc returned: " << ret << std::endl;
+  if (cxx_log_fp) { fprintf(cxx_log_fp, "gen_solve_pc returned %d\n", ret); fflush(cxx_log_fp); }
+  // Marco original logic: return -1 for duplicate path-prefix
+  return ret;
+}
 
 int generate_next_tscs(std::ifstream &pcsetpipe) {
   std::string line;
@@ -1076,7 +1349,29 @@ int generate_next_tscs(std::ifstream &pcsetpipe) {
       if (cxx_log_fp) { fprintf(cxx_log_fp, "stream not good before getline, good=%d eof=%d fail=%d bad=%d\n", pcsetpipe.good(), pcsetpipe.eof(), pcsetpipe.fail(), pcsetpipe.bad()); fflush(cxx_log_fp); }
     }
     extra.clear();
-    if (std::getline(pcsetpipe, line)) {
+    uint64_t wait_start = marco_metrics_now();
+    if (decision_chan.is_open()) {
+      ChanDecisionRecord dec;
+      bool got = decision_chan.recv_decision(dec);
+      marco_observe(MH_DECISION_WAIT_US, marco_metrics_now() - wait_start);
+      if (!got) {
+        // nothing can drive us any more
+        std::cout << "[generate_next_tscs] scheduler channel closed, exiting" << std::endl;
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "scheduler channel closed\n"); fflush(cxx_log_fp); }
+        exit(1);
+      }
+      queueid = dec.qid;
+      tree_id = dec.tid;
+      node_id = dec.nid;
+      conc_dir = dec.conc_dir;
+      cur_label_loc = dec.plen;
+      untaken_update_ifsat = dec.pp_hash;
+      extra = chan_extra_string(dec);
+      return run_decision(queueid, tree_id, node_id, conc_dir, cur_label_loc, extra);
+    }
+    bool got = (bool)std::getline(pcsetpipe, line);
+    marco_observe(MH_DECISION_WAIT_US, marco_metrics_now() - wait_start);
+    if (got) {
       if (cxx_log_fp) { fprintf(cxx_log_fp, "getline ok, raw=[%s]\n", line.c_str()); fflush(cxx_log_fp); }
       // trim trailing CR/LF and trailing commas/spaces
       while (!line.empty() && (line.back() == '\r' || line.back() == '\n' || line.back() == ' ' || line.back() == '\t')) {
@@ -1123,32 +1418,7 @@ int generate_next_tscs(std::ifstream &pcsetpipe) {
         payload.pop_back();
       }
       extra = payload; // remainder (may contain commas/dots/#, already trimmed above)
-      std::cout << "[generate_next_tscs] parsed qid=" << queueid
-                << " tree_id=" << tree_id
-                << " node_id=" << node_id
-                << " conc_dir=" << conc_dir
-                << " cur_label_loc=" << cur_label_loc
-                << " pp_hash=" << untaken_update_ifsat
-                << " extra=\"" << extra << "\"" << std::endl;
-      if (cxx_log_fp) {
-        fprintf(cxx_log_fp, "parsed qid=%u tid=%u nid=%u dir=%u cur=%u pp=%llu extra=[%s]\n",
-                queueid, tree_id, node_id, conc_dir, cur_label_loc,
-                (unsigned long long)untaken_update_ifsat, extra.c_str());
-        fflush(cxx_log_fp);
-      }
-      // Marco original logic: check path-prefix deduplication
-      if (!BRC_MODE && !check_pp(untaken_update_ifsat)) {
-        std::cout << "dup pp, skip! pp_hash=" << untaken_update_ifsat << std::endl;
-        if (cxx_log_fp) { fprintf(cxx_log_fp, "dup pp, skip! pp_hash=%llu\n", (unsigned long long)untaken_update_ifsat); fflush(cxx_log_fp); }
-        return -1; // skip it, query next one!
-      }
-      std::cout << "[generate_next_tscs] invoking gen_solve_pc() qid=" << queueid << " tid=" << tree_id << " label=" << node_id << " dir=" << conc_dir << " cur=" << cur_label_loc << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "invoking gen_solve_pc qid=%u tid=%u label=%u dir=%u cur=%u\n", queueid, tree_id, node_id, conc_dir, cur_label_loc); fflush(cxx_log_fp); }
-      int ret = gen_solve_pc(queueid, tree_id, node_id, conc_dir, cur_label_loc, extra);
-      std::cout << "[generate_next_tscs] gen_solve_pc returned: " << ret << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "gen_solve_pc returned %d\n", ret); fflush(cxx_log_fp); }
-      // Marco original logic: return -1 for duplicate path-prefix
-      return ret;
+      return run_decision(queueid, tree_id, node_id, conc_dir, cur_label_loc, extra);
     }
 
     // If we reach here, getline failed. Likely FIFO writer closed; reopen to block for next decision.
@@ -1158,7 +1428,7 @@ int generate_next_tscs(std::ifstream &pcsetpipe) {
       pcsetpipe.clear();
       pcsetpipe.close();
       // Reopen in blocking mode; this will block until a writer opens the FIFO
-      pcsetpipe.open("/tmp/myfifo");
+      pcsetpipe.open(pipe_path("myfifo"));
       if (!pcsetpipe.is_open()) {
         std::cout << "[generate_next_tscs] Failed to reopen /tmp/myfifo" << std::endl;
         if (cxx_log_fp) { fprintf(cxx_log_fp, "failed to reopen myfifo\n"); fflush(cxx_log_fp); }
@@ -1175,7 +1445,12 @@ int generate_next_tscs(std::ifstream &pcsetpipe) {
 
 #if 1
 const int pfxkMapSize  = 1<<27;
-uint8_t pfx_pp_map[pfxkMapSize];
+// points into pp_store when MARCO_STATE_DIR is set
+static uint8_t pfx_pp_local[pfxkMapSize];
+uint8_t *pfx_pp_map = pfx_pp_local;
+#define PP_SNAPSHOT_SECS 300
+static PrefixStore pp_store;
+static uint64_t last_pp_snapshot = 0;
 uint16_t node_map[pfxkMapSize];
 const int kMapSize = 1 << 16;
 uint8_t pp_map[kMapSize];
@@ -1196,6 +1471,7 @@ void mark_pp(uint64_t digest) {
   uint32_t hash = digest % (pfxkMapSize * CHAR_BIT);
   uint32_t idx = hash / CHAR_BIT;
   uint32_t mask = 1 << (hash % CHAR_BIT);
+  pp_store.touch();
   pfx_pp_map[idx] |= mask;
 }
 
@@ -1207,9 +1483,11 @@ static int update_graph(dfsan_label label, uint64_t pc, uint32_t tkdir,
     // Concrete branches (label == 0) are skipped - they don't need to be added to graph structure
     if (!label) return 0;
     
-    printf("[update_graph] ENTER label=%u pc=0x%llx dir=%u try_solve=%d tid=%u qid=%u uniq=%d memo=%d [branch_debug]\n",
-           label, (unsigned long long)pc, tkdir, try_solve, inputid, queueid, uniq_pcset, ifmemorize);
-    fflush(stdout);
+    if (trace_debug) {
+      printf("[update_graph] ENTER label=%u pc=0x%llx dir=%u try_solve=%d tid=%u qid=%u uniq=%d memo=%d [branch_debug]\n",
+             label, (unsigned long long)pc, tkdir, try_solve, inputid, queueid, uniq_pcset, ifmemorize);
+      fflush(stdout);
+    }
     
     // For symbolic branches only (label != 0)
     bool is_concrete = (label == 0);
@@ -1247,19 +1525,33 @@ static int update_graph(dfsan_label label, uint64_t pc, uint32_t tkdir,
 
     // proceed to update graph, pipe the record to python scheduler
     std::string record;
+    // same fields for the binary channel
+    bool use_chan = decision_chan.is_open();
+    ChanEdgeRecord edge;
+    memset(&edge, 0, sizeof(edge));
+    edge.kind = CHAN_EDGE;
+    edge.pc = pc;
+    edge.ctx = call_stack_hash_;
+    edge.tkdir = tkdir;
+    edge.label = label;
+    edge.inputid = inputid;
+    edge.queueid = queueid;
 
     // if filtered by policy, or already picked it for this trace, or pruned, update visit of concrete branch only
     // For concrete branches (label==0), use "none" format UNLESS try_solve was forced to true
     if(!try_solve && uniq_pcset == 0) {
       // This includes concrete branches (label==0) and filtered symbolic branches
       // BUT: If try_solve was forced to true, we should still send proper PC_ids
-      record = std::to_string(pc) \
-               + "-" + std::to_string(call_stack_hash_) \
-               + "-" + std::to_string(tkdir) \
-               + "-" + std::to_string(label) \
-               + "-" + std::to_string(inputid) \
-               + "-" + std::to_string(queueid) \
-               + "@none@@\n";
+      edge.flags = CHAN_EDGE_NOPC;
+      if (!use_chan) {
+        record = std::to_string(pc) \
+                 + "-" + std::to_string(call_stack_hash_) \
+                 + "-" + std::to_string(tkdir) \
+                 + "-" + std::to_string(label) \
+                 + "-" + std::to_string(inputid) \
+                 + "-" + std::to_string(queueid) \
+                 + "@none@@\n";
+      }
     } else if (was_forced && is_concrete) {
       // FORCE MODE: Concrete branch with try_solve=true
       // Generate a simplified PC_ids format for concrete branches (no label info needed)
@@ -1277,15 +1569,20 @@ static int update_graph(dfsan_label label, uint64_t pc, uint32_t tkdir,
       uint64_t concrete_pp_hash = XXH64_digest(&tmp_pp);
       // Ensure non-zero hash
       if (concrete_pp_hash == 0) concrete_pp_hash = 1;
-      record = std::to_string(pc) \
-               + "-" + std::to_string(call_stack_hash_) \
-               + "-" + std::to_string(tkdir) \
-               + "-" + std::to_string(label) \
-               + "-" + std::to_string(inputid) \
-               + "-" + std::to_string(queueid) \
-               + "@" \
-               + "1-" + std::to_string(queueid) + "-" + std::to_string(concrete_pp_hash) \
-               + "-0-0-0-" + std::to_string(inputid) + "-0#@@\n";
+      edge.flags = CHAN_EDGE_FORCED;
+      edge.is_good = 1;
+      edge.pp_hash = concrete_pp_hash;
+      if (!use_chan) {
+        record = std::to_string(pc) \
+                 + "-" + std::to_string(call_stack_hash_) \
+                 + "-" + std::to_string(tkdir) \
+                 + "-" + std::to_string(label) \
+                 + "-" + std::to_string(inputid) \
+                 + "-" + std::to_string(queueid) \
+                 + "@" \
+                 + "1-" + std::to_string(queueid) + "-" + std::to_string(concrete_pp_hash) \
+                 + "-0-0-0-" + std::to_string(inputid) + "-0#@@\n";
+      }
       printf("[update_graph] FORCE MODE: generated PC_ids for concrete branch, pp_hash=%llu\n", 
              (unsigned long long)concrete_pp_hash);
       fflush(stdout);
@@ -1306,9 +1603,20 @@ static int update_graph(dfsan_label label, uint64_t pc, uint32_t tkdir,
       uint64_t t_extra = getTimeStamp();
       // Marco-compatible: get_extra_tuple does not use path prefix hash for filtering
       // Path prefix hash is only used for path deduplication, not for constraint filtering
-      std::string res = get_extra_tuple(label, tkdir, ifmemorize);
+      std::vector<std::pair<uint32_t, uint32_t>> extra_pairs;
+      std::string res = get_extra_tuple(label, tkdir, ifmemorize, &extra_pairs);
       total_extra_time += (getTimeStamp() - t_extra);
 
+      edge.is_good = uniq_pcset;
+      edge.pp_hash = untaken_update_ifsat;
+      edge.depth = get_label_info(label)->depth;
+      for (auto &ep : extra_pairs) {
+        if (edge.nextra == CHAN_MAX_EXTRA) break;
+        edge.extra[edge.nextra * 2] = ep.first;
+        edge.extra[edge.nextra * 2 + 1] = ep.second;
+        edge.nextra++;
+      }
+
       // Debug: log PC value before converting to string
       static int debug_pc_before_string_count = 0;
       if (debug_pc_before_string_count++ < 10) {
@@ -1322,32 +1630,45 @@ static int update_graph(dfsan_label label, uint64_t pc, uint32_t tkdir,
         }
       }
 
-      record = std::to_string(pc) \
-               + "-" + std::to_string(call_stack_hash_) \
-               + "-" + std::to_string(tkdir) \
-               + "-" + std::to_string(label) \
-               + "-" + std::to_string(inputid) \
-               + "-" + std::to_string(queueid) \
-               + "@" \
-               + std::to_string(uniq_pcset) \
-               + "-" + std::to_string(queueid) \
-               + "-" + std::to_string(untaken_update_ifsat) \
-               + "-" + std::to_string(get_label_info(label)->depth) \
-               + "#" + res \
-               + "@@\n";
+      if (!use_chan) {
+        record = std::to_string(pc) \
+                 + "-" + std::to_string(call_stack_hash_) \
+                 + "-" + std::to_string(tkdir) \
+                 + "-" + std::to_string(label) \
+                 + "-" + std::to_string(inputid) \
+                 + "-" + std::to_string(queueid) \
+                 + "@" \
+                 + std::to_string(uniq_pcset) \
+                 + "-" + std::to_string(queueid) \
+                 + "-" + std::to_string(untaken_update_ifsat) \
+                 + "-" + std::to_string(get_label_info(label)->depth) \
+                 + "#" + res \
+                 + "@@\n";
+      }
+    }
+    if (use_chan) {
+      if (!decision_chan.send_edge(edge)) {
+        printf("[update_graph] scheduler channel closed\n");
+        fflush(stdout);
+      }
+      return 0;
     }
     // debug: also dump what will be written to the pipe into a local log and stdout
-    if (cxx_log_fp) {
-      fprintf(cxx_log_fp, "[update_graph] WRITE RECORD(len=%zu): %s", record.size(), record.c_str());
-      fflush(cxx_log_fp);
+    if (trace_debug) {
+      if (cxx_log_fp) {
+        fprintf(cxx_log_fp, "[update_graph] WRITE RECORD(len=%zu): %s", record.size(), record.c_str());
+        fflush(cxx_log_fp);
+      }
+      printf("[update_graph] WRITE RECORD(len=%zu)\n", record.size());
+      fflush(stdout);
     }
-    printf("[update_graph] WRITE RECORD(len=%zu)\n", record.size());
-    fflush(stdout);
     {
       ssize_t wret = write(named_pipe_fd, record.c_str(), strlen(record.c_str()));
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "[update_graph] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0)); fflush(cxx_log_fp); }
-      printf("[update_graph] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0));
-      fflush(stdout);
+      if (trace_debug) {
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "[update_graph] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0)); fflush(cxx_log_fp); }
+        printf("[update_graph] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0));
+        fflush(stdout);
+      }
     }
     fsync(named_pipe_fd);
 
@@ -1509,7 +1830,7 @@ uint64_t roll_in_pp(uint32_t label, uint64_t addr, uint64_t direction,
   // std::cout << "tk: " << taken_digest << " utk: " << untaken_digest << std::endl;
   
   // Debug: log taken_digest and untaken_digest for analysis
-  if (cxx_log_fp) {
+  if (trace_debug && cxx_log_fp) {
     fprintf(cxx_log_fp, "[roll_in_pp] addr=0x%llx dir=%lu label=%u taken_digest=0x%llx untaken_digest=0x%llx mark_pp(taken_digest) called\n",
             (unsigned long long)addr, (unsigned long)direction, label,
             (unsigned long long)taken_digest, (unsigned long long)untaken_digest);
@@ -1570,25 +1891,27 @@ bool isInterestingBranch(uint64_t pc, bool taken, uint64_t ctx) {
   updateBitmap((void *)pc, ctx);
   bool bitmap_interesting = is_interesting_;
   if (!is_interesting_) {
-    if (cxx_log_fp) {
-      fprintf(cxx_log_fp,
+    if (trace_debug) {
+      if (cxx_log_fp) {
+        fprintf(cxx_log_fp,
+                "[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=1\n",
+                (unsigned long long)pc,
+                taken ? 1u : 0u,
+                (unsigned long long)ctx);
+        fflush(cxx_log_fp);
+      }
+      printf("[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=1\n",
+             (unsigned long long)pc,
+             taken ? 1u : 0u,
+             (unsigned long long)ctx);
+      fflush(stdout);
+      fprintf(stderr,
               "[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=1\n",
               (unsigned long long)pc,
               taken ? 1u : 0u,
               (unsigned long long)ctx);
-      fflush(cxx_log_fp);
+      fflush(stderr);
     }
-    printf("[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=1\n",
-           (unsigned long long)pc,
-           taken ? 1u : 0u,
-           (unsigned long long)ctx);
-    fflush(stdout);
-    fprintf(stderr,
-            "[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=1\n",
-            (unsigned long long)pc,
-            taken ? 1u : 0u,
-            (unsigned long long)ctx);
-    fflush(stderr);
     return false; // if pruned, don't proceed anymore, treat this brc as concrete basically.
   }
 
@@ -1624,8 +1947,35 @@ bool isInterestingBranch(uint64_t pc, bool taken, uint64_t ctx) {
 
   prev_loc_ = h;
 
-  if (cxx_log_fp) {
-    fprintf(cxx_log_fp,
+  if (trace_debug) {
+    if (cxx_log_fp) {
+      fprintf(cxx_log_fp,
+              "[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=0 new_context=%d ret=%d idx=%u virgin_before=%u virgin_after=%u trace_before=%u trace_after=%u\n",
+              (unsigned long long)pc,
+              taken ? 1u : 0u,
+              (unsigned long long)ctx,
+              new_context ? 1 : 0,
+              ret ? 1 : 0,
+              idx,
+              virgin_before,
+              virgin_map_[idx],
+              trace_before,
+              trace_map_[idx]);
+      fflush(cxx_log_fp);
+    }
+    printf("[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=0 new_context=%d ret=%d idx=%u virgin_before=%u virgin_after=%u trace_before=%u trace_after=%u\n",
+           (unsigned long long)pc,
+           taken ? 1u : 0u,
+           (unsigned long long)ctx,
+           new_context ? 1 : 0,
+           ret ? 1 : 0,
+           idx,
+           virgin_before,
+           virgin_map_[idx],
+           trace_before,
+           trace_map_[idx]);
+    fflush(stdout);
+    fprintf(stderr,
             "[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=0 new_context=%d ret=%d idx=%u virgin_before=%u virgin_after=%u trace_before=%u trace_after=%u\n",
             (unsigned long long)pc,
             taken ? 1u : 0u,
@@ -1637,33 +1987,8 @@ bool isInterestingBranch(uint64_t pc, bool taken, uint64_t ctx) {
             virgin_map_[idx],
             trace_before,
             trace_map_[idx]);
-    fflush(cxx_log_fp);
+    fflush(stderr);
   }
-  printf("[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=0 new_context=%d ret=%d idx=%u virgin_before=%u virgin_after=%u trace_before=%u trace_after=%u\n",
-         (unsigned long long)pc,
-         taken ? 1u : 0u,
-         (unsigned long long)ctx,
-         new_context ? 1 : 0,
-         ret ? 1 : 0,
-         idx,
-         virgin_before,
-         virgin_map_[idx],
-         trace_before,
-         trace_map_[idx]);
-  fflush(stdout);
-  fprintf(stderr,
-          "[interesting_branch] pc=0x%llx taken=%u ctx=0x%llx bitmap_pruned=0 new_context=%d ret=%d idx=%u virgin_before=%u virgin_after=%u trace_before=%u trace_after=%u\n",
-          (unsigned long long)pc,
-          taken ? 1u : 0u,
-          (unsigned long long)ctx,
-          new_context ? 1 : 0,
-          ret ? 1 : 0,
-          idx,
-          virgin_before,
-          virgin_map_[idx],
-          trace_before,
-          trace_map_[idx]);
-  fflush(stderr);
 
   return ret;
 }
@@ -1685,46 +2010,16 @@ void generate_tree_dump(int qid) {
   fflush(stdout);
   if (cxx_log_fp) { fprintf(cxx_log_fp, "[generate_tree_dump] called with qid=%d, output_file=%s\n", qid, abs_output_file.c_str()); fflush(cxx_log_fp); }
   
-  // Create tree directory if it doesn't exist
-  std::string mkdir_cmd = "mkdir -p " + abs_tree_dir;
-  printf("[generate_tree_dump] DEBUG: mkdir_cmd='%s', tree_base='%s', abs_tree_dir='%s'\n", mkdir_cmd.c_str(), tree_base.c_str(), abs_tree_dir.c_str());
-  fflush(stdout);
-  if (cxx_log_fp) { fprintf(cxx_log_fp, "[generate_tree_dump] DEBUG: mkdir_cmd='%s', tree_base='%s', abs_tree_dir='%s'\n", mkdir_cmd.c_str(), tree_base.c_str(), abs_tree_dir.c_str()); fflush(cxx_log_fp); }
-  
-  int mkdir_ret = system(mkdir_cmd.c_str());
-  if (mkdir_ret != 0) {
-    fprintf(stderr, "[generate_tree_dump] failed to create directory: %s (ret=%d, errno=%d: %s)\n", abs_tree_dir.c_str(), mkdir_ret, errno, strerror(errno));
-    if (cxx_log_fp) { fprintf(cxx_log_fp, "[generate_tree_dump] failed to create directory: %s (ret=%d, errno=%d: %s)\n", abs_tree_dir.c_str(), mkdir_ret, errno, strerror(errno)); fflush(cxx_log_fp); }
-  } else {
-    printf("[generate_tree_dump] created directory: %s\n", abs_tree_dir.c_str());
-    fflush(stdout);
-    std::cout << "[generate_tree_dump] created directory: " << abs_tree_dir << std::endl;
-    std::cout.flush();
-    if (cxx_log_fp) { fprintf(cxx_log_fp, "[generate_tree_dump] created directory: %s\n", abs_tree_dir.c_str()); fflush(cxx_log_fp); }
-  }
-  
-  // Use absolute path for file output
-  std::string output_file = abs_output_file;
-  
-  size_t swrite;
-  FILE *fp;
-  if ((fp = fopen(output_file.c_str(), "wb")) == NULL) {
-    fprintf(stderr, "[generate_tree_dump]1: cannot open file to write: %s (errno=%d: %s)\n", output_file.c_str(), errno, strerror(errno));
-    if (cxx_log_fp) { fprintf(cxx_log_fp, "[generate_tree_dump]1: cannot open file to write: %s (errno=%d: %s)\n", output_file.c_str(), errno, strerror(errno)); fflush(cxx_log_fp); }
-    return;
-  }
-
   std::cout << "max_label_ = " << max_label_ << ", max_label_per_session = " << max_label_per_session << std::endl;
 
   // Use max_label_per_session if max_label_ is 0 (fallback for SymFit compatibility)
   uint32_t effective_max_label = (max_label_ > 0) ? max_label_ : max_label_per_session;
   std::cout << "[generate_tree_dump] using effective_max_label = " << effective_max_label << std::endl;
 
-  swrite = fwrite((void *)__union_table, sizeof(dfsan_label_info), effective_max_label+1, fp);
-  if (swrite != (effective_max_label+1)) {
-    fprintf(stderr, "[generate_tree_dump]1: write error %d (expected %u)\n", swrite, effective_max_label+1);
-  }
-  fclose(fp);
+  // the union table is copied into the job here, so cleanup1() can wipe it right away;
+  // directory creation and the write itself happen on the writer thread
+  output_writer.write_tree(abs_tree_dir, abs_output_file, (void *)__union_table,
+                           sizeof(dfsan_label_info) * (effective_max_label+1));
 
   // generate deps protobuf dump
   // std::string output_file1 = "./deps/id:" + std::string(6-tree_idstr.size(),'0') + tree_idstr;
@@ -1752,7 +2047,7 @@ void handle_fmemcmp(uint8_t* data, uint64_t index, uint32_t size, uint32_t tid,
     const char* out_base_env = getenv("SYMCC_OUTPUT_DIR");
     std::string out_base = (out_base_env && out_base_env[0] != '\0') ? std::string(out_base_env) : std::string(".");
     std::string out_fifo_dir = out_base + "/fifo";
-    generate_input(rgd_solution, input_file, out_fifo_dir.c_str(), ce_count+=1);
+    emit_solution(rgd_solution, trace_parent, out_fifo_dir);
   }
   else {
     RGDSolution sol = {rgd_solution, tid, addr, 0, 0};
@@ -1810,6 +2105,27 @@ int cleanup_deps() {
 }
 
 
+// add the input bytes of one symbolic branch to the mask of the traced seed
+static void mask_branch_deps(dfsan_label label, bool unsolved) {
+  auto itr = deps_cache.find(label);
+  if (itr != deps_cache.end()) {
+    byte_mask.add_branch(itr->second, unsolved);
+    return;
+  }
+  if (get_label_info(label)->tree_size > 50000) return;
+  std::unordered_set<uint32_t> deps;
+  try {
+    uint64_t t_getdep = getTimeStamp();
+    get_input_deps(label, deps);
+    total_getdeps_cost += (getTimeStamp() - t_getdep);
+  } catch (z3::exception e) {
+    return;
+  }
+  byte_mask.add_branch(deps, unsolved);
+}
+
+static uint32_t ingest_trace(std::istream &myfile, uint32_t brc_flip);
+
 uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcsetpipe) {
   // Use printf to ensure output (not buffered)
   printf("[solve] ENTER function, shmid=%d pipeid=%u brc_flip=%u\n", shmid, pipeid, brc_flip);
@@ -1826,7 +2142,7 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
   fprintf(stderr, "[solve] about to open /tmp/wp2\n");
   fflush(stderr);
   if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] about to open /tmp/wp2\n"); fflush(cxx_log_fp); } else { fprintf(stderr, "[solve] ERROR: cxx_log_fp is NULL!\n"); fflush(stderr); }
-  myfile.open("/tmp/wp2");
+  myfile.open(pipe_path("wp2"));
   std::cout << "[solve] opened /tmp/wp2, is_open=" << myfile.is_open() << " good=" << myfile.good() << " eof=" << myfile.eof() << " fail=" << myfile.fail() << " bad=" << myfile.bad() << std::endl;
   std::cout.flush();
   fprintf(stderr, "[solve] opened /tmp/wp2, is_open=%d good=%d eof=%d fail=%d bad=%d\n", myfile.is_open(), myfile.good(), myfile.eof(), myfile.fail(), myfile.bad());
@@ -1842,7 +2158,15 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
   }
   std::cout << "[solve] shmat succeeded, __union_table=" << (void*)__union_table << std::endl;
   if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] shmat succeeded, __union_table=%p\n", __union_table); fflush(cxx_log_fp); }
+  return ingest_trace(myfile, brc_flip);
+}
 
+// one trace worth of branch records, from wp2 or from a capture
+static uint32_t ingest_trace(std::istream &myfile, uint32_t brc_flip) {
+  capture.begin_trace(brc_flip);
+  // input_file is rewritten for the next trace, read it now for handle_fmemcmp
+  if (SAVING_WHOLE) trace_parent = output_writer.load_parent(input_file);
+  uint64_t ingest_start = marco_metrics_now();
   memset(virgin_map_, 0, kMapSize);
   memset(node_map, 0, pfxkMapSize * sizeof(uint16_t)); // a per trace bitmap, for localvis bucketization pruning;
   prev_loc_ = 0;
@@ -1888,12 +2212,17 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
   if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] about to enter while loop to read from /tmp/wp2\n"); fflush(cxx_log_fp); }
   while (std::getline(myfile, line))
   {
+    capture.line(line);
     line_count++;
-    std::cout << "[solve] read line " << line_count << " (length=" << line.length() << "): " << (line.length() > 80 ? line.substr(0, 80) : line) << std::endl;
-    if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] read line %d (length=%zu): %s\n", line_count, line.length(), (line.length() > 80 ? line.substr(0, 80).c_str() : line.c_str())); fflush(cxx_log_fp); }
+    if (trace_debug) {
+      std::cout << "[solve] read line " << line_count << " (length=" << line.length() << "): " << (line.length() > 80 ? line.substr(0, 80) : line) << std::endl;
+      if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] read line %d (length=%zu): %s\n", line_count, line.length(), (line.length() > 80 ? line.substr(0, 80).c_str() : line.c_str())); fflush(cxx_log_fp); }
+    }
     if (line.empty()) {
-      std::cout << "[solve] got empty line, continue" << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] got empty line, continue\n"); fflush(cxx_log_fp); }
+      if (trace_debug) {
+        std::cout << "[solve] got empty line, continue" << std::endl;
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] got empty line, continue\n"); fflush(cxx_log_fp); }
+      }
       continue;
     }
     int token_index = 0;
@@ -1904,9 +2233,11 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
         case 0: 
                 qid = stoul(token);
                 // Track the first qid for tree dump (should match queueid from scheduler)
-                printf("[solve] DEBUG: case 0, token='%s', qid=%u, first_qid_set=%d\n", token.c_str(), qid, first_qid_set ? 1 : 0);
-                fflush(stdout);
-                if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: case 0, token='%s', qid=%u, first_qid_set=%d\n", token.c_str(), qid, first_qid_set ? 1 : 0); fflush(cxx_log_fp); }
+                if (trace_debug) {
+                  printf("[solve] DEBUG: case 0, token='%s', qid=%u, first_qid_set=%d\n", token.c_str(), qid, first_qid_set ? 1 : 0);
+                  fflush(stdout);
+                  if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: case 0, token='%s', qid=%u, first_qid_set=%d\n", token.c_str(), qid, first_qid_set ? 1 : 0); fflush(cxx_log_fp); }
+                }
                 if (!first_qid_set) {
                   first_qid = qid;
                   first_qid_set = true;
@@ -1925,11 +2256,13 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
         case 6: cons_type = stoul(token); break;
         case 7: // testcase id
                 tid = stoul(token);
-                printf("[solve] DEBUG: case 7, token='%s', tid=%u, first_tid_set=%s, first_tid=%u, dump_tree_id_=%u\n", token.c_str(), tid, (first_tid_set ? "true" : "false"), first_tid, dump_tree_id_);
-                fflush(stdout);
-                fprintf(stderr, "[solve] DEBUG: case 7, token='%s', tid=%u, first_tid_set=%s, first_tid=%u, dump_tree_id_=%u\n", token.c_str(), tid, (first_tid_set ? "true" : "false"), first_tid, dump_tree_id_);
-                fflush(stderr);
-                if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: case 7, token='%s', tid=%u, first_tid_set=%s, first_tid=%u, dump_tree_id_=%u\n", token.c_str(), tid, (first_tid_set ? "true" : "false"), first_tid, dump_tree_id_); fflush(cxx_log_fp); }
+                if (trace_debug) {
+                  printf("[solve] DEBUG: case 7, token='%s', tid=%u, first_tid_set=%s, first_tid=%u, dump_tree_id_=%u\n", token.c_str(), tid, (first_tid_set ? "true" : "false"), first_tid, dump_tree_id_);
+                  fflush(stdout);
+                  fprintf(stderr, "[solve] DEBUG: case 7, token='%s', tid=%u, first_tid_set=%s, first_tid=%u, dump_tree_id_=%u\n", token.c_str(), tid, (first_tid_set ? "true" : "false"), first_tid, dump_tree_id_);
+                  fflush(stderr);
+                  if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: case 7, token='%s', tid=%u, first_tid_set=%s, first_tid=%u, dump_tree_id_=%u\n", token.c_str(), tid, (first_tid_set ? "true" : "false"), first_tid, dump_tree_id_); fflush(cxx_log_fp); }
+                }
                 // Marco-compatible: update dump_tree_id_ for each tid
                 // This ensures each tid gets its own tree file generated
                 // Note: tid=-1 (0xFFFFFFFF) means uninitialized, tid=0 is a valid input id
@@ -1938,13 +2271,15 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
                   if (previous_tid != (uint32_t)-1 && tid != previous_tid && previous_dump_tree_id != (uint32_t)-1) {
                     // Tid has changed, generate tree file for previous tid
                     uint32_t tree_dump_qid_for_prev = first_qid_set ? first_qid : qid;
-                    printf("[solve] DEBUG: tid changed from %u to %u, generating tree file for tid=%u (dump_tree_id_=%u)\n", 
-                           previous_tid, tid, previous_tid, previous_dump_tree_id);
-                    fflush(stdout);
-                    if (cxx_log_fp) { 
-                      fprintf(cxx_log_fp, "[solve] DEBUG: tid changed from %u to %u, generating tree file for tid=%u (dump_tree_id_=%u)\n", 
-                              previous_tid, tid, previous_tid, previous_dump_tree_id); 
-                      fflush(cxx_log_fp); 
+                    if (trace_debug) {
+                      printf("[solve] DEBUG: tid changed from %u to %u, generating tree file for tid=%u (dump_tree_id_=%u)\n", 
+                             previous_tid, tid, previous_tid, previous_dump_tree_id);
+                      fflush(stdout);
+                      if (cxx_log_fp) { 
+                        fprintf(cxx_log_fp, "[solve] DEBUG: tid changed from %u to %u, generating tree file for tid=%u (dump_tree_id_=%u)\n", 
+                                previous_tid, tid, previous_tid, previous_dump_tree_id); 
+                        fflush(cxx_log_fp); 
+                      }
                     }
                     // Temporarily set dump_tree_id_ to previous value for tree file generation
                     uint32_t saved_dump_tree_id = dump_tree_id_;
@@ -1965,7 +2300,7 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
                   fprintf(stderr, "[solve] DEBUG: first_tid set to %u, dump_tree_id_ set to %u\n", first_tid, dump_tree_id_);
                   fflush(stderr);
                   if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: first_tid set to %u, dump_tree_id_ set to %u\n", first_tid, dump_tree_id_); fflush(cxx_log_fp); }
-                  } else {
+                  } else if (trace_debug) {
                     printf("[solve] DEBUG: updated dump_tree_id_ to %u (tid=%u)\n", dump_tree_id_, tid);
                     fflush(stdout);
                     fprintf(stderr, "[solve] DEBUG: updated dump_tree_id_ to %u (tid=%u)\n", dump_tree_id_, tid);
@@ -1973,11 +2308,13 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
                     if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: updated dump_tree_id_ to %u (tid=%u)\n", dump_tree_id_, tid); fflush(cxx_log_fp); }
                   }
                 } else if (tid == (uint32_t)-1) {
-                  printf("[solve] DEBUG: tid=-1 (uninitialized), not updating dump_tree_id_ (current=%u)\n", dump_tree_id_);
-                  fflush(stdout);
-                  fprintf(stderr, "[solve] DEBUG: tid=-1 (uninitialized), not updating dump_tree_id_ (current=%u)\n", dump_tree_id_);
-                  fflush(stderr);
-                  if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: tid=-1 (uninitialized), not updating dump_tree_id_ (current=%u)\n", dump_tree_id_); fflush(cxx_log_fp); }
+                  if (trace_debug) {
+                    printf("[solve] DEBUG: tid=-1 (uninitialized), not updating dump_tree_id_ (current=%u)\n", dump_tree_id_);
+                    fflush(stdout);
+                    fprintf(stderr, "[solve] DEBUG: tid=-1 (uninitialized), not updating dump_tree_id_ (current=%u)\n", dump_tree_id_);
+                    fflush(stderr);
+                    if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: tid=-1 (uninitialized), not updating dump_tree_id_ (current=%u)\n", dump_tree_id_); fflush(cxx_log_fp); }
+                  }
                 }
                 break;
         case 8: // the maximum entry count in the union table
@@ -1998,33 +2335,45 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
       if (!line.empty()) {
         try {
           max_label_ = stoull(line);
-          std::cout << "[solve] DEBUG: parsed last field max_label_=" << max_label_ << " from remaining line='" << line << "'" << std::endl;
-          if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: parsed last field max_label_=%llu from remaining line='%s'\n", (unsigned long long)max_label_, line.c_str()); fflush(cxx_log_fp); }
+          if (trace_debug) {
+            std::cout << "[solve] DEBUG: parsed last field max_label_=" << max_label_ << " from remaining line='" << line << "'" << std::endl;
+            if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: parsed last field max_label_=%llu from remaining line='%s'\n", (unsigned long long)max_label_, line.c_str()); fflush(cxx_log_fp); }
+          }
         } catch (...) {
-          std::cout << "[solve] DEBUG: failed to parse max_label_ from line='" << line << "'" << std::endl;
-          if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: failed to parse max_label_ from line='%s'\n", line.c_str()); fflush(cxx_log_fp); }
+          if (trace_debug) {
+            std::cout << "[solve] DEBUG: failed to parse max_label_ from line='" << line << "'" << std::endl;
+            if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: failed to parse max_label_ from line='%s'\n", line.c_str()); fflush(cxx_log_fp); }
+          }
         }
       } else {
-        std::cout << "[solve] DEBUG: remaining line is empty after parsing 8 fields, token_index=" << token_index << std::endl;
-        if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: remaining line is empty after parsing 8 fields, token_index=%d\n", token_index); fflush(cxx_log_fp); }
+        if (trace_debug) {
+          std::cout << "[solve] DEBUG: remaining line is empty after parsing 8 fields, token_index=" << token_index << std::endl;
+          if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: remaining line is empty after parsing 8 fields, token_index=%d\n", token_index); fflush(cxx_log_fp); }
+        }
       }
     } else {
-      std::cout << "[solve] DEBUG: token_index=" << token_index << ", line.empty()=" << (line.empty() ? "true" : "false") << ", line='" << line << "'" << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: token_index=%d, line.empty()=%s, line='%s'\n", token_index, (line.empty() ? "true" : "false"), line.c_str()); fflush(cxx_log_fp); }
+      if (trace_debug) {
+        std::cout << "[solve] DEBUG: token_index=" << token_index << ", line.empty()=" << (line.empty() ? "true" : "false") << ", line='" << line << "'" << std::endl;
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: token_index=%d, line.empty()=%s, line='%s'\n", token_index, (line.empty() ? "true" : "false"), line.c_str()); fflush(cxx_log_fp); }
+      }
     }
     // Debug: log tid value after parsing
-    if (line_count <= 5 || tid != 0) {
+    if (trace_debug && (line_count <= 5 || tid != 0)) {
       std::cout << "[solve] DEBUG: after parsing line " << line_count << ", tid=" << tid << ", token_index=" << token_index << std::endl;
       if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] DEBUG: after parsing line %d, tid=%u, token_index=%d\n", line_count, tid, token_index); fflush(cxx_log_fp); }
     }
-    std::cout << "[solve] parsed line " << line_count << ": qid=" << qid << " label=" << label << " dir=" << direction << " addr=0x" << std::hex << addr << std::dec << " ctx=" << ctx << " order=" << order << " cons_type=" << cons_type << " tid=" << tid << " max_label_=" << max_label_ << std::endl;
-    if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] parsed line %d: qid=%u label=%u dir=%u addr=0x%llx ctx=%llu order=%u cons_type=%u tid=%u max_label_=%llu\n", line_count, qid, label, direction, (unsigned long long)addr, (unsigned long long)ctx, order, cons_type, tid, (unsigned long long)max_label_); fflush(cxx_log_fp); }
+    if (trace_debug) {
+      std::cout << "[solve] parsed line " << line_count << ": qid=" << qid << " label=" << label << " dir=" << direction << " addr=0x" << std::hex << addr << std::dec << " ctx=" << ctx << " order=" << order << " cons_type=" << cons_type << " tid=" << tid << " max_label_=" << max_label_ << std::endl;
+      if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] parsed line %d: qid=%u label=%u dir=%u addr=0x%llx ctx=%llu order=%u cons_type=%u tid=%u max_label_=%llu\n", line_count, qid, label, direction, (unsigned long long)addr, (unsigned long long)ctx, order, cons_type, tid, (unsigned long long)max_label_); fflush(cxx_log_fp); }
+    }
     std::unordered_map<uint32_t, uint8_t> sol;
     std::unordered_map<uint32_t, uint8_t> opt_sol;
 
     if (skip_rest) {
-      std::cout << "[solve] skip_rest=true, continue" << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] skip_rest=true, continue\n"); fflush(cxx_log_fp); }
+      if (trace_debug) {
+        std::cout << "[solve] skip_rest=true, continue" << std::endl;
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] skip_rest=true, continue\n"); fflush(cxx_log_fp); }
+      }
       continue;
     }
 
@@ -2032,10 +2381,12 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
 
     // Initialize path_prefix with tid for the first branch of each trace
     // This ensures different traces have different path-prefix hashes even if they process the same PC
-    if (cxx_log_fp) {
-      fprintf(cxx_log_fp, "[solve] DEBUG: checking path_prefix init: cons_type=%u first_tid_for_pp=%u tid=%u\n", 
-              cons_type, first_tid_for_pp, tid);
-      fflush(cxx_log_fp);
+    if (trace_debug) {
+      if (cxx_log_fp) {
+        fprintf(cxx_log_fp, "[solve] DEBUG: checking path_prefix init: cons_type=%u first_tid_for_pp=%u tid=%u\n", 
+                cons_type, first_tid_for_pp, tid);
+        fflush(cxx_log_fp);
+      }
     }
     if (cons_type == 0 && first_tid_for_pp == (uint32_t)-1 && tid != (uint32_t)-1) {
       first_tid_for_pp = tid;
@@ -2049,8 +2400,10 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
     }
 
     if (cons_type == 0) {
-      std::cout << "[solve] cons_type=0 (conditional), processing..." << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] cons_type=0 (conditional), processing...\n"); fflush(cxx_log_fp); }
+      if (trace_debug) {
+        std::cout << "[solve] cons_type=0 (conditional), processing..." << std::endl;
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] cons_type=0 (conditional), processing...\n"); fflush(cxx_log_fp); }
+      }
       bool try_solve = false;
       int uniq_pcset = 0;
       int ifmemorize = 0;
@@ -2082,13 +2435,47 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
       }
       if (try_solve) {
         filtered_count++;
+      } else if (label) {
+        marco_count(MM_BRANCHES_FILTERED, 1);
       }
+      marco_count(MM_BRANCHES_INGESTED, 1);
       uint64_t t_update = getTimeStamp();
-      std::cout << "[solve] calling update_graph label=" << label << " addr=0x" << std::hex << addr << std::dec << " dir=" << direction << " try_solve=" << try_solve << " tid=" << tid << " qid=" << qid << " uniq_pcset=" << uniq_pcset << " ifmemorize=" << ifmemorize << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] calling update_graph label=%u addr=0x%llx dir=%u try_solve=%d tid=%u qid=%u uniq_pcset=%d ifmemorize=%d\n", label, (unsigned long long)addr, direction, try_solve, tid, qid, uniq_pcset, ifmemorize); fflush(cxx_log_fp); }
+      if (trace_debug) {
+        std::cout << "[solve] calling update_graph label=" << label << " addr=0x" << std::hex << addr << std::dec << " dir=" << direction << " try_solve=" << try_solve << " tid=" << tid << " qid=" << qid << " uniq_pcset=" << uniq_pcset << " ifmemorize=" << ifmemorize << std::endl;
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] calling update_graph label=%u addr=0x%llx dir=%u try_solve=%d tid=%u qid=%u uniq_pcset=%d ifmemorize=%d\n", label, (unsigned long long)addr, direction, try_solve, tid, qid, uniq_pcset, ifmemorize); fflush(cxx_log_fp); }
+      }
       update_graph(label, addr, direction, try_solve, tid, qid, uniq_pcset, ifmemorize);
-      if (cxx_log_fp) {
-        fprintf(cxx_log_fp,
+      if (trace_debug) {
+        if (cxx_log_fp) {
+          fprintf(cxx_log_fp,
+                  "[branch_summary] tid=%u qid=%u label=%u dir=%u addr=0x%llx ctx=%llu order=%u try_solve=%d uniq_pcset=%d ifmemorize=%d untaken_digest=0x%llx\n",
+                  tid,
+                  qid,
+                  label,
+                  direction,
+                  (unsigned long long)addr,
+                  (unsigned long long)ctx,
+                  order,
+                  try_solve ? 1 : 0,
+                  uniq_pcset,
+                  ifmemorize,
+                  (unsigned long long)untaken_update_ifsat);
+          fflush(cxx_log_fp);
+        }
+        printf("[branch_summary] tid=%u qid=%u label=%u dir=%u addr=0x%llx ctx=%llu order=%u try_solve=%d uniq_pcset=%d ifmemorize=%d untaken_digest=0x%llx\n",
+               tid,
+               qid,
+               label,
+               direction,
+               (unsigned long long)addr,
+               (unsigned long long)ctx,
+               order,
+               try_solve ? 1 : 0,
+               uniq_pcset,
+               ifmemorize,
+               (unsigned long long)untaken_update_ifsat);
+        fflush(stdout);
+        fprintf(stderr,
                 "[branch_summary] tid=%u qid=%u label=%u dir=%u addr=0x%llx ctx=%llu order=%u try_solve=%d uniq_pcset=%d ifmemorize=%d untaken_digest=0x%llx\n",
                 tid,
                 qid,
@@ -2101,41 +2488,21 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
                 uniq_pcset,
                 ifmemorize,
                 (unsigned long long)untaken_update_ifsat);
-        fflush(cxx_log_fp);
+        fflush(stderr);
       }
-      printf("[branch_summary] tid=%u qid=%u label=%u dir=%u addr=0x%llx ctx=%llu order=%u try_solve=%d uniq_pcset=%d ifmemorize=%d untaken_digest=0x%llx\n",
-             tid,
-             qid,
-             label,
-             direction,
-             (unsigned long long)addr,
-             (unsigned long long)ctx,
-             order,
-             try_solve ? 1 : 0,
-             uniq_pcset,
-             ifmemorize,
-             (unsigned long long)untaken_update_ifsat);
-      fflush(stdout);
-      fprintf(stderr,
-              "[branch_summary] tid=%u qid=%u label=%u dir=%u addr=0x%llx ctx=%llu order=%u try_solve=%d uniq_pcset=%d ifmemorize=%d untaken_digest=0x%llx\n",
-              tid,
-              qid,
-              label,
-              direction,
-              (unsigned long long)addr,
-              (unsigned long long)ctx,
-              order,
-              try_solve ? 1 : 0,
-              uniq_pcset,
-              ifmemorize,
-              (unsigned long long)untaken_update_ifsat);
-      fflush(stderr);
       total_updateG_time += (getTimeStamp() - t_update);
-      std::cout << "[solve] update_graph returned" << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] update_graph returned\n"); fflush(cxx_log_fp); }
+      if (label && tid != (uint32_t)-1 && byte_mask.is_open()) {
+        byte_mask.begin(qid, tid);
+        mask_branch_deps(label, try_solve);
+      }
+      if (trace_debug) {
+        std::cout << "[solve] update_graph returned" << std::endl;
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] update_graph returned\n"); fflush(cxx_log_fp); }
+      }
     }
     else if (cons_type == 2) {
       if (std::getline(myfile,line)) {
+        capture.line(line);
         uint32_t memcmp_datasize = label;
         uint8_t data[1024];
         int token_index = 0;
@@ -2146,7 +2513,9 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
         }
         data[token_index++] = stoul(line);
         bool try_solve = bcount_filter(addr, ctx, 0, order);
-        std::cout << "going for handle_fmemcmp branch" << std::endl;
+        if (trace_debug) {
+          std::cout << "going for handle_fmemcmp branch" << std::endl;
+        }
         if (try_solve)
           handle_fmemcmp(data, direction, label, tid, addr);
       } else {
@@ -2164,6 +2533,8 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
   if (cxx_log_fp) { fprintf(cxx_log_fp, "[solve] exited while loop, line_count=%d, end of one input\n", line_count); fflush(cxx_log_fp); }
   // end of one input
   total_symb_brc += filtered_count;
+  marco_count(MM_TRACES_INGESTED, 1);
+  marco_observe(MH_TRACE_INGEST_US, marco_metrics_now() - ingest_start);
 
   fid = 0; // reset for next input seed
   // at the end of each execution, dump tree and flush everything of the running seed
@@ -2199,6 +2570,12 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
     dump_tree_id_ = saved_dump_tree_id;
   }
 
+  byte_mask.publish(); // before the union table of this trace is flushed
+  if (capture.is_open()) {
+    uint32_t top = max_label_ > max_label_per_session ? max_label_ : max_label_per_session;
+    capture.union_table(tree_dump_qid, tree_dump_tid, __union_table, sizeof(dfsan_label_info) * (top + 1));
+    capture.end_trace();
+  }
   cleanup1(); // flush the union table of the running seed
   cleanup_deps(); // flush the dependency tree
 
@@ -2216,6 +2593,13 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
               << "\ncur (exec;no solving)cost: " << acc_time / 1000  << "ms"
               << "\ntotal reload time " << total_reload_time / 1000  << "ms"
               << "\ntotal solving(reload included) time " << total_solving_time / 1000  << "ms"
+              << "\nsolver cache hits " << solver_cache.hits() << " misses " << solver_cache.misses()
+              << "\nbyte masks published " << byte_mask.published()
+              << "\nnested constraints dropped by partitioning " << total_dropped_nested
+              << "\ncomponent cache hits " << total_component_hits
+              << "\nsolved full/relaxed/optimistic/unsat " << total_full_sat << "/" << total_relaxed_sat
+              << "/" << total_opt_sat << "/" << total_unsat
+              << "\nrelaxation tries " << total_relax_tries << " time " << total_relax_time / 1000 << "ms"
               << std::endl;
   }
   // Use first_tid if available, otherwise use last tid
@@ -2242,11 +2626,37 @@ uint32_t solve(int shmid, uint32_t pipeid, uint32_t brc_flip, std::ifstream &pcs
   return return_tid;
 }
 
+// END* tokens close a round on the scheduler side
+static void send_end_token(const std::string &endtoken, uint32_t kind) {
+  if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] WRITE TOKEN: %s", endtoken.c_str()); fflush(cxx_log_fp); }
+  printf("[run_solver] WRITE TOKEN: %s", endtoken.c_str());
+  fflush(stdout);
+  if (decision_chan.is_open()) {
+    if (!decision_chan.send_token(kind)) {
+      printf("[run_solver] scheduler channel closed\n");
+      fflush(stdout);
+    }
+    return;
+  }
+  ssize_t wret = write(named_pipe_fd, endtoken.c_str(), strlen(endtoken.c_str()));
+  if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0)); fflush(cxx_log_fp); }
+  printf("[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0));
+  fflush(stdout);
+  fsync(named_pipe_fd);
+}
+
 extern "C" {
   void init_core(bool saving_whole, uint32_t initial_count) {
     init(saving_whole);
     
-    named_pipe_fd = open("/tmp/pcpipe", O_WRONLY);
+    // MARCO_CHANNEL=<socket path> switches to the shared-memory channel
+    const char* chan_path = getenv("MARCO_CHANNEL");
+    bool use_chan = chan_path && chan_path[0] != '\0';
+    if (use_chan && !decision_chan.serve(chan_path)) {
+      printf("[init_core] cannot set up channel at %s, falling back to FIFOs\n", chan_path);
+      use_chan = false;
+    }
+    named_pipe_fd = use_chan ? -1 : open(pipe_path("pcpipe").c_str(), O_WRONLY);
     // Get log directory from environment or use default
     const char* log_dir = getenv("MARCO_LOG_DIR");
     char log_path[512];
@@ -2257,13 +2667,18 @@ extern "C" {
     }
     cxx_log_fp = fopen(log_path, "a");
     if (cxx_log_fp) { fprintf(cxx_log_fp, "[init_core] starting, open(/tmp/pcpipe) fd=%d errno=%d, log_path=%s\n", named_pipe_fd, (named_pipe_fd < 0 ? errno : 0), log_path); fflush(cxx_log_fp); }
-    pcsetpipe.open("/tmp/myfifo");
-    if (!pcsetpipe.is_open()) {
-      std::cout << "[init_core] failed to open /tmp/myfifo for reading" << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "open myfifo FAILED\n"); fflush(cxx_log_fp); }
+    if (use_chan) {
+      std::cout << "[init_core] scheduler attached on " << chan_path << std::endl;
+      if (cxx_log_fp) { fprintf(cxx_log_fp, "channel %s OK\n", chan_path); fflush(cxx_log_fp); }
     } else {
-      std::cout << "[init_core] opened /tmp/myfifo for reading" << std::endl;
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "open myfifo OK\n"); fflush(cxx_log_fp); }
+      pcsetpipe.open(pipe_path("myfifo"));
+      if (!pcsetpipe.is_open()) {
+        std::cout << "[init_core] failed to open /tmp/myfifo for reading" << std::endl;
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "open myfifo FAILED\n"); fflush(cxx_log_fp); }
+      } else {
+        std::cout << "[init_core] opened /tmp/myfifo for reading" << std::endl;
+        if (cxx_log_fp) { fprintf(cxx_log_fp, "open myfifo OK\n"); fflush(cxx_log_fp); }
+      }
     }
 
     ce_count = -1;
@@ -2271,7 +2686,20 @@ extern "C" {
 
     printf("the length of union_table is %u\n", 0xC00000000/sizeof(dfsan_label_info));
     __z3_solver.set("timeout", 1000U);
-    memset(pfx_pp_map, 0, pfxkMapSize);
+    // MARCO_STATE_DIR=<dir> keeps the path-prefix dedup map across restarts
+    const char* state_dir = getenv("MARCO_STATE_DIR");
+    if (state_dir && state_dir[0] != '\0') {
+      mkdir(state_dir, 0755);
+      std::string pp_path = std::string(state_dir) + "/pp_map";
+      if (pp_store.open(pp_path, pfxkMapSize)) {
+        pfx_pp_map = pp_store.bits();
+        last_pp_snapshot = getTimeStamp();
+        std::cout << "[init_core] path-prefix map at " << pp_path
+                  << (pp_store.recovered() ? ", recovered" : ", fresh") << std::endl;
+      }
+    }
+    if (!pp_store.is_open())
+      memset(pfx_pp_map, 0, pfxkMapSize);
     memset(node_map, 0, pfxkMapSize * sizeof(uint16_t));
     memset(pp_map, 0, kMapSize);
     memset(trace_map_, 0, kMapSize);
@@ -2285,6 +2713,8 @@ extern "C" {
     if (cxx_log_fp) { fprintf(cxx_log_fp, "ENTER run_solver lastone=%u pipeid=%u brc=%u\n", lastone, pipeid, brc_flip); fflush(cxx_log_fp); } else { printf("[run_solver] ERROR: cxx_log_fp is NULL!\n"); fflush(stdout); }
     // reset for every new episode
     max_label_ = 0;
+    uint64_t round_start = marco_metrics_now();
+    marco_count(MM_ROUNDS, 1);
     printf("[run_solver] about to call solve()\n");
     fflush(stdout);
     uint32_t cur_inid = solve(shmid, pipeid, brc_flip, pcsetpipe);
@@ -2295,19 +2725,8 @@ extern "C" {
     int res;
     std::cout << "cur_inid=" << cur_inid << std::endl;
     std::cout << "run_solver:lastone=" << lastone << std::endl;
-    std::string endtoken;
     // Marco semantics: signal end of current trace ingestion
-    endtoken = "END@@\n";
-    if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] WRITE TOKEN: %s", endtoken.c_str()); fflush(cxx_log_fp); }
-    printf("[run_solver] WRITE TOKEN: %s", endtoken.c_str());
-    fflush(stdout);
-    {
-      ssize_t wret = write(named_pipe_fd, endtoken.c_str(), strlen(endtoken.c_str()));
-      if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0)); fflush(cxx_log_fp); }
-      printf("[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0));
-      fflush(stdout);
-    }
-    fsync(named_pipe_fd);
+    send_end_token("END@@\n", CHAN_END);
 
     // retry and keep producing seeds continuously; block waiting for new decisions
     while (1) {
@@ -2317,43 +2736,20 @@ extern "C" {
       if (res > 0) { // with outcome, CE will pick up new seed to run
         std::cout << "new outcome, move on to sync new batch" << std::endl;
         shmdt(__union_table); // reset for next epi
-        endtoken = "ENDNEW@@\n";  // a new seed is generated!
-        if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] WRITE TOKEN: %s", endtoken.c_str()); fflush(cxx_log_fp); }
-        printf("[run_solver] WRITE TOKEN: %s", endtoken.c_str());
-        fflush(stdout);
-        {
-          ssize_t wret = write(named_pipe_fd, endtoken.c_str(), strlen(endtoken.c_str()));
-          if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0)); fflush(cxx_log_fp); }
-          printf("[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0));
-          fflush(stdout);
+        output_writer.flush(); // the fuzzer syncs fifo/queue as soon as it sees ENDNEW
+        if (pp_store.is_open() && getTimeStamp() - last_pp_snapshot > (uint64_t)PP_SNAPSHOT_SECS * 1000000) {
+          if (!pp_store.snapshot())
+            std::cout << "path-prefix map snapshot failed" << std::endl;
+          last_pp_snapshot = getTimeStamp();
         }
-        fsync(named_pipe_fd);
+        send_end_token("ENDNEW@@\n", CHAN_ENDNEW);  // a new seed is generated!
+        marco_observe(MH_ROUND_US, marco_metrics_now() - round_start);
         break;
       } else if (res == -1) {
         // Marco original logic: send ENDDUP for duplicate path-prefix
-        endtoken = "ENDDUP@@\n";
-        if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] WRITE TOKEN: %s", endtoken.c_str()); fflush(cxx_log_fp); }
-        printf("[run_solver] WRITE TOKEN: %s", endtoken.c_str());
-        fflush(stdout);
-        {
-          ssize_t wret = write(named_pipe_fd, endtoken.c_str(), strlen(endtoken.c_str()));
-          if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0)); fflush(cxx_log_fp); }
-          printf("[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0));
-          fflush(stdout);
-        }
-        fsync(named_pipe_fd);
+        send_end_token("ENDDUP@@\n", CHAN_ENDDUP);
       } else {
-        endtoken = "ENDUNSAT@@\n";
-        if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] WRITE TOKEN: %s", endtoken.c_str()); fflush(cxx_log_fp); }
-        printf("[run_solver] WRITE TOKEN: %s", endtoken.c_str());
-        fflush(stdout);
-        {
-          ssize_t wret = write(named_pipe_fd, endtoken.c_str(), strlen(endtoken.c_str()));
-          if (cxx_log_fp) { fprintf(cxx_log_fp, "[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0)); fflush(cxx_log_fp); }
-          printf("[run_solver] write() ret=%zd errno=%d\n", wret, (wret < 0 ? errno : 0));
-          fflush(stdout);
-        }
-        fsync(named_pipe_fd);
+        send_end_token("ENDUNSAT@@\n", CHAN_ENDUNSAT);
         std::cout << "failure solving, UNSAT!" << std::endl;
       }
     }
@@ -2373,3 +2769,57 @@ extern "C" {
   }
 
 };
+
+// fastgen-replay: the same ingestion and solving path, without the scheduler
+// and the shared union table
+void replay_init(void *union_table) {
+  init(false);
+  // logging every branch record would dominate the ingest timings
+  const char *debug_env = getenv("MARCO_TRACE_DEBUG");
+  trace_debug = debug_env && debug_env[0] != '\0' && strcmp(debug_env, "0") != 0;
+  named_pipe_fd = open("/dev/null", O_WRONLY);
+  ce_count = -1;
+  __z3_solver.set("timeout", 1000U);
+  memset(pfx_pp_map, 0, pfxkMapSize);
+  memset(node_map, 0, pfxkMapSize * sizeof(uint16_t));
+  memset(pp_map, 0, kMapSize);
+  memset(trace_map_, 0, kMapSize);
+  memset(context_map_, 0, kMapSize);
+  memset(bitmap_, 0, kBitmapSize * sizeof(uint16_t));
+  __union_table = (dfsan_label_info *)union_table;
+}
+
+uint32_t replay_trace(std::istream &lines, uint32_t brc_flip) {
+  max_label_ = 0;
+  memset(virgin_map_, 0, kMapSize);
+  memset(node_map, 0, pfxkMapSize * sizeof(uint16_t));
+  prev_loc_ = 0;
+  dump_tree_id_ = 0;
+  return ingest_trace(lines, brc_flip);
+}
+
+int replay_decision(uint32_t qid, uint32_t tid, uint32_t nid, uint32_t conc_dir,
+                    uint32_t plen, uint64_t pp_hash, std::string &extra) {
+  untaken_update_ifsat = pp_hash;
+  uint64_t one_start = getTimeStamp();
+  int res = run_decision(qid, tid, nid, conc_dir, plen, extra);
+  total_solving_time += (getTimeStamp() - one_start);
+  return res;
+}
+
+void replay_sync() {
+  output_writer.flush();
+}
+
+void replay_counters(ReplayCounters &c) {
+  c.updateG_time = total_updateG_time;
+  c.getdeps_time = total_getdeps_cost;
+  c.tupling_time = total_extra_time;
+  c.reload_time = total_reload_time;
+  c.relax_time = total_relax_time;
+  c.full_sat = total_full_sat;
+  c.relaxed_sat = total_relaxed_sat;
+  c.opt_sat = total_opt_sat;
+  c.unsat = total_unsat;
+  c.generated = ce_count + 1;
+}
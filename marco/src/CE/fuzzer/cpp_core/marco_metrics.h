@@ -0,0 +1,183 @@
+/*
+ * Pipeline metrics: counters and latency histograms in a shared-memory block.
+ *
+ * With MARCO_METRICS=<dir> every process that touches a metric maps
+ * <dir>/<program name>.<pid>.metrics (fastgen.4711.metrics, ...) and bumps
+ * its slots with relaxed atomics, so concurrent instances of a program (one
+ * per orchestrator lane) never share counters. Fork server children inherit
+ * the mapping of the server and count into its block. Without MARCO_METRICS
+ * every update is a single predicted branch.
+ *
+ * marco-metrics (metrics_cli.cc) prints a snapshot of the blocks, summed per
+ * program or one per process, or what changed over an interval.
+ *
+ * This header is plain C and is included by FastGen, by SymFit
+ * (accel/tcg/tcg-runtime-symsan.c) and by the symsan runtime. The copy in
+ * symfit-source/external/symsan/runtime/marco_metrics.h must stay identical;
+ * bump MARCO_METRICS_VERSION whenever the enums below change.
+ */
+#ifndef MARCO_METRICS_H_
+#define MARCO_METRICS_H_
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#define MARCO_METRICS_MAGIC 0x3172744d7a4dULL /* "MzMtr1" */
+#define MARCO_METRICS_VERSION 2
+#define MARCO_HIST_BUCKETS 32
+
+enum marco_counter {
+  /* SymFit */
+  MM_BRANCHES_EMITTED,     /* branch records written to wp2 */
+  MM_BRANCHES_SYMBOLIC,    /* ... of which had a label */
+  MM_BRANCH_WRITE_ERRORS,
+  MM_UNIONS_CREATED,
+  MM_UNIONS_DEDUPED,       /* __taint_union answered from the hash table */
+  MM_SIMPLIFY_FOLDED,      /* __taint_union peepholes: became concrete */
+  MM_SIMPLIFY_IDENTITY,    /* ... an operand stands for the node */
+  MM_SIMPLIFY_REASSOC,     /* ... constant chain merged */
+  MM_SIMPLIFY_CAST,        /* ... nested ZExt/SExt/Trunc collapsed */
+  MM_SIMPLIFY_EXTRACT,     /* ... Extract/Concat collapsed */
+  MM_EXECUTIONS,           /* fork server children */
+  /* FastGen */
+  MM_TRACES_INGESTED,
+  MM_BRANCHES_INGESTED,
+  MM_BRANCHES_FILTERED,    /* symbolic, but not worth a solver call */
+  MM_DECISIONS,
+  MM_DECISIONS_DUP,        /* dropped by the path-prefix check */
+  MM_SOLVER_SAT,
+  MM_SOLVER_RELAXED,
+  MM_SOLVER_OPTIMISTIC,
+  MM_SOLVER_UNSAT,
+  MM_SOLVER_CACHE_HITS,
+  MM_INPUTS_GENERATED,
+  MM_TREE_WRITE_BYTES,
+  MM_TREE_READ_BYTES,
+  MM_ROUNDS,               /* run_solver calls */
+  MM_NUM_COUNTERS
+};
+
+enum marco_hist_id {
+  MH_TRACE_INGEST_US,      /* one trace through update_graph */
+  MH_SOLVE_US,             /* one decision through gen_solve_pc */
+  MH_SOLVER_CHECK_US,      /* one z3 check */
+  MH_TREE_WRITE_US,
+  MH_TREE_READ_US,
+  MH_DECISION_WAIT_US,     /* blocked on the scheduler */
+  MH_ROUND_US,             /* run_solver, trace to ENDNEW */
+  MH_NUM_HISTS
+};
+
+/* bucket 0 holds 0, bucket b > 0 holds [2^(b-1), 2^b), the last one is open */
+struct marco_hist {
+  uint64_t count;
+  uint64_t sum;
+  uint64_t buckets[MARCO_HIST_BUCKETS];
+};
+
+struct marco_metrics {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t ncounters;
+  uint32_t nhists;
+  uint32_t pad;
+  uint64_t created_us;     /* CLOCK_REALTIME */
+  uint64_t counters[MM_NUM_COUNTERS];
+  struct marco_hist hists[MH_NUM_HISTS];
+};
+
+#ifdef __cplusplus
+extern "C" char *program_invocation_short_name;
+#else
+extern char *program_invocation_short_name;
+#endif
+
+static struct marco_metrics *marco_metrics_block;
+static int marco_metrics_tried;
+
+static inline uint64_t marco_metrics_now(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline struct marco_metrics *marco_metrics_open(const char *path) {
+  int fd = open(path, O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    fprintf(stderr, "[marco_metrics]cannot open %s: %s\n", path, strerror(errno));
+    return NULL;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 ||
+      ((size_t)st.st_size < sizeof(struct marco_metrics) &&
+       ftruncate(fd, sizeof(struct marco_metrics)) < 0)) {
+    fprintf(stderr, "[marco_metrics]cannot size %s: %s\n", path, strerror(errno));
+    close(fd);
+    return NULL;
+  }
+  void *map = mmap(NULL, sizeof(struct marco_metrics), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return NULL;
+  struct marco_metrics *m = (struct marco_metrics *)map;
+  if (__atomic_load_n(&m->magic, __ATOMIC_ACQUIRE) != MARCO_METRICS_MAGIC) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    m->version = MARCO_METRICS_VERSION;
+    m->ncounters = MM_NUM_COUNTERS;
+    m->nhists = MH_NUM_HISTS;
+    m->created_us = (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(&m->magic, &expected, MARCO_METRICS_MAGIC, 0,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+  } else if (m->version != MARCO_METRICS_VERSION) {
+    fprintf(stderr, "[marco_metrics]%s has layout version %u, expected %u\n",
+            path, m->version, MARCO_METRICS_VERSION);
+    munmap(map, sizeof(struct marco_metrics));
+    return NULL;
+  }
+  return m;
+}
+
+/* the block of this translation unit, mapped on first use */
+static inline struct marco_metrics *marco_metrics_get(void) {
+  if (__builtin_expect(!marco_metrics_tried, 0)) {
+    marco_metrics_tried = 1;
+    const char *dir = getenv("MARCO_METRICS");
+    if (dir && dir[0] != '\0') {
+      char path[4096];
+      snprintf(path, sizeof(path), "%s/%s.%d.metrics", dir, program_invocation_short_name,
+               (int)getpid());
+      marco_metrics_block = marco_metrics_open(path);
+    }
+  }
+  return marco_metrics_block;
+}
+
+static inline void marco_count(enum marco_counter id, uint64_t n) {
+  struct marco_metrics *m = marco_metrics_get();
+  if (m) __atomic_fetch_add(&m->counters[id], n, __ATOMIC_RELAXED);
+}
+
+static inline uint32_t marco_hist_bucket(uint64_t v) {
+  uint32_t b = v ? 64 - __builtin_clzll(v) : 0;
+  return b < MARCO_HIST_BUCKETS ? b : MARCO_HIST_BUCKETS - 1;
+}
+
+static inline void marco_observe(enum marco_hist_id id, uint64_t v) {
+  struct marco_metrics *m = marco_metrics_get();
+  if (!m) return;
+  struct marco_hist *h = &m->hists[id];
+  __atomic_fetch_add(&h->count, 1, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&h->sum, v, __ATOMIC_RELAXED);
+  __atomic_fetch_add(&h->buckets[marco_hist_bucket(v)], 1, __ATOMIC_RELAXED);
+}
+
+#endif
@@ -0,0 +1,265 @@
+// marco-metrics: print the MARCO_METRICS blocks of a running pipeline.
+//
+//   marco-metrics [-p] <dir|file>...             snapshot since the blocks were created
+//   marco-metrics [-p] -i 5 [-n 12] <dir|file>... change over every 5s window
+//
+// A directory stands for all *.metrics files in it. Every process has a
+// block of its own (<program>.<pid>.metrics); they are summed per program,
+// or printed one by one with -p. Counters are printed as totals (snapshot)
+// or per-second rates (interval); histograms as count, mean and approximate
+// percentiles taken from the log2 buckets.
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <map>
+#include "marco_metrics.h"
+
+static const char *counter_names[] = {
+  "branches_emitted",
+  "branches_symbolic",
+  "branch_write_errors",
+  "unions_created",
+  "unions_deduped",
+  "simplify_folded",
+  "simplify_identity",
+  "simplify_reassoc",
+  "simplify_cast",
+  "simplify_extract",
+  "executions",
+  "traces_ingested",
+  "branches_ingested",
+  "branches_filtered",
+  "decisions",
+  "decisions_dup",
+  "solver_sat",
+  "solver_relaxed",
+  "solver_optimistic",
+  "solver_unsat",
+  "solver_cache_hits",
+  "inputs_generated",
+  "tree_write_bytes",
+  "tree_read_bytes",
+  "rounds",
+};
+
+static const char *hist_names[] = {
+  "trace_ingest_us",
+  "solve_us",
+  "solver_check_us",
+  "tree_write_us",
+  "tree_read_us",
+  "decision_wait_us",
+  "round_us",
+};
+
+static_assert(sizeof(counter_names) / sizeof(counter_names[0]) == MM_NUM_COUNTERS,
+              "counter_names out of sync with marco_metrics.h");
+static_assert(sizeof(hist_names) / sizeof(hist_names[0]) == MH_NUM_HISTS,
+              "hist_names out of sync with marco_metrics.h");
+
+// one program, or one process with -p
+struct Source {
+  std::string name;
+  std::vector<const marco_metrics*> blocks;
+  marco_metrics last;
+};
+
+static bool ends_with(const std::string &s, const char *suffix) {
+  size_t n = strlen(suffix);
+  return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+// read-only mapping, without creating anything
+static const marco_metrics *map_block(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "[marco-metrics]cannot open %s: %s\n", path.c_str(), strerror(errno));
+    return nullptr;
+  }
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(marco_metrics)) {
+    fprintf(stderr, "[marco-metrics]%s is too small for a metrics block\n", path.c_str());
+    close(fd);
+    return nullptr;
+  }
+  void *map = mmap(NULL, sizeof(marco_metrics), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return nullptr;
+  const marco_metrics *m = (const marco_metrics *)map;
+  if (m->magic != MARCO_METRICS_MAGIC || m->version != MARCO_METRICS_VERSION ||
+      m->ncounters != MM_NUM_COUNTERS || m->nhists != MH_NUM_HISTS) {
+    fprintf(stderr, "[marco-metrics]%s is not a version %d metrics block\n",
+            path.c_str(), MARCO_METRICS_VERSION);
+    munmap(map, sizeof(marco_metrics));
+    return nullptr;
+  }
+  return m;
+}
+
+// program a block belongs to: dir/fastgen.4711.metrics -> fastgen
+static std::string program_of(const std::string &path) {
+  size_t slash = path.rfind('/');
+  std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+  if (ends_with(name, ".metrics")) name.resize(name.size() - strlen(".metrics"));
+  size_t dot = name.rfind('.');
+  if (dot != std::string::npos && dot + 1 < name.size() &&
+      name.find_first_not_of("0123456789", dot + 1) == std::string::npos)
+    name.resize(dot);
+  return name;
+}
+
+static void add_files(const std::string &arg, std::vector<std::string> &out) {
+  struct stat st;
+  if (stat(arg.c_str(), &st) == 0 && S_ISDIR(st.st_mode)) {
+    DIR *dir = opendir(arg.c_str());
+    if (!dir) return;
+    std::vector<std::string> names;
+    while (struct dirent *e = readdir(dir)) {
+      if (ends_with(e->d_name, ".metrics")) names.push_back(e->d_name);
+    }
+    closedir(dir);
+    std::sort(names.begin(), names.end());
+    for (auto &n : names) out.push_back(arg + "/" + n);
+    return;
+  }
+  out.push_back(arg);
+}
+
+static std::vector<Source> group_sources(const std::vector<std::string> &files,
+                                         bool per_process) {
+  std::vector<Source> out;
+  std::map<std::string, size_t> index;
+  for (auto &f : files) {
+    const marco_metrics *m = map_block(f);
+    if (!m) continue;
+    std::string name = per_process ? f : program_of(f);
+    auto it = index.find(name);
+    if (it == index.end()) {
+      it = index.emplace(name, out.size()).first;
+      out.emplace_back();
+      out.back().name = name;
+    }
+    out[it->second].blocks.push_back(m);
+  }
+  return out;
+}
+
+// sum of the blocks of s
+static void read_source(const Source &s, marco_metrics &dst) {
+  memset(&dst, 0, sizeof(dst));
+  for (const marco_metrics *src : s.blocks) {
+    for (int i = 0; i < MM_NUM_COUNTERS; i++)
+      dst.counters[i] += __atomic_load_n(&src->counters[i], __ATOMIC_RELAXED);
+    for (int i = 0; i < MH_NUM_HISTS; i++) {
+      dst.hists[i].count += __atomic_load_n(&src->hists[i].count, __ATOMIC_RELAXED);
+      dst.hists[i].sum += __atomic_load_n(&src->hists[i].sum, __ATOMIC_RELAXED);
+      for (int b = 0; b < MARCO_HIST_BUCKETS; b++)
+        dst.hists[i].buckets[b] += __atomic_load_n(&src->hists[i].buckets[b], __ATOMIC_RELAXED);
+    }
+  }
+}
+
+// upper bound of the bucket holding the q-quantile
+static uint64_t quantile(const marco_hist &h, uint64_t total, double q) {
+  uint64_t want = (uint64_t)(q * total);
+  if (want >= total) want = total - 1;
+  uint64_t seen = 0;
+  for (int b = 0; b < MARCO_HIST_BUCKETS; b++) {
+    seen += h.buckets[b];
+    if (seen > want) return b ? (1ULL << b) - 1 : 0;
+  }
+  return 1ULL << (MARCO_HIST_BUCKETS - 1);
+}
+
+// cur - prev when prev is given, cur otherwise; rates per second if secs > 0
+static void print_block(const Source &s, const marco_metrics &cur,
+                        const marco_metrics *prev, double secs) {
+  if (s.blocks.size() > 1)
+    printf("== %s (%zu processes)\n", s.name.c_str(), s.blocks.size());
+  else
+    printf("== %s\n", s.name.c_str());
+  for (int i = 0; i < MM_NUM_COUNTERS; i++) {
+    uint64_t v = cur.counters[i] - (prev ? prev->counters[i] : 0);
+    if (!v) continue;
+    if (secs > 0)
+      printf("  %-22s %14llu  %12.1f/s\n", counter_names[i], (unsigned long long)v, v / secs);
+    else
+      printf("  %-22s %14llu\n", counter_names[i], (unsigned long long)v);
+  }
+  for (int i = 0; i < MH_NUM_HISTS; i++) {
+    marco_hist h = cur.hists[i];
+    if (prev) {
+      h.count -= prev->hists[i].count;
+      h.sum -= prev->hists[i].sum;
+      for (int b = 0; b < MARCO_HIST_BUCKETS; b++) h.buckets[b] -= prev->hists[i].buckets[b];
+    }
+    if (!h.count) continue;
+    printf("  %-22s n=%llu mean=%.0f p50<=%llu p90<=%llu p99<=%llu total=%.1fms\n",
+           hist_names[i], (unsigned long long)h.count, (double)h.sum / h.count,
+           (unsigned long long)quantile(h, h.count, 0.5),
+           (unsigned long long)quantile(h, h.count, 0.9),
+           (unsigned long long)quantile(h, h.count, 0.99),
+           h.sum / 1000.0);
+  }
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-p] [-i secs [-n count]] <dir|file>...\n", prog);
+}
+
+int main(int argc, char **argv) {
+  int interval = 0;
+  int rounds = 0;
+  bool per_process = false;
+  int opt;
+  while ((opt = getopt(argc, argv, "pi:n:")) != -1) {
+    switch (opt) {
+      case 'p': per_process = true; break;
+      case 'i': interval = atoi(optarg); break;
+      case 'n': rounds = atoi(optarg); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind >= argc) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<std::string> files;
+  for (int i = optind; i < argc; i++) add_files(argv[i], files);
+  std::vector<Source> sources = group_sources(files, per_process);
+  if (sources.empty()) {
+    fprintf(stderr, "[marco-metrics]no metrics blocks found\n");
+    return 1;
+  }
+
+  if (interval <= 0) {
+    for (auto &s : sources) {
+      marco_metrics cur;
+      read_source(s, cur);
+      print_block(s, cur, nullptr, 0);
+    }
+    return 0;
+  }
+
+  for (auto &s : sources) read_source(s, s.last);
+  for (int r = 0; rounds <= 0 || r < rounds; r++) {
+    uint64_t start = marco_metrics_now();
+    sleep(interval);
+    double secs = (marco_metrics_now() - start) / 1e6;
+    printf("-- last %.1fs\n", secs);
+    for (auto &s : sources) {
+      marco_metrics cur;
+      read_source(s, cur);
+      print_block(s, cur, &s.last, secs);
+      s.last = cur;
+    }
+    fflush(stdout);
+  }
+  return 0;
+}
@@ -0,0 +1,323 @@
+#include "output_writer.h"
+#include "marco_metrics.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+OutputWriter::OutputWriter(size_t capacity)
+  : capacity_(capacity), busy_(0), stopping_(false), started_(false),
+    pack_(false), inputs_written_(0), trees_written_(0) {
+}
+
+OutputWriter::~OutputWriter() {
+  stop();
+}
+
+void OutputWriter::start() {
+  std::lock_guard<std::mutex> guard(lock_);
+  if (started_) return;
+  const char *pack_env = getenv("MARCO_OUTPUT_PACK");
+  pack_ = pack_env && pack_env[0] != '\0' && strcmp(pack_env, "0") != 0;
+  stopping_ = false;
+  started_ = true;
+  thread_ = std::thread(&OutputWriter::run, this);
+}
+
+void OutputWriter::stop() {
+  {
+    std::lock_guard<std::mutex> guard(lock_);
+    if (!started_) return;
+    stopping_ = true;
+  }
+  not_empty_.notify_all();
+  thread_.join();
+  started_ = false;
+  for (auto &it : pack_fds_) close(it.second);
+  pack_fds_.clear();
+}
+
+// urgent jobs go to the front and may exceed the capacity, a caller is waiting on them
+void OutputWriter::enqueue(Job &job, bool urgent) {
+  std::unique_lock<std::mutex> guard(lock_);
+  if (!started_) {
+    // no writer thread (e.g. init_core not called), write inline
+    guard.unlock();
+    run_job(job);
+    return;
+  }
+  if (urgent) {
+    jobs_.push_front(std::move(job));
+  } else {
+    not_full_.wait(guard, [this] { return jobs_.size() < capacity_; });
+    jobs_.push_back(std::move(job));
+  }
+  guard.unlock();
+  not_empty_.notify_one();
+}
+
+ParentFuture OutputWriter::load_parent(const std::string &path) {
+  Job job;
+  job.type = JOB_PARENT;
+  job.fid = 0;
+  job.path = path;
+  job.loaded = std::make_shared<std::promise<ParentRef>>();
+  ParentFuture loaded = job.loaded->get_future().share();
+  enqueue(job, true);
+  return loaded;
+}
+
+void OutputWriter::write_input(const std::unordered_map<uint32_t,uint8_t> &sol,
+                               const ParentRef &parent,
+                               const std::string &outputDir, uint32_t fid) {
+  Job job;
+  job.type = JOB_INPUT;
+  job.fid = fid;
+  job.dir = outputDir;
+  job.parent = parent;
+  job.sol.assign(sol.begin(), sol.end());
+  std::sort(job.sol.begin(), job.sol.end());
+  enqueue(job, false);
+}
+
+void OutputWriter::write_tree(const std::string &tree_dir, const std::string &path,
+                              const void *data, size_t size) {
+  Job job;
+  job.type = JOB_TREE;
+  job.fid = 0;
+  job.dir = tree_dir;
+  job.path = path;
+  job.data.assign((const uint8_t*)data, (const uint8_t*)data + size);
+  enqueue(job, false);
+}
+
+void OutputWriter::flush() {
+  std::unique_lock<std::mutex> guard(lock_);
+  idle_.wait(guard, [this] { return jobs_.empty() && busy_ == 0; });
+}
+
+void OutputWriter::run() {
+  while (true) {
+    Job job;
+    {
+      std::unique_lock<std::mutex> guard(lock_);
+      not_empty_.wait(guard, [this] { return stopping_ || !jobs_.empty(); });
+      if (jobs_.empty()) break; // stopping and drained
+      job = std::move(jobs_.front());
+      jobs_.pop_front();
+      busy_++;
+    }
+    not_full_.notify_one();
+
+    run_job(job);
+
+    {
+      std::lock_guard<std::mutex> guard(lock_);
+      busy_--;
+      if (jobs_.empty() && busy_ == 0) idle_.notify_all();
+    }
+  }
+  idle_.notify_all();
+}
+
+void OutputWriter::run_job(Job &job) {
+  switch (job.type) {
+    case JOB_INPUT: do_input(job); break;
+    case JOB_TREE: do_tree(job); break;
+    case JOB_PARENT: job.loaded->set_value(read_parent(job.path)); break;
+  }
+}
+
+// mkdir -p, remembering what already exists so each dir is created once per run
+bool OutputWriter::ensure_dir(const std::string &dir) {
+  if (dir.empty() || dirs_.count(dir)) return true;
+  size_t pos = 0;
+  while (pos != std::string::npos) {
+    pos = dir.find('/', pos + 1);
+    std::string prefix = dir.substr(0, pos);
+    if (prefix.empty() || dirs_.count(prefix)) continue;
+    if (mkdir(prefix.c_str(), 0777) == -1 && errno != EEXIST) {
+      fprintf(stderr, "[OutputWriter]cannot create output dir(%s) %s!\n", prefix.c_str(), strerror(errno));
+      return false;
+    }
+    dirs_.insert(prefix);
+  }
+  return true;
+}
+
+// consecutive decisions almost always share the parent seed, keep it cached
+ParentRef OutputWriter::read_parent(const std::string &path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "[OutputWriter]cannot open input file(%s) %s!\n", path.c_str(), strerror(errno));
+    return nullptr;
+  }
+  struct stat statbuf;
+  if (fstat(fd, &statbuf) < 0) {
+    fprintf(stderr, "cannot stat file %s!\n", strerror(errno));
+    close(fd);
+    return nullptr;
+  }
+
+  if (parent_ && path == parent_path_ && statbuf.st_ino == parent_ino_ &&
+      statbuf.st_size == parent_size_ &&
+      statbuf.st_mtim.tv_sec == parent_mtime_.tv_sec &&
+      statbuf.st_mtim.tv_nsec == parent_mtime_.tv_nsec) {
+    close(fd);
+    return parent_;
+  }
+
+  auto seed = std::make_shared<ParentSeed>();
+  seed->path = path;
+  seed->bytes.resize(statbuf.st_size);
+  size_t off = 0;
+  while (off < seed->bytes.size()) {
+    ssize_t n = read(fd, seed->bytes.data() + off, seed->bytes.size() - off);
+    if (n <= 0) {
+      if (n < 0 && errno == EINTR) continue;
+      fprintf(stderr, "[OutputWriter]short read on %s!\n", path.c_str());
+      close(fd);
+      return nullptr;
+    }
+    off += n;
+  }
+  close(fd);
+  XXH128_hash_t h = XXH3_128bits(seed->bytes.data(), seed->bytes.size());
+  seed->hash_lo = h.low64;
+  seed->hash_hi = h.high64;
+  parent_path_ = path;
+  parent_ino_ = statbuf.st_ino;
+  parent_size_ = statbuf.st_size;
+  parent_mtime_ = statbuf.st_mtim;
+  parent_ = seed;
+  return parent_;
+}
+
+static bool write_all(int fd, const uint8_t *buf, size_t size) {
+  while (size > 0) {
+    ssize_t n = write(fd, buf, size);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    buf += n;
+    size -= n;
+  }
+  return true;
+}
+
+void OutputWriter::do_input(Job &job) {
+  std::string queue_dir = job.dir + "/queue";
+  if (!ensure_dir(queue_dir)) return;
+
+  std::vector<uint8_t> out(job.parent->bytes);
+  for (auto &it : job.sol) {
+    if (it.first < out.size())
+      out[it.first] = it.second;
+  }
+
+  std::string idstr = std::to_string(job.fid % 1000000);
+  std::string output_file = queue_dir + "/id:" + std::string(6-idstr.size(),'0') + idstr;
+  int fdout = open(output_file.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0777);
+  if (fdout < 0) {
+    fprintf(stderr, "cannot open outputfile(%s) %s!\n", output_file.c_str(), strerror(errno));
+    return;
+  }
+  if (!write_all(fdout, out.data(), out.size())) {
+    fprintf(stderr, "write output error: %s!\n", strerror(errno));
+  }
+  close(fdout);
+  inputs_written_++;
+
+  if (pack_) append_pack(job);
+}
+
+// delta record: only byte ranges that differ from the parent are stored
+void OutputWriter::append_pack(Job &job) {
+  const std::vector<uint8_t> &parent = job.parent->bytes;
+  int fd;
+  auto it = pack_fds_.find(job.dir);
+  if (it == pack_fds_.end()) {
+    std::string pack_file = job.dir + "/queue.pack";
+    fd = open(pack_file.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+      fprintf(stderr, "[OutputWriter]cannot open pack file(%s) %s!\n", pack_file.c_str(), strerror(errno));
+      pack_ = false;
+      return;
+    }
+    pack_fds_[job.dir] = fd;
+  } else {
+    fd = it->second;
+  }
+
+  std::vector<uint8_t> ranges;
+  uint32_t range_count = 0;
+  size_t i = 0;
+  while (i < job.sol.size()) {
+    uint32_t off = job.sol[i].first;
+    if (off >= parent.size() || parent[off] == job.sol[i].second) {
+      i++;
+      continue;
+    }
+    size_t j = i;
+    while (j + 1 < job.sol.size() && job.sol[j + 1].first == job.sol[j].first + 1 &&
+           job.sol[j + 1].first < parent.size())
+      j++;
+    uint32_t len = j - i + 1;
+    ranges.insert(ranges.end(), (uint8_t*)&off, (uint8_t*)&off + sizeof(off));
+    ranges.insert(ranges.end(), (uint8_t*)&len, (uint8_t*)&len + sizeof(len));
+    for (size_t k = i; k <= j; k++) ranges.push_back(job.sol[k].second);
+    range_count++;
+    i = j + 1;
+  }
+
+  PackRecordHeader hdr;
+  hdr.magic = PACK_MAGIC;
+  hdr.fid = job.fid;
+  hdr.parent_lo = job.parent->hash_lo;
+  hdr.parent_hi = job.parent->hash_hi;
+  hdr.parent_size = parent.size();
+  hdr.range_count = range_count;
+
+  // one write per record so concurrent readers never see a torn entry
+  std::vector<uint8_t> rec;
+  rec.reserve(sizeof(hdr) + ranges.size());
+  rec.insert(rec.end(), (uint8_t*)&hdr, (uint8_t*)&hdr + sizeof(hdr));
+  rec.insert(rec.end(), ranges.begin(), ranges.end());
+  if (!write_all(fd, rec.data(), rec.size())) {
+    fprintf(stderr, "[OutputWriter]pack write error: %s!\n", strerror(errno));
+  }
+}
+
+void OutputWriter::do_tree(Job &job) {
+  if (!ensure_dir(job.dir)) return;
+  uint64_t start = marco_metrics_now();
+  // write to a temp name first, gen_solve_pc stats the final name
+  std::string tmp_file = job.path + ".tmp";
+  int fd = open(tmp_file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "[generate_tree_dump]1: cannot open file to write: %s (errno=%d: %s)\n", tmp_file.c_str(), errno, strerror(errno));
+    return;
+  }
+  bool ok = write_all(fd, job.data.data(), job.data.size());
+  close(fd);
+  if (!ok) {
+    fprintf(stderr, "[generate_tree_dump]1: write error %s\n", strerror(errno));
+    unlink(tmp_file.c_str());
+    return;
+  }
+  if (rename(tmp_file.c_str(), job.path.c_str()) != 0) {
+    fprintf(stderr, "[generate_tree_dump]1: rename to %s failed: %s\n", job.path.c_str(), strerror(errno));
+    return;
+  }
+  trees_written_++;
+  marco_count(MM_TREE_WRITE_BYTES, job.data.size());
+  marco_observe(MH_TREE_WRITE_US, marco_metrics_now() - start);
+}
@@ -0,0 +1,115 @@
+#ifndef OUTPUT_WRITER_H_
+#define OUTPUT_WRITER_H_
+#include <stdint.h>
+#include <sys/types.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <unordered_set>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <time.h>
+#include "parent_seed.h"
+
+// Asynchronous writer for generated test cases and union table tree dumps.
+// Solving threads only enqueue jobs; a single writer thread owns all of the
+// file system work (parent seed reads, directory creation, writes).
+//
+// Parent seeds are requested with load_parent() before solving starts. The
+// read jumps the queue, so it sees the file as it was when requested, and
+// the solving thread only waits on the future if a solution turns up before
+// the writer got to it.
+//
+// Test cases still land in <outputDir>/queue/id:%06d so the fuzzer side
+// (depot.rs) keeps picking them up. When MARCO_OUTPUT_PACK is set, every
+// test case is also appended to <outputDir>/queue.pack as a delta against
+// its parent seed (see PackRecordHeader).
+
+#define PACK_MAGIC 0x324b504d // "MPK2"
+
+struct PackRecordHeader {
+  uint32_t magic;
+  uint32_t fid;
+  uint64_t parent_lo;   // XXH3-128 of the parent seed contents, which
+  uint64_t parent_hi;   // identifies it among the queue seeds
+  uint32_t parent_size;
+  uint32_t range_count; // (offset, len, bytes[len]) triples following the header
+} __attribute__((packed));
+
+class OutputWriter {
+public:
+  OutputWriter(size_t capacity);
+  ~OutputWriter();
+
+  void start();
+  void stop();
+
+  // read a parent seed ahead of the queued jobs; a parent that is itself
+  // still queued (fifo/queue) needs a flush() first
+  ParentFuture load_parent(const std::string &path);
+  // queue one test case: parent with sol applied
+  void write_input(const std::unordered_map<uint32_t,uint8_t> &sol,
+                   const ParentRef &parent,
+                   const std::string &outputDir, uint32_t fid);
+  // queue one tree dump; data is copied before returning
+  void write_tree(const std::string &tree_dir, const std::string &path,
+                  const void *data, size_t size);
+  // block until every queued job has been written out
+  void flush();
+
+  uint64_t inputs_written() const { return inputs_written_; }
+  uint64_t trees_written() const { return trees_written_; }
+
+private:
+  enum JobType { JOB_INPUT, JOB_TREE, JOB_PARENT };
+  struct Job {
+    JobType type;
+    uint32_t fid;
+    std::string dir;
+    std::string path;   // target file for trees, seed to read for parents
+    ParentRef parent;
+    std::shared_ptr<std::promise<ParentRef>> loaded;
+    std::vector<std::pair<uint32_t,uint8_t>> sol;
+    std::vector<uint8_t> data;
+  };
+
+  void enqueue(Job &job, bool urgent);
+  void run();
+  void run_job(Job &job);
+  void do_input(Job &job);
+  void do_tree(Job &job);
+  void append_pack(Job &job);
+  bool ensure_dir(const std::string &dir);
+  ParentRef read_parent(const std::string &path);
+
+  size_t capacity_;
+  std::deque<Job> jobs_;
+  std::mutex lock_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  std::condition_variable idle_;
+  size_t busy_;
+  bool stopping_;
+  bool started_;
+  std::thread thread_;
+
+  // writer thread only
+  // last parent seed read, reused while the file is unchanged; callers keep
+  // rewriting the same path, so it is keyed on the file identity too
+  std::string parent_path_;
+  ino_t parent_ino_;
+  off_t parent_size_;
+  struct timespec parent_mtime_;
+  ParentRef parent_;
+  std::unordered_set<std::string> dirs_;
+  bool pack_;
+  std::unordered_map<std::string, int> pack_fds_;
+  std::atomic<uint64_t> inputs_written_;
+  std::atomic<uint64_t> trees_written_;
+};
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef PARENT_SEED_H_
+#define PARENT_SEED_H_
+#include <stdint.h>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Contents of a parent seed as read by the output writer, shared by the
+// solution filter and the queued test cases built on it. The XXH3-128 hash
+// is the seed's identity; the path is not, /outroot/tmp/cur_input_2 is
+// rewritten for every traced input.
+struct ParentSeed {
+  std::string path; // for logging
+  std::vector<uint8_t> bytes;
+  uint64_t hash_lo;
+  uint64_t hash_hi;
+};
+
+typedef std::shared_ptr<const ParentSeed> ParentRef;
+// null once resolved if the seed could not be read
+typedef std::shared_future<ParentRef> ParentFuture;
+
+#endif
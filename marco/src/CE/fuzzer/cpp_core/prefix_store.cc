@@ -0,0 +1,85 @@
+#include "prefix_store.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#define PREFIX_STORE_MAGIC 0x3150507a4d5a784dULL // "MxZMzPP1"
+// keeps the bitmap page aligned
+#define PREFIX_STORE_HEADER 4096
+
+PrefixStore::PrefixStore()
+  : map_(nullptr), map_size_(0), hdr_(nullptr), bits_(nullptr), bytes_(0),
+    clean_(false), recovered_(false) {}
+
+PrefixStore::~PrefixStore() {
+  if (map_) munmap(map_, map_size_);
+}
+
+bool PrefixStore::open(const std::string &path, size_t bytes) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "[PrefixStore]cannot open %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  size_t size = PREFIX_STORE_HEADER + bytes;
+  Header existing;
+  memset(&existing, 0, sizeof(existing));
+  bool valid = pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+               existing.magic == PREFIX_STORE_MAGIC && existing.bytes == bytes;
+  void *map = MAP_FAILED;
+  for (int attempt = 0; attempt < 2; attempt++) {
+    // truncating is how the map gets cleared, without touching 128MB of pages
+    if (!valid && ftruncate(fd, 0) < 0) break;
+    if (ftruncate(fd, size) < 0) break;
+    map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (map == MAP_FAILED) break;
+    Header *hdr = (Header *)map;
+    if (!valid) {
+      hdr->magic = PREFIX_STORE_MAGIC;
+      hdr->bytes = bytes;
+      break;
+    }
+    if (!hdr->clean || XXH3_64bits((uint8_t *)map + PREFIX_STORE_HEADER, bytes) == hdr->checksum) {
+      recovered_ = true;
+      break;
+    }
+    fprintf(stderr, "[PrefixStore]%s does not match its snapshot, cleared\n", path.c_str());
+    munmap(map, size);
+    map = MAP_FAILED;
+    valid = false;
+  }
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "[PrefixStore]cannot map %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  map_ = map;
+  map_size_ = size;
+  hdr_ = (Header *)map;
+  bits_ = (uint8_t *)map + PREFIX_STORE_HEADER;
+  bytes_ = bytes;
+  // stays clean until the first mark
+  clean_ = hdr_->clean != 0;
+  return true;
+}
+
+bool PrefixStore::snapshot() {
+  if (!map_) return false;
+  // bits first, then the header that vouches for them
+  if (msync(bits_, bytes_, MS_SYNC) < 0) {
+    fprintf(stderr, "[PrefixStore]msync failed: %s\n", strerror(errno));
+    return false;
+  }
+  hdr_->checksum = XXH3_64bits(bits_, bytes_);
+  hdr_->seq++;
+  hdr_->clean = 1;
+  clean_ = true;
+  return msync(map_, PREFIX_STORE_HEADER, MS_SYNC) == 0;
+}
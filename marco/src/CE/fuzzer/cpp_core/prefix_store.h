@@ -0,0 +1,55 @@
+#ifndef PREFIX_STORE_H_
+#define PREFIX_STORE_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+
+// mmap-backed path-prefix dedup bitmap (pfx_pp_map), kept across FastGen
+// restarts under MARCO_STATE_DIR.
+//
+// The set only grows, so whatever bits reached the file before a kill form a
+// valid, slightly smaller dedup set; the shared mapping puts every mark in
+// the page cache as soon as it is made. snapshot() flushes the map and
+// records a checksum and a clean flag in the header, and the first mark after
+// that clears the flag. On reopen, a clean map whose checksum does not match
+// is corrupt and gets cleared; a map that was not clean is taken as is.
+class PrefixStore {
+public:
+  PrefixStore();
+  ~PrefixStore();
+
+  bool open(const std::string &path, size_t bytes);
+  bool is_open() const { return bits_ != nullptr; }
+  uint8_t* bits() const { return bits_; }
+  // bits were carried over from an earlier run
+  bool recovered() const { return recovered_; }
+
+  // call before setting a bit
+  inline void touch() {
+    if (clean_) {
+      clean_ = false;
+      __atomic_store_n(&hdr_->clean, 0, __ATOMIC_RELAXED);
+    }
+  }
+  bool snapshot();
+
+private:
+  struct Header {
+    uint64_t magic;
+    uint64_t bytes;
+    uint64_t seq;
+    uint64_t checksum; // of the bitmap at snapshot seq
+    uint32_t clean;    // no bit set since that snapshot
+    uint32_t pad;
+  };
+
+  void *map_;
+  size_t map_size_;
+  Header *hdr_;
+  uint8_t *bits_;
+  size_t bytes_;
+  bool clean_;
+  bool recovered_;
+};
+
+#endif
@@ -0,0 +1,241 @@
+// fastgen-replay: run a MARCO_CAPTURE file through the solver, offline.
+//
+//   fastgen-replay [-w workdir] [-b brc_flip] capture > /dev/null
+//
+// Traces are ingested with the same code as live runs (ingest_trace) and the
+// captured scheduler decisions are replayed in their original order against
+// them, so changes to the solver side can be measured without SymQEMU, the
+// fuzzer or the scheduler in the loop. Trees, parent seeds and generated
+// inputs go to workdir (a fresh /tmp/fastgen-replay.XXXXXX by default). The
+// solver keeps logging to stdout, minus the per-record ingest logging unless
+// MARCO_TRACE_DEBUG=1; the report goes to stderr.
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <string>
+#include <sstream>
+#include "trace_capture.h"
+#include "union_table.h"
+#include "util.h"
+
+#define UNION_TABLE_SIZE 0xC00000000ULL
+
+struct Pending {
+  bool valid;
+  uint32_t qid, tid, nid, conc_dir, plen;
+  uint64_t pp_hash;
+  std::string extra;
+};
+
+static uint64_t n_traces = 0;
+static uint64_t n_branches = 0;
+static uint64_t n_decisions = 0;
+static uint64_t n_dup = 0;
+static uint64_t ingest_time = 0;
+static uint64_t decide_time = 0;
+
+static std::string id_name(uint32_t id) {
+  char buf[16];
+  snprintf(buf, sizeof(buf), "id:%06u", id % 1000000);
+  return buf;
+}
+
+static bool write_file(const std::string &dir, const std::string &name,
+                       const char *data, size_t size) {
+  std::string path = dir + "/" + name;
+  FILE *fp = fopen(path.c_str(), "wb");
+  if (!fp) {
+    fprintf(stderr, "[fastgen-replay]cannot write %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  if (size) fwrite(data, size, 1, fp);
+  fclose(fp);
+  return true;
+}
+
+static void run_pending(Pending &p) {
+  if (!p.valid) return;
+  p.valid = false;
+  uint64_t start = getTimeStamp();
+  int res = replay_decision(p.qid, p.tid, p.nid, p.conc_dir, p.plen, p.pp_hash, p.extra);
+  decide_time += getTimeStamp() - start;
+  n_decisions++;
+  if (res == -1) n_dup++;
+}
+
+static double per_sec(uint64_t n, uint64_t us) {
+  return us ? n * 1000000.0 / us : 0.0;
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr, "usage: %s [-w workdir] [-b brc_flip] capture\n", prog);
+}
+
+int main(int argc, char **argv) {
+  std::string workdir;
+  int brc_override = -1;
+  int opt;
+  while ((opt = getopt(argc, argv, "w:b:")) != -1) {
+    switch (opt) {
+      case 'w': workdir = optarg; break;
+      case 'b': brc_override = atoi(optarg); break;
+      default: usage(argv[0]); return 1;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  TraceReader reader;
+  if (!reader.open(argv[optind])) return 1;
+  if (reader.label_size() != sizeof(dfsan_label_info)) {
+    fprintf(stderr, "[fastgen-replay]label size %u in capture, %zu here\n",
+            reader.label_size(), sizeof(dfsan_label_info));
+    return 1;
+  }
+
+  if (workdir.empty()) {
+    char tmpl[] = "/tmp/fastgen-replay.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+      fprintf(stderr, "[fastgen-replay]cannot create a work directory: %s\n", strerror(errno));
+      return 1;
+    }
+    workdir = tmpl;
+  } else {
+    mkdir(workdir.c_str(), 0755);
+  }
+  if (chdir(workdir.c_str()) != 0) {
+    fprintf(stderr, "[fastgen-replay]cannot enter %s: %s\n", workdir.c_str(), strerror(errno));
+    return 1;
+  }
+  mkdir("afl-slave", 0755);
+  mkdir("afl-slave/queue", 0755);
+  mkdir("fifo", 0755);
+  mkdir("fifo/queue", 0755);
+
+  // everything relative to workdir, nothing shared with a live instance
+  unsetenv("MARCO_CAPTURE");
+  unsetenv("MARCO_TREE_DIR");
+  unsetenv("SYMCC_OUTPUT_DIR");
+  unsetenv("MARCO_STATE_DIR");
+  setenv("MARCO_SOLVER_CACHE", "0", 1);
+  setenv("MARCO_BYTE_MASK", "0", 1);
+
+  void *table = mmap(NULL, UNION_TABLE_SIZE, PROT_READ | PROT_WRITE,
+                     MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+  if (table == MAP_FAILED) {
+    fprintf(stderr, "[fastgen-replay]cannot map the union table: %s\n", strerror(errno));
+    return 1;
+  }
+  replay_init(table);
+
+  TraceRecord rec;
+  Pending pending;
+  pending.valid = false;
+  bool in_trace = false;
+  uint32_t brc_flip = 0;
+  std::string lines;
+  uint64_t trace_lines = 0;
+  uint64_t total_start = getTimeStamp();
+
+  while (reader.next(rec)) {
+    switch (rec.type) {
+      case TRACE_BEGIN:
+        run_pending(pending);
+        in_trace = true;
+        brc_flip = brc_override >= 0 ? brc_override : rec.u32(0);
+        lines.clear();
+        trace_lines = 0;
+        break;
+      case TRACE_LINE:
+        if (!in_trace) break;
+        lines.append(rec.payload);
+        lines.push_back('\n');
+        if (!rec.payload.empty()) trace_lines++;
+        break;
+      case TRACE_UNION: {
+        if (rec.payload.size() < 8) break;
+        const char *data = rec.payload.data() + 8;
+        size_t size = rec.payload.size() - 8;
+        if (in_trace) {
+          memcpy(table, data, size);
+        } else {
+          // tree of a trace that was ingested before the capture started
+          std::string dir = "tree" + std::to_string(rec.u32(0));
+          mkdir(dir.c_str(), 0755);
+          replay_sync();
+          write_file(dir, id_name(rec.u32(4)), data, size);
+        }
+        break;
+      }
+      case TRACE_END: {
+        if (!in_trace) break;
+        in_trace = false;
+        std::istringstream in(lines);
+        uint64_t start = getTimeStamp();
+        replay_trace(in, brc_flip);
+        ingest_time += getTimeStamp() - start;
+        n_traces++;
+        n_branches += trace_lines;
+        break;
+      }
+      case TRACE_SEED: {
+        if (rec.payload.size() < 8) break;
+        const char *dir = rec.u32(0) == 0 ? "afl-slave/queue" : "fifo/queue";
+        // a generated input of this run may still be queued under the same name
+        replay_sync();
+        write_file(dir, id_name(rec.u32(4)), rec.payload.data() + 8, rec.payload.size() - 8);
+        break;
+      }
+      case TRACE_DECISION:
+        run_pending(pending);
+        if (rec.payload.size() < 28) break;
+        // held back until the tree and seed records that follow it are applied
+        pending.valid = true;
+        pending.qid = rec.u32(0);
+        pending.tid = rec.u32(4);
+        pending.nid = rec.u32(8);
+        pending.conc_dir = rec.u32(12);
+        pending.plen = rec.u32(16);
+        pending.pp_hash = rec.u64(20);
+        pending.extra = rec.payload.substr(28);
+        break;
+      default:
+        fprintf(stderr, "[fastgen-replay]skipping unknown record type %u\n", rec.type);
+        break;
+    }
+  }
+  run_pending(pending);
+  replay_sync();
+  uint64_t total = getTimeStamp() - total_start;
+
+  ReplayCounters c;
+  replay_counters(c);
+  uint32_t solved = c.full_sat + c.relaxed_sat + c.opt_sat;
+  fprintf(stderr,
+          "[fastgen-replay] %s\n"
+          "traces %llu, branch records %llu, decisions %llu (%llu dup)\n"
+          "ingest %.1fms, %.0f branches/s\n"
+          "solve %.1fms, %.1f decisions/s, %.1f solves/s\n"
+          "  updateG %.1fms getdeps %.1fms tupling %.1fms reload %.1fms relax %.1fms\n"
+          "solved full/relaxed/optimistic/unsat %u/%u/%u/%u\n"
+          "generated inputs %llu in %s/fifo/queue\n"
+          "total %.1fms\n",
+          argv[optind],
+          (unsigned long long)n_traces, (unsigned long long)n_branches,
+          (unsigned long long)n_decisions, (unsigned long long)n_dup,
+          ingest_time / 1000.0, per_sec(n_branches, ingest_time),
+          decide_time / 1000.0, per_sec(n_decisions, decide_time), per_sec(solved, decide_time),
+          c.updateG_time / 1000.0, c.getdeps_time / 1000.0, c.tupling_time / 1000.0,
+          c.reload_time / 1000.0, c.relax_time / 1000.0,
+          c.full_sat, c.relaxed_sat, c.opt_sat, c.unsat,
+          (unsigned long long)c.generated, workdir.c_str(),
+          total / 1000.0);
+  return 0;
+}
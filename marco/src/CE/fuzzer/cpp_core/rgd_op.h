@@ -79,9 +79,16 @@ const uint32_t  DFSAN_XOR = 28;
 const uint32_t  DFSAN_TRUNC = 36;
 const uint32_t  DFSAN_ZEXT = 37;
 const uint32_t  DFSAN_SEXT = 38;
-const uint32_t  DFSAN_LOAD = 67;
-const uint32_t  DFSAN_EXTRACT = 68;
-const uint32_t  DFSAN_CONCAT = 69;
+const uint32_t  DFSAN_SELECT = 55; // l1 ? op1 : (l2 or op2), symbolic table lookups
+//self-defined ops sit above the last LLVM opcode, as in dfsan's enum operators
+const uint32_t  DFSAN_LAST_LLVM_OP = 64;
+const uint32_t  DFSAN_LOAD = DFSAN_LAST_LLVM_OP + 3;
+const uint32_t  DFSAN_EXTRACT = DFSAN_LAST_LLVM_OP + 4;
+const uint32_t  DFSAN_CONCAT = DFSAN_LAST_LLVM_OP + 5;
+const uint32_t  DFSAN_BSWAP = DFSAN_LAST_LLVM_OP + 11;
+const uint32_t  DFSAN_ROTL = DFSAN_LAST_LLVM_OP + 12;
+const uint32_t  DFSAN_ROTR = DFSAN_LAST_LLVM_OP + 13;
+const uint32_t  DFSAN_FSHR = DFSAN_LAST_LLVM_OP + 14;
 //relational
 const uint32_t  DFSAN_BVEQ = 32;
 const uint32_t  DFSAN_BVNEQ = 33;
@@ -0,0 +1,69 @@
+// sends a decision with several extra constraints through the channel and
+// checks every (label, dir) pair survives into the list build_nested_set_old
+// solves; exits nonzero on the first mismatch
+#include "decision_channel.h"
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <thread>
+
+static const uint32_t kPairs[][2] = {{17, 1}, {4242, 0}, {9, 1}, {123456, 0}};
+static const uint32_t kNumPairs = sizeof(kPairs) / sizeof(kPairs[0]);
+
+int main() {
+  std::string path = "/tmp/decision_extra_test." + std::to_string(getpid());
+  unlink(path.c_str());
+
+  std::thread sched([&]() {
+    DecisionChannel peer;
+    for (int i = 0; i < 500 && !peer.attach(path); i++)
+      usleep(10000);
+    ChanDecisionRecord dec;
+    memset(&dec, 0, sizeof(dec));
+    dec.qid = 1;
+    dec.nid = 7;
+    dec.conc_dir = 1;
+    dec.nextra = kNumPairs;
+    for (uint32_t i = 0; i < kNumPairs; i++) {
+      dec.extra[i * 2] = kPairs[i][0];
+      dec.extra[i * 2 + 1] = kPairs[i][1];
+    }
+    peer.send_decision(dec);
+  });
+
+  DecisionChannel chan;
+  if (!chan.serve(path)) {
+    fprintf(stderr, "serve failed\n");
+    sched.join();
+    return 1;
+  }
+  ChanDecisionRecord dec;
+  bool got = chan.recv_decision(dec);
+  sched.join();
+  unlink(path.c_str());
+  if (!got) {
+    fprintf(stderr, "no decision received\n");
+    return 1;
+  }
+
+  std::string extra = chan_extra_string(dec);
+  auto pairs = parse_extra_pairs(extra);
+  if (pairs.size() != kNumPairs) {
+    fprintf(stderr, "extra \"%s\" parsed to %zu pairs, want %u\n", extra.c_str(), pairs.size(), kNumPairs);
+    return 1;
+  }
+  for (uint32_t i = 0; i < kNumPairs; i++) {
+    if (pairs[i].first != kPairs[i][0] || pairs[i].second != kPairs[i][1]) {
+      fprintf(stderr, "pair %u is %u.%u, want %u.%u\n", i, pairs[i].first, pairs[i].second,
+              kPairs[i][0], kPairs[i][1]);
+      return 1;
+    }
+  }
+
+  // the FIFO encoding and the comma form get_extra_tuple writes parse the same
+  if (parse_extra_pairs("17.1@4242.0@").size() != 2 || parse_extra_pairs("17,1.#9,1.#").size() != 2) {
+    fprintf(stderr, "alternate extra encodings did not parse\n");
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,60 @@
+#include "solution_filter.h"
+#include <string.h>
+#include <algorithm>
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+SolutionFilter::SolutionFilter(uint32_t bucket_bits)
+  : buckets_((size_t)1 << bucket_bits), mask_(((uint64_t)1 << bucket_bits) - 1),
+    hits_(0), misses_(0), evictions_(0) {
+  memset(buckets_.data(), 0, buckets_.size() * sizeof(Bucket));
+}
+
+bool SolutionFilter::insert(const ParentSeed &parent,
+                            const std::unordered_map<uint32_t,uint8_t> &sol) {
+  const std::vector<uint8_t> &bytes = parent.bytes;
+  std::vector<std::pair<uint32_t,uint8_t>> delta;
+  delta.reserve(sol.size());
+  for (auto &it : sol) {
+    if (it.first < bytes.size() && bytes[it.first] != it.second)
+      delta.push_back(it);
+  }
+  if (delta.empty()) {
+    hits_++;
+    return false;
+  }
+  std::sort(delta.begin(), delta.end());
+
+  XXH3_state_t state;
+  XXH3_128bits_reset(&state);
+  Fingerprint parent_hash = {parent.hash_lo, parent.hash_hi};
+  XXH3_128bits_update(&state, &parent_hash, sizeof(parent_hash));
+  for (auto &it : delta) {
+    uint8_t rec[5];
+    memcpy(rec, &it.first, sizeof(uint32_t));
+    rec[4] = it.second;
+    XXH3_128bits_update(&state, rec, sizeof(rec));
+  }
+  XXH128_hash_t h = XXH3_128bits_digest(&state);
+  // all-zero marks an empty slot
+  if (h.low64 == 0 && h.high64 == 0) h.low64 = 1;
+
+  Bucket &b = buckets_[h.low64 & mask_];
+  int empty = -1;
+  for (int i = 0; i < kWays; i++) {
+    if (b.slots[i].lo == h.low64 && b.slots[i].hi == h.high64) {
+      hits_++;
+      return false;
+    }
+    if (empty < 0 && b.slots[i].lo == 0 && b.slots[i].hi == 0)
+      empty = i;
+  }
+  if (empty < 0) {
+    empty = h.high64 % kWays;
+    evictions_++;
+  }
+  b.slots[empty].lo = h.low64;
+  b.slots[empty].hi = h.high64;
+  misses_++;
+  return true;
+}
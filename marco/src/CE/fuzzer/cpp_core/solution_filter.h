@@ -0,0 +1,44 @@
+#ifndef SOLUTION_FILTER_H_
+#define SOLUTION_FILTER_H_
+#include <stdint.h>
+#include <vector>
+#include <unordered_map>
+#include "parent_seed.h"
+
+// Content filter for generated test cases. Each solution is reduced to the
+// bytes that actually differ from its parent seed and fingerprinted with a
+// 128-bit hash of (parent contents, delta). The fingerprints live in a fixed-size
+// table of 4-way buckets (one cache line each), so memory stays bounded for
+// the whole FastGen lifetime; when a bucket is full a resident entry is
+// evicted, which can only let a duplicate through, never drop a new input.
+
+class SolutionFilter {
+public:
+  SolutionFilter(uint32_t bucket_bits);
+
+  // true if the solution is new and has been recorded; false for a
+  // duplicate or a solution that does not change the parent at all
+  bool insert(const ParentSeed &parent, const std::unordered_map<uint32_t,uint8_t> &sol);
+
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+  uint64_t evictions() const { return evictions_; }
+
+private:
+  struct Fingerprint {
+    uint64_t lo;
+    uint64_t hi;
+  };
+  enum { kWays = 4 };
+  struct Bucket {
+    Fingerprint slots[kWays];
+  };
+
+  std::vector<Bucket> buckets_;
+  uint64_t mask_;
+  uint64_t hits_;
+  uint64_t misses_;
+  uint64_t evictions_;
+};
+
+#endif
@@ -0,0 +1,335 @@
+#include "solver_cache.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+#define XXH_INLINE_ALL
+#include "xxhash.h"
+
+#define SOLVER_CACHE_MAGIC 0x3165686361437a4dULL // "MzCache1"
+#define SOLVER_CACHE_WAYS 4
+#define VAR_TAG 0xffffffffULL
+#define AND_TAG 0xfffffffeULL
+
+static inline QueryKey hash_buf(const std::vector<uint64_t> &buf) {
+  XXH128_hash_t h = XXH3_128bits(buf.data(), buf.size() * sizeof(uint64_t));
+  QueryKey k = {h.low64, h.high64};
+  return k;
+}
+
+static inline bool key_less(const QueryKey &a, const QueryKey &b) {
+  return a.hi != b.hi ? a.hi < b.hi : a.lo < b.lo;
+}
+
+static inline bool is_commutative(Z3_decl_kind kind) {
+  switch (kind) {
+    case Z3_OP_AND:
+    case Z3_OP_OR:
+    case Z3_OP_XOR:
+    case Z3_OP_EQ:
+    case Z3_OP_DISTINCT:
+    case Z3_OP_BADD:
+    case Z3_OP_BMUL:
+    case Z3_OP_BAND:
+    case Z3_OP_BOR:
+    case Z3_OP_BXOR:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static inline bool is_input(const z3::expr &e) {
+  return e.is_const() && e.decl().decl_kind() == Z3_OP_UNINTERPRETED;
+}
+
+// operator, sort and parameters of one node, without its children
+bool QueryCanonicalizer::node_header(const z3::expr &e, std::vector<uint64_t> &buf) {
+  if (!e.is_app()) {
+    ok_ = false;
+    return false;
+  }
+  z3::context &ctx = e.ctx();
+  z3::func_decl decl = e.decl();
+  buf.push_back(decl.decl_kind());
+  if (e.is_bool()) {
+    buf.push_back(0);
+  } else if (e.is_bv()) {
+    buf.push_back(e.get_sort().bv_size());
+  } else {
+    ok_ = false;
+    return false;
+  }
+  if (e.is_numeral()) {
+    uint64_t v;
+    if (Z3_get_numeral_uint64(ctx, e, &v)) {
+      buf.push_back(v);
+    } else {
+      std::string s = Z3_get_numeral_string(ctx, e);
+      buf.push_back(XXH64(s.data(), s.size(), 0));
+    }
+  }
+  unsigned nparams = Z3_get_decl_num_parameters(ctx, decl);
+  for (unsigned i = 0; i < nparams; i++) {
+    if (Z3_get_decl_parameter_kind(ctx, decl, i) != Z3_PARAMETER_INT) {
+      ok_ = false;
+      return false;
+    }
+    buf.push_back((uint64_t)Z3_get_decl_int_parameter(ctx, decl, i));
+  }
+  return true;
+}
+
+// structural hash with every input byte anonymized, used to order operands
+QueryKey QueryCanonicalizer::anon_hash(const z3::expr &e) {
+  auto itr = anon_memo_.find(e.id());
+  if (itr != anon_memo_.end()) return itr->second;
+
+  std::vector<uint64_t> buf;
+  if (is_input(e)) {
+    buf.push_back(VAR_TAG);
+    buf.push_back(e.get_sort().bv_size());
+  } else if (node_header(e, buf)) {
+    unsigned n = e.num_args();
+    std::vector<QueryKey> kids;
+    kids.reserve(n);
+    for (unsigned i = 0; i < n; i++)
+      kids.push_back(anon_hash(e.arg(i)));
+    if (is_commutative(e.decl().decl_kind())) {
+      std::sort(kids.begin(), kids.end(), key_less);
+    }
+    for (auto &k : kids) {
+      buf.push_back(k.lo);
+      buf.push_back(k.hi);
+    }
+  }
+  QueryKey k = hash_buf(buf);
+  anon_memo_[e.id()] = k;
+  return k;
+}
+
+void QueryCanonicalizer::ordered_args(const z3::expr &e, std::vector<z3::expr> &args) {
+  unsigned n = e.num_args();
+  for (unsigned i = 0; i < n; i++)
+    args.push_back(e.arg(i));
+  if (is_commutative(e.decl().decl_kind())) {
+    std::stable_sort(args.begin(), args.end(), [this](const z3::expr &a, const z3::expr &b) {
+      return key_less(anon_hash(a), anon_hash(b));
+    });
+  }
+}
+
+// structural hash with input bytes renamed to positions in canonical order
+QueryKey QueryCanonicalizer::canon_hash(const z3::expr &e) {
+  auto itr = canon_memo_.find(e.id());
+  if (itr != canon_memo_.end()) return itr->second;
+
+  std::vector<uint64_t> buf;
+  if (is_input(e)) {
+    z3::symbol name = e.decl().name();
+    if (name.kind() != Z3_INT_SYMBOL) {
+      ok_ = false;
+    } else {
+      uint32_t off = name.to_int();
+      auto p = off2pos_.find(off);
+      uint32_t pos;
+      if (p == off2pos_.end()) {
+        pos = pos2off_.size();
+        off2pos_[off] = pos;
+        pos2off_.push_back(off);
+      } else {
+        pos = p->second;
+      }
+      buf.push_back(VAR_TAG);
+      buf.push_back(e.get_sort().bv_size());
+      buf.push_back(pos);
+    }
+  } else if (node_header(e, buf)) {
+    std::vector<z3::expr> args;
+    ordered_args(e, args);
+    std::vector<QueryKey> kids;
+    kids.reserve(args.size());
+    for (auto &a : args)
+      kids.push_back(canon_hash(a));
+    // isomorphic operands may be visited in either order, so the multiset is what counts
+    if (is_commutative(e.decl().decl_kind()))
+      std::sort(kids.begin(), kids.end(), key_less);
+    for (auto &k : kids) {
+      buf.push_back(k.lo);
+      buf.push_back(k.hi);
+    }
+  }
+  QueryKey k = hash_buf(buf);
+  canon_memo_[e.id()] = k;
+  return k;
+}
+
+bool QueryCanonicalizer::canonicalize(const z3::expr_vector &assertions, QueryKey &key) {
+  anon_memo_.clear();
+  canon_memo_.clear();
+  off2pos_.clear();
+  pos2off_.clear();
+  ok_ = true;
+
+  // the assertion set is an implicit conjunction, order it like any commutative node
+  std::vector<z3::expr> top;
+  for (unsigned i = 0; i < assertions.size(); i++)
+    top.push_back(assertions[i]);
+  std::stable_sort(top.begin(), top.end(), [this](const z3::expr &a, const z3::expr &b) {
+    return key_less(anon_hash(a), anon_hash(b));
+  });
+
+  std::vector<QueryKey> kids;
+  for (auto &a : top)
+    kids.push_back(canon_hash(a));
+  std::sort(kids.begin(), kids.end(), key_less);
+
+  std::vector<uint64_t> buf;
+  buf.push_back(AND_TAG);
+  buf.push_back(kids.size());
+  for (auto &k : kids) {
+    buf.push_back(k.lo);
+    buf.push_back(k.hi);
+  }
+  key = hash_buf(buf);
+  return ok_;
+}
+
+SolverCache::SolverCache()
+  : map_(nullptr), map_size_(0), slots_(nullptr), mask_(0), hits_(0), misses_(0) {
+}
+
+SolverCache::~SolverCache() {
+  if (map_) munmap(map_, map_size_);
+}
+
+bool SolverCache::open(const std::string &path, uint32_t slot_bits) {
+  int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0666);
+  if (fd < 0) {
+    fprintf(stderr, "[SolverCache]cannot open %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  // another instance may have created the table with a different size
+  Header existing;
+  if (pread(fd, &existing, sizeof(existing), 0) == sizeof(existing) &&
+      existing.magic == SOLVER_CACHE_MAGIC) {
+    slot_bits = existing.slot_bits;
+  }
+  size_t size = sizeof(Header) + ((size_t)1 << slot_bits) * sizeof(Slot);
+  struct stat st;
+  if (fstat(fd, &st) < 0 || ((size_t)st.st_size < size && ftruncate(fd, size) < 0)) {
+    fprintf(stderr, "[SolverCache]cannot size %s: %s\n", path.c_str(), strerror(errno));
+    close(fd);
+    return false;
+  }
+  void *map = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "[SolverCache]cannot map %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  Header *hdr = (Header *)map;
+  if (__atomic_load_n(&hdr->magic, __ATOMIC_ACQUIRE) != SOLVER_CACHE_MAGIC) {
+    hdr->slot_bits = slot_bits;
+    uint64_t expected = 0;
+    __atomic_compare_exchange_n(&hdr->magic, &expected, SOLVER_CACHE_MAGIC, false,
+                                __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+  }
+  map_ = map;
+  map_size_ = size;
+  slots_ = (Slot *)((uint8_t *)map + sizeof(Header));
+  mask_ = ((uint64_t)1 << slot_bits) - 1;
+  return true;
+}
+
+SolverCache::Slot* SolverCache::probe(const QueryKey &key, bool for_write) {
+  uint64_t base = key.lo & mask_;
+  Slot *empty = nullptr;
+  for (uint64_t i = 0; i < SOLVER_CACHE_WAYS; i++) {
+    Slot *s = &slots_[(base + i) & mask_];
+    if (s->key_lo == key.lo && s->key_hi == key.hi)
+      return s;
+    if (!empty && s->verdict == MISS)
+      empty = s;
+  }
+  if (!for_write) return nullptr;
+  return empty ? empty : &slots_[(base + key.hi % SOLVER_CACHE_WAYS) & mask_];
+}
+
+SolverCache::Verdict SolverCache::lookup(const QueryKey &key, const std::vector<uint32_t> &pos2off,
+                                         std::unordered_map<uint32_t, uint8_t> &sol) {
+  if (!slots_) return MISS;
+  Slot *s = probe(key, false);
+  if (!s) {
+    misses_++;
+    return MISS;
+  }
+  Slot copy;
+  uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+  memcpy(&copy, s, sizeof(Slot));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if ((seq & 1) || seq != __atomic_load_n(&s->seq, __ATOMIC_RELAXED) ||
+      copy.key_lo != key.lo || copy.key_hi != key.hi) {
+    misses_++;
+    return MISS;
+  }
+  if (copy.verdict == SAT) {
+    if (copy.nvars != pos2off.size()) {
+      misses_++;
+      return MISS;
+    }
+    for (uint32_t i = 0; i < copy.nvars; i++) {
+      if (copy.present & (1U << i))
+        sol[pos2off[i]] = copy.values[i];
+    }
+  }
+  if (copy.verdict == MISS) {
+    misses_++;
+    return MISS;
+  }
+  hits_++;
+  return (Verdict)copy.verdict;
+}
+
+void SolverCache::store(const QueryKey &key, uint8_t verdict, uint8_t nvars,
+                        uint32_t present, const uint8_t *values) {
+  if (!slots_) return;
+  Slot *s = probe(key, true);
+  uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+  // somebody else is writing this slot, just skip
+  if ((seq & 1) || !__atomic_compare_exchange_n(&s->seq, &seq, seq + 1, false,
+                                                __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+    return;
+  s->verdict = verdict;
+  s->nvars = nvars;
+  s->key_lo = key.lo;
+  s->key_hi = key.hi;
+  s->present = present;
+  memset(s->values, 0, sizeof(s->values));
+  if (values) memcpy(s->values, values, nvars);
+  __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+void SolverCache::store_unsat(const QueryKey &key) {
+  store(key, UNSAT, 0, 0, nullptr);
+}
+
+void SolverCache::store_sat(const QueryKey &key, const std::vector<uint32_t> &pos2off,
+                            const std::unordered_map<uint32_t, uint8_t> &sol) {
+  if (pos2off.size() > SOLVER_CACHE_MAX_VARS) return;
+  uint8_t values[SOLVER_CACHE_MAX_VARS] = {0};
+  uint32_t present = 0;
+  for (size_t i = 0; i < pos2off.size(); i++) {
+    auto itr = sol.find(pos2off[i]);
+    if (itr != sol.end()) {
+      values[i] = itr->second;
+      present |= (1U << i);
+    }
+  }
+  store(key, SAT, pos2off.size(), present, values);
+}
@@ -0,0 +1,101 @@
+#ifndef SOLVER_CACHE_H_
+#define SOLVER_CACHE_H_
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <z3++.h>
+
+// Persistent cache of solver verdicts, keyed by a canonical form of the query.
+//
+// QueryCanonicalizer turns a set of assertions into a 128-bit structural
+// fingerprint that does not depend on which input bytes are involved: input
+// bytes are renamed to positional variables (in canonical traversal order)
+// and the operands of commutative operators are sorted. The positional
+// variables map back to the concrete offsets of the query being solved, so a
+// cached SAT model can be relocated onto a different trace or seed.
+//
+// SolverCache is a fixed-size, mmap-backed table shared by all FastGen
+// instances on the host (MARCO_SOLVER_CACHE, /tmp/marco_solver_cache by
+// default). Slots are protected by a per-slot sequence counter so concurrent
+// readers never see a half-written entry.
+
+struct QueryKey {
+  uint64_t lo;
+  uint64_t hi;
+};
+
+class QueryCanonicalizer {
+public:
+  // returns false when the query cannot be keyed (unsupported term)
+  bool canonicalize(const z3::expr_vector &assertions, QueryKey &key);
+  // offset of the i-th positional variable of the last canonicalized query
+  const std::vector<uint32_t>& positions() const { return pos2off_; }
+
+private:
+  QueryKey anon_hash(const z3::expr &e);
+  QueryKey canon_hash(const z3::expr &e);
+  bool node_header(const z3::expr &e, std::vector<uint64_t> &buf);
+  void ordered_args(const z3::expr &e, std::vector<z3::expr> &args);
+
+  std::unordered_map<unsigned, QueryKey> anon_memo_;
+  std::unordered_map<unsigned, QueryKey> canon_memo_;
+  std::unordered_map<uint32_t, uint32_t> off2pos_;
+  std::vector<uint32_t> pos2off_;
+  bool ok_;
+};
+
+#define SOLVER_CACHE_MAX_VARS 32
+
+class SolverCache {
+public:
+  enum Verdict { MISS = 0, SAT = 1, UNSAT = 2 };
+
+  SolverCache();
+  ~SolverCache();
+
+  bool open(const std::string &path, uint32_t slot_bits);
+  bool is_open() const { return slots_ != nullptr; }
+
+  // on SAT, sol receives the cached model relocated through pos2off
+  Verdict lookup(const QueryKey &key, const std::vector<uint32_t> &pos2off,
+                 std::unordered_map<uint32_t, uint8_t> &sol);
+  void store_unsat(const QueryKey &key);
+  // models over more than SOLVER_CACHE_MAX_VARS bytes are not cached
+  void store_sat(const QueryKey &key, const std::vector<uint32_t> &pos2off,
+                 const std::unordered_map<uint32_t, uint8_t> &sol);
+
+  uint64_t hits() const { return hits_; }
+  uint64_t misses() const { return misses_; }
+
+private:
+  struct Header {
+    uint64_t magic;
+    uint32_t slot_bits;
+    uint32_t reserved;
+  };
+  struct Slot {
+    uint32_t seq;     // odd while a writer owns the slot
+    uint8_t verdict;
+    uint8_t nvars;
+    uint16_t pad;
+    uint64_t key_lo;
+    uint64_t key_hi;
+    uint32_t present; // bit i set if values[i] came from the model
+    uint32_t pad2;
+    uint8_t values[SOLVER_CACHE_MAX_VARS];
+  };
+
+  Slot* probe(const QueryKey &key, bool for_write);
+  void store(const QueryKey &key, uint8_t verdict, uint8_t nvars,
+             uint32_t present, const uint8_t *values);
+
+  void *map_;
+  size_t map_size_;
+  Slot *slots_;
+  uint64_t mask_;
+  uint64_t hits_;
+  uint64_t misses_;
+};
+
+#endif
@@ -0,0 +1,138 @@
+#include "trace_capture.h"
+#include <string.h>
+#include <errno.h>
+#include <vector>
+
+#define TRACE_CAPTURE_MAGIC "MZTRACE1"
+
+static inline uint64_t trace_key(uint32_t qid, uint32_t tid) {
+  return ((uint64_t)qid << 32) | tid;
+}
+
+TraceCapture::TraceCapture() : fp_(nullptr) {
+}
+
+TraceCapture::~TraceCapture() {
+  if (fp_) fclose(fp_);
+}
+
+bool TraceCapture::open(const std::string &path, uint32_t label_size) {
+  fp_ = fopen(path.c_str(), "wb");
+  if (!fp_) {
+    fprintf(stderr, "[TraceCapture]cannot open %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  uint32_t hdr[2] = {TRACE_CAPTURE_VERSION, label_size};
+  fwrite(TRACE_CAPTURE_MAGIC, 8, 1, fp_);
+  fwrite(hdr, sizeof(hdr), 1, fp_);
+  fflush(fp_);
+  return true;
+}
+
+void TraceCapture::record(uint32_t type, const void *head, size_t head_len,
+                          const void *body, size_t body_len) {
+  if (!fp_) return;
+  uint32_t rec[2] = {type, (uint32_t)(head_len + body_len)};
+  fwrite(rec, sizeof(rec), 1, fp_);
+  if (head_len) fwrite(head, head_len, 1, fp_);
+  if (body_len) fwrite(body, body_len, 1, fp_);
+}
+
+void TraceCapture::begin_trace(uint32_t brc_flip) {
+  record(TRACE_BEGIN, &brc_flip, sizeof(brc_flip), nullptr, 0);
+}
+
+void TraceCapture::line(const std::string &line) {
+  record(TRACE_LINE, nullptr, 0, line.data(), line.size());
+}
+
+void TraceCapture::end_trace() {
+  record(TRACE_END, nullptr, 0, nullptr, 0);
+  if (fp_) fflush(fp_);
+}
+
+void TraceCapture::union_table(uint32_t qid, uint32_t tid, const void *table, size_t size) {
+  uint32_t head[2] = {qid, tid};
+  unions_.insert(trace_key(qid, tid));
+  record(TRACE_UNION, head, sizeof(head), table, size);
+}
+
+void TraceCapture::union_once(uint32_t qid, uint32_t tid, const void *table, size_t size) {
+  if (!fp_ || !unions_.insert(trace_key(qid, tid)).second) return;
+  union_table(qid, tid, table, size);
+  fflush(fp_);
+}
+
+void TraceCapture::seed_once(uint32_t qid, uint32_t tid, const std::string &path) {
+  if (!fp_ || seeds_.count(trace_key(qid, tid))) return;
+  FILE *in = fopen(path.c_str(), "rb");
+  if (!in) return;
+  std::vector<char> buf;
+  char chunk[65536];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), in)) > 0)
+    buf.insert(buf.end(), chunk, chunk + n);
+  fclose(in);
+  seeds_.insert(trace_key(qid, tid));
+  uint32_t head[2] = {qid, tid};
+  record(TRACE_SEED, head, sizeof(head), buf.data(), buf.size());
+  fflush(fp_);
+}
+
+void TraceCapture::decision(uint32_t qid, uint32_t tid, uint32_t nid, uint32_t conc_dir,
+                            uint32_t plen, uint64_t pp_hash, const std::string &extra) {
+  uint8_t head[5 * sizeof(uint32_t) + sizeof(uint64_t)];
+  uint32_t fields[5] = {qid, tid, nid, conc_dir, plen};
+  memcpy(head, fields, sizeof(fields));
+  memcpy(head + sizeof(fields), &pp_hash, sizeof(pp_hash));
+  record(TRACE_DECISION, head, sizeof(head), extra.data(), extra.size());
+  if (fp_) fflush(fp_);
+}
+
+uint32_t TraceRecord::u32(size_t off) const {
+  uint32_t v = 0;
+  if (off + sizeof(v) <= payload.size()) memcpy(&v, payload.data() + off, sizeof(v));
+  return v;
+}
+
+uint64_t TraceRecord::u64(size_t off) const {
+  uint64_t v = 0;
+  if (off + sizeof(v) <= payload.size()) memcpy(&v, payload.data() + off, sizeof(v));
+  return v;
+}
+
+TraceReader::TraceReader() : fp_(nullptr), label_size_(0) {
+}
+
+TraceReader::~TraceReader() {
+  if (fp_) fclose(fp_);
+}
+
+bool TraceReader::open(const std::string &path) {
+  fp_ = fopen(path.c_str(), "rb");
+  if (!fp_) {
+    fprintf(stderr, "[TraceReader]cannot open %s: %s\n", path.c_str(), strerror(errno));
+    return false;
+  }
+  char magic[8];
+  uint32_t hdr[2];
+  if (fread(magic, sizeof(magic), 1, fp_) != 1 || memcmp(magic, TRACE_CAPTURE_MAGIC, 8) != 0 ||
+      fread(hdr, sizeof(hdr), 1, fp_) != 1 || hdr[0] != TRACE_CAPTURE_VERSION) {
+    fprintf(stderr, "[TraceReader]%s is not a version %d capture\n", path.c_str(), TRACE_CAPTURE_VERSION);
+    fclose(fp_);
+    fp_ = nullptr;
+    return false;
+  }
+  label_size_ = hdr[1];
+  return true;
+}
+
+bool TraceReader::next(TraceRecord &rec) {
+  if (!fp_) return false;
+  uint32_t head[2];
+  if (fread(head, sizeof(head), 1, fp_) != 1) return false;
+  rec.type = head[0];
+  rec.payload.resize(head[1]);
+  if (head[1] && fread(&rec.payload[0], head[1], 1, fp_) != 1) return false;
+  return true;
+}
@@ -0,0 +1,112 @@
+#ifndef TRACE_CAPTURE_H_
+#define TRACE_CAPTURE_H_
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <istream>
+#include <unordered_set>
+
+// Record/replay of everything the solver consumes, for offline benchmarking.
+//
+// With MARCO_CAPTURE=<file> FastGen records into <file> (truncated at start):
+//   - each trace it ingests: the raw branch records read from wp2, followed
+//     by the union table as it was at the end of the trace
+//   - each scheduler decision, followed by the tree and the parent seed that
+//     gen_solve_pc loaded for it (once per trace id)
+// fastgen-replay (replay.cc) feeds such a file back through the same code.
+//
+// File layout, all integers little endian:
+//   header  "MZTRACE1", u32 version, u32 sizeof(dfsan_label_info)
+//   records u32 type, u32 payload length, payload
+//     TRACE_BEGIN  u32 brc_flip
+//     TRACE_LINE   one branch record line, without the newline
+//     TRACE_END    -
+//     UNION        u32 qid, u32 tid, label infos 0..max_label
+//     SEED         u32 qid, u32 tid, seed bytes
+//     DECISION     u32 qid, tid, nid, conc_dir, plen, u64 pp_hash, extra
+
+#define TRACE_CAPTURE_VERSION 1
+
+enum TraceRecordType {
+  TRACE_BEGIN = 1,
+  TRACE_LINE = 2,
+  TRACE_END = 3,
+  TRACE_UNION = 4,
+  TRACE_SEED = 5,
+  TRACE_DECISION = 6,
+};
+
+class TraceCapture {
+public:
+  TraceCapture();
+  ~TraceCapture();
+
+  bool open(const std::string &path, uint32_t label_size);
+  bool is_open() const { return fp_ != nullptr; }
+
+  void begin_trace(uint32_t brc_flip);
+  void line(const std::string &line);
+  void end_trace();
+  void union_table(uint32_t qid, uint32_t tid, const void *table, size_t size);
+  // once per (qid, tid); the seed is read from path
+  void union_once(uint32_t qid, uint32_t tid, const void *table, size_t size);
+  void seed_once(uint32_t qid, uint32_t tid, const std::string &path);
+  void decision(uint32_t qid, uint32_t tid, uint32_t nid, uint32_t conc_dir,
+                uint32_t plen, uint64_t pp_hash, const std::string &extra);
+
+private:
+  void record(uint32_t type, const void *head, size_t head_len,
+              const void *body, size_t body_len);
+
+  FILE *fp_;
+  std::unordered_set<uint64_t> unions_;
+  std::unordered_set<uint64_t> seeds_;
+};
+
+struct TraceRecord {
+  uint32_t type;
+  std::string payload;
+
+  uint32_t u32(size_t off) const;
+  uint64_t u64(size_t off) const;
+};
+
+class TraceReader {
+public:
+  TraceReader();
+  ~TraceReader();
+
+  bool open(const std::string &path);
+  uint32_t label_size() const { return label_size_; }
+  // false at the end of the file or on a truncated record
+  bool next(TraceRecord &rec);
+
+private:
+  FILE *fp_;
+  uint32_t label_size_;
+};
+
+// Solver entry points for fastgen-replay, implemented in interface.cc. The
+// union table is owned by the caller.
+struct ReplayCounters {
+  uint64_t updateG_time;
+  uint64_t getdeps_time;
+  uint64_t tupling_time;
+  uint64_t reload_time;
+  uint64_t relax_time;
+  uint32_t full_sat;
+  uint32_t relaxed_sat;
+  uint32_t opt_sat;
+  uint32_t unsat;
+  uint64_t generated;
+};
+
+void replay_init(void *union_table);
+uint32_t replay_trace(std::istream &lines, uint32_t brc_flip);
+int replay_decision(uint32_t qid, uint32_t tid, uint32_t nid, uint32_t conc_dir,
+                    uint32_t plen, uint64_t pp_hash, std::string &extra);
+// wait until the trees and inputs queued so far are on disk
+void replay_sync();
+void replay_counters(ReplayCounters &c);
+
+#endif
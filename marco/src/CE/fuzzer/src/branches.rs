@@ -1,10 +1,10 @@
 use crate::status_type::StatusType;
-use fastgen_common::{config::BRANCHES_SIZE, shm::SHM};
+use fastgen_common::{config::BRANCHES_SIZE, shm::SHM, touch_log::TouchLog};
 use std::{
     self,
     sync::{
-        atomic::{AtomicUsize, Ordering},
-        Arc, RwLock,
+        atomic::{AtomicU8, AtomicUsize, Ordering},
+        Arc,
     },
 };
 #[cfg(feature = "unstable")]
@@ -46,21 +46,27 @@ macro_rules! cast {
     }};
 }
 
+// Shared by all executor threads. Entries are updated one byte at a time
+// with atomics, so threads never wait on each other for a whole map.
 pub struct GlobalBranches {
-    virgin_branches: RwLock<Box<BranchBuf>>,
-    tmouts_branches: RwLock<Box<BranchBuf>>,
-    crashes_branches: RwLock<Box<BranchBuf>>,
-    total_hit: RwLock<Box<BranchBuf>>,  
+    virgin_branches: Box<[AtomicU8]>,
+    tmouts_branches: Box<[AtomicU8]>,
+    crashes_branches: Box<[AtomicU8]>,
+    total_hit: Box<[AtomicU8]>,
     density: AtomicUsize,
 }
 
+fn new_global_map() -> Box<[AtomicU8]> {
+    (0..BRANCHES_SIZE).map(|_| AtomicU8::new(255u8)).collect()
+}
+
 impl GlobalBranches {
     pub fn new() -> Self {
         Self {
-            virgin_branches: RwLock::new(Box::new([255u8; BRANCHES_SIZE])),
-            tmouts_branches: RwLock::new(Box::new([255u8; BRANCHES_SIZE])),
-            crashes_branches: RwLock::new(Box::new([255u8; BRANCHES_SIZE])),
-            total_hit: RwLock::new(Box::new([255u8; BRANCHES_SIZE])),
+            virgin_branches: new_global_map(),
+            tmouts_branches: new_global_map(),
+            crashes_branches: new_global_map(),
+            total_hit: new_global_map(),
             density: AtomicUsize::new(0),
         }
     }
@@ -75,17 +81,30 @@ pub struct Branches {
     global: Arc<GlobalBranches>,
     trace: SHM<BranchBuf>,
     path_hash: SHM<PathHash>,
+    touch: SHM<TouchLog>,
 }
 
 impl Branches {
     pub fn new(global: Arc<GlobalBranches>) -> Self {
         let trace = SHM::<BranchBuf>::new();
         let path_hash = SHM::<PathHash>::new();
-        Self { global, trace, path_hash }
+        let touch = SHM::<TouchLog>::new();
+        Self { global, trace, path_hash, touch }
     }
 
     pub fn clear_trace(&mut self) {
-        self.trace.clear();
+        // only what the last run touched can be non-zero
+        match self.touch.touched() {
+            Some(touched) => {
+                for &idx in touched {
+                    if let Some(v) = self.trace.get_mut(idx as usize) {
+                        *v = 0;
+                    }
+                }
+            },
+            None => self.trace.clear(),
+        }
+        self.touch.reset();
         self.path_hash[0] = 0;
     }
 
@@ -95,108 +114,96 @@ impl Branches {
     pub fn get_path_id(&self) -> i32 {
         self.path_hash.get_id()
     }
+    pub fn get_touch_id(&self) -> i32 {
+        self.touch.get_id()
+    }
 
-    fn get_path(&self, total_buf: &RwLock<Box<BranchBuf>>) -> (Vec<(usize, u8)>, f32) {
-        let mut rareness :f32 = 0.0;
-        let mut path = Vec::<(usize, u8)>::new();
-        let buf_plus: &BranchBufPlus = cast!(&*self.trace); 
+    // (index, hit count) of every entry hit by the last run
+    fn for_each_hit<F: FnMut(usize, u8)>(&self, mut f: F) {
         let buf: &BranchBuf = &*self.trace;
-        
-        // load current hit count
-        let mut to_write = vec![];
-        {
-            let total_buf_read = total_buf.read().unwrap();
-            //let total_buf: &BranchBuf = &mut *self.total_hit;
-            for (i, &v) in buf_plus.iter().enumerate() {
-                macro_rules! run_loop { () => {{
-                    let base = i * ENTRY_SIZE;
-                    for j in 0..ENTRY_SIZE {
-                        let idx = base + j;
-                        let new_val = buf[idx]; // 0 ~ 2^20-1
-                        let mut old_hit = total_buf_read[idx];
-                        if new_val > 0 { // new_val => hit count of one branch. 
-                            path.push((idx, COUNT_LOOKUP[new_val as usize]));              
-                            //println!("Before: {}, after: {}", old_hit, new_val);     
-                            old_hit += new_val;
-                            let flt = new_val as f32;
-                            let flt_total = old_hit as f32;
-                            rareness += (flt / flt_total);      
-                            to_write.push((idx, old_hit));
-                        }
-                    }
-                }}}
-                #[cfg(feature = "unstable")]
-                {
-                    if unsafe { unlikely(v > 0) } {
-                        run_loop!()
-                    }
+        if let Some(touched) = self.touch.touched() {
+            for &idx in touched {
+                let idx = idx as usize;
+                if idx < BRANCHES_SIZE && buf[idx] > 0 {
+                    f(idx, buf[idx]);
                 }
-                #[cfg(not(feature = "unstable"))]
-                {
-                    if v > 0 {
-                        run_loop!()
+            }
+            return;
+        }
+
+        // no usable touch log: scan the map a word at a time
+        let buf_plus: &BranchBufPlus = cast!(&*self.trace);
+        for (i, &v) in buf_plus.iter().enumerate() {
+            macro_rules! run_loop { () => {{
+                let base = i * ENTRY_SIZE;
+                for j in 0..ENTRY_SIZE {
+                    let idx = base + j;
+                    let new_val = buf[idx]; // 0 ~ 2^20-1
+                    if new_val > 0 { // new_val => hit count of one branch.
+                        f(idx, new_val);
                     }
                 }
+            }}}
+            #[cfg(feature = "unstable")]
+            {
+                if unsafe { unlikely(v > 0) } {
+                    run_loop!()
+                }
             }
-        }
-        // store new hitcount back
-        {
-            let mut total_buf_write = total_buf.write().unwrap();
-            for &br in &to_write {
-                total_buf_write[br.0] = br.1;
+            #[cfg(not(feature = "unstable"))]
+            {
+                if v > 0 {
+                    run_loop!()
+                }
             }
         }
+    }
 
-        // debug!("count branch table: {}", path.len());
-        (path, rareness)
+    // fold the last run into total_hit and gb_map:
+    // (new edges, whether gb_map changed, rareness)
+    fn merge_path(&self, gb_map: &[AtomicU8]) -> (usize, bool, f32) {
+        let total_hit = &self.global.total_hit;
+        let mut rareness: f32 = 0.0;
+        let mut num_new_edge = 0;
+        let mut changed = false;
+        self.for_each_hit(|idx, new_val| {
+            // rare score => sum(hitcount / total hitcount)
+            let old_hit = total_hit[idx].fetch_add(new_val, Ordering::Relaxed);
+            rareness += new_val as f32 / old_hit.wrapping_add(new_val) as f32;
+
+            let bits = COUNT_LOOKUP[new_val as usize];
+            // read first: most hits are not new and should not dirty the line
+            if gb_map[idx].load(Ordering::Relaxed) & bits == 0 {
+                return;
+            }
+            let gb_v = gb_map[idx].fetch_and(!bits, Ordering::Relaxed);
+            if gb_v == 255u8 {
+                num_new_edge += 1;
+            }
+            if (bits & gb_v) > 0 {
+                changed = true;
+            }
+        });
+        (num_new_edge, changed, rareness)
+    }
+
+    fn global_map(&self, status: StatusType) -> Option<&[AtomicU8]> {
+        match status {
+            StatusType::Normal => Some(&self.global.virgin_branches),
+            StatusType::Timeout => Some(&self.global.tmouts_branches),
+            StatusType::Crash => Some(&self.global.crashes_branches),
+            _ => None,
+        }
     }
 
     pub fn has_new(&mut self, status: StatusType) -> bool {
-        let gb_map = match status {
-            StatusType::Normal => &self.global.virgin_branches,
-            StatusType::Timeout => &self.global.tmouts_branches,
-            StatusType::Crash => &self.global.crashes_branches,
-            _ => {
+        let gb_map = match self.global_map(status) {
+            Some(map) => map,
+            None => {
                 return false;
             },
         };
-        // let (path, rareness) = self.get_path();
-        let all_hit = &self.global.total_hit;
-        let (path, rareness) = self.get_path(all_hit);
-/*
-        let path_hash: &PathHash = &*self.path_hash;
-        println!("path_hash: {}", path_hash[0]);
-        //let edge_num = path.len();
-        println!("Before new path hash insertion, we have {} unique paths", UNIQ_PATH_SET.len());
-        if UNIQ_PATH_SET.insert(path_hash[0]) {
-            println!("Hit new! set size shall increase by 1: {}", UNIQ_PATH_SET.len());
-        }
-        else {
-            println!("Nothing new! set size remains the same: {}", UNIQ_PATH_SET.len());
-        }
-        // rare score => priority sum(1/hitcount)
-        // path hash => save, hash(current edge adress, hash), xor()
-
-        // set store hash and decide if should generate. 
-*/        
-
-        let mut to_write = vec![];
-        let mut num_new_edge = 0;
-        {
-            // read only
-            let gb_map_read = gb_map.read().unwrap();
-            for &br in &path {
-                let gb_v = gb_map_read[br.0];
-
-                if gb_v == 255u8 {
-                    num_new_edge += 1;
-                }
-
-                if (br.1 & gb_v) > 0 {
-                    to_write.push((br.0, gb_v & (!br.1)));
-                }
-            }
-        }
+        let (num_new_edge, changed, _rareness) = self.merge_path(gb_map);
 
         if num_new_edge > 0 {
             if status == StatusType::Normal {
@@ -207,57 +214,20 @@ impl Branches {
             }
         }
 
-        if to_write.is_empty() {
-            return false;
-        }
-
-        {
-            // write
-            let mut gb_map_write = gb_map.write().unwrap();
-            for &br in &to_write {
-                gb_map_write[br.0] = br.1;
-            }
-        }
-
-        true
+        changed
     }
 
     pub fn has_new_unique_path(&mut self, status: StatusType, unique_path_set: &mut HashSet<u64>) -> (u16, f32) { // return level and rareness score. 
-        let mut path_unique: bool = false; 
-        let gb_map = match status {
-            StatusType::Normal => &self.global.virgin_branches,
-            StatusType::Timeout => &self.global.tmouts_branches,
-            StatusType::Crash => &self.global.crashes_branches,
-            _ => {
+        let gb_map = match self.global_map(status) {
+            Some(map) => map,
+            None => {
                 //return false;
                 return (0, 0.0);
             },
         };
-        let all_hit = &self.global.total_hit;
-        let (path, rareness) = self.get_path(all_hit);
         let path_hash: &PathHash = &*self.path_hash;
-        //println!("path_hash: {}", path_hash[0]);
-        //let edge_num = path.len();
-        //println!("Before new path hash insertion, we have {} unique paths", unique_path_set.len());
-        path_unique = unique_path_set.insert(path_hash[0]); // true means made insertion, new path! 
-        
-        let mut to_write = vec![];
-        let mut num_new_edge = 0;
-        {
-            // read only
-            let gb_map_read = gb_map.read().unwrap();
-            for &br in &path {
-                let gb_v = gb_map_read[br.0];
-
-                if gb_v == 255u8 {
-                    num_new_edge += 1;
-                }
-
-                if (br.1 & gb_v) > 0 {
-                    to_write.push((br.0, gb_v & (!br.1)));
-                }
-            }
-        }
+        let path_unique = unique_path_set.insert(path_hash[0]); // true means made insertion, new path! 
+        let (num_new_edge, changed, rareness) = self.merge_path(gb_map);
 
         if num_new_edge > 0 {
             if status == StatusType::Normal {
@@ -269,7 +239,7 @@ impl Branches {
             assert!(path_unique, "new edge but not path unique???");
         }
 
-        if to_write.is_empty() { // no need to update map 
+        if !changed { // no need to update map 
             if path_unique{
                 return (1, rareness);
             }
@@ -278,15 +248,6 @@ impl Branches {
             }
         }
 
-        {
-            // write
-            let mut gb_map_write = gb_map.write().unwrap();
-            for &br in &to_write {
-                gb_map_write[br.0] = br.1;
-            }
-        }
-        
-
         if num_new_edge > 0 {
             return (2, rareness);
         }
@@ -4,6 +4,7 @@ use crate::bcount_queue::*;
 use crate::file::*;
 use crate::depot_dir::*;
 use crate::status_type::StatusType;
+use crate::seed_index::SeedIndex;
 use rand;
 use std::{
     fs,
@@ -16,8 +17,6 @@ use std::{
 };
 use min_max_heap::MinMaxHeap;
 use priority_queue::PriorityQueue;
-extern crate glob;
-use self::glob::glob;
 //use std::process;
 // https://crates.io/crates/priority-queue
 
@@ -36,12 +35,22 @@ pub struct DepotSync {
   //pub input_queue: Mutex<PriorityQueue<PathBuf, BcountPriorityValue>>,
   pub input_queue: Mutex<MinMaxHeap<BcountPriorityValue>>,
   pub num_inputs: AtomicUsize,
+  // one index per queue directory, fed by inotify
+  afl_index: Mutex<SeedIndex>,
+  ce_index: Mutex<SeedIndex>,
+  grader_q_index: Mutex<SeedIndex>,
+  grader_path_index: Mutex<SeedIndex>,
 }
 
 impl DepotSync {
   pub fn new(out_dir: &Path) -> Self {
+    let dirs = DepotSyncDir::new(out_dir);
+    let afl_index = Mutex::new(SeedIndex::new(&dirs.afl_queue_dir));
+    let ce_index = Mutex::new(SeedIndex::new(&dirs.ce_queue_dir));
+    let grader_q_index = Mutex::new(SeedIndex::new(&dirs.grader_queue_dir));
+    let grader_path_index = Mutex::new(SeedIndex::new(&dirs.grader_path_dir));
     Self {
-      dirs: DepotSyncDir::new(out_dir),
+      dirs,
       next_afl_id: AtomicUsize::new(0),
       next_grader_q_id: AtomicUsize::new(0),
       next_ce_queue_id: AtomicUsize::new(0),
@@ -55,53 +64,43 @@ impl DepotSync {
       // input_queue: Mutex::new(PriorityQueue::new()),
       input_queue: Mutex::new(MinMaxHeap::new()),
       num_inputs: AtomicUsize::new(0),
+      afl_index,
+      ce_index,
+      grader_q_index,
+      grader_path_index,
     }
   }
 
-  fn check_seed(&self, category: i32) -> Option<PathBuf> {
-    let mut seed_id = 0;
-    let mut query = String::new();
-    let mut rpath = PathBuf::new();
-    let mut found = false;
-    match category {
-      0 => {
-              seed_id = self.next_afl_id.load(Ordering::Relaxed);
-              query = format!("{}/id:{:06}*", self.dirs.afl_queue_dir.display(), seed_id);
-           },
-      1 => {
-              seed_id = self.next_grader_q_id.load(Ordering::Relaxed);
-              query = format!("{}/id:{:06}*", self.dirs.grader_queue_dir.display(), seed_id);
-           },
-      2 => {
-              seed_id = self.next_grader_path_id.load(Ordering::Relaxed);
-              query = format!("{}/id:{:06}*", self.dirs.grader_path_dir.display(), seed_id);
-           },
-      _ => (),
+  // queue directory of a category: fifo mode syncs afl-slave (0) and fifo (1),
+  // sage mode afl-slave (0), grader (1) and grader-path (2)
+  fn seed_index(&self, category: i32, fifo: bool) -> Option<(&Mutex<SeedIndex>, &AtomicUsize)> {
+    match (category, fifo) {
+      (0, _) => Some((&self.afl_index, &self.next_afl_id)),
+      (1, true) => Some((&self.ce_index, &self.next_ce_queue_id)),
+      (1, false) => Some((&self.grader_q_index, &self.next_grader_q_id)),
+      (2, false) => Some((&self.grader_path_index, &self.next_grader_path_id)),
+      _ => None,
     }
-    for entry in glob(&query).expect("Failed to read glob pattern") {
-      match entry {
-        Ok(path) => {
-          found = true;
-          rpath = path;
-          break;
-        },
-        Err(e) => println!("{:?}", e),
-      }
-    }
-    if found {
-      seed_id = seed_id + 1;
-      match category {
-        0 => { self.next_afl_id.store(seed_id, Ordering::Relaxed); },
-        1 => { self.next_grader_q_id.store(seed_id, Ordering::Relaxed); },
-        2 => { self.next_grader_path_id.store(seed_id, Ordering::Relaxed); },
-        _ => (),
-      }
-    }
-    if found {
-      info!("Execute {:?}", rpath.display());
-      return Some(rpath);
+  }
+
+  fn lock_index<'a>(&self, index: &'a Mutex<SeedIndex>) -> std::sync::MutexGuard<'a, SeedIndex> {
+    match index.lock() {
+      Ok(guard) => guard,
+      Err(poisoned) => {
+        warn!("Mutex for seed index poisoned");
+        poisoned.into_inner()
+      },
     }
-    None
+  }
+
+  fn check_seed(&self, category: i32) -> Option<PathBuf> {
+    let (index, next_id) = self.seed_index(category, false)?;
+    let mut index = self.lock_index(index);
+    index.poll();
+    let (seed_id, rpath) = index.pop()?;
+    next_id.fetch_max(seed_id + 1, Ordering::Relaxed);
+    info!("Execute {:?}", rpath.display());
+    Some(rpath)
   }
 
   pub fn enqueue(&self, path: PathBuf, rare: u32,  queue_id: u32, seed_id: u32) {
@@ -150,53 +149,18 @@ impl DepotSync {
   }
 
   pub fn sync_fz_cefifo(&self, category: i32) {
-    let mut totalnum = self.num_inputs.load(Ordering::Relaxed);
     // synchronize fzq and then ce_output0 queue
-    let mut seed_id = 0;
-    match category {
-      0 => { seed_id = self.next_afl_id.load(Ordering::Relaxed); },
-      1 => { seed_id = self.next_ce_queue_id.load(Ordering::Relaxed); },
-      _ => (),
+    let (index, next_id) = match self.seed_index(category, true) {
+      Some(v) => v,
+      None => return,
+    };
+    let mut index = self.lock_index(index);
+    index.poll(); // drain events even when nothing is taken
+    if self.qlen() > 0 { // take new seeds only once the queue ran dry
+      return;
     }
-    loop { // loop to sync all new seeds inside the directory
-      let mut query = String::new();
-      let mut prefixfmt = String::new();
-      let mut rpath = PathBuf::new();
-      let mut found = false;
-
-      match category {
-        0 => { query = format!("{}/id:{:06}*", self.dirs.afl_queue_dir.display(), seed_id);
-                prefixfmt = format!("{}", self.dirs.afl_queue_dir.display()); },
-        1 => { query = format!("{}/id:{:06}*", self.dirs.ce_queue_dir.display(), seed_id);
-                prefixfmt = format!("{}", self.dirs.ce_queue_dir.display()); },
-        _ => (),
-      }
-
-      for entry in glob(&query).expect("Failed to read glob pattern") {
-        match entry {
-          Ok(path) => {
-            found = true;
-            rpath = path;
-            // println!("find next seed here: {}", rpath.display());
-            break;
-          },
-          Err(e) =>  {
-            println!("{:?}", e);
-          },
-        }
-      }
-      if  (!found || self.qlen() > 0)  { // never found the nextid
-        match category {
-          0 => { 
-            self.next_afl_id.store(seed_id, Ordering::Relaxed); 
-            self.num_inputs.store(totalnum, Ordering::Relaxed);},
-          1 => { 
-            self.next_ce_queue_id.store(seed_id, Ordering::Relaxed); 
-            self.num_inputs.store(totalnum, Ordering::Relaxed);},
-          _ => (),
-        }
-        break;
-      }
+    let mut totalnum = self.num_inputs.load(Ordering::Relaxed);
+    while let Some((seed_id, rpath)) = index.pop() {
       let mut rarevalue: u32 = 0;
       if (category > 0 ) {
         rarevalue = 999999 - (seed_id as u32);
@@ -208,88 +172,37 @@ impl DepotSync {
           self.enqueue(rpath, rarevalue, category as u32, seed_id as u32);
           totalnum += 1;
       }
-      
-      // move on to next
-      seed_id = seed_id + 1;      
+      next_id.fetch_max(seed_id + 1, Ordering::Relaxed);
     }
+    self.num_inputs.store(totalnum, Ordering::Relaxed);
   }
 
   // helper func of rareness based priority queue
   pub fn sync_new(&self, category: i32) -> bool {
     // scan 3 queues for new seeds and enqueue
-    let mut seed_id = 0;
+    let (index, next_id) = match self.seed_index(category, false) {
+      Some(v) => v,
+      None => return false,
+    };
+    let mut index = self.lock_index(index);
+    index.poll();
     let mut res:bool = false;
 
-    match category { // load checkpoint first
-      0 => { seed_id = self.next_afl_id.load(Ordering::Relaxed); },
-      1 => { seed_id = self.next_grader_q_id.load(Ordering::Relaxed); },
-      2 => { seed_id = self.next_grader_path_id.load(Ordering::Relaxed); },
-      _ => (),
-    }
-
-    loop { // loop to sync all new seeds inside the directory
-      let mut query = String::new();
-      let mut prefixfmt = String::new();
-      let mut rpath = PathBuf::new();
-      let mut found = false;
-
-      match category {
-        0 => { query = format!("{}/id:{:06}*", self.dirs.afl_queue_dir.display(), seed_id);
-                prefixfmt = format!("{}", self.dirs.afl_queue_dir.display()); },
-        1 => { query = format!("{}/id:{:06}*", self.dirs.grader_queue_dir.display(), seed_id);
-                prefixfmt = format!("{}", self.dirs.grader_queue_dir.display()); },
-        2 => { query = format!("{}/id:{:06}*", self.dirs.grader_path_dir.display(), seed_id);
-                prefixfmt = format!("{}", self.dirs.grader_path_dir.display()); },
-        _ => (),
-      }
-      // println!("making query to {}", query);
-      for entry in glob(&query).expect("Failed to read glob pattern") {
-        match entry {
-          Ok(path) => {
-            found = true;
-            rpath = path;
-            res = true;
-            // println!("find next seed here: {}", rpath.display());
-            break;
-          },
-          Err(e) =>  {
-            println!("{:?}", e);
-          },
-        }
-      }
-      if  (!found)  { // never found the nextid
-        match category {
-          0 => { self.next_afl_id.store(seed_id, Ordering::Relaxed); },
-          1 => { self.next_grader_q_id.store(seed_id, Ordering::Relaxed); },
-          2 => { self.next_grader_path_id.store(seed_id, Ordering::Relaxed); },
-          _ => (),
-        }
-        break;
-      }
+    while let Some((seed_id, rpath)) = index.pop() {
+      res = true;
       let mut rarevalue: u32 = 0;
       if (category > 0 ) { // grader queue, not inf inside name
-
-        let fname = rpath.strip_prefix(prefixfmt).unwrap().to_str().unwrap();
+        let fname = rpath.file_name().unwrap().to_str().unwrap();
         if (!fname.contains("inf")) {
           let v: Vec<&str> = fname.split('_').collect();
           let raref: f32 = v.get(1).unwrap_or(&"0.00").parse().unwrap();
           rarevalue = (100.0 * raref) as u32;
         }
-      // } else { // fzq, continue to next id if the file is not "+cov"
-      //   let fname = rpath.strip_prefix(prefixfmt).unwrap().to_str().unwrap();
-        // println("enqueue fzq seed {:?}", rpath);
-        // if (!fname.contains("+cov")) {
-        //   seed_id = seed_id + 1;
-        //   continue;
-        // }
       }
 
       // now push the seed into the job queue
-      // println!("pushed: {}", rpath.display());
       self.enqueue(rpath, rarevalue, category as u32, seed_id as u32);
-
-      // move on to next
-      seed_id = seed_id + 1;
+      next_id.fetch_max(seed_id + 1, Ordering::Relaxed);
     }
     return res;
   }
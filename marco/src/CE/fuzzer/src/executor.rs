@@ -30,6 +30,9 @@ pub struct ExecutorSync {
     fd: PipeFd,
     tmout_cnt: usize,
     pub shmid: i32,
+    // symqemu fork server for track(), started on the first seed
+    forksrv: Option<Forksrv>,
+    forksrv_disabled: bool,
 }
 
 impl ExecutorSync {
@@ -87,6 +90,39 @@ impl ExecutorSync {
         }
   }
 
+  fn run_track(&mut self, options: &str) -> StatusType {
+        if self.forksrv.is_none() && !self.forksrv_disabled {
+            self.forksrv = forksrv::Forksrv::new_track(
+                &format!("{}_track", &self.cmd.forksrv_socket_path),
+                &self.cmd.track,
+                &self.envs,
+                self.fd.as_raw_fd(),
+                self.cmd.is_stdin,
+                self.cmd.uses_asan,
+                config::TIME_LIMIT_TRACK,
+                config::MEM_LIMIT_TRACK,
+            );
+            self.forksrv_disabled = self.forksrv.is_none();
+        }
+
+        if let Some(ref mut fs) = self.forksrv {
+            let ret = fs.run_with(options);
+            if ret != StatusType::Error {
+                return ret;
+            }
+            // the server went away; start a new one for the next seed
+            warn!("track fork server failed, exec'ing this seed");
+            self.forksrv = None;
+        }
+
+        self.run_target(
+            &self.cmd.track,
+            config::MEM_LIMIT_TRACK,
+            //self.cmd.time_limit *
+            config::TIME_LIMIT_TRACK,
+        )
+  }
+
   pub fn new(
         cmd: command::CommandOpt,
         depot: Arc<depot::DepotSync>,
@@ -109,6 +145,8 @@ impl ExecutorSync {
 
         let fd = pipe_fd::PipeFd::new(&cmd.out_file);
         
+        let forksrv_disabled = std::env::var(defs::DISABLE_TRACK_FORKSRV_VAR).is_ok();
+
         Self {
             cmd,
             envs,
@@ -116,36 +154,33 @@ impl ExecutorSync {
             fd,
             tmout_cnt: 0,
             shmid,
+            forksrv: None,
+            forksrv_disabled,
         }
     }
 
     pub fn track(&mut self, id: usize, qid: usize, buf: &Vec<u8>) {
         //FIXME
         // let e = format!("taint_file=output/tmp/cur_input_2 solver_select=1 tid={}",id);
-        let e = format!("taint_file={} tid={} shmid={} pipeid={} inputid={}", &self.cmd.out_file, &qid, &self.shmid, &self.cmd.id, &id);
-
-        if self.cmd.is_stdin {
-            let e = format!("taint_file=stdin tid={} shmid={} pipeid={} inputid={}", &qid, &self.shmid, &self.cmd.id, &id);
-        } 
+        let e = if self.cmd.is_stdin {
+            format!("taint_file=stdin tid={} shmid={} pipeid={} inputid={}", &qid, &self.shmid, &self.cmd.id, &id)
+        } else {
+            format!("taint_file={} tid={} shmid={} pipeid={} inputid={}", &self.cmd.out_file, &qid, &self.shmid, &self.cmd.id, &id)
+        };
         info!("Track {}, e is {}", &id, e);
 
         // let mut outlog = std::fs::OpenOptions::new().append(true).open("/home/jie/coco-loop/log.log").expect("cannot open file");
         // write!(outlog, "[new input] = {}\n", id);
         self.envs.insert(
             defs::TAINT_OPTIONS.to_string(),
-            e,
+            e.clone(),
         );
 
 
         self.write_test(buf);
 
         compiler_fence(Ordering::SeqCst);
-        let ret_status = self.run_target(
-            &self.cmd.track,
-            config::MEM_LIMIT_TRACK,
-            //self.cmd.time_limit *
-            config::TIME_LIMIT_TRACK,
-        );
+        let ret_status = self.run_track(&e);
         compiler_fence(Ordering::SeqCst);
 
         if ret_status != StatusType::Normal {
@@ -200,6 +235,10 @@ impl Executor {
             defs::PATH_HASH_SHM_ENV_VAR.to_string(),
             branches.get_path_id().to_string(),
         );
+        envs.insert(
+            defs::TOUCH_LOG_SHM_ENV_VAR.to_string(),
+            branches.get_touch_id().to_string(),
+        );
         envs.insert(
             defs::LD_LIBRARY_PATH_VAR.to_string(),
             cmd.ld_library.clone(),
@@ -1,19 +1,21 @@
 //use super::{limit::SetLimit, *};
 use super::{limit::SetLimit};
 use fastgen_common::defs::*;
-use byteorder::{LittleEndian, ReadBytesExt};
+use byteorder::{LittleEndian, ReadBytesExt, WriteBytesExt};
 use libc;
 use std::{
     collections::HashMap,
     fs,
-    io::prelude::*,
+    io::{self, prelude::*},
+    net::Shutdown,
     os::unix::{
         io::RawFd,
         net::{UnixListener, UnixStream},
     },
     path::Path,
     process::{Command, Stdio},
-    time::Duration,
+    thread,
+    time::{Duration, Instant},
 };
 
 use crate::status_type::StatusType;
@@ -91,12 +93,128 @@ impl Forksrv {
         }
     }
 
+    // Fork server inside symqemu for the tracking runs. Each run passes its
+    // TAINT_OPTIONS along with the fork request (see run_with), so the server
+    // only has to be started once. Returns None if the track binary does not
+    // connect back, e.g. a symqemu built without fork-server support; the
+    // caller then keeps exec'ing one process per seed.
+    pub fn new_track(
+        socket_path: &str,
+        target: &(String, Vec<String>),
+        envs: &HashMap<String, String>,
+        fd: RawFd,
+        is_stdin: bool,
+        uses_asan: bool,
+        time_limit: u64,
+        mem_limit: u64,
+    ) -> Option<Forksrv> {
+        let _ = fs::remove_file(socket_path);
+        let listener = match UnixListener::bind(socket_path) {
+            Ok(sock) => sock,
+            Err(e) => {
+                warn!("Failed to bind track fork server socket {}: {:?}", socket_path, e);
+                return None;
+            }
+        };
+        listener
+            .set_nonblocking(true)
+            .expect("Couldn't set socket to nonblocking");
+
+        let mut envs_fk = envs.clone();
+        envs_fk.insert(SYMFIT_FORKSRV_SOCKET_PATH_VAR.to_string(), socket_path.to_owned());
+        let mut c = match Command::new(&target.0)
+            .args(&target.1)
+            .env_clear()
+            .envs(&envs_fk)
+            .stdout(Stdio::null())
+            .stderr(Stdio::null())
+            .mem_limit(mem_limit.clone())
+            .setsid()
+            .pipe_stdin(fd, is_stdin)
+            .spawn()
+        {
+            Ok(c) => c,
+            Err(e) => {
+                warn!("Failed to spawn track fork server: {:?}", e);
+                let _ = fs::remove_file(socket_path);
+                return None;
+            }
+        };
+
+        // the server connects right before running the guest
+        let deadline = Instant::now() + Duration::from_secs(FORKSRV_CONNECT_TIMEOUT);
+        let socket = loop {
+            match listener.accept() {
+                Ok((socket, _)) => break Some(socket),
+                Err(ref e) if e.kind() == io::ErrorKind::WouldBlock => {
+                    if Instant::now() > deadline {
+                        break None;
+                    }
+                    if let Ok(Some(_)) = c.try_wait() {
+                        break None;
+                    }
+                    thread::sleep(Duration::from_millis(10));
+                }
+                Err(e) => {
+                    warn!("Failed to accept from track fork server: {:?}", e);
+                    break None;
+                }
+            }
+        };
+        let socket = match socket {
+            Some(socket) => socket,
+            None => {
+                info!("{} did not start a fork server, tracking without it", target.0);
+                let _ = c.kill();
+                let _ = c.wait();
+                let _ = fs::remove_file(socket_path);
+                return None;
+            }
+        };
+
+        socket
+            .set_nonblocking(false)
+            .expect("Couldn't set socket to blocking");
+        socket
+            .set_read_timeout(Some(Duration::from_secs(time_limit)))
+            .expect("Couldn't set read timeout");
+        socket
+            .set_write_timeout(Some(Duration::from_secs(time_limit)))
+            .expect("Couldn't set write timeout");
+
+        info!("Track fork server {} is up", socket_path);
+
+        Some(Forksrv {
+            path: socket_path.to_owned(),
+            socket,
+            uses_asan,
+            is_stdin,
+            child: c,
+        })
+    }
+
     pub fn run(&mut self) -> StatusType {
         if self.socket.write(&FORKSRV_NEW_CHILD).is_err() {
             warn!("Fail to write socket!!");
             return StatusType::Error;
         }
+        self.wait_child()
+    }
+
+    // fork request carrying the run's TAINT_OPTIONS (u32 length + bytes)
+    pub fn run_with(&mut self, options: &str) -> StatusType {
+        let mut req = FORKSRV_NEW_CHILD.to_vec();
+        req.write_u32::<LittleEndian>(options.len() as u32)
+            .expect("Could not encode fork request");
+        req.extend_from_slice(options.as_bytes());
+        if self.socket.write_all(&req).is_err() {
+            warn!("Fail to write socket!!");
+            return StatusType::Error;
+        }
+        self.wait_child()
+    }
 
+    fn wait_child(&mut self) -> StatusType {
         let mut buf = vec![0; 4];
         let child_pid: i32;
         match self.socket.read(&mut buf) {
@@ -167,6 +285,7 @@ impl Drop for Forksrv {
         if self.socket.write(&fin).is_err() {
             debug!("Fail to write socket !!  FIN ");
         }
+        let _ = self.socket.shutdown(Shutdown::Write);
         let path = Path::new(&self.path);
         if path.exists() {
             if fs::remove_file(&self.path).is_err() {
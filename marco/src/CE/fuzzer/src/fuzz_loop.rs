@@ -39,7 +39,10 @@ pub fn ce_loop_sync(
   let executor_id = cmd_opt.id;
   let mut all_time = 0;
   let mut last_all_time = 0;
+  // the orchestrator hands every lane a private union table through MARCO_SHM_ID
+  let lane_shmid = std::env::var("MARCO_SHM_ID").ok().and_then(|v| v.parse::<i32>().ok());
   let shmid = match executor_id {
+    _ if lane_shmid.is_some() => lane_shmid.unwrap(),
     2 => unsafe {
       libc::shmget(
           0x9876,
@@ -16,6 +16,7 @@ pub mod command;
 pub mod check_dep;
 pub mod tmpfs;
 pub mod depot;
+pub mod seed_index;
 pub mod depot_dir;
 pub mod file;
 pub mod fuzz_main;
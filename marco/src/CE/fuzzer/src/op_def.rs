@@ -73,9 +73,16 @@ pub const DFSAN_XOR: u32 = 28;
 pub const DFSAN_TRUNC: u32 = 36;
 pub const DFSAN_ZEXT: u32 = 37;
 pub const DFSAN_SEXT: u32 = 38;
-pub const DFSAN_LOAD: u32 = 67;
-pub const DFSAN_EXTRACT: u32 = 68;
-pub const DFSAN_CONCAT: u32 = 69;
+pub const DFSAN_SELECT: u32 = 55;
+//self-defined ops sit above the last LLVM opcode, as in dfsan's enum operators
+pub const DFSAN_LAST_LLVM_OP: u32 = 64;
+pub const DFSAN_LOAD: u32 = DFSAN_LAST_LLVM_OP + 3;
+pub const DFSAN_EXTRACT: u32 = DFSAN_LAST_LLVM_OP + 4;
+pub const DFSAN_CONCAT: u32 = DFSAN_LAST_LLVM_OP + 5;
+pub const DFSAN_BSWAP: u32 = DFSAN_LAST_LLVM_OP + 11;
+pub const DFSAN_ROTL: u32 = DFSAN_LAST_LLVM_OP + 12;
+pub const DFSAN_ROTR: u32 = DFSAN_LAST_LLVM_OP + 13;
+pub const DFSAN_FSHR: u32 = DFSAN_LAST_LLVM_OP + 14;
 //relational
 pub const DFSAN_BVEQ: u32 = 32;
 pub const DFSAN_BVNEQ: u32 = 33;
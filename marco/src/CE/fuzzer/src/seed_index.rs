@@ -0,0 +1,152 @@
+// In-memory index of the "id:NNNNNN*" seeds of one queue directory.
+//
+// New files are learned from inotify (IN_CLOSE_WRITE / IN_MOVED_TO, plus
+// IN_CREATE for hard links), so a poll costs O(new files) instead of a glob
+// per candidate id. The directory is read in full only once when the watch is
+// set up and again after an event queue overflow. Without inotify (limit
+// reached, directory not created yet) every poll falls back to one read_dir
+// pass that only looks at names it has not indexed yet.
+//
+// Ids are handed out smallest first whenever they appear, so a seed written
+// after a higher id does not stall or get skipped.
+use std::{
+    collections::{BTreeMap, HashSet},
+    ffi::{CString, OsStr},
+    fs,
+    os::unix::{ffi::OsStrExt, io::RawFd},
+    path::{Path, PathBuf},
+};
+
+const WATCH_MASK: u32 = libc::IN_CLOSE_WRITE | libc::IN_MOVED_TO | libc::IN_CREATE;
+const EVENT_BUF_SIZE: usize = 64 * 1024;
+
+pub struct SeedIndex {
+    dir: PathBuf,
+    fd: RawFd,
+    watching: bool,
+    seen: HashSet<usize>,
+    pending: BTreeMap<usize, PathBuf>,
+    buf: Vec<u8>,
+}
+
+// "id:000123,src:..." -> 123
+pub fn seed_id(name: &OsStr) -> Option<usize> {
+    let name = name.as_bytes();
+    if name.len() < 9 || &name[..3] != b"id:" {
+        return None;
+    }
+    std::str::from_utf8(&name[3..9]).ok()?.parse::<usize>().ok()
+}
+
+impl SeedIndex {
+    pub fn new(dir: &Path) -> Self {
+        let fd = unsafe { libc::inotify_init1(libc::IN_NONBLOCK | libc::IN_CLOEXEC) };
+        if fd < 0 {
+            warn!("inotify unavailable, polling {:?}", dir);
+        }
+        let mut index = Self {
+            dir: dir.to_path_buf(),
+            fd,
+            watching: false,
+            seen: HashSet::new(),
+            pending: BTreeMap::new(),
+            buf: vec![0u8; EVENT_BUF_SIZE],
+        };
+        index.poll();
+        index
+    }
+
+    // index whatever showed up since the last call
+    pub fn poll(&mut self) {
+        if !self.watching {
+            // watch before scanning, so nothing falls between the two
+            if self.fd >= 0 && self.dir.is_dir() {
+                let cdir = CString::new(self.dir.as_os_str().as_bytes()).unwrap();
+                let wd = unsafe { libc::inotify_add_watch(self.fd, cdir.as_ptr(), WATCH_MASK) };
+                self.watching = wd >= 0;
+            }
+            self.scan();
+            return;
+        }
+        loop {
+            let n = unsafe {
+                libc::read(self.fd, self.buf.as_mut_ptr() as *mut libc::c_void, self.buf.len())
+            };
+            if n <= 0 {
+                break;
+            }
+            let mut off = 0;
+            let mut rescan = false;
+            let mut names = vec![];
+            while off + std::mem::size_of::<libc::inotify_event>() <= n as usize {
+                let ev = unsafe {
+                    std::ptr::read_unaligned(self.buf.as_ptr().add(off) as *const libc::inotify_event)
+                };
+                let name_at = off + std::mem::size_of::<libc::inotify_event>();
+                off = name_at + ev.len as usize;
+                if ev.mask & libc::IN_Q_OVERFLOW != 0 {
+                    rescan = true;
+                } else if ev.mask & libc::IN_IGNORED != 0 {
+                    // directory removed or moved away: back to polling until it is back
+                    self.watching = false;
+                } else if ev.len > 0 {
+                    let raw = &self.buf[name_at..off];
+                    let end = raw.iter().position(|&c| c == 0).unwrap_or(raw.len());
+                    names.push((OsStr::from_bytes(&raw[..end]).to_os_string(), ev.mask));
+                }
+            }
+            for (name, mask) in names {
+                if mask & libc::IN_CREATE != 0 && !self.is_link(&name) {
+                    continue; // still being written, IN_CLOSE_WRITE follows
+                }
+                self.add(&name);
+            }
+            if rescan {
+                warn!("inotify queue overflow on {:?}, rescanning", self.dir);
+                self.scan();
+            }
+        }
+        if !self.watching {
+            self.scan();
+        }
+    }
+
+    // smallest indexed id not handed out yet
+    pub fn pop(&mut self) -> Option<(usize, PathBuf)> {
+        let id = *self.pending.keys().next()?;
+        self.pending.remove(&id).map(|path| (id, path))
+    }
+
+    fn add(&mut self, name: &OsStr) {
+        if let Some(id) = seed_id(name) {
+            if self.seen.insert(id) {
+                self.pending.insert(id, self.dir.join(name));
+            }
+        }
+    }
+
+    fn is_link(&self, name: &OsStr) -> bool {
+        use std::os::unix::fs::MetadataExt;
+        fs::metadata(self.dir.join(name)).map(|m| m.nlink() > 1).unwrap_or(false)
+    }
+
+    fn scan(&mut self) {
+        if let Ok(entries) = self.dir.read_dir() {
+            for entry in entries.flatten() {
+                let name = entry.file_name();
+                match seed_id(&name) {
+                    Some(id) if !self.seen.contains(&id) => self.add(&name),
+                    _ => (),
+                }
+            }
+        }
+    }
+}
+
+impl Drop for SeedIndex {
+    fn drop(&mut self) {
+        if self.fd >= 0 {
+            unsafe { libc::close(self.fd) };
+        }
+    }
+}
@@ -1,5 +1,6 @@
 use crate::file::*;
 use crate::executor::Executor;
+use crate::seed_index::SeedIndex;
 use fastgen_common::{config, defs};
 use std::{
     collections::HashMap,
@@ -38,7 +39,7 @@ pub fn sync_afl(
     executor: &mut Executor,
     running: Arc<AtomicBool>,
     sync_dir: &Path,
-    sync_ids: &mut HashMap<String, usize>,
+    sync_ids: &mut HashMap<String, SeedIndex>,
 ) {
     executor.rebind_forksrv();
 
@@ -63,54 +64,29 @@ pub fn sync_afl(
 
 }
 
-fn get_afl_id(f: &fs::DirEntry) -> Option<usize> {
-    let file_name = f.file_name().into_string();
-    if let Ok(name) = file_name {
-        if name.len() >= 9 {
-            let id_str = &name[3..9];
-            if let Ok(id) = id_str.parse::<usize>() {
-                return Some(id);
-            }
-        }
-    }
-    None
-}
-
 fn sync_one_afl_dir(
     executor: &mut Executor,
     running: Arc<AtomicBool>,
     sync_dir: &Path,
     sync_name: &str,
-    sync_ids: &mut HashMap<String, usize>,
+    sync_ids: &mut HashMap<String, SeedIndex>,
 ) {
-    let min_id = *sync_ids.get(sync_name).unwrap_or(&0);
-    let mut max_id = min_id;
-    let seed_dir = sync_dir
-        .read_dir()
-        .expect("read_dir call failed while syncing afl ..");
-    for entry in seed_dir {
-        if let Ok(entry) = entry {
-            if !running.load(Ordering::SeqCst) {
-                break;
-            }
-            let path = &entry.path();
-            if path.is_file() {
-                if let Some(id) = get_afl_id(&entry) {
-                    if id >= min_id {
-                        let file_len = fs::metadata(path).unwrap().len() as usize;
-                        if file_len < config::MAX_INPUT_LEN {
-                            info!("sync {:?}", path);
-                            let buf = read_from_file(path);
-                            executor.run_norun(&buf);
-                        }
-                        if id > max_id {
-                            max_id = id;
-                        }
-                    }
-                }
+    // the index only reports files it has not handed out before
+    let index = sync_ids
+        .entry(sync_name.to_string())
+        .or_insert_with(|| SeedIndex::new(sync_dir));
+    index.poll();
+    while running.load(Ordering::SeqCst) {
+        let path = match index.pop() {
+            Some((_, path)) => path,
+            None => break,
+        };
+        if let Ok(meta) = fs::metadata(&path) {
+            if meta.is_file() && (meta.len() as usize) < config::MAX_INPUT_LEN {
+                info!("sync {:?}", path);
+                let buf = read_from_file(&path);
+                executor.run_norun(&buf);
             }
         }
     }
-
-    sync_ids.insert(sync_name.to_string(), max_id + 1);
 }
@@ -98,6 +98,7 @@ public:
   Constant *TraceSwTT;
   Constant *TraceFnTT;
   Constant *TraceExploitTT;
+  Constant *TouchFn;
 
   FunctionType *TraceCmpTy;
   FunctionType *TraceSwTy;
@@ -105,6 +106,7 @@ public:
   FunctionType *TraceSwTtTy;
   FunctionType *TraceFnTtTy;
   FunctionType *TraceExploitTtTy;
+  FunctionType *TouchFnTy;
 
   // Custom setting
   AngoraABIList ABIList;
@@ -296,6 +298,13 @@ void AngoraLLVMPass::initVariables(Module &M) {
       // F->addAttribute(1, Attribute::ZExt);
     }
 
+    Type *TouchArgs[1] = {Int32Ty};
+    TouchFnTy = FunctionType::get(VoidTy, TouchArgs, false);
+    TouchFn = M.getOrInsertFunction("__angora_touch", TouchFnTy);
+    if (Function *F = dyn_cast<Function>(TouchFn)) {
+      F->addAttribute(LLVM_ATTRIBUTE_LIST::FunctionIndex, Attribute::NoUnwind);
+    }
+
   } else if (TrackMode) {
     Type *TraceCmpTtArgs[7] = {Int32Ty, Int32Ty, Int32Ty, Int32Ty,
                                Int64Ty, Int64Ty, Int32Ty};
@@ -385,7 +394,8 @@ void AngoraLLVMPass::countEdge(Module &M, BasicBlock &BB) {
   ConstantInt *CurLoc = ConstantInt::get(Int32Ty, cur_loc);
 
   BasicBlock::iterator IP = BB.getFirstInsertionPt();
-  IRBuilder<> IRB(&(*IP));
+  Instruction *InsertPoint = &(*IP);
+  IRBuilder<> IRB(InsertPoint);
 
   LoadInst *PrevLoc = IRB.CreateLoad(AngoraPrevLoc);
   setInsNonSan(PrevLoc);
@@ -406,6 +416,18 @@ void AngoraLLVMPass::countEdge(Module &M, BasicBlock &BB) {
   LoadInst *Counter = IRB.CreateLoad(MapPtrIdx);
   setInsNonSan(Counter);
 
+  // First hit of this edge in the run: append it to the touch log, so the
+  // fuzzer walks the touched entries instead of the whole map
+  Value *IsFirst = IRB.CreateICmpEQ(Counter, ConstantInt::get(Int8Ty, 0));
+  setValueNonSan(IsFirst);
+  BranchInst *BI = cast<BranchInst>(
+      SplitBlockAndInsertIfThen(IsFirst, InsertPoint, false, ColdCallWeights));
+  setInsNonSan(BI);
+  IRBuilder<> ThenB(BI);
+  CallInst *TouchCall = ThenB.CreateCall(TouchFn, {BrId});
+  setInsNonSan(TouchCall);
+  IRB.SetInsertPoint(InsertPoint);
+
   // Implementation of saturating counter.
   // Value *CmpOF = IRB.CreateICmpNE(Counter, ConstantInt::get(Int8Ty, -1));
   // setValueNonSan(CmpOF);
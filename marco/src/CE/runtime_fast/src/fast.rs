@@ -9,6 +9,7 @@ fn fast_init() {
     START.call_once(|| {
         shm_branches::map_branch_counting_shm();
         shm_branches::path_hash_shm();
+        shm_branches::map_touch_log_shm();
         forkcli::start_forkcli();
     });
 }
@@ -3,7 +3,10 @@
 use fastgen_common::config::BRANCHES_SIZE;
 use fastgen_common::defs::BRANCHES_SHM_ENV_VAR;
 use fastgen_common::defs::PATH_HASH_SHM_ENV_VAR;
+use fastgen_common::defs::TOUCH_LOG_SHM_ENV_VAR;
 use fastgen_common::shm;
+use fastgen_common::touch_log::TouchLog;
+use std::sync::atomic::Ordering;
 use std::env;
 use std::process;
 
@@ -19,6 +22,8 @@ static mut __PATH_HASH_INITIAL: PathHash = [0; 1];    // J.H.
 pub static mut __angora_area_ptr: *const u8 = unsafe{  &__ANGORA_AREA_INITIAL[0] as *const u8 };
 #[no_mangle]
 pub static mut __path_hash_ptr: *const u64 = unsafe{ &__PATH_HASH_INITIAL[0] as *const u64 };
+// null when the fuzzer did not hand us a touch log
+static mut __TOUCH_LOG_PTR: *mut TouchLog = 0 as *mut TouchLog;
 
 pub fn map_branch_counting_shm() {
     let id_val = env::var(BRANCHES_SHM_ENV_VAR);
@@ -57,4 +62,33 @@ pub fn path_hash_shm() {
         }
         Err(_) => {}
     }
-}
\ No newline at end of file
+}
+pub fn map_touch_log_shm() {
+    let id_val = env::var(TOUCH_LOG_SHM_ENV_VAR);
+    match id_val {
+        Ok(val) => {
+            let shm_id = val.parse::<i32>().expect("Could not parse i32 value.");
+            let mem = shm::SHM::<TouchLog>::from_id(shm_id);
+            if mem.is_fail() {
+              eprintln!("fail to load shm");
+              process::exit(1);
+            }
+            unsafe {
+                __TOUCH_LOG_PTR = mem.get_ptr();
+                (*__TOUCH_LOG_PTR).active.store(1, Ordering::Relaxed);
+            }
+            return;
+        }
+        Err(_) => {}
+    }
+}
+
+// called by the instrumentation when an edge counter leaves 0
+#[no_mangle]
+pub extern "C" fn __angora_touch(idx: u32) {
+    unsafe {
+        if !__TOUCH_LOG_PTR.is_null() {
+            TouchLog::push(__TOUCH_LOG_PTR, idx);
+        }
+    }
+}
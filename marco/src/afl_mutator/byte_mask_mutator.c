@@ -0,0 +1,242 @@
+// AFL++ custom mutator that aims havoc at the input bytes FastGen found to
+// matter.
+//
+//   AFL_CUSTOM_MUTATOR_LIBRARY=libbyte_mask_mutator.so afl-fuzz -S afl-slave ...
+//
+// FastGen traces the seeds of afl-slave/queue and publishes, per seed id, the
+// offsets its symbolic branches depend on, weighted by how many of those
+// branches still have an unexplored side (see CE/fuzzer/cpp_core/byte_mask.h).
+// For a queue entry with such a mask we run extra havoc rounds whose byte
+// mutations pick their offsets in proportion to that weight. Entries without
+// a mask are left to AFL's own stages.
+//
+// Environment:
+//   MARCO_BYTE_MASK        table path (default <MARCO_PIPE_DIR>/marco_byte_mask)
+//   MARCO_BYTE_MASK_QUEUE  FastGen queue id of AFL's queue (default 0)
+//   MARCO_BYTE_MASK_ROUNDS havoc rounds per masked entry (default 128)
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+/* must match ByteMaskTable in CE/fuzzer/cpp_core/byte_mask.h */
+#define BYTE_MASK_MAGIC 0x316b73614d7a4dULL
+#define BYTE_MASK_MAX_RUNS 254
+
+struct mask_header {
+  uint64_t magic;
+  uint32_t slot_bits;
+  uint32_t max_runs;
+};
+
+struct mask_run {
+  uint32_t start;
+  uint16_t len;
+  uint16_t weight;
+};
+
+struct mask_slot {
+  uint32_t seq;
+  uint32_t queue_id;
+  uint32_t seed_id;
+  uint16_t nruns;
+  uint16_t flags;
+  uint32_t total;
+  uint32_t pad;
+  struct mask_run runs[BYTE_MASK_MAX_RUNS];
+};
+
+#define DEFAULT_ROUNDS 128
+#define MAX_STACK 16
+#define PICK_TRIES 8
+
+static const int8_t interesting_8[] = {-128, -1, 0, 1, 16, 32, 64, 100, 127};
+
+struct mutator {
+  void *map;
+  size_t map_size;
+  struct mask_slot *slots;
+  uint64_t mask;
+  uint32_t queue_id;
+  uint32_t rounds;
+  uint64_t rng;
+  // mask of the current queue entry
+  struct mask_slot cur;
+  uint64_t cum[BYTE_MASK_MAX_RUNS];
+  uint64_t cum_total;
+  uint8_t *out;
+  size_t out_size;
+};
+
+static uint64_t next_rand(struct mutator *m) {
+  uint64_t x = m->rng;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  return m->rng = x;
+}
+
+static uint64_t rand_below(struct mutator *m, uint64_t limit) {
+  return limit ? next_rand(m) % limit : 0;
+}
+
+static void open_table(struct mutator *m) {
+  char buf[512];
+  const char *path = getenv("MARCO_BYTE_MASK");
+  if (!path || path[0] == '\0') {
+    const char *dir = getenv("MARCO_PIPE_DIR");
+    snprintf(buf, sizeof(buf), "%s/marco_byte_mask", (dir && dir[0] != '\0') ? dir : "/tmp");
+    path = buf;
+  }
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    fprintf(stderr, "[byte_mask_mutator] no mask table at %s\n", path);
+    return;
+  }
+  struct mask_header hdr;
+  struct stat st;
+  if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || hdr.magic != BYTE_MASK_MAGIC ||
+      hdr.max_runs != BYTE_MASK_MAX_RUNS || fstat(fd, &st) < 0) {
+    fprintf(stderr, "[byte_mask_mutator] %s is not a mask table\n", path);
+    close(fd);
+    return;
+  }
+  size_t size = sizeof(hdr) + ((size_t)1 << hdr.slot_bits) * sizeof(struct mask_slot);
+  if ((size_t)st.st_size < size) {
+    close(fd);
+    return;
+  }
+  void *map = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) return;
+  m->map = map;
+  m->map_size = size;
+  m->slots = (struct mask_slot *)((uint8_t *)map + sizeof(hdr));
+  m->mask = ((uint64_t)1 << hdr.slot_bits) - 1;
+}
+
+// copy the mask of (queue_id, seed_id) into m->cur; 0 if there is none
+static int load_mask(struct mutator *m, uint32_t seed_id) {
+  m->cum_total = 0;
+  if (!m->slots) return 0;
+  uint64_t key = ((uint64_t)m->queue_id << 32) | seed_id;
+  struct mask_slot *s = &m->slots[(key * 0x9e3779b97f4a7c15ULL >> 32) & m->mask];
+  uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+  memcpy(&m->cur, s, sizeof(m->cur));
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if ((seq & 1) || seq != __atomic_load_n(&s->seq, __ATOMIC_RELAXED) ||
+      !(m->cur.flags & 1) || m->cur.queue_id != m->queue_id ||
+      m->cur.seed_id != seed_id || m->cur.nruns > BYTE_MASK_MAX_RUNS)
+    return 0;
+  for (uint32_t i = 0; i < m->cur.nruns; i++) {
+    m->cum_total += (uint64_t)m->cur.runs[i].len * m->cur.runs[i].weight;
+    m->cum[i] = m->cum_total;
+  }
+  return m->cum_total != 0;
+}
+
+// offset drawn in proportion to its weight, uniform if the mask does not
+// reach into this (possibly trimmed) buffer
+static size_t pick_offset(struct mutator *m, size_t size) {
+  for (int t = 0; t < PICK_TRIES; t++) {
+    uint64_t r = rand_below(m, m->cum_total);
+    uint32_t lo = 0, hi = m->cur.nruns - 1;
+    while (lo < hi) {
+      uint32_t mid = (lo + hi) / 2;
+      if (m->cum[mid] > r) hi = mid;
+      else lo = mid + 1;
+    }
+    const struct mask_run *run = &m->cur.runs[lo];
+    uint64_t base = lo ? m->cum[lo - 1] : 0;
+    size_t off = run->start + (r - base) / run->weight;
+    if (off < size) return off;
+  }
+  return rand_below(m, size);
+}
+
+void *afl_custom_init(void *afl, unsigned int seed) {
+  (void)afl;
+  struct mutator *m = calloc(1, sizeof(struct mutator));
+  if (!m) return NULL;
+  m->rng = ((uint64_t)seed << 32) ^ 0x2545f4914f6cdd1dULL;
+  const char *q = getenv("MARCO_BYTE_MASK_QUEUE");
+  m->queue_id = q ? strtoul(q, NULL, 10) : 0;
+  const char *r = getenv("MARCO_BYTE_MASK_ROUNDS");
+  m->rounds = r ? strtoul(r, NULL, 10) : DEFAULT_ROUNDS;
+  open_table(m);
+  return m;
+}
+
+// called when AFL moves to a new queue entry: "<dir>/id:000123,..."
+uint8_t afl_custom_queue_get(void *data, const uint8_t *filename) {
+  struct mutator *m = data;
+  const char *name = strrchr((const char *)filename, '/');
+  name = name ? name + 1 : (const char *)filename;
+  m->cum_total = 0;
+  if (!m->slots) open_table(m); // FastGen may have come up after us
+  if (strncmp(name, "id:", 3) == 0)
+    load_mask(m, strtoul(name + 3, NULL, 10));
+  return 1;
+}
+
+uint32_t afl_custom_fuzz_count(void *data, const uint8_t *buf, size_t buf_size) {
+  struct mutator *m = data;
+  (void)buf;
+  return (m->cum_total && buf_size) ? m->rounds : 0;
+}
+
+size_t afl_custom_fuzz(void *data, uint8_t *buf, size_t buf_size, uint8_t **out_buf,
+                       uint8_t *add_buf, size_t add_buf_size, size_t max_size) {
+  struct mutator *m = data;
+  (void)add_buf;
+  (void)add_buf_size;
+  size_t size = buf_size < max_size ? buf_size : max_size;
+  if (m->out_size < size) {
+    uint8_t *out = realloc(m->out, size);
+    if (!out) {
+      *out_buf = buf;
+      return buf_size;
+    }
+    m->out = out;
+    m->out_size = size;
+  }
+  memcpy(m->out, buf, size);
+  *out_buf = m->out;
+  if (!size || !m->cum_total) return size;
+
+  uint32_t stack = 1u << (1 + rand_below(m, 4));
+  if (stack > MAX_STACK) stack = MAX_STACK;
+  for (uint32_t i = 0; i < stack; i++) {
+    size_t off = pick_offset(m, size);
+    switch (rand_below(m, 5)) {
+      case 0:
+        m->out[off] ^= 1 << rand_below(m, 8);
+        break;
+      case 1:
+        m->out[off] = interesting_8[rand_below(m, sizeof(interesting_8))];
+        break;
+      case 2:
+        m->out[off] += 1 + rand_below(m, 35);
+        break;
+      case 3:
+        m->out[off] -= 1 + rand_below(m, 35);
+        break;
+      default:
+        m->out[off] = next_rand(m);
+        break;
+    }
+  }
+  return size;
+}
+
+void afl_custom_deinit(void *data) {
+  struct mutator *m = data;
+  if (m->map) munmap(m->map, m->map_size);
+  free(m->out);
+  free(m);
+}
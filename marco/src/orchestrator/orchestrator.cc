@@ -0,0 +1,561 @@
+// Parallel driver for the Marco-SymFit pipeline.
+//
+//   marco_orch -j <workers> -o <out> -i <seeds> -t <target>
+//              --fastgen <bin> --scheduler <main-MS.py> --fgtest <bin> --qemu <bin>
+//              [-c first_cpu] [-T exec_timeout] [-R max_runtime] [-r report_secs]
+//              [-s state_dir] [-x] [-- scheduler args]
+//
+// run_marco_symfit_integration.sh drives one FastGen, one scheduler and one
+// symqemu at a time through /tmp/wp2, /tmp/pcpipe, /tmp/myfifo and a single
+// union table. Here every worker is a lane of its own under <out>/lane<N>:
+//
+//   - a FastGen and a scheduler instance, started like the script does
+//   - its FIFOs in <out>/lane<N>/chan (MARCO_PIPE_DIR), or a decision
+//     channel socket there with -x (MARCO_CHANNEL)
+//   - a private union-table segment created here and handed to FastGen and
+//     fgtest through MARCO_SHM_ID
+//   - its symqemu runs pinned to CPU first_cpu + N
+//
+// Test cases a lane's FastGen generates (lane fifo/queue) are tree-dumped
+// under that lane's trace ids, so they are executed by the same lane, first.
+// Seeds from <seeds>, including ones that show up while running, form one
+// shared queue: an idle lane takes the next one, numbers it into its own
+// afl-slave/queue and runs it.
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <sched.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <signal.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <set>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+
+extern char **environ;
+
+#define UNION_TABLE_SIZE 0xc00000000ULL
+#define IDLE_POLL_MS 100
+#define SEED_SCAN_MS 1000
+#define STARTUP_DELAY_MS 500
+
+struct Options {
+  int workers = 1;
+  int first_cpu = 0;
+  int exec_timeout = 15;
+  int max_runtime = 0;
+  int report_secs = 10;
+  bool channel = false;
+  std::string out_dir;
+  std::string seed_dir;
+  std::string target;
+  std::string fastgen;
+  std::string scheduler;
+  std::string fgtest;
+  std::string qemu;
+  std::string state_dir;
+  std::vector<std::string> sched_args;
+};
+
+static std::atomic<bool> running(true);
+
+static void on_signal(int) {
+  running = false;
+}
+
+static uint64_t now_us() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool make_dirs(const std::string &path) {
+  for (size_t pos = 1; pos <= path.size(); pos++) {
+    if (pos != path.size() && path[pos] != '/') continue;
+    std::string sub = path.substr(0, pos);
+    if (mkdir(sub.c_str(), 0755) < 0 && errno != EEXIST) {
+      fprintf(stderr, "[orch] cannot create %s: %s\n", sub.c_str(), strerror(errno));
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool is_file(const std::string &path) {
+  struct stat st;
+  return stat(path.c_str(), &st) == 0 && S_ISREG(st.st_mode);
+}
+
+static bool copy_file(const std::string &from, const std::string &to) {
+  if (link(from.c_str(), to.c_str()) == 0) return true;
+  int in = open(from.c_str(), O_RDONLY);
+  if (in < 0) return false;
+  int out = open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (out < 0) {
+    close(in);
+    return false;
+  }
+  char buf[65536];
+  ssize_t n;
+  bool ok = true;
+  while ((n = read(in, buf, sizeof(buf))) > 0) {
+    if (write(out, buf, n) != n) {
+      ok = false;
+      break;
+    }
+  }
+  close(in);
+  close(out);
+  return ok && n == 0;
+}
+
+// children run inside their lane directory, so hand them absolute paths
+static std::string absolute(const std::string &path) {
+  char buf[PATH_MAX];
+  if (path.empty() || path[0] == '/' || !realpath(path.c_str(), buf)) return path;
+  return buf;
+}
+
+// trace id of an "id:NNNNNN[,...]" name, -1 otherwise
+static long name_tid(const char *name) {
+  if (strncmp(name, "id:", 3) != 0) return -1;
+  char *end;
+  long tid = strtol(name + 3, &end, 10);
+  return end == name + 3 ? -1 : tid;
+}
+
+// environment of a child: ours, with overrides
+static std::vector<std::string> child_env(const std::map<std::string, std::string> &set) {
+  std::vector<std::string> env;
+  for (char **e = environ; *e; e++) {
+    const char *eq = strchr(*e, '=');
+    if (eq && set.count(std::string(*e, eq - *e))) continue;
+    env.push_back(*e);
+  }
+  for (auto &kv : set) env.push_back(kv.first + "=" + kv.second);
+  return env;
+}
+
+// fork/exec in a new process group, output appended to log
+static pid_t spawn(const std::vector<std::string> &argv, const std::vector<std::string> &env,
+                   const std::string &cwd, const std::string &log, int cpu) {
+  std::vector<char*> cargv, cenv;
+  for (auto &a : argv) cargv.push_back(const_cast<char*>(a.c_str()));
+  cargv.push_back(nullptr);
+  for (auto &e : env) cenv.push_back(const_cast<char*>(e.c_str()));
+  cenv.push_back(nullptr);
+
+  pid_t pid = fork();
+  if (pid != 0) return pid;
+  setpgid(0, 0);
+  if (cpu >= 0) {
+    // inherited by symqemu, which fgtest forks
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    sched_setaffinity(0, sizeof(set), &set);
+  }
+  if (!cwd.empty() && chdir(cwd.c_str()) < 0) _exit(127);
+  int fd = open(log.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd >= 0) {
+    dup2(fd, STDOUT_FILENO);
+    dup2(fd, STDERR_FILENO);
+    close(fd);
+  }
+  int null = open("/dev/null", O_RDONLY);
+  if (null >= 0) {
+    dup2(null, STDIN_FILENO);
+    close(null);
+  }
+  execve(cargv[0], cargv.data(), cenv.data());
+  fprintf(stderr, "[orch] cannot exec %s: %s\n", cargv[0], strerror(errno));
+  _exit(127);
+}
+
+static bool alive(pid_t pid) {
+  if (pid <= 0) return false;
+  return waitpid(pid, nullptr, WNOHANG) == 0;
+}
+
+static void kill_group(pid_t pid) {
+  if (pid <= 0) return;
+  kill(-pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+}
+
+// seeds from the input directory, fed to whichever lane is idle
+class SeedQueue {
+public:
+  explicit SeedQueue(const std::string &dir) : dir_(dir) {}
+
+  // pick up files not seen before, in name order
+  void scan() {
+    DIR *d = opendir(dir_.c_str());
+    if (!d) return;
+    std::vector<std::string> fresh;
+    struct dirent *ent;
+    while ((ent = readdir(d)) != nullptr) {
+      if (ent->d_name[0] == '.') continue;
+      std::string name = ent->d_name;
+      if (seen_.count(name) || !is_file(dir_ + "/" + name)) continue;
+      seen_.insert(name);
+      fresh.push_back(name);
+    }
+    closedir(d);
+    std::sort(fresh.begin(), fresh.end());
+    std::lock_guard<std::mutex> lock(mu_);
+    for (auto &name : fresh) pending_.push_back(dir_ + "/" + name);
+  }
+
+  bool pop(std::string &path) {
+    std::lock_guard<std::mutex> lock(mu_);
+    if (pending_.empty()) return false;
+    path = pending_.front();
+    pending_.pop_front();
+    return true;
+  }
+
+  size_t size() {
+    std::lock_guard<std::mutex> lock(mu_);
+    return pending_.size();
+  }
+
+private:
+  std::string dir_;
+  std::set<std::string> seen_; // only touched by the scanning thread
+  std::mutex mu_;
+  std::deque<std::string> pending_;
+};
+
+struct Lane {
+  int id;
+  int cpu;
+  std::string dir;
+  std::string chan_dir;
+  std::string log_dir;
+  int shmid = -1;
+  pid_t fastgen = -1;
+  pid_t sched = -1;
+  uint32_t next_init_tid = 0; // next id in the lane's afl-slave/queue
+  uint32_t next_fifo_tid = 0; // next lane fifo/queue case to execute
+  std::deque<std::pair<std::string, uint32_t>> init_pending;
+  std::thread worker;
+  bool stopped = false;
+
+  std::atomic<uint64_t> execs{0};
+  std::atomic<uint64_t> init_execs{0};
+  std::atomic<uint64_t> timeouts{0};
+  std::atomic<uint64_t> busy_us{0};
+};
+
+static std::map<std::string, std::string> lane_vars(const Options &opt, const Lane &lane) {
+  std::map<std::string, std::string> vars;
+  vars["MARCO_MODE"] = "1";
+  vars["MARCO_LOG_DIR"] = lane.log_dir;
+  vars["MARCO_TREE_DIR"] = lane.dir;
+  vars["SYMCC_OUTPUT_DIR"] = lane.dir;
+  vars["MARCO_PIPE_DIR"] = lane.chan_dir;
+  vars["MARCO_SHM_ID"] = std::to_string(lane.shmid);
+  if (opt.channel) vars["MARCO_CHANNEL"] = lane.chan_dir + "/decisions.sock";
+  if (!opt.state_dir.empty()) vars["MARCO_STATE_DIR"] = opt.state_dir + "/lane" + std::to_string(lane.id);
+  return vars;
+}
+
+// hand one input seed to the lane, as the next entry of its afl-slave/queue
+static bool place_seed(Lane &lane, const std::string &seed) {
+  char name[64];
+  snprintf(name, sizeof(name), "id:%06u,orig", lane.next_init_tid);
+  std::string dst = lane.dir + "/afl-slave/queue/" + name;
+  if (!copy_file(seed, dst)) {
+    fprintf(stderr, "[orch] lane %d: cannot copy %s: %s\n", lane.id, seed.c_str(), strerror(errno));
+    return false;
+  }
+  lane.init_pending.push_back(std::make_pair(dst, lane.next_init_tid++));
+  return true;
+}
+
+static bool setup_lane(const Options &opt, Lane &lane) {
+  lane.dir = opt.out_dir + "/lane" + std::to_string(lane.id);
+  lane.chan_dir = lane.dir + "/chan";
+  lane.log_dir = lane.dir + "/logs";
+  const char *subdirs[] = {"afl-slave/queue", "fifo/queue", "tree0", "tree1", "tmp", "chan", "logs"};
+  for (const char *sub : subdirs)
+    if (!make_dirs(lane.dir + "/" + sub)) return false;
+  const char *fifos[] = {"pcpipe", "myfifo", "wp2"};
+  for (const char *f : fifos) {
+    std::string path = lane.chan_dir + "/" + f;
+    unlink(path.c_str());
+    if (mkfifo(path.c_str(), 0666) < 0) {
+      fprintf(stderr, "[orch] cannot create %s: %s\n", path.c_str(), strerror(errno));
+      return false;
+    }
+  }
+  lane.shmid = shmget(IPC_PRIVATE, UNION_TABLE_SIZE, IPC_CREAT | SHM_NORESERVE | 0600);
+  if (lane.shmid < 0) {
+    fprintf(stderr, "[orch] lane %d: cannot create union table: %s\n", lane.id, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+static bool start_lane(const Options &opt, Lane &lane) {
+  auto env = child_env(lane_vars(opt, lane));
+  // FastGen first: it opens the FIFOs the scheduler then attaches to
+  std::vector<std::string> fg = {opt.fastgen, "--sync_afl", "-i", lane.dir + "/afl-slave/queue",
+                                 "-o", lane.dir, "-t", opt.target, "-b", "1", "-f", "1", "-c", "10",
+                                 "-T", "60", "-M", "0", "--", opt.target, "@@"};
+  lane.fastgen = spawn(fg, env, lane.dir, lane.log_dir + "/fastgen.log", -1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(STARTUP_DELAY_MS));
+  std::vector<std::string> sc = {"/usr/bin/env", "python3", opt.scheduler};
+  sc.insert(sc.end(), opt.sched_args.begin(), opt.sched_args.end());
+  lane.sched = spawn(sc, env, lane.dir, lane.log_dir + "/scheduler.log", -1);
+  std::this_thread::sleep_for(std::chrono::milliseconds(STARTUP_DELAY_MS));
+  if (!alive(lane.fastgen) || !alive(lane.sched)) {
+    fprintf(stderr, "[orch] lane %d failed to start, see %s\n", lane.id, lane.log_dir.c_str());
+    return false;
+  }
+  return true;
+}
+
+// run fgtest + symqemu on one seed, pinned to the lane's CPU; false on timeout
+static bool exec_seed(const Options &opt, Lane &lane, const std::string &seed, uint32_t tid) {
+  auto vars = lane_vars(opt, lane);
+  vars["SYMCC_INPUT_FILE"] = seed;
+  vars["TAINT_OPTIONS"] = "taint_file=" + seed + " inputid=" + std::to_string(tid);
+  std::vector<std::string> argv = {opt.fgtest, opt.qemu, opt.target, seed};
+  uint64_t start = now_us();
+  pid_t pid = spawn(argv, child_env(vars), lane.dir, lane.log_dir + "/symfit.log", lane.cpu);
+  bool done = false;
+  while (!done) {
+    int status;
+    pid_t r = waitpid(pid, &status, WNOHANG);
+    if (r == pid || (r < 0 && errno != EINTR)) {
+      done = true;
+      break;
+    }
+    if (now_us() - start > (uint64_t)opt.exec_timeout * 1000000 || !running) break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+  }
+  if (!done) {
+    kill_group(pid);
+    lane.timeouts++;
+  }
+  lane.busy_us += now_us() - start;
+  lane.execs++;
+  return done;
+}
+
+// next case the lane's FastGen wrote to its fifo/queue, skipping over gaps
+static bool next_fifo_case(Lane &lane, std::string &path, uint32_t &tid) {
+  std::string queue = lane.dir + "/fifo/queue";
+  char name[32];
+  snprintf(name, sizeof(name), "id:%06u", lane.next_fifo_tid);
+  if (is_file(queue + "/" + name)) {
+    path = queue + "/" + name;
+    tid = lane.next_fifo_tid;
+    return true;
+  }
+  DIR *d = opendir(queue.c_str());
+  if (!d) return false;
+  long best = -1;
+  std::string best_name;
+  struct dirent *ent;
+  while ((ent = readdir(d)) != nullptr) {
+    long t = name_tid(ent->d_name);
+    if (t >= (long)lane.next_fifo_tid && (best < 0 || t < best)) {
+      best = t;
+      best_name = ent->d_name;
+    }
+  }
+  closedir(d);
+  if (best < 0) return false;
+  path = queue + "/" + best_name;
+  tid = best;
+  return true;
+}
+
+static void lane_loop(const Options &opt, Lane &lane, SeedQueue &seeds) {
+  while (running) {
+    std::string path;
+    uint32_t tid;
+    if (next_fifo_case(lane, path, tid)) {
+      exec_seed(opt, lane, path, tid);
+      lane.next_fifo_tid = tid + 1;
+    } else if (!lane.init_pending.empty() || (seeds.pop(path) && place_seed(lane, path))) {
+      auto job = lane.init_pending.front();
+      lane.init_pending.pop_front();
+      exec_seed(opt, lane, job.first, job.second);
+      lane.init_execs++;
+      // same placeholder the serial script leaves for seeds without branches
+      char tree[32];
+      snprintf(tree, sizeof(tree), "/tree0/id:%06u", job.second);
+      std::string tree_path = lane.dir + tree;
+      if (!is_file(tree_path)) {
+        int fd = open(tree_path.c_str(), O_WRONLY | O_CREAT, 0644);
+        if (fd >= 0) close(fd);
+      }
+    } else {
+      std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_POLL_MS));
+    }
+    if (!alive(lane.fastgen) || !alive(lane.sched)) {
+      fprintf(stderr, "[orch] lane %d: %s stopped, see %s\n", lane.id,
+              alive(lane.fastgen) ? "scheduler" : "FastGen", lane.log_dir.c_str());
+      lane.stopped = true;
+      return;
+    }
+  }
+}
+
+static void report(std::vector<Lane*> &lanes, SeedQueue &seeds, std::vector<uint64_t> &last_execs,
+                   std::vector<uint64_t> &last_busy, double secs) {
+  uint64_t total = 0, total_delta = 0;
+  printf("[orch] %zu seeds queued\n", seeds.size());
+  for (size_t i = 0; i < lanes.size(); i++) {
+    Lane &l = *lanes[i];
+    uint64_t execs = l.execs, busy = l.busy_us;
+    uint64_t delta = execs - last_execs[i];
+    printf("[orch]   lane %2d cpu %3d: %8lu execs (%lu seeds, %lu fifo), %6.2f execs/s, %5.1f%% busy, %lu timeouts%s\n",
+           l.id, l.cpu, (unsigned long)execs, (unsigned long)l.init_execs.load(),
+           (unsigned long)(execs - l.init_execs), delta / secs,
+           100.0 * (busy - last_busy[i]) / (secs * 1e6), (unsigned long)l.timeouts.load(),
+           l.stopped ? ", stopped" : "");
+    total += execs;
+    total_delta += delta;
+    last_execs[i] = execs;
+    last_busy[i] = busy;
+  }
+  printf("[orch]   total: %lu execs, %.2f execs/s\n", (unsigned long)total, total_delta / secs);
+  fflush(stdout);
+}
+
+static void usage(const char *prog) {
+  fprintf(stderr,
+          "usage: %s -j <workers> -o <out> -i <seeds> -t <target>\n"
+          "          --fastgen <bin> --scheduler <main-MS.py> --fgtest <bin> --qemu <bin>\n"
+          "          [-c first_cpu] [-T exec_timeout] [-R max_runtime] [-r report_secs]\n"
+          "          [-s state_dir] [-x] [-- scheduler args]\n", prog);
+}
+
+int main(int argc, char **argv) {
+  Options opt;
+  for (int i = 1; i < argc; i++) {
+    std::string a = argv[i];
+    bool has = i + 1 < argc;
+    if (a == "--") {
+      opt.sched_args.assign(argv + i + 1, argv + argc);
+      break;
+    }
+    if (a == "-x") opt.channel = true;
+    else if (a == "-j" && has) opt.workers = atoi(argv[++i]);
+    else if (a == "-c" && has) opt.first_cpu = atoi(argv[++i]);
+    else if (a == "-T" && has) opt.exec_timeout = atoi(argv[++i]);
+    else if (a == "-R" && has) opt.max_runtime = atoi(argv[++i]);
+    else if (a == "-r" && has) opt.report_secs = atoi(argv[++i]);
+    else if (a == "-o" && has) opt.out_dir = argv[++i];
+    else if (a == "-i" && has) opt.seed_dir = argv[++i];
+    else if (a == "-t" && has) opt.target = argv[++i];
+    else if (a == "-s" && has) opt.state_dir = argv[++i];
+    else if (a == "--fastgen" && has) opt.fastgen = argv[++i];
+    else if (a == "--scheduler" && has) opt.scheduler = argv[++i];
+    else if (a == "--fgtest" && has) opt.fgtest = argv[++i];
+    else if (a == "--qemu" && has) opt.qemu = argv[++i];
+    else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (opt.workers < 1 || opt.out_dir.empty() || opt.seed_dir.empty() || opt.target.empty() ||
+      opt.fastgen.empty() || opt.scheduler.empty() || opt.fgtest.empty() || opt.qemu.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (opt.sched_args.empty()) opt.sched_args = {"-d", "0", "-m", "2"};
+  if (opt.report_secs < 1) opt.report_secs = 1;
+  if (!make_dirs(opt.out_dir)) return 1;
+  std::string *paths[] = {&opt.out_dir, &opt.seed_dir, &opt.target, &opt.fastgen,
+                          &opt.scheduler, &opt.fgtest, &opt.qemu, &opt.state_dir};
+  for (std::string *path : paths) *path = absolute(*path);
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  long ncpu = sysconf(_SC_NPROCESSORS_ONLN);
+  if (ncpu < 1) ncpu = 1;
+  if (opt.workers > ncpu)
+    printf("[orch] %d workers on %ld CPUs, some share a core\n", opt.workers, ncpu);
+
+  SeedQueue seeds(opt.seed_dir);
+  seeds.scan();
+
+  std::vector<Lane*> lanes;
+  bool ok = true;
+  for (int i = 0; i < opt.workers && ok; i++) {
+    Lane *lane = new Lane();
+    lane->id = i;
+    lane->cpu = (opt.first_cpu + i) % ncpu;
+    lanes.push_back(lane);
+    ok = setup_lane(opt, *lane);
+    // FastGen wants something in its input queue when it starts
+    std::string seed;
+    if (ok && seeds.pop(seed)) place_seed(*lane, seed);
+  }
+  for (size_t i = 0; i < lanes.size() && ok; i++)
+    ok = start_lane(opt, *lanes[i]);
+
+  if (ok) {
+    printf("[orch] %d lanes up under %s\n", opt.workers, opt.out_dir.c_str());
+    for (Lane *lane : lanes)
+      lane->worker = std::thread(lane_loop, std::cref(opt), std::ref(*lane), std::ref(seeds));
+
+    std::vector<uint64_t> last_execs(lanes.size(), 0), last_busy(lanes.size(), 0);
+    uint64_t start = now_us(), last_report = start, last_scan = start;
+    while (running) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(IDLE_POLL_MS));
+      uint64_t now = now_us();
+      if (now - last_scan >= SEED_SCAN_MS * 1000ULL) {
+        seeds.scan();
+        last_scan = now;
+      }
+      if (now - last_report >= (uint64_t)opt.report_secs * 1000000) {
+        report(lanes, seeds, last_execs, last_busy, (now - last_report) / 1e6);
+        last_report = now;
+      }
+      if (opt.max_runtime > 0 && now - start >= (uint64_t)opt.max_runtime * 1000000) {
+        printf("[orch] max runtime (%ds) reached\n", opt.max_runtime);
+        running = false;
+      }
+      bool any = false;
+      for (Lane *lane : lanes) any |= !lane->stopped;
+      if (!any) {
+        printf("[orch] all lanes stopped\n");
+        running = false;
+      }
+    }
+    report(lanes, seeds, last_execs, last_busy, std::max(1e-6, (now_us() - last_report) / 1e6));
+  }
+
+  running = false;
+  for (Lane *lane : lanes) {
+    if (lane->worker.joinable()) lane->worker.join();
+    kill_group(lane->sched);
+    kill_group(lane->fastgen);
+    if (lane->shmid >= 0) shmctl(lane->shmid, IPC_RMID, nullptr);
+    delete lane;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,171 @@
+#!/usr/bin/python3
+# Scheduler side of the FastGen decision channel; the layout mirrors
+# cpp_core/decision_channel.h, keep both in sync.
+#
+# FastGen listens on the MARCO_CHANNEL unix socket and hands over a memfd
+# holding two SPSC rings plus one eventfd per direction. Edge records and
+# END* tokens come in on the edge ring, scheduling decisions go back on the
+# decision ring.
+import ctypes
+import mmap
+import os
+import select
+import socket
+import time
+
+CHAN_MAGIC = 0x314e4843
+CHAN_VERSION = 1
+CHAN_EDGE_SLOTS = 1 << 14
+CHAN_DECISION_SLOTS = 1 << 6
+CHAN_MAX_EXTRA = 10
+
+# record kinds on the edge ring
+CHAN_EDGE = 0
+CHAN_END = 1
+CHAN_ENDNEW = 2
+CHAN_ENDDUP = 3
+CHAN_ENDUNSAT = 4
+TOKENS = {CHAN_END: "END", CHAN_ENDNEW: "ENDNEW", CHAN_ENDDUP: "ENDDUP", CHAN_ENDUNSAT: "ENDUNSAT"}
+
+# edge flags
+CHAN_EDGE_NOPC = 0x1
+CHAN_EDGE_FORCED = 0x2
+
+
+class ChanEdgeRecord(ctypes.Structure):
+    _fields_ = [("kind", ctypes.c_uint32),
+                ("flags", ctypes.c_uint32),
+                ("pc", ctypes.c_uint64),
+                ("ctx", ctypes.c_uint64),
+                ("tkdir", ctypes.c_uint32),
+                ("label", ctypes.c_uint32),
+                ("inputid", ctypes.c_uint32),
+                ("queueid", ctypes.c_uint32),
+                ("is_good", ctypes.c_uint32),
+                ("depth", ctypes.c_uint32),
+                ("pp_hash", ctypes.c_uint64),
+                ("nextra", ctypes.c_uint32),
+                ("pad", ctypes.c_uint32),
+                ("extra", ctypes.c_uint32 * (CHAN_MAX_EXTRA * 2))]
+
+
+class ChanDecisionRecord(ctypes.Structure):
+    _fields_ = [("qid", ctypes.c_uint32),
+                ("tid", ctypes.c_uint32),
+                ("nid", ctypes.c_uint32),
+                ("conc_dir", ctypes.c_uint32),
+                ("plen", ctypes.c_uint32),
+                ("nextra", ctypes.c_uint32),
+                ("pp_hash", ctypes.c_uint64),
+                ("extra", ctypes.c_uint32 * (CHAN_MAX_EXTRA * 2))]
+
+
+class ChanRingCtl(ctypes.Structure):
+    _fields_ = [("head", ctypes.c_uint64),
+                ("pad0", ctypes.c_uint8 * 56),
+                ("tail", ctypes.c_uint64),
+                ("waiting", ctypes.c_uint32),
+                ("pad1", ctypes.c_uint8 * 52)]
+
+
+class ChanHeader(ctypes.Structure):
+    _fields_ = [("magic", ctypes.c_uint32),
+                ("version", ctypes.c_uint32),
+                ("edge_slots", ctypes.c_uint32),
+                ("decision_slots", ctypes.c_uint32),
+                ("edge_size", ctypes.c_uint32),
+                ("decision_size", ctypes.c_uint32),
+                ("pad", ctypes.c_uint8 * 40),
+                ("edges", ChanRingCtl),
+                ("decisions", ChanRingCtl)]
+
+
+EDGE_SIZE = ctypes.sizeof(ChanEdgeRecord)
+DECISION_SIZE = ctypes.sizeof(ChanDecisionRecord)
+CHAN_EDGE_OFFSET = 4096
+CHAN_DECISION_OFFSET = CHAN_EDGE_OFFSET + CHAN_EDGE_SLOTS * EDGE_SIZE
+CHAN_SEGMENT_SIZE = CHAN_DECISION_OFFSET + CHAN_DECISION_SLOTS * DECISION_SIZE
+
+
+def pc_ids(rec):
+    ''' PC_ids text of an edge record, as it would have come over /tmp/pcpipe '''
+    if rec.flags & CHAN_EDGE_NOPC:
+        return "none"
+    if rec.flags & CHAN_EDGE_FORCED:
+        return "1-%d-%d-0-0-0-%d-0#" % (rec.queueid, rec.pp_hash, rec.inputid)
+    extra = "".join("%d,%d." % (rec.extra[2 * i], rec.extra[2 * i + 1]) for i in range(min(rec.nextra, CHAN_MAX_EXTRA)))
+    return "%d-%d-%d-%d#%s" % (rec.is_good, rec.queueid, rec.pp_hash, rec.depth, extra)
+
+
+class DecisionChannel():
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        # FastGen may not be listening yet
+        while True:
+            try:
+                self.sock.connect(path)
+                break
+            except (FileNotFoundError, ConnectionRefusedError):
+                time.sleep(0.01)
+
+        fds = []
+        msg, ancdata, flags, addr = self.sock.recvmsg(1, socket.CMSG_LEN(3 * ctypes.sizeof(ctypes.c_int)))
+        for level, ctype, data in ancdata:
+            if level == socket.SOL_SOCKET and ctype == socket.SCM_RIGHTS:
+                fds += list(memoryview(data).cast("i"))
+        if len(fds) != 3:
+            raise RuntimeError("no descriptors from %s" % path)
+        memfd, self.efd_edges, self.efd_decisions = fds
+
+        self.mm = mmap.mmap(memfd, CHAN_SEGMENT_SIZE)
+        os.close(memfd)
+        self.hdr = ChanHeader.from_buffer(self.mm)
+        if (self.hdr.magic != CHAN_MAGIC or self.hdr.version != CHAN_VERSION or
+                self.hdr.edge_size != EDGE_SIZE or self.hdr.decision_size != DECISION_SIZE):
+            raise RuntimeError("channel layout mismatch")
+
+    def close(self):
+        self.hdr = None
+        self.mm.close()
+        os.close(self.efd_edges)
+        os.close(self.efd_decisions)
+        self.sock.close()
+
+    def recv_edge(self):
+        ''' next edge record or END* token; blocks, None once FastGen is gone '''
+        ring = self.hdr.edges
+        tail = ring.tail
+        while ring.head == tail:
+            ring.waiting = 1
+            if ring.head == tail:
+                readable, _, _ = select.select([self.efd_edges, self.sock], [], [])
+                if self.efd_edges in readable:
+                    os.read(self.efd_edges, 8)
+                elif ring.head == tail:
+                    ring.waiting = 0
+                    return None
+            ring.waiting = 0
+        rec = ChanEdgeRecord.from_buffer_copy(self.mm, CHAN_EDGE_OFFSET + (tail & (CHAN_EDGE_SLOTS - 1)) * EDGE_SIZE)
+        ring.tail = tail + 1
+        return rec
+
+    def send_decision(self, qid, tid, nid, conc_dir, plen, pp_hash, extra):
+        ''' extra is the scheduler's "label,dir." list '''
+        rec = ChanDecisionRecord(qid, tid, nid, conc_dir, plen, 0, pp_hash)
+        for entry in extra.split("."):
+            if "," not in entry or rec.nextra == CHAN_MAX_EXTRA:
+                continue
+            label, direction = entry.split(",", 1)
+            rec.extra[2 * rec.nextra] = int(label)
+            rec.extra[2 * rec.nextra + 1] = int(direction)
+            rec.nextra += 1
+
+        ring = self.hdr.decisions
+        head = ring.head
+        while head - ring.tail >= CHAN_DECISION_SLOTS:
+            time.sleep(0.0001)
+        off = CHAN_DECISION_OFFSET + (head & (CHAN_DECISION_SLOTS - 1)) * DECISION_SIZE
+        self.mm[off:off + DECISION_SIZE] = bytes(rec)
+        ring.head = head + 1
+        # FastGen blocks on every decision, always wake it up
+        os.write(self.efd_decisions, (1).to_bytes(8, "little"))
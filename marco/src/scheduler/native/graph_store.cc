@@ -0,0 +1,486 @@
+#include "graph_store.h"
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <algorithm>
+
+#define STORE_MAGIC 0x3150524753637a4dULL // "MzScGRP1"
+#define STORE_VERSION 2
+#define LOG_HEADER_SIZE 64
+// records per log growth step (2.5MB)
+#define LOG_CHUNK (1 << 16)
+#define SNAP_HEADER_SIZE 256
+#define SNAP_ALIGN 64
+// verifier read size
+#define VERIFY_CHUNK (1 << 20)
+
+enum { VERIFY_RUNNING, VERIFY_OK, VERIFY_BAD };
+
+// snapshot sections, in file order
+enum {
+  SEC_NODES,
+  SEC_EDGES,
+  SEC_EDGE_SLOTS,
+  SEC_BRANCH_SLOTS,
+  SEC_DECISIONS,
+  SEC_DIRTY,
+  SEC_COUNT
+};
+
+static StoreTable StoreImage::* const sections[SEC_COUNT] = {
+  &StoreImage::nodes, &StoreImage::edges, &StoreImage::edge_slots,
+  &StoreImage::branch_slots, &StoreImage::decisions, &StoreImage::dirty,
+};
+
+static const uint64_t entry_size[SEC_COUNT] = {
+  sizeof(StoreNode), sizeof(StoreEdge), sizeof(StoreEdgeSlot),
+  sizeof(StoreBranchSlot), sizeof(uint32_t), sizeof(uint32_t),
+};
+
+struct SnapHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t pad;
+  uint64_t seq;
+  uint64_t counts[SEC_COUNT];
+  uint64_t branches;
+  uint64_t round;
+  uint64_t epoch;
+  uint64_t unvisited;
+  uint64_t payload_check; // over everything after the header block
+  uint64_t header_check;  // over the fields above
+};
+
+struct LogHeader {
+  uint64_t magic;
+  uint32_t version;
+  uint32_t pad;
+  uint64_t seq;
+  uint64_t header_check;
+};
+
+static inline uint64_t mix64(uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+static uint64_t store_hash(const void *data, size_t len, uint64_t seed) {
+  const uint8_t *p = (const uint8_t*)data;
+  uint64_t h = mix64(seed ^ (len * 0x9e3779b97f4a7c15ULL));
+  while (len >= 8) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    h = mix64(h ^ w) + 0x9e3779b97f4a7c15ULL;
+    p += 8;
+    len -= 8;
+  }
+  uint64_t w = 0;
+  memcpy(&w, p, len);
+  return mix64(h ^ w ^ ((uint64_t)len << 56));
+}
+
+static uint32_t record_check(const StoreRecord &rec) {
+  StoreRecord tmp = rec;
+  tmp.check = 0;
+  uint32_t c = (uint32_t)store_hash(&tmp, sizeof(tmp), STORE_MAGIC);
+  return c ? c : 1;
+}
+
+// store_hash over a byte stream fed in pieces of any size
+class PayloadHash {
+public:
+  PayloadHash() : h_(1), len_(0), ntail_(0) {}
+
+  void update(const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t*)data;
+    len_ += len;
+    if (ntail_) {
+      size_t n = std::min<size_t>(len, 8 - ntail_);
+      memcpy(tail_ + ntail_, p, n);
+      ntail_ += n;
+      p += n;
+      len -= n;
+      if (ntail_ < 8) return;
+      word(tail_);
+      ntail_ = 0;
+    }
+    while (len >= 8) {
+      word(p);
+      p += 8;
+      len -= 8;
+    }
+    memcpy(tail_, p, len);
+    ntail_ = len;
+  }
+
+  uint64_t digest() const {
+    uint64_t w = 0;
+    memcpy(&w, tail_, ntail_);
+    return mix64(h_ ^ w ^ (len_ << 8));
+  }
+
+private:
+  void word(const uint8_t *p) {
+    uint64_t w;
+    memcpy(&w, p, 8);
+    h_ = mix64(h_ ^ w) + 0x9e3779b97f4a7c15ULL;
+  }
+
+  uint64_t h_;
+  uint64_t len_;
+  uint8_t tail_[8];
+  size_t ntail_;
+};
+
+// section offsets for the counts in a header, returns the file size
+static uint64_t snap_layout(const uint64_t *counts, uint64_t *offsets) {
+  uint64_t off = SNAP_HEADER_SIZE;
+  for (int i = 0; i < SEC_COUNT; i++) {
+    off = (off + SNAP_ALIGN - 1) & ~(uint64_t)(SNAP_ALIGN - 1);
+    offsets[i] = off;
+    off += counts[i] * entry_size[i];
+  }
+  return off;
+}
+
+static bool write_all(int fd, const void *buf, size_t len) {
+  const char *p = (const char*)buf;
+  while (len > 0) {
+    ssize_t n = write(fd, p, len);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return false;
+    }
+    p += n;
+    len -= n;
+  }
+  return true;
+}
+
+// make a rename durable
+static void sync_dir(const std::string &dir) {
+  int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+  if (fd < 0) return;
+  fsync(fd);
+  close(fd);
+}
+
+GraphStore::GraphStore()
+  : seq_(0), snap_map_(nullptr), snap_size_(0), verify_state_(VERIFY_OK),
+    log_fd_(-1), log_map_(nullptr), log_size_(0), log_(nullptr), log_count_(0), log_cap_(0) {
+  memset(&image_, 0, sizeof(image_));
+}
+
+GraphStore::~GraphStore() {
+  if (verifier_.joinable()) verifier_.join();
+  unmap_snapshot();
+  unmap_log();
+}
+
+void GraphStore::unmap_snapshot() {
+  if (snap_map_) munmap(snap_map_, snap_size_);
+  snap_map_ = nullptr;
+  snap_size_ = 0;
+  memset(&image_, 0, sizeof(image_));
+}
+
+void GraphStore::unmap_log() {
+  if (log_map_) munmap(log_map_, log_size_);
+  if (log_fd_ >= 0) close(log_fd_);
+  log_map_ = nullptr;
+  log_size_ = 0;
+  log_ = nullptr;
+  log_fd_ = -1;
+  log_count_ = log_cap_ = 0;
+}
+
+bool GraphStore::open(const std::string &dir) {
+  if (mkdir(dir.c_str(), 0755) < 0 && errno != EEXIST) {
+    fprintf(stderr, "[graph_store] cannot create %s: %s\n", dir.c_str(), strerror(errno));
+    return false;
+  }
+  dir_ = dir;
+  seq_ = 0;
+  std::string snap = dir_ + "/graph.snap";
+  StoreImage img;
+  void *map;
+  size_t size;
+  uint64_t check;
+  if (!map_snapshot(snap, img, &map, &size, &check)) {
+    // keep the evidence, start over; the log is a delta against it and goes too
+    rename(snap.c_str(), (snap + ".bad").c_str());
+    fprintf(stderr, "[graph_store] %s is corrupt, moved to graph.snap.bad\n", snap.c_str());
+  } else if (map) {
+    snap_map_ = map;
+    snap_size_ = size;
+    image_ = img;
+    seq_ = img.seq;
+    // the header and the layout check out; the payload is checked off the
+    // reopen path, against the file rather than the mapping the engine writes to
+    verify_state_ = VERIFY_RUNNING;
+    verifier_ = std::thread(&GraphStore::verify, this, snap, (uint64_t)size, check);
+  }
+  return map_log();
+}
+
+// maps a snapshot and points img at its tables; true with *map null if there
+// is none, false if it is not a valid snapshot
+bool GraphStore::map_snapshot(const std::string &path, StoreImage &img, void **map,
+                              size_t *size, uint64_t *check) {
+  memset(&img, 0, sizeof(img));
+  *map = nullptr;
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return errno == ENOENT;
+  struct stat st;
+  if (fstat(fd, &st) < 0 || (size_t)st.st_size < SNAP_HEADER_SIZE) {
+    close(fd);
+    return false;
+  }
+  // private and writable: the engine updates the tables in place
+  void *m = mmap(nullptr, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED) return false;
+
+  const SnapHeader *hdr = (const SnapHeader*)m;
+  uint64_t offsets[SEC_COUNT];
+  bool ok = hdr->magic == STORE_MAGIC && hdr->version == STORE_VERSION &&
+            hdr->header_check == store_hash(hdr, offsetof(SnapHeader, header_check), STORE_MAGIC);
+  for (int i = 0; ok && i < SEC_COUNT; i++)
+    ok = hdr->counts[i] < (1ULL << 32);
+  if (!ok || snap_layout(hdr->counts, offsets) != (uint64_t)st.st_size) {
+    munmap(m, st.st_size);
+    return false;
+  }
+  for (int i = 0; i < SEC_COUNT; i++) {
+    StoreTable &t = img.*sections[i];
+    t.data = (char*)m + offsets[i];
+    t.count = hdr->counts[i];
+  }
+  img.seq = hdr->seq;
+  img.branches = hdr->branches;
+  img.round = hdr->round;
+  img.epoch = hdr->epoch;
+  img.unvisited = hdr->unvisited;
+  *map = m;
+  *size = st.st_size;
+  *check = hdr->payload_check;
+  return true;
+}
+
+void GraphStore::verify(std::string path, uint64_t size, uint64_t check) {
+  PayloadHash hash;
+  bool ok = false;
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    std::string buf(VERIFY_CHUNK, '\0');
+    uint64_t off = SNAP_HEADER_SIZE;
+    while (off < size) {
+      ssize_t n = pread(fd, &buf[0], std::min<uint64_t>(VERIFY_CHUNK, size - off), off);
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) break;
+      hash.update(buf.data(), n);
+      off += n;
+    }
+    close(fd);
+    ok = off == size && hash.digest() == check;
+  }
+  if (ok) {
+    verify_state_ = VERIFY_OK;
+    return;
+  }
+  rename(path.c_str(), (path + ".bad").c_str());
+  fprintf(stderr, "[graph_store] %s is corrupt, moved to graph.snap.bad; "
+                  "its state will not be snapshotted again\n", path.c_str());
+  verify_state_ = VERIFY_BAD;
+}
+
+bool GraphStore::verified() {
+  if (verifier_.joinable()) verifier_.join();
+  return verify_state_ != VERIFY_BAD;
+}
+
+static void make_log_header(LogHeader &hdr, uint64_t seq) {
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = STORE_MAGIC;
+  hdr.version = STORE_VERSION;
+  hdr.seq = seq;
+  hdr.header_check = store_hash(&hdr, offsetof(LogHeader, header_check), STORE_MAGIC);
+}
+
+bool GraphStore::map_log() {
+  std::string path = dir_ + "/graph.log";
+  int fd = ::open(path.c_str(), O_RDWR);
+  if (fd >= 0) {
+    LogHeader hdr, want;
+    make_log_header(want, seq_);
+    // a log that does not extend the current snapshot is already folded into it
+    if (pread(fd, &hdr, sizeof(hdr), 0) != (ssize_t)sizeof(hdr) || memcmp(&hdr, &want, sizeof(hdr)) != 0) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  if (fd < 0) {
+    std::string tmp = path + ".tmp";
+    fd = ::open(tmp.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+      fprintf(stderr, "[graph_store] cannot create %s: %s\n", tmp.c_str(), strerror(errno));
+      return false;
+    }
+    char buf[LOG_HEADER_SIZE] = {0};
+    LogHeader hdr;
+    make_log_header(hdr, seq_);
+    memcpy(buf, &hdr, sizeof(hdr));
+    if (!write_all(fd, buf, sizeof(buf)) || fsync(fd) < 0 || rename(tmp.c_str(), path.c_str()) < 0) {
+      fprintf(stderr, "[graph_store] cannot start %s: %s\n", path.c_str(), strerror(errno));
+      close(fd);
+      return false;
+    }
+    sync_dir(dir_);
+  }
+  log_fd_ = fd;
+
+  struct stat st;
+  if (fstat(fd, &st) < 0) {
+    unmap_log();
+    return false;
+  }
+  log_cap_ = st.st_size > LOG_HEADER_SIZE ? (st.st_size - LOG_HEADER_SIZE) / sizeof(StoreRecord) : 0;
+  if (log_cap_ == 0) {
+    if (!grow_log()) return false;
+  } else {
+    log_size_ = LOG_HEADER_SIZE + log_cap_ * sizeof(StoreRecord);
+    log_map_ = mmap(nullptr, log_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (log_map_ == MAP_FAILED) {
+      log_map_ = nullptr;
+      unmap_log();
+      return false;
+    }
+    log_ = (StoreRecord*)((char*)log_map_ + LOG_HEADER_SIZE);
+  }
+
+  // records are appended in order, the first empty or torn one ends the log
+  log_count_ = 0;
+  while (log_count_ < log_cap_ && log_[log_count_].op != 0 &&
+         log_[log_count_].check == record_check(log_[log_count_]))
+    log_count_++;
+  if (log_count_ < log_cap_)
+    memset(&log_[log_count_], 0, sizeof(StoreRecord));
+  return true;
+}
+
+bool GraphStore::grow_log() {
+  uint64_t cap = log_cap_ + LOG_CHUNK;
+  size_t size = LOG_HEADER_SIZE + cap * sizeof(StoreRecord);
+  if (ftruncate(log_fd_, size) < 0) {
+    fprintf(stderr, "[graph_store] cannot grow log: %s\n", strerror(errno));
+    return false;
+  }
+  void *map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, log_fd_, 0);
+  if (map == MAP_FAILED) {
+    fprintf(stderr, "[graph_store] cannot map log: %s\n", strerror(errno));
+    return false;
+  }
+  if (log_map_) munmap(log_map_, log_size_);
+  log_map_ = map;
+  log_size_ = size;
+  log_ = (StoreRecord*)((char*)map + LOG_HEADER_SIZE);
+  log_cap_ = cap;
+  return true;
+}
+
+void GraphStore::append(StoreRecord &rec) {
+  if (!log_) return;
+  if (log_count_ == log_cap_ && !grow_log()) return;
+  rec.check = 0;
+  uint32_t check = record_check(rec);
+  StoreRecord *dst = &log_[log_count_++];
+  memcpy(dst, &rec, sizeof(rec));
+  // the checksum goes in last, a record cut short by a kill stays invalid
+  __atomic_store_n(&dst->check, check, __ATOMIC_RELEASE);
+}
+
+bool GraphStore::snapshot(const StoreImage &img) {
+  if (!log_) return false;
+  if (!verified()) return false;
+  SnapHeader hdr;
+  memset(&hdr, 0, sizeof(hdr));
+  hdr.magic = STORE_MAGIC;
+  hdr.version = STORE_VERSION;
+  hdr.seq = seq_ + 1;
+  for (int i = 0; i < SEC_COUNT; i++) {
+    const StoreTable &t = img.*sections[i];
+    hdr.counts[i] = t.count + t.extra_count;
+  }
+  hdr.branches = img.branches;
+  hdr.round = img.round;
+  hdr.epoch = img.epoch;
+  hdr.unvisited = img.unvisited;
+  uint64_t offsets[SEC_COUNT];
+  uint64_t size = snap_layout(hdr.counts, offsets);
+
+  std::string path = dir_ + "/graph.snap";
+  std::string tmp = path + ".tmp";
+  int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    fprintf(stderr, "[graph_store] cannot create %s: %s\n", tmp.c_str(), strerror(errno));
+    return false;
+  }
+  static const char zero[SNAP_HEADER_SIZE] = {0};
+  PayloadHash hash;
+  uint64_t off = SNAP_HEADER_SIZE;
+  // the header goes in last, once the payload checksum is known
+  bool ok = write_all(fd, zero, SNAP_HEADER_SIZE);
+  for (int i = 0; ok && i < SEC_COUNT; i++) {
+    const StoreTable &t = img.*sections[i];
+    const void *parts[2] = {t.data, t.extra};
+    uint64_t counts[2] = {t.count, t.extra_count};
+    ok = write_all(fd, zero, offsets[i] - off);
+    hash.update(zero, offsets[i] - off);
+    off = offsets[i];
+    for (int j = 0; ok && j < 2; j++) {
+      uint64_t len = counts[j] * entry_size[i];
+      if (!len) continue;
+      ok = write_all(fd, parts[j], len);
+      hash.update(parts[j], len);
+      off += len;
+    }
+  }
+  hdr.payload_check = hash.digest();
+  hdr.header_check = store_hash(&hdr, offsetof(SnapHeader, header_check), STORE_MAGIC);
+  ok = ok && off == size && pwrite(fd, &hdr, sizeof(hdr), 0) == (ssize_t)sizeof(hdr) &&
+       fsync(fd) == 0;
+  close(fd);
+  if (!ok || rename(tmp.c_str(), path.c_str()) < 0) {
+    fprintf(stderr, "[graph_store] snapshot failed: %s\n", strerror(errno));
+    unlink(tmp.c_str());
+    return false;
+  }
+  sync_dir(dir_);
+
+  // the new snapshot is durable; the old log no longer matches it
+  seq_ = hdr.seq;
+  StoreImage fresh;
+  void *map;
+  uint64_t check;
+  size_t map_size;
+  if (map_snapshot(path, fresh, &map, &map_size, &check) && map) {
+    unmap_snapshot();
+    snap_map_ = map;
+    snap_size_ = map_size;
+    image_ = fresh;
+  } else {
+    // the caller stays on its current tables, which hold the same state
+    fprintf(stderr, "[graph_store] cannot map %s: %s\n", path.c_str(), strerror(errno));
+  }
+  unmap_log();
+  return map_log();
+}
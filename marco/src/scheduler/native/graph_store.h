@@ -0,0 +1,175 @@
+#ifndef GRAPH_STORE_H_
+#define GRAPH_STORE_H_
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include <thread>
+
+// On-disk state of the native scheduling engine, kept in one directory:
+//
+//   graph.snap  full snapshot of the engine tables: nodes, edges (with their
+//               adjacency lists), the edge and branch key indexes, the ceq
+//               decision list and the pending dirty list, with a checksum
+//               over the whole payload
+//   graph.log   append-only mutation log since that snapshot, one
+//               self-checksummed record per engine call
+//
+// The snapshot is the engine's own memory layout, so reopening it is an
+// mmap: the engine works on a private writable mapping of the tables and
+// keeps whatever it adds after them in memory, and nothing is rebuilt. The
+// payload checksum is verified by a background thread on a separate read of
+// the file; a mismatch moves the snapshot to graph.snap.bad (the next start
+// begins fresh) and no further snapshot is written from its contents.
+//
+// The log is written through a shared mapping, so every record is in the
+// page cache as soon as the call returns and survives the scheduler being
+// killed (OOM, timeout). Snapshots are written to a temporary file, fsync'd
+// and renamed over the old one; a new log is started only after that, so a
+// crash at any point leaves a snapshot and a log that belong together.
+//
+// Reopening maps the snapshot and replays the log up to the first torn
+// record; the log never holds more than one snapshot interval of work.
+
+#define STORE_NONE 0xffffffffU
+
+struct StoreNode {
+  uint64_t addr;         // node key
+  uint64_t ctx;
+  double score;          // last sample or aggregate
+  uint32_t parent;       // branch node of an outcome node
+  uint32_t parent_edge;  // edge parent -> this node
+  uint32_t first_out;    // out-edge list, through StoreEdge::next_out
+  uint32_t first_in;     // in-edge list, through StoreEdge::next_in
+  uint32_t visit;
+  uint32_t attempt;
+  uint32_t win;
+  uint32_t dirty_round;  // round in which the node was last queued as dirty
+  uint32_t update_round; // round of the updates counted below
+  uint32_t rank_round;
+  uint32_t actionable;   // epoch in which the node was last made actionable
+  uint8_t updates;
+  uint8_t outcome;
+  uint8_t dir;
+  uint8_t status;
+};
+
+struct StoreEdge {
+  uint32_t beg;
+  uint32_t end;
+  uint32_t next_out;
+  uint32_t next_in;
+  double weight;
+  double p; // last sampled transition probability
+};
+
+// open addressing slots of the key indexes, id STORE_NONE when empty
+struct StoreEdgeSlot {
+  uint64_t key; // beg << 32 | end
+  uint32_t id;
+  uint32_t pad;
+};
+
+struct StoreBranchSlot {
+  uint64_t addr;
+  uint64_t ctx;
+  uint32_t id;
+  uint32_t pad;
+};
+
+// one engine table: the part mapped from the snapshot, then what was added
+// since (written out back to back, empty in a mapped image)
+struct StoreTable {
+  void *data;
+  uint64_t count;
+  const void *extra;
+  uint64_t extra_count;
+};
+
+struct StoreImage {
+  uint64_t seq;         // snapshot the tables were mapped from, 0 for none
+  StoreTable nodes;
+  StoreTable edges;
+  StoreTable edge_slots;
+  StoreTable branch_slots;
+  StoreTable decisions;
+  StoreTable dirty;
+  uint64_t branches;    // used branch slots
+  uint64_t round;
+  uint64_t epoch;
+  uint64_t unvisited;
+};
+
+enum StoreOp {
+  STORE_NODE = 1,   // a: parent, f0: outcome, f1: dir, x: addr, y: ctx
+  STORE_EDGE,       // a: beg, b: end, x: weight bits
+  STORE_WEIGHT,     // a: beg, b: end, x: delta bits
+  STORE_BUMP,       // a: node, b: visit, c: attempt, d: win
+  STORE_STATUS,     // a: node, f0: status
+  STORE_DECISION,   // a: node
+};
+
+struct StoreRecord {
+  uint8_t op;
+  uint8_t f0;
+  uint8_t f1;
+  uint8_t pad;
+  uint32_t a;
+  uint32_t b;
+  uint32_t c;
+  uint32_t d;
+  uint32_t check; // over the record with check = 0, never 0 once written
+  uint64_t x;
+  uint64_t y;
+};
+
+class GraphStore {
+public:
+  GraphStore();
+  ~GraphStore();
+
+  // creates dir if needed and maps the snapshot and the log
+  bool open(const std::string &dir);
+
+  // tables of the current snapshot, mapped private and writable (all empty
+  // without one); replaced by a successful snapshot()
+  const StoreImage& image() const { return image_; }
+
+  // log records written after that snapshot, in order
+  uint64_t log_count() const { return log_count_; }
+  const StoreRecord& log_at(uint64_t i) const { return log_[i]; }
+
+  void append(StoreRecord &rec);
+  // writes img as the next snapshot, then maps it in place of the current
+  // one; the caller moves over to image() if its seq changed
+  bool snapshot(const StoreImage &img);
+
+private:
+  bool map_snapshot(const std::string &path, StoreImage &img, void **map, size_t *size,
+                    uint64_t *check);
+  bool map_log();
+  bool grow_log();
+  void unmap_snapshot();
+  void unmap_log();
+  void verify(std::string path, uint64_t size, uint64_t check);
+  bool verified();
+
+  std::string dir_;
+  uint64_t seq_; // snapshot the current log extends, 0 before the first one
+
+  void *snap_map_;
+  size_t snap_size_;
+  StoreImage image_;
+
+  std::thread verifier_;
+  std::atomic<int> verify_state_;
+
+  int log_fd_;
+  void *log_map_;
+  size_t log_size_;
+  StoreRecord *log_;
+  uint64_t log_count_;
+  uint64_t log_cap_;
+};
+
+#endif
@@ -0,0 +1,624 @@
+#include "sched_core.h"
+#include "graph_store.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <deque>
+#include <random>
+#include <algorithm>
+
+#define NO_EDGE STORE_NONE
+// cycles in the graph (loops in the program) would otherwise propagate forever
+#define MAX_UPDATES_PER_ROUND 4
+#define SCORE_EPS 1e-9
+#define MIN_SLOTS 1024
+
+// the engine works on the store's table layout directly, so a snapshot can
+// be mapped back in as is
+typedef StoreNode SchedNode;
+typedef StoreEdge SchedEdge;
+
+// table mapped from the snapshot, followed by what was added since
+template <typename T>
+struct Layered {
+  T *base;
+  uint64_t base_count;
+  std::vector<T> extra;
+
+  Layered() : base(nullptr), base_count(0) {}
+  uint64_t size() const { return base_count + extra.size(); }
+  T& operator[](uint64_t i) { return i < base_count ? base[i] : extra[i - base_count]; }
+  void push_back(const T &v) { extra.push_back(v); }
+  void attach(const StoreTable &t) {
+    base = (T*)t.data;
+    base_count = t.count;
+    std::vector<T>().swap(extra);
+  }
+  StoreTable table() const {
+    StoreTable t = {base, base_count, extra.data(), extra.size()};
+    return t;
+  }
+};
+
+static inline uint64_t slot_hash(uint64_t a, uint64_t b) {
+  uint64_t h = a * 0x9e3779b97f4a7c15ULL ^ b;
+  h ^= h >> 29;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  return h ^ (h >> 32);
+}
+
+static inline uint64_t slot_hash(const StoreEdgeSlot &s) { return slot_hash(s.key, 0); }
+static inline uint64_t slot_hash(const StoreBranchSlot &s) { return slot_hash(s.addr, s.ctx); }
+static inline bool same_key(const StoreEdgeSlot &a, const StoreEdgeSlot &b) { return a.key == b.key; }
+static inline bool same_key(const StoreBranchSlot &a, const StoreBranchSlot &b) {
+  return a.addr == b.addr && a.ctx == b.ctx;
+}
+
+// open addressing key -> id index with linear probing, on the store's slots
+template <typename Slot>
+struct SlotIndex {
+  Slot *slots;
+  uint64_t cap; // power of two
+  uint64_t count;
+  std::vector<Slot> owned;
+
+  SlotIndex() : slots(nullptr), cap(0), count(0) {}
+
+  uint32_t find(const Slot &key) const {
+    if (!cap) return STORE_NONE;
+    for (uint64_t i = slot_hash(key) & (cap - 1);; i = (i + 1) & (cap - 1)) {
+      if (slots[i].id == STORE_NONE) return STORE_NONE;
+      if (same_key(slots[i], key)) return slots[i].id;
+    }
+  }
+
+  // key must not be present
+  void insert(const Slot &slot) {
+    if ((count + 1) * 4 > cap * 3) reserve(count + 1);
+    place(slot);
+    count++;
+  }
+
+  // room for n keys at half load, so a mapped index takes as many again
+  void reserve(uint64_t n) {
+    uint64_t want = MIN_SLOTS;
+    while (want < n * 2) want <<= 1;
+    if (want <= cap) return;
+    std::vector<Slot> fresh(want);
+    for (Slot &s : fresh) s.id = STORE_NONE;
+    Slot *old = slots;
+    uint64_t old_cap = cap;
+    slots = fresh.data();
+    cap = want;
+    for (uint64_t i = 0; i < old_cap; i++)
+      if (old[i].id != STORE_NONE) place(old[i]);
+    owned.swap(fresh);
+  }
+
+  void attach(const StoreTable &t, uint64_t used) {
+    slots = (Slot*)t.data;
+    cap = t.count;
+    count = used;
+    std::vector<Slot>().swap(owned);
+  }
+
+  StoreTable table() const {
+    StoreTable t = {slots, cap, nullptr, 0};
+    return t;
+  }
+
+private:
+  void place(const Slot &slot) {
+    uint64_t i = slot_hash(slot) & (cap - 1);
+    while (slots[i].id != STORE_NONE) i = (i + 1) & (cap - 1);
+    slots[i] = slot;
+  }
+};
+
+struct msched {
+  int mode;
+  bool freeze; // resample candidates only when dirty
+  std::mt19937_64 rng;
+  Layered<SchedNode> nodes;
+  Layered<SchedEdge> edges;
+  SlotIndex<StoreEdgeSlot> edge_index;
+  // branch node by key, so a restarted scheduler can resolve keys lazily
+  SlotIndex<StoreBranchSlot> branch_index;
+  std::vector<uint32_t> dirty;
+  std::vector<uint32_t> actionable; // may hold stale ids, filtered when ranking
+  uint32_t round;
+  // SchedNode::actionable holds the epoch the flag was set in; a reopened
+  // engine starts a new epoch, which clears every flag at once
+  uint32_t epoch;
+  uint64_t unvisited;
+  uint64_t actionable_count;
+  uint64_t last_recomputed;
+  Layered<uint32_t> decisions;
+  GraphStore *store;
+};
+
+static double sample_beta(msched *s, double a, double b) {
+  std::gamma_distribution<double> ga(a, 1.0);
+  std::gamma_distribution<double> gb(b, 1.0);
+  double x = ga(s->rng);
+  double y = gb(s->rng);
+  return (x + y) > 0 ? x / (x + y) : 0.5;
+}
+
+static inline uint64_t edge_key(uint32_t beg, uint32_t end) {
+  return ((uint64_t)beg << 32) | end;
+}
+
+static void mark_dirty(msched *s, uint32_t n) {
+  SchedNode &node = s->nodes[n];
+  // dirty_round is the round the node will be processed in
+  if (node.dirty_round == s->round + 1) return;
+  node.dirty_round = s->round + 1;
+  s->dirty.push_back(n);
+}
+
+// a counter or status change of n alters its own reward and out-edges, and
+// the out-edges of every node pointing at it (win/attempt feed the branch split)
+static void touch(msched *s, uint32_t n) {
+  mark_dirty(s, n);
+  for (uint32_t e = s->nodes[n].first_in; e != NO_EDGE; e = s->edges[e].next_in)
+    mark_dirty(s, s->edges[e].beg);
+}
+
+static inline void log_record(msched *s, StoreRecord &rec) {
+  if (s->store) s->store->append(rec);
+}
+
+static uint32_t apply_add_node(msched *s, int outcome, uint32_t parent, uint64_t addr, uint64_t ctx, int dir) {
+  SchedNode node;
+  memset(&node, 0, sizeof(node));
+  node.addr = addr;
+  node.ctx = ctx;
+  node.dir = dir;
+  node.parent = parent;
+  node.parent_edge = NO_EDGE;
+  node.first_out = NO_EDGE;
+  node.first_in = NO_EDGE;
+  node.outcome = outcome != 0;
+  node.status = MSCHED_ALIVE;
+  s->nodes.push_back(node);
+  s->unvisited++;
+  uint32_t id = s->nodes.size() - 1;
+  if (id != MSCHED_ROOT) {
+    // outcome nodes are found through the out-edges of their branch node
+    if (!node.outcome) {
+      StoreBranchSlot slot = {addr, ctx, id, 0};
+      s->branch_index.insert(slot);
+    }
+    mark_dirty(s, id);
+  }
+  return id;
+}
+
+static void apply_add_edge(msched *s, uint32_t beg, uint32_t end, double weight) {
+  if (beg >= s->nodes.size() || end >= s->nodes.size()) return;
+  StoreEdgeSlot slot = {edge_key(beg, end), 0, 0};
+  uint32_t found = s->edge_index.find(slot);
+  if (found != NO_EDGE) {
+    // networkit's addEdge would add a parallel edge; hits on it are what count
+    s->edges[found].weight += weight;
+    mark_dirty(s, beg);
+    return;
+  }
+  uint32_t id = s->edges.size();
+  SchedNode &from = s->nodes[beg];
+  SchedNode &to = s->nodes[end];
+  SchedEdge edge = {beg, end, from.first_out, to.first_in, weight, 0.0};
+  s->edges.push_back(edge);
+  slot.id = id;
+  s->edge_index.insert(slot);
+  from.first_out = id;
+  to.first_in = id;
+  if (to.outcome && to.parent == beg)
+    to.parent_edge = id;
+  mark_dirty(s, beg);
+}
+
+static void apply_increase_weight(msched *s, uint32_t beg, uint32_t end, double delta) {
+  StoreEdgeSlot slot = {edge_key(beg, end), 0, 0};
+  uint32_t found = s->edge_index.find(slot);
+  if (found == NO_EDGE) {
+    apply_add_edge(s, beg, end, delta);
+    return;
+  }
+  s->edges[found].weight += delta;
+  mark_dirty(s, beg);
+}
+
+static void apply_bump(msched *s, uint32_t node, uint32_t visit, uint32_t attempt, uint32_t win) {
+  if (node >= s->nodes.size()) return;
+  SchedNode &n = s->nodes[node];
+  if (n.visit == 0 && visit > 0) s->unvisited--;
+  n.visit += visit;
+  n.attempt += attempt;
+  n.win += win;
+  touch(s, node);
+}
+
+static void apply_set_status(msched *s, uint32_t node, int status) {
+  if (node >= s->nodes.size() || s->nodes[node].status == status) return;
+  s->nodes[node].status = status;
+  touch(s, node);
+}
+
+static inline uint64_t double_bits(double v) {
+  uint64_t x;
+  memcpy(&x, &v, sizeof(x));
+  return x;
+}
+
+static inline double bits_double(uint64_t x) {
+  double v;
+  memcpy(&v, &x, sizeof(v));
+  return v;
+}
+
+static void replay(msched *s, const StoreRecord &rec) {
+  switch (rec.op) {
+    case STORE_NODE: apply_add_node(s, rec.f0, rec.a, rec.x, rec.y, rec.f1); break;
+    case STORE_EDGE: apply_add_edge(s, rec.a, rec.b, bits_double(rec.x)); break;
+    case STORE_WEIGHT: apply_increase_weight(s, rec.a, rec.b, bits_double(rec.x)); break;
+    case STORE_BUMP: apply_bump(s, rec.a, rec.b, rec.c, rec.d); break;
+    case STORE_STATUS: apply_set_status(s, rec.a, rec.f0); break;
+    case STORE_DECISION: s->decisions.push_back(rec.a); break;
+  }
+}
+
+// work on the tables of a mapped snapshot, dropping what was added before
+static void attach(msched *s, const StoreImage &img) {
+  s->nodes.attach(img.nodes);
+  s->edges.attach(img.edges);
+  s->edge_index.attach(img.edge_slots, img.edges.count);
+  s->branch_index.attach(img.branch_slots, img.branches);
+  s->decisions.attach(img.decisions);
+}
+
+// map the snapshot tables, then bring them up to date with the log; only
+// what the log touches is marked dirty, the rest keeps its samples
+static void recover(msched *s) {
+  GraphStore *st = s->store;
+  const StoreImage &img = st->image();
+  if (img.nodes.count > 0) {
+    attach(s, img);
+    const uint32_t *dirty = (const uint32_t*)img.dirty.data;
+    s->dirty.assign(dirty, dirty + img.dirty.count);
+    s->round = img.round;
+    // the solving queues of the earlier run are gone, and its flags with them
+    s->epoch = img.epoch + 1;
+    s->unvisited = img.unvisited;
+  }
+  for (uint64_t i = 0; i < st->log_count(); i++)
+    replay(s, st->log_at(i));
+}
+
+extern "C" {
+
+msched_t* msched_create(int mode, uint64_t seed) {
+  msched *s = new msched();
+  s->mode = mode;
+  s->freeze = false;
+  s->rng.seed(seed);
+  s->round = 0;
+  s->epoch = 1;
+  s->unvisited = 0;
+  s->actionable_count = 0;
+  s->last_recomputed = 0;
+  s->store = nullptr;
+  apply_add_node(s, 0, MSCHED_ROOT, 0, 0, 0);
+  return s;
+}
+
+void msched_destroy(msched_t *s) {
+  delete s->store;
+  delete s;
+}
+
+int64_t msched_open_store(msched_t *s, const char *dir) {
+  if (s->store || s->nodes.size() != 1 || s->edges.size() != 0) return -1;
+  GraphStore *st = new GraphStore();
+  if (!st->open(dir)) {
+    delete st;
+    return -1;
+  }
+  s->store = st;
+  recover(s);
+  return s->nodes.size();
+}
+
+int msched_snapshot(msched_t *s) {
+  if (!s->store) return -1;
+  // leave the indexes room to take as many keys again once mapped
+  s->edge_index.reserve(s->edge_index.count);
+  s->branch_index.reserve(s->branch_index.count);
+  StoreImage img;
+  memset(&img, 0, sizeof(img));
+  img.nodes = s->nodes.table();
+  img.edges = s->edges.table();
+  img.edge_slots = s->edge_index.table();
+  img.branch_slots = s->branch_index.table();
+  img.decisions = s->decisions.table();
+  img.dirty.data = s->dirty.data();
+  img.dirty.count = s->dirty.size();
+  img.branches = s->branch_index.count;
+  img.round = s->round;
+  img.epoch = s->epoch;
+  img.unvisited = s->unvisited;
+  uint64_t seq = s->store->image().seq;
+  if (!s->store->snapshot(img)) return -1;
+  if (s->store->image().seq != seq) attach(s, s->store->image());
+  return 0;
+}
+
+uint32_t msched_add_node(msched_t *s, int outcome, uint32_t parent, uint64_t addr, uint64_t ctx, int dir) {
+  StoreRecord rec = {};
+  rec.op = STORE_NODE;
+  rec.f0 = outcome != 0;
+  rec.f1 = dir;
+  rec.a = parent;
+  rec.x = addr;
+  rec.y = ctx;
+  log_record(s, rec);
+  return apply_add_node(s, outcome, parent, addr, ctx, dir);
+}
+
+void msched_add_edge(msched_t *s, uint32_t beg, uint32_t end, double weight) {
+  StoreRecord rec = {};
+  rec.op = STORE_EDGE;
+  rec.a = beg;
+  rec.b = end;
+  rec.x = double_bits(weight);
+  log_record(s, rec);
+  apply_add_edge(s, beg, end, weight);
+}
+
+void msched_increase_weight(msched_t *s, uint32_t beg, uint32_t end, double delta) {
+  StoreRecord rec = {};
+  rec.op = STORE_WEIGHT;
+  rec.a = beg;
+  rec.b = end;
+  rec.x = double_bits(delta);
+  log_record(s, rec);
+  apply_increase_weight(s, beg, end, delta);
+}
+
+void msched_bump(msched_t *s, uint32_t node, uint32_t visit, uint32_t attempt, uint32_t win) {
+  StoreRecord rec = {};
+  rec.op = STORE_BUMP;
+  rec.a = node;
+  rec.b = visit;
+  rec.c = attempt;
+  rec.d = win;
+  log_record(s, rec);
+  apply_bump(s, node, visit, attempt, win);
+}
+
+void msched_set_status(msched_t *s, uint32_t node, int status) {
+  if (node >= s->nodes.size() || s->nodes[node].status == status) return;
+  StoreRecord rec = {};
+  rec.op = STORE_STATUS;
+  rec.a = node;
+  rec.f0 = status;
+  log_record(s, rec);
+  apply_set_status(s, node, status);
+}
+
+void msched_add_decision(msched_t *s, uint32_t node) {
+  StoreRecord rec = {};
+  rec.op = STORE_DECISION;
+  rec.a = node;
+  log_record(s, rec);
+  s->decisions.push_back(node);
+}
+
+uint32_t msched_decision(msched_t *s, uint32_t idx) {
+  return idx < s->decisions.size() ? s->decisions[idx] : MSCHED_ROOT;
+}
+
+void msched_set_freeze(msched_t *s, int freeze) {
+  s->freeze = freeze != 0;
+}
+
+void msched_set_actionable(msched_t *s, uint32_t node, int actionable) {
+  if (node >= s->nodes.size()) return;
+  SchedNode &n = s->nodes[node];
+  bool a = actionable != 0;
+  if ((n.actionable == s->epoch) == a) return;
+  n.actionable = a ? s->epoch : 0;
+  if (a) {
+    s->actionable.push_back(node);
+    s->actionable_count++;
+  } else {
+    s->actionable_count--;
+  }
+}
+
+// same policy as init_reward, for a leaf
+static void sample_leaf(msched *s, SchedNode &n) {
+  if (n.status == MSCHED_DEAD) return;
+  if (s->mode == 3)
+    n.score = n.visit == 0 ? 1.0 : 0.0;
+  else
+    n.score = sample_beta(s, 1, 1 + (double)n.attempt + n.visit);
+}
+
+// same policy as updateTranProb, for all out-edges of n
+static void sample_edges(msched *s, uint32_t id) {
+  SchedNode &n = s->nodes[id];
+  bool deter = !n.outcome && s->mode != 3;
+  double sibling = -1.0;
+  for (uint32_t e = n.first_out; e != NO_EDGE; e = s->edges[e].next_out) {
+    SchedEdge &edge = s->edges[e];
+    SchedNode &child = s->nodes[edge.end];
+    if (child.status == MSCHED_DEAD) {
+      edge.p = 0.0;
+    } else if (deter) {
+      // X -> X-T/F: the two outcomes split the probability
+      if (sibling >= 0) {
+        edge.p = 1.0 - sibling;
+      } else {
+        double a = child.win;
+        double b = child.attempt > child.win ? (double)(child.attempt - child.win) : 0.0;
+        edge.p = sample_beta(s, 1 + a, 1 + b);
+      }
+    } else {
+      // X-T/F -> next: how often this successor followed
+      double a = edge.weight;
+      double b = (double)n.visit + n.attempt - a;
+      if (b < 0) b = 0;
+      edge.p = sample_beta(s, 1 + a, 1 + b);
+    }
+    if (deter) sibling = edge.p;
+  }
+}
+
+static double aggregate(msched *s, const SchedNode &n) {
+  double sum_p = 0.0;
+  for (uint32_t e = n.first_out; e != NO_EDGE; e = s->edges[e].next_out)
+    sum_p += s->edges[e].p;
+  if (sum_p <= 0) return 0.0;
+  double score = 0.0;
+  for (uint32_t e = n.first_out; e != NO_EDGE; e = s->edges[e].next_out)
+    score += s->edges[e].p / sum_p * s->nodes[s->edges[e].end].score;
+  return score;
+}
+
+uint32_t msched_rank(msched_t *s, uint32_t *out_nodes, double *out_scores, uint32_t cap) {
+  // Thompson sampling needs a fresh draw for every candidate each round: its
+  // own reward and the split of its branch node, which holds the parent edge
+  if (!s->freeze) {
+    for (uint32_t id : s->actionable) {
+      const SchedNode &n = s->nodes[id];
+      if (n.actionable != s->epoch || !n.outcome || n.parent_edge == NO_EDGE) continue;
+      mark_dirty(s, id);
+      mark_dirty(s, n.parent);
+    }
+  }
+
+  uint32_t round = ++s->round;
+  uint64_t recomputed = 0;
+
+  // 1. resample what changed since the last round, and the candidates
+  std::deque<uint32_t> work;
+  for (uint32_t id : s->dirty) {
+    if (id == MSCHED_ROOT) continue;
+    SchedNode &n = s->nodes[id];
+    if (n.first_out == NO_EDGE) {
+      sample_leaf(s, n);
+      // a leaf's score is final, go straight to its parents
+      for (uint32_t e = n.first_in; e != NO_EDGE; e = s->edges[e].next_in)
+        work.push_back(s->edges[e].beg);
+    } else {
+      sample_edges(s, id);
+      work.push_back(id);
+    }
+  }
+  s->dirty.clear();
+
+  // 2. propagate score changes towards the root
+  while (!work.empty()) {
+    uint32_t id = work.front();
+    work.pop_front();
+    if (id == MSCHED_ROOT) continue;
+    SchedNode &n = s->nodes[id];
+    if (n.first_out == NO_EDGE) continue;
+    if (n.update_round != round) {
+      n.update_round = round;
+      n.updates = 0;
+    }
+    if (n.updates >= MAX_UPDATES_PER_ROUND) continue;
+    n.updates++;
+    double score = aggregate(s, n);
+    recomputed++;
+    if (fabs(score - n.score) <= SCORE_EPS) continue;
+    n.score = score;
+    for (uint32_t e = n.first_in; e != NO_EDGE; e = s->edges[e].next_in)
+      work.push_back(s->edges[e].beg);
+  }
+  s->last_recomputed = recomputed;
+
+  // 3. rank actionable outcome nodes by discounted score
+  std::vector<std::pair<double, uint32_t>> ranked;
+  size_t keep = 0;
+  for (size_t i = 0; i < s->actionable.size(); i++) {
+    uint32_t id = s->actionable[i];
+    SchedNode &n = s->nodes[id];
+    if (n.actionable != s->epoch) continue;
+    // drop ids that went inactive (and duplicates from re-activation)
+    if (n.rank_round == round) continue;
+    n.rank_round = round;
+    s->actionable[keep++] = id;
+    if (!n.outcome || n.parent_edge == NO_EDGE) continue;
+    // mode 1: unvisited nodes only
+    if (s->mode == 1 && n.visit != 0) continue;
+    ranked.push_back(std::make_pair(n.score * s->edges[n.parent_edge].p, id));
+  }
+  s->actionable.resize(keep);
+
+  uint32_t count = std::min<size_t>(cap, ranked.size());
+  std::partial_sort(ranked.begin(), ranked.begin() + count, ranked.end(),
+                    [](const std::pair<double, uint32_t> &a, const std::pair<double, uint32_t> &b) {
+                      return a.first > b.first;
+                    });
+  for (uint32_t i = 0; i < count; i++) {
+    out_nodes[i] = ranked[i].second;
+    if (out_scores) out_scores[i] = ranked[i].first;
+  }
+  return count;
+}
+
+double msched_score(msched_t *s, uint32_t node) {
+  return node < s->nodes.size() ? s->nodes[node].score : 0.0;
+}
+
+void msched_stats(msched_t *s, msched_stats_t *out) {
+  out->nodes = s->nodes.size();
+  out->edges = s->edges.size();
+  out->unvisited = s->unvisited;
+  out->actionable = s->actionable_count;
+  out->rounds = s->round;
+  out->last_recomputed = s->last_recomputed;
+  out->decisions = s->decisions.size();
+  out->log_records = s->store ? s->store->log_count() : 0;
+}
+
+int msched_node(msched_t *s, uint32_t node, msched_node_t *out) {
+  if (node >= s->nodes.size()) return -1;
+  const SchedNode &n = s->nodes[node];
+  out->addr = n.addr;
+  out->ctx = n.ctx;
+  out->parent = n.parent;
+  out->visit = n.visit;
+  out->attempt = n.attempt;
+  out->win = n.win;
+  out->outcome = n.outcome;
+  out->dir = n.dir;
+  out->status = n.status;
+  return 0;
+}
+
+uint32_t msched_find(msched_t *s, int outcome, uint64_t addr, uint64_t ctx, int dir) {
+  StoreBranchSlot key = {addr, ctx, 0, 0};
+  uint32_t branch = s->branch_index.find(key);
+  if (branch == MSCHED_NONE || !outcome) return branch;
+  for (uint32_t e = s->nodes[branch].first_out; e != NO_EDGE; e = s->edges[e].next_out) {
+    const SchedNode &n = s->nodes[s->edges[e].end];
+    if (n.outcome && n.parent == branch && n.dir == dir) return s->edges[e].end;
+  }
+  return MSCHED_NONE;
+}
+
+int msched_edge(msched_t *s, uint32_t edge, uint32_t *beg, uint32_t *end, double *weight) {
+  if (edge >= s->edges.size()) return -1;
+  *beg = s->edges[edge].beg;
+  *end = s->edges[edge].end;
+  *weight = s->edges[edge].weight;
+  return 0;
+}
+
+}
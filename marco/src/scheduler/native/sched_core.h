@@ -0,0 +1,107 @@
+#ifndef SCHED_CORE_H_
+#define SCHED_CORE_H_
+#include <stdint.h>
+
+// Native scheduling engine for main-MS.py (sched modes 1, 2 and 3).
+//
+// Holds the branch graph (branch nodes "X" and their outcome nodes "X-T/F"),
+// the per-node visit/attempt/win counters and the per-edge hit counts, and
+// ranks actionable outcome nodes the same way graphUpdate + pick_one do:
+// leaves get a Beta(1, 1+attempt+visit) reward (0/1 by visit in mode 3),
+// edges get Beta transition probabilities, interior nodes take the
+// probability-weighted average of their children, and each actionable node
+// is ranked by score * p(parent -> node).
+//
+// Unlike the Python version, nothing is recomputed from scratch. Any change
+// (new edge, weight, counter or status) marks the affected nodes dirty; a
+// round resamples the dirty nodes plus every rankable candidate and its
+// branch split, then propagates score changes upwards along in-edges until
+// they settle. Other nodes keep their previous sample. With freezing on
+// (msched_set_freeze), candidates are only resampled when dirty, which is
+// cheaper but makes the ranking nearly greedy between changes.
+//
+// With a store directory (msched_open_store), every mutation is also logged
+// to disk (graph_store.h) together with the node keys and the ceq decision
+// list, so a restarted scheduler picks the graph up where it was left.
+//
+// Plain C ABI so the scheduler can load it with ctypes (native_sched.py).
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MSCHED_ALIVE 0
+#define MSCHED_DEAD 1
+#define MSCHED_EXPLD 2
+
+#define MSCHED_ROOT 0
+#define MSCHED_NONE 0xffffffffU
+
+typedef struct msched msched_t;
+
+typedef struct {
+  uint64_t nodes;
+  uint64_t edges;
+  uint64_t unvisited;
+  uint64_t actionable;
+  uint64_t rounds;
+  uint64_t last_recomputed; // node score updates in the last round
+  uint64_t decisions;
+  uint64_t log_records;     // store records since the last snapshot
+} msched_stats_t;
+
+typedef struct {
+  uint64_t addr;
+  uint64_t ctx;
+  uint32_t parent;
+  uint32_t visit;
+  uint32_t attempt;
+  uint32_t win;
+  int32_t outcome;
+  int32_t dir;
+  int32_t status;
+} msched_node_t;
+
+// mode is main-MS.py's sched mode (1, 2 or 3); node 0 is the root
+msched_t* msched_create(int mode, uint64_t seed);
+void msched_destroy(msched_t *s);
+
+// persist to dir, recovering what an earlier run left there; call before
+// adding any node. Returns the node count (1 when starting fresh), -1 on error
+int64_t msched_open_store(msched_t *s, const char *dir);
+// write a checksummed snapshot and start a new log, 0 on success
+int msched_snapshot(msched_t *s);
+
+// outcome nodes (X-T/F) name their branch node X as parent, others pass
+// MSCHED_ROOT; addr/ctx/dir are the node key, only kept for recovery
+uint32_t msched_add_node(msched_t *s, int outcome, uint32_t parent, uint64_t addr, uint64_t ctx, int dir);
+void msched_add_edge(msched_t *s, uint32_t beg, uint32_t end, double weight);
+void msched_increase_weight(msched_t *s, uint32_t beg, uint32_t end, double delta);
+
+void msched_bump(msched_t *s, uint32_t node, uint32_t visit, uint32_t attempt, uint32_t win);
+void msched_set_status(msched_t *s, uint32_t node, int status);
+// node has a non-empty solving queue
+void msched_set_actionable(msched_t *s, uint32_t node, int actionable);
+
+// keep the samples of clean candidates across rounds; off by default
+void msched_set_freeze(msched_t *s, int freeze);
+// run one round and return up to cap nodes, best first
+uint32_t msched_rank(msched_t *s, uint32_t *nodes, double *scores, uint32_t cap);
+
+// ceq decision list (Gsched.ceq_decid), persisted with the graph
+void msched_add_decision(msched_t *s, uint32_t node);
+uint32_t msched_decision(msched_t *s, uint32_t idx);
+
+double msched_score(msched_t *s, uint32_t node);
+void msched_stats(msched_t *s, msched_stats_t *out);
+// recovery accessors, 0 on success
+int msched_node(msched_t *s, uint32_t node, msched_node_t *out);
+// node with this key (as passed to msched_add_node), MSCHED_NONE if absent
+uint32_t msched_find(msched_t *s, int outcome, uint64_t addr, uint64_t ctx, int dir);
+int msched_edge(msched_t *s, uint32_t edge, uint32_t *beg, uint32_t *end, double *weight);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
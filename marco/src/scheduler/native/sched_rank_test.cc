@@ -0,0 +1,61 @@
+// With the counters held fixed, Thompson sampling must still vary the
+// ranking from round to round; with freezing on it must not. Exits nonzero
+// on failure.
+#include "sched_core.h"
+#include <stdio.h>
+
+#define BRANCHES 4
+#define ROUNDS 64
+
+// BRANCHES branch nodes under the root, each with two actionable outcomes
+static msched_t *build(int freeze) {
+  msched_t *s = msched_create(2, 7);
+  msched_set_freeze(s, freeze);
+  for (int b = 0; b < BRANCHES; b++) {
+    uint32_t x = msched_add_node(s, 0, MSCHED_ROOT, 0x1000 + b, 0, 0);
+    msched_add_edge(s, MSCHED_ROOT, x, 1.0);
+    for (int dir = 0; dir < 2; dir++) {
+      uint32_t o = msched_add_node(s, 1, x, 0x1000 + b, 0, dir);
+      msched_add_edge(s, x, o, 1.0);
+      msched_bump(s, o, 1, 2, 1);
+      msched_set_actionable(s, o, 1);
+    }
+  }
+  return s;
+}
+
+// number of rounds whose best node differs from the round before
+static int top_changes(msched_t *s) {
+  uint32_t nodes[2 * BRANCHES];
+  uint32_t prev = MSCHED_ROOT;
+  int changes = 0;
+  for (int r = 0; r < ROUNDS; r++) {
+    if (msched_rank(s, nodes, NULL, 2 * BRANCHES) != 2 * BRANCHES) {
+      fprintf(stderr, "round %d ranked too few nodes\n", r);
+      return -1;
+    }
+    if (r > 0 && nodes[0] != prev) changes++;
+    prev = nodes[0];
+  }
+  return changes;
+}
+
+int main() {
+  msched_t *s = build(0);
+  int changes = top_changes(s);
+  msched_destroy(s);
+  if (changes <= 0) {
+    fprintf(stderr, "ranking never changed over %d rounds with fixed stats\n", ROUNDS);
+    return 1;
+  }
+
+  s = build(1);
+  int frozen = top_changes(s);
+  msched_destroy(s);
+  if (frozen != 0) {
+    fprintf(stderr, "frozen ranking changed %d times without any update\n", frozen);
+    return 1;
+  }
+  printf("top node changed in %d of %d rounds\n", changes, ROUNDS - 1);
+  return 0;
+}
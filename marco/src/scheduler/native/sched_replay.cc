@@ -0,0 +1,243 @@
+// Replay benchmark for the native scheduling engine.
+//
+//   sched_replay [-m mode] [-p dir] <pipe_mirror.log>   replay a recorded campaign
+//   sched_replay [-m mode] [-p dir] -s <traces>         synthetic campaign
+//
+// pipe_mirror.log is what main-MS.py mirrors from /tmp/pcpipe. Graph updates
+// follow Gsched.add_branch; every END/ENDDUP/ENDUNSAT token runs one
+// scheduling round, and the time of each round is reported. With -p the
+// graph is persisted to dir, and the cost of a snapshot and of reopening the
+// store is reported at the end.
+#include "sched_core.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <sstream>
+#include <chrono>
+#include <random>
+#include <algorithm>
+#include <unordered_map>
+
+#define RANK_CAP 256
+
+struct Replay {
+  msched_t *s;
+  std::unordered_map<std::string, uint32_t> addr_nodeid;
+  std::vector<uint32_t> parent;  // branch node of each node
+  std::vector<uint32_t> pcqueue; // queued solving candidates per node
+  uint32_t cur_edgebeg;
+  uint32_t choice;
+  std::vector<uint32_t> rank;
+  std::vector<double> round_ms;
+  uint64_t recomputed;
+
+  Replay(int mode) : s(msched_create(mode, 7)), cur_edgebeg(MSCHED_ROOT), choice(MSCHED_ROOT), recomputed(0) {
+    parent.push_back(MSCHED_ROOT);
+    pcqueue.push_back(0);
+  }
+  ~Replay() { msched_destroy(s); }
+
+  uint32_t node(const std::string &key, int outcome, uint32_t p, uint64_t addr, uint64_t ctx, int dir) {
+    uint32_t id = msched_add_node(s, outcome, p, addr, ctx, dir);
+    addr_nodeid[key] = id;
+    parent.push_back(p);
+    pcqueue.push_back(0);
+    return id;
+  }
+
+  void add_branch(uint64_t addr, uint64_t ctx, uint32_t tkdir, bool solvable) {
+    std::string p_root = std::to_string(addr) + "_" + std::to_string(ctx);
+    std::string child_T = p_root + "-" + std::to_string(tkdir);
+    std::string child_F = p_root + "-" + std::to_string(1 - tkdir);
+    uint32_t P, T, F;
+    auto it = addr_nodeid.find(p_root);
+    if (it == addr_nodeid.end()) {
+      P = node(p_root, 0, MSCHED_ROOT, addr, ctx, 0);
+      T = node(child_T, 1, P, addr, ctx, tkdir);
+      F = node(child_F, 1, P, addr, ctx, 1 - tkdir);
+      msched_add_edge(s, cur_edgebeg, P, 1.0);
+      msched_add_edge(s, P, T, 1.0);
+      msched_add_edge(s, P, F, 0.0);
+    } else {
+      P = it->second;
+      T = addr_nodeid[child_T];
+      F = addr_nodeid[child_F];
+      msched_increase_weight(s, cur_edgebeg, P, 1.0);
+      msched_increase_weight(s, P, T, 1.0);
+    }
+    if (solvable) {
+      if (pcqueue[F]++ == 0) msched_set_actionable(s, F, 1);
+    }
+    msched_bump(s, P, 1, 0, 0);
+    msched_bump(s, T, 1, 0, 0);
+    cur_edgebeg = T;
+  }
+
+  void sched_round() {
+    msched_stats_t st;
+    msched_stats(s, &st);
+    if (st.actionable == 0) return;
+    auto t0 = std::chrono::steady_clock::now();
+    // native_sched.py asks for the same bounded prefix
+    uint32_t cap = std::min<uint64_t>(RANK_CAP, std::max<uint64_t>(1, st.nodes / 3));
+    rank.resize(cap);
+    rank.resize(msched_rank(s, rank.data(), nullptr, cap));
+    auto t1 = std::chrono::steady_clock::now();
+    round_ms.push_back(std::chrono::duration<double, std::milli>(t1 - t0).count());
+    msched_stats(s, &st);
+    recomputed += st.last_recomputed;
+    for (uint32_t id : rank) {
+      if (pcqueue[id] == 0) continue;
+      choice = id;
+      if (--pcqueue[id] == 0) msched_set_actionable(s, id, 0);
+      break;
+    }
+  }
+
+  void token(const std::string &tok) {
+    if (tok == "ENDNEW") {
+      msched_add_decision(s, choice);
+      if (choice != MSCHED_ROOT) {
+        msched_bump(s, choice, 0, 1, 0);
+        msched_bump(s, parent[choice], 0, 1, 0);
+      }
+    } else {
+      if (tok == "ENDUNSAT" && choice != MSCHED_ROOT)
+        msched_set_status(s, choice, MSCHED_DEAD);
+      sched_round();
+    }
+    cur_edgebeg = MSCHED_ROOT;
+  }
+
+  void record(std::string rec) {
+    rec.erase(std::remove_if(rec.begin(), rec.end(), [](char c) { return c == '\n' || c == ' '; }), rec.end());
+    if (rec.empty()) return;
+    if (rec.compare(0, 3, "END") == 0) {
+      token(rec);
+      return;
+    }
+    size_t at = rec.find('@');
+    if (at == std::string::npos) return;
+    uint64_t f[6];
+    std::stringstream ss(rec.substr(0, at));
+    std::string field;
+    for (int i = 0; i < 6; i++) {
+      if (!std::getline(ss, field, '-')) return;
+      f[i] = strtoull(field.c_str(), nullptr, 10);
+    }
+    add_branch(f[0], f[1], f[2], rec.find("none", at) == std::string::npos);
+  }
+};
+
+static void replay_log(Replay &r, const char *path) {
+  std::ifstream in(path);
+  if (!in) {
+    fprintf(stderr, "cannot open %s\n", path);
+    exit(1);
+  }
+  std::stringstream buf;
+  buf << in.rdbuf();
+  std::string data = buf.str();
+  size_t pos = 0, end;
+  while ((end = data.find("@@", pos)) != std::string::npos) {
+    r.record(data.substr(pos, end - pos));
+    pos = end + 2;
+  }
+}
+
+// traces over a synthetic program: mostly local control flow, occasional jumps
+static void replay_synthetic(Replay &r, uint32_t traces, bool persist) {
+  std::mt19937_64 rng(1);
+  const uint64_t branches = 1 << 18;
+  for (uint32_t t = 0; t < traces; t++) {
+    uint64_t pc = rng() % branches;
+    for (int i = 0; i < 64; i++) {
+      uint32_t dir = rng() & 1;
+      r.add_branch(0x400000 + pc * 16, 0, dir, rng() % 10 < 7);
+      pc = (rng() % 8 == 0) ? rng() % branches : (pc * 2 + dir + 1) % branches;
+    }
+    r.token("END");
+    for (int k = 0; k < 4; k++) {
+      uint64_t o = rng() % 3;
+      r.token(o == 0 ? "ENDNEW" : (o == 1 ? "ENDDUP" : "ENDUNSAT"));
+    }
+    // roughly what main-MS.py does every few minutes
+    if (persist && t % 2000 == 1999) msched_snapshot(r.s);
+  }
+}
+
+int main(int argc, char **argv) {
+  int mode = 2;
+  uint32_t synthetic = 0;
+  const char *log = nullptr;
+  const char *store = nullptr;
+  for (int i = 1; i < argc; i++) {
+    if (!strcmp(argv[i], "-m") && i + 1 < argc) mode = atoi(argv[++i]);
+    else if (!strcmp(argv[i], "-p") && i + 1 < argc) store = argv[++i];
+    else if (!strcmp(argv[i], "-s") && i + 1 < argc) synthetic = atoi(argv[++i]);
+    else log = argv[i];
+  }
+  if (!log && !synthetic) {
+    fprintf(stderr, "usage: %s [-m mode] [-p dir] <pipe_mirror.log> | -s <traces>\n", argv[0]);
+    return 1;
+  }
+
+  Replay r(mode);
+  if (store) {
+    int64_t n = msched_open_store(r.s, store);
+    if (n < 0) {
+      fprintf(stderr, "cannot open store %s\n", store);
+      return 1;
+    }
+    if (n > 1) {
+      fprintf(stderr, "store %s is not empty (%ld nodes)\n", store, (long)n);
+      return 1;
+    }
+  }
+  auto t0 = std::chrono::steady_clock::now();
+  if (log) replay_log(r, log);
+  else replay_synthetic(r, synthetic, store != nullptr);
+  double total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+
+  msched_stats_t st;
+  msched_stats(r.s, &st);
+  std::vector<double> ms(r.round_ms);
+  std::sort(ms.begin(), ms.end());
+  double sum = 0;
+  for (double v : ms) sum += v;
+  printf("graph: %lu nodes, %lu edges, %lu unvisited, %lu actionable\n",
+         (unsigned long)st.nodes, (unsigned long)st.edges, (unsigned long)st.unvisited, (unsigned long)st.actionable);
+  printf("rounds: %zu, replay total %.1fms\n", ms.size(), total);
+  if (!ms.empty()) {
+    printf("node updates per round: %.1f\n", (double)r.recomputed / ms.size());
+    printf("round ms: mean %.3f p50 %.3f p99 %.3f max %.3f\n", sum / ms.size(),
+           ms[ms.size() / 2], ms[std::min(ms.size() - 1, ms.size() * 99 / 100)], ms.back());
+  }
+
+  if (store) {
+    msched_stats(r.s, &st);
+    uint64_t tail = st.log_records;
+    // reopen with the log tail as it is, as after a kill
+    auto t1 = std::chrono::steady_clock::now();
+    msched_t *again = msched_create(mode, 7);
+    int64_t n = msched_open_store(again, store);
+    double reopen = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t1).count();
+    msched_stats_t st2;
+    msched_stats(again, &st2);
+    printf("reopen: %ld nodes, %lu edges, %lu decisions, %lu log records replayed in %.1fms\n",
+           (long)n, (unsigned long)st2.edges, (unsigned long)st2.decisions, (unsigned long)tail, reopen);
+    if (st2.nodes != st.nodes || st2.edges != st.edges || st2.unvisited != st.unvisited ||
+        st2.decisions != st.decisions) {
+      fprintf(stderr, "reopened store does not match the live graph\n");
+      return 1;
+    }
+    t1 = std::chrono::steady_clock::now();
+    msched_snapshot(again);
+    printf("snapshot: %.1fms\n", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t1).count());
+    msched_destroy(again);
+  }
+  return 0;
+}
@@ -7,7 +7,11 @@
 #include "tcg.h"
 #include "qemu/cutils.h"
 #include "dfsan_interface.h"
+#include "marco_metrics.h"
 #include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
 /* Minimal dfsan declarations to query label parents without pulling C++ headers */
 typedef struct dfsan_label_info {
     unsigned int l1;
@@ -87,45 +91,11 @@ DEF_HELPER_BINARY(shift_right, LShr, 64)
 DEF_HELPER_BINARY(arithmetic_shift_right, AShr, 64)
 DEF_HELPER_BINARY(shift_left, Shl, 64)
 
-DECL_HELPER_BINARY(rotate_left, 32)
-{
-    BINARY_HELPER_ENSURE_EXPRESSIONS
-    // UNIMPLEMENTED_HELPER("rotate_left32")
-    // arg1 << arg2 | arg1 >> (32 - arg2)
-    uint32_t shl = dfsan_union(arg1_label, arg2_label, Shl, 32, arg1, arg2);
-    uint32_t tmp = dfsan_union(CONST_LABEL, arg2_label, Sub, 32, 32, arg2);
-    uint32_t lshr = dfsan_union(arg1_label, tmp, LShr, 32, arg1, 32-arg2);
-    return dfsan_union(shl, lshr, Or, 32, arg1 << arg2, arg1 >> (32 - arg2));
-}
-DECL_HELPER_BINARY(rotate_left, 64)
-{
-    BINARY_HELPER_ENSURE_EXPRESSIONS
-    // UNIMPLEMENTED_HELPER("rotate_left64")
-    // arg1 << arg2 | arg1 >> (64 - arg2)
-    uint32_t shl = dfsan_union(arg1_label, arg2_label, Shl, 64, arg1, arg2);
-    uint32_t tmp = dfsan_union(CONST_LABEL, arg2_label, Sub, 64, 64, arg2);
-    uint32_t lshr = dfsan_union(arg1_label, tmp, LShr, 64, arg1, 64-arg2);
-    return dfsan_union(shl, lshr, Or, 64, arg1 << arg2, arg1 >> (64 - arg2));
-}
-DECL_HELPER_BINARY(rotate_right, 32)
-{
-    BINARY_HELPER_ENSURE_EXPRESSIONS
-    // UNIMPLEMENTED_HELPER("rotate_right32")
-    // arg1 >> arg2 | arg1 << (32 - arg2)
-    uint32_t lshr = dfsan_union(arg1_label, arg2_label, LShr, 32, arg1, arg2);
-    uint32_t tmp = dfsan_union(CONST_LABEL, arg2_label, Sub, 32, 32, arg2);
-    uint32_t shl = dfsan_union(arg1_label, tmp, Shl, 32, arg1, 32-arg2);
-    return dfsan_union(lshr, shl, Or, 32, arg1 >> arg2, arg1 << (32 - arg2));
-}
-DECL_HELPER_BINARY(rotate_right, 64)
-{
-    BINARY_HELPER_ENSURE_EXPRESSIONS
-    // UNIMPLEMENTED_HELPER("rotate_right64")
-    uint32_t lshr = dfsan_union(arg1_label, arg2_label, LShr, 64, arg1, arg2);
-    uint32_t tmp = dfsan_union(CONST_LABEL, arg2_label, Sub, 64, 64, arg2);
-    uint32_t shl = dfsan_union(arg1_label, tmp, Shl, 64, arg1, 64-arg2);
-    return dfsan_union(lshr, shl, Or, 64, arg1 >> arg2, arg1 << (64 - arg2));
-}
+/* Rotations are single RotL/RotR nodes, the amount is taken modulo the width */
+DEF_HELPER_BINARY(rotate_left, RotL, 32)
+DEF_HELPER_BINARY(rotate_right, RotR, 32)
+DEF_HELPER_BINARY(rotate_left, RotL, 64)
+DEF_HELPER_BINARY(rotate_right, RotR, 64)
 
 DECL_HELPER_BINARY(nand, 32)
 {
@@ -313,223 +283,22 @@ uint64_t HELPER(symsan_trunc_i64_i32)(uint64_t op1, uint64_t op1_label)
     // Result is 32-bit.
     return dfsan_union(op1_label, CONST_LABEL, Trunc, 32, op1, 32);
 }
-// https://github.com/chenju2k6/symsan/commit/3392e5b1d33b8ac6e350eeefb37ae861848ba9b2
-// bswap support
+/* bswap of the low `length` bytes; the bytes above are assumed to be zero
+ * (see tcg_gen_bswap16_i32) and the result is zero extended to the width.
+ * One BSwap node, the solvers rebuild it as a concat of byte extracts. The
+ * concrete value is left out so that equal swaps dedup. */
 uint64_t HELPER(symsan_bswap_i32)(uint32_t op1, uint64_t op1_label, uint64_t length)
 {
     if (op1_label == 0) return 0;
-    uint64_t arg1, arg2, tmp, tmp1, tmp2, first_block, second_block;
-    switch (length) {
-        case 2:
-            arg1 = dfsan_union(
-                dfsan_union(op1_label, CONST_LABEL, ZExt, 64, op1, 1),
-                CONST_LABEL,
-                Shl,
-                64,
-                op1,
-                8);
-            arg2 = dfsan_union(
-                op1_label,
-                CONST_LABEL,
-                LShr,
-                64,
-                op1,
-                8);
-            return dfsan_union(arg1, arg2, Or, 64, 0, 0);
-        case 4:
-            tmp = dfsan_union(op1_label, CONST_LABEL, LShr, 64, op1, 8);
-            arg1 = dfsan_union(
-                tmp,
-                CONST_LABEL,
-                And,
-                64,
-                op1,
-                0x00ff00ff
-            );
-            arg2 = dfsan_union(
-                dfsan_union(op1_label, CONST_LABEL, And, 64, op1, 0x00ff00ff),
-                CONST_LABEL,
-                Shl,
-                64,
-                op1,
-                8
-            );
-            first_block = dfsan_union(arg1, arg2, Or, 64, 0, 0);
-            tmp1 = dfsan_union(first_block, CONST_LABEL, LShr, 64, op1, 16);
-            tmp2 = dfsan_union(first_block, CONST_LABEL, Shl, 64, op1, 16);
-            return dfsan_union(tmp1, tmp2, Or, 64, 0, 0);
-        case 8:
-            tmp1 = dfsan_union(
-                dfsan_union(op1_label, CONST_LABEL, LShr, 64, op1, 8),
-                CONST_LABEL,
-                And,
-                64,
-                op1,
-                0x00ff00ff00ff00ffull
-            );
-            tmp2 = dfsan_union(
-                dfsan_union(op1_label, CONST_LABEL, And, 64, op1, 0x00ff00ff00ff00ffull),
-                CONST_LABEL,
-                Shl,
-                64,
-                op1,
-                8
-            );
-            first_block = dfsan_union(tmp1, tmp2, Or, 64, 0, 0);
-            tmp1 = dfsan_union(
-                dfsan_union(first_block, CONST_LABEL, LShr, 64, op1, 16),
-                CONST_LABEL,
-                And,
-                64,
-                op1,
-                0x0000ffff0000ffffull
-            );
-            tmp2 = dfsan_union(
-                dfsan_union(first_block, CONST_LABEL, And, 64, op1, 0x0000ffff0000ffffull),
-                CONST_LABEL,
-                Shl,
-                64,
-                op1,
-                16
-            );
-            second_block = dfsan_union(tmp1, tmp2, Or, 64, 0, 0);
-            return dfsan_union(
-                dfsan_union(
-                    second_block,
-                    CONST_LABEL,
-                    LShr,
-                    64,
-                    op1,
-                    32
-                ),
-                dfsan_union(
-                    second_block,
-                    CONST_LABEL,
-                    Shl,
-                    64,
-                    op1,
-                    32
-                ),
-                Or,
-                64,
-                0,
-                0
-            );
-        default:
-            g_assert_not_reached();
-    }
+    g_assert(length == 2 || length == 4);
+    return dfsan_union(op1_label, CONST_LABEL, BSwap, 32, 0, length);
 }
 
 uint64_t HELPER(symsan_bswap_i64)(uint64_t op1, uint64_t op1_label, uint64_t length)
 {
     if (op1_label == 0) return 0;
-    uint64_t arg1, arg2, tmp, tmp1, tmp2, first_block, second_block;
-    switch (length) {
-        case 2:
-            arg1 = dfsan_union(
-                dfsan_union(op1_label, CONST_LABEL, ZExt, 64, op1, 1),
-                CONST_LABEL,
-                Shl,
-                64,
-                op1,
-                8);
-            arg2 = dfsan_union(
-                op1_label,
-                CONST_LABEL,
-                LShr,
-                64,
-                op1,
-                8);
-            return dfsan_union(arg1, arg2, Or, 64, 0, 0);
-        case 4:
-            tmp = dfsan_union(op1_label, CONST_LABEL, LShr, 64, op1, 8);
-            arg1 = dfsan_union(
-                tmp,
-                CONST_LABEL,
-                And,
-                64,
-                op1,
-                0x00ff00ff
-            );
-            arg2 = dfsan_union(
-                dfsan_union(op1_label, CONST_LABEL, And, 64, op1, 0x00ff00ff),
-                CONST_LABEL,
-                Shl,
-                64,
-                op1,
-                8
-            );
-            first_block = dfsan_union(arg1, arg2, Or, 64, 0, 0);
-            tmp1 = dfsan_union(first_block, CONST_LABEL, LShr, 64, op1, 16);
-            tmp2 = dfsan_union(
-                dfsan_union(first_block, CONST_LABEL, Shl, 64, op1, 48),
-                CONST_LABEL,
-                LShr,
-                64,
-                op1,
-                32
-            );
-            return dfsan_union(tmp1, tmp2, Or, 64, 0, 0);
-        case 8:
-            tmp1 = dfsan_union(
-                dfsan_union(op1_label, CONST_LABEL, LShr, 64, op1, 8),
-                CONST_LABEL,
-                And,
-                64,
-                op1,
-                0x00ff00ff00ff00ffull
-            );
-            tmp2 = dfsan_union(
-                dfsan_union(op1_label, CONST_LABEL, And, 64, op1, 0x00ff00ff00ff00ffull),
-                CONST_LABEL,
-                Shl,
-                64,
-                op1,
-                8
-            );
-            first_block = dfsan_union(tmp1, tmp2, Or, 64, 0, 0);
-            tmp1 = dfsan_union(
-                dfsan_union(first_block, CONST_LABEL, LShr, 64, op1, 16),
-                CONST_LABEL,
-                And,
-                64,
-                op1,
-                0x0000ffff0000ffffull
-            );
-            tmp2 = dfsan_union(
-                dfsan_union(first_block, CONST_LABEL, And, 64, op1, 0x0000ffff0000ffffull),
-                CONST_LABEL,
-                Shl,
-                64,
-                op1,
-                16
-            );
-            second_block = dfsan_union(tmp1, tmp2, Or, 64, 0, 0);
-            return dfsan_union(
-                dfsan_union(
-                    second_block,
-                    CONST_LABEL,
-                    LShr,
-                    64,
-                    op1,
-                    32
-                ),
-                dfsan_union(
-                    second_block,
-                    CONST_LABEL,
-                    Shl,
-                    64,
-                    op1,
-                    32
-                ),
-                Or,
-                64,
-                0,
-                0
-            );
-        default:
-            g_assert_not_reached();
-    }
+    g_assert(length == 2 || length == 4 || length == 8);
+    return dfsan_union(op1_label, CONST_LABEL, BSwap, 64, 0, length);
 }
 
 /* Extract syntax
@@ -610,6 +379,8 @@ uint64_t HELPER(symsan_deposit_i64)(uint64_t arg1, uint64_t arg1_label,
     return dfsan_union(arg1_new_label, arg2_new_label, Or, 64, arg1 & ~(mask << ofs), (arg2 & mask) << ofs);
 }
 
+/* extract2 is a funnel shift: the low half of (ah:al) >> ofs. ofs travels in
+ * the high byte of the op, like the ICmp predicate. */
 uint64_t HELPER(symsan_extract2_i32)(uint32_t ah, uint64_t ah_label,
                                      uint32_t al, uint64_t al_label,
                                      uint64_t ofs)
@@ -617,16 +388,11 @@ uint64_t HELPER(symsan_extract2_i32)(uint32_t ah, uint64_t ah_label,
     if (ah_label == 0 && al_label == 0)
         return 0;
 
-    /* The implementation follows the alternative implementation of
-     * tcg_gen_extract2_i32 in tcg-op.c (which handles architectures that don't
-     * support extract2 directly). */
-
     if (ofs == 0)
         return al_label;
     if (ofs == 32)
         return ah_label;
-    uint64_t al_new = dfsan_union(al_label, CONST_LABEL, LShr, 32, al, ofs);
-    return HELPER(symsan_deposit_i32)(al >> ofs, al_new, ah, ah_label, 32-ofs, ofs);
+    return dfsan_union(ah_label, al_label, (ofs << 8) | FunnelShift, 32, ah, al);
 }
 
 uint64_t HELPER(symsan_extract2_i64)(uint64_t ah, uint64_t ah_label,
@@ -636,28 +402,36 @@ uint64_t HELPER(symsan_extract2_i64)(uint64_t ah, uint64_t ah_label,
     if (ah_label == 0 && al_label == 0)
         return 0;
 
-    /* The implementation follows the alternative implementation of
-     * tcg_gen_extract2_i64 in tcg-op.c (which handles architectures that don't
-     * support extract2 directly). */
-
     if (ofs == 0)
         return al_label;
     if (ofs == 64)
         return ah_label;
-    uint64_t al_new = dfsan_union(al_label, CONST_LABEL, LShr, 64, al, ofs);
-    return HELPER(symsan_deposit_i64)(al >> ofs, al_new, ah, ah_label, 64-ofs, ofs);
+    return dfsan_union(ah_label, al_label, (ofs << 8) | FunnelShift, 64, ah, al);
 }
 
 // Marco-compatible pipe communication
 static int __marco_pipe_fd = -1;
 static int __marco_ack_fd = -1;
 // Removed unused __marco_order variable
-static uint32_t __marco_ctxh = 0; /* call-stack context hash (TaintPass.cc style) */
 static uint64_t __marco_pp_state = 0; /* path-prefix rolling state */
 static uint32_t __marco_max_label = 0; /* Marco-compatible: max label in current trace (reset per trace) */
-/* small ring buffer to dedup pp_hash (untaken_update_ifsat) like path-prefix check */
-#define SEEN_PP_CAP 256
-static uint32_t __marco_seen_pp[SEEN_PP_CAP];
+/* Path-prefix digests seen in the current trace, as a cuckoo filter: 4-slot
+ * buckets of 16-bit fingerprints, two candidate buckets per digest, so a
+ * lookup reads at most 8 slots. MARCO_PP_FILTER_BITS sets log2 of the bucket
+ * count (default 10, 4096 digests in 8KB). When an insert cannot place its
+ * last evicted fingerprint, that one is dropped and counted; lookups can
+ * then miss it, like the old ring once it wrapped. */
+#define PP_FILTER_SLOTS 4
+#define PP_FILTER_MAX_KICKS 128
+#define PP_FILTER_DEFAULT_BITS 10
+typedef struct {
+    uint16_t fp[PP_FILTER_SLOTS];
+} pp_bucket_t;
+static pp_bucket_t *__marco_seen_pp = NULL;
+static uint32_t __marco_seen_pp_mask = 0;   /* bucket count - 1 */
+static uint32_t __marco_seen_pp_size = 0;   /* fingerprints stored */
+static uint32_t __marco_seen_pp_dropped = 0;
+static uint32_t __marco_seen_pp_hits = 0; /* flips reported as already taken */
 
 /* Marco-compatible: track branch order per (context, PC) pair
  * Similar to Marco's __branches map: key={__taint_trace_callstack, addr}, value=order
@@ -788,8 +562,6 @@ static inline void reset_branch_orders(void) {
     }
     __marco_branch_orders_count = 0;  /* Reset entry count */
 }
-static uint32_t __marco_seen_pp_size = 0;
-static uint32_t __marco_seen_pp_idx = 0;
 
 /* Marco-compatible: bitmap and virgin_map for isInterestingBranch */
 #define MARCO_BITMAP_SIZE 65536
@@ -804,11 +576,16 @@ static uint32_t __marco_prev_loc = 0;
 static uint32_t __marco_visited_set[256];  /* simplified visited set */
 static uint32_t __marco_visited_size = 0;
 
-/* Call stack tracking for context-sensitive hashing (TaintPass.cc style) */
-#define CALL_STACK_DEPTH 32
-static uint64_t __marco_call_stack[CALL_STACK_DEPTH];  /* PC addresses in call stack */
-static uint32_t __marco_call_depth = 0;  /* Current call stack depth */
-static uint64_t __marco_last_pc = 0;  /* Last PC for detecting call/ret */
+/* Symbolic table lookups already turned into Select chains; digest covers
+ * the table bytes at the time */
+#define SYMMEM_MEMO_SIZE 64
+typedef struct {
+    uint64_t digest;
+    uint32_t addr_label;
+    uint32_t length;
+    uint32_t label;
+} symmem_memo_t;
+static symmem_memo_t __marco_symmem_memo[SYMMEM_MEMO_SIZE];
 
 /* Branch dependency tracking for extra field generation (Marco style) */
 #define CONST_OFFSET 0x80000000
@@ -1130,20 +907,98 @@ static void generate_extra_field(dfsan_label label, uint32_t tkdir, char *extra,
     }
 }
 
-static inline int seen_pp_before(uint32_t h) {
-    for (uint32_t i = 0; i < __marco_seen_pp_size; ++i) {
-        if (__marco_seen_pp[i] == h) return 1;
+static int pp_filter_init(void) {
+    if (__marco_seen_pp) return 1;
+    uint32_t bits = PP_FILTER_DEFAULT_BITS;
+    const char *env = getenv("MARCO_PP_FILTER_BITS");
+    if (env && env[0] != '\0') {
+        int v = atoi(env);
+        if (v >= 4 && v <= 24) {
+            bits = v;
+        } else {
+            fprintf(stderr, "[SymFit] MARCO_PP_FILTER_BITS=%s out of range 4..24, using %u\n",
+                    env, bits);
+        }
+    }
+    __marco_seen_pp = calloc((size_t)1 << bits, sizeof(pp_bucket_t));
+    if (__marco_seen_pp == NULL) return 0;
+    __marco_seen_pp_mask = (1u << bits) - 1;
+    return 1;
+}
+
+static void pp_filter_reset(void) {
+    if (__marco_seen_pp) {
+        memset(__marco_seen_pp, 0, sizeof(pp_bucket_t) * (__marco_seen_pp_mask + 1));
+    }
+    __marco_seen_pp_size = 0;
+    __marco_seen_pp_dropped = 0;
+    __marco_seen_pp_hits = 0;
+}
+
+/* the fingerprint is never 0, which marks an empty slot */
+static inline uint16_t pp_fingerprint(uint64_t h) {
+    uint16_t fp = (uint16_t)(h >> 48);
+    return fp ? fp : 1;
+}
+
+/* the other candidate bucket, computable from either one and the fingerprint */
+static inline uint32_t pp_alt_bucket(uint32_t i, uint16_t fp) {
+    return (i ^ (uint32_t)(fp * 0x5bd1e995u)) & __marco_seen_pp_mask;
+}
+
+static inline int pp_bucket_has(uint32_t i, uint16_t fp) {
+    const pp_bucket_t *b = &__marco_seen_pp[i];
+    return b->fp[0] == fp || b->fp[1] == fp || b->fp[2] == fp || b->fp[3] == fp;
+}
+
+static inline int pp_bucket_put(uint32_t i, uint16_t fp) {
+    pp_bucket_t *b = &__marco_seen_pp[i];
+    for (int s = 0; s < PP_FILTER_SLOTS; s++) {
+        if (b->fp[s] == 0) {
+            b->fp[s] = fp;
+            return 1;
+        }
     }
     return 0;
 }
 
-static inline void remember_pp(uint32_t h) {
-    if (__marco_seen_pp_size < SEEN_PP_CAP) {
-        __marco_seen_pp[__marco_seen_pp_size++] = h;
-    } else {
-        __marco_seen_pp[__marco_seen_pp_idx++] = h;
-        if (__marco_seen_pp_idx >= SEEN_PP_CAP) __marco_seen_pp_idx = 0;
+static inline int seen_pp_before(uint64_t h) {
+    if (__marco_seen_pp == NULL) return 0;
+    uint16_t fp = pp_fingerprint(h);
+    uint32_t i1 = (uint32_t)h & __marco_seen_pp_mask;
+    return pp_bucket_has(i1, fp) || pp_bucket_has(pp_alt_bucket(i1, fp), fp);
+}
+
+static void remember_pp(uint64_t h) {
+    if (!pp_filter_init() || seen_pp_before(h)) return;
+    uint16_t fp = pp_fingerprint(h);
+    uint32_t i = (uint32_t)h & __marco_seen_pp_mask;
+    if (pp_bucket_put(i, fp) || pp_bucket_put(pp_alt_bucket(i, fp), fp)) {
+        __marco_seen_pp_size++;
+        return;
     }
+    /* both full: move residents to their other bucket until one fits */
+    for (int kick = 0; kick < PP_FILTER_MAX_KICKS; kick++) {
+        pp_bucket_t *b = &__marco_seen_pp[i];
+        int s = (fp ^ kick) & (PP_FILTER_SLOTS - 1);
+        uint16_t victim = b->fp[s];
+        b->fp[s] = fp;
+        fp = victim;
+        i = pp_alt_bucket(i, fp);
+        if (pp_bucket_put(i, fp)) {
+            __marco_seen_pp_size++;
+            return;
+        }
+    }
+    __marco_seen_pp_dropped++;
+}
+
+/* chance that a digest never remembered is reported as seen */
+static double pp_filter_fpr(void) {
+    if (__marco_seen_pp == NULL) return 0.0;
+    double load = (double)__marco_seen_pp_size /
+                  ((double)(__marco_seen_pp_mask + 1) * PP_FILTER_SLOTS);
+    return 2.0 * PP_FILTER_SLOTS * load / 65535.0;
 }
 
 /* simple 64-bit mix */
@@ -1191,7 +1046,7 @@ static inline uint64_t roll_in_pp(uint64_t pc, uint32_t label, uint32_t taken) {
     taken_digest = __marco_pp_state;
     
     /* Marco-compatible: mark taken branch as visited */
-    remember_pp((uint32_t)(taken_digest & 0xffffffffu));
+    remember_pp(taken_digest);
     
     /* return untaken digest (for untaken_update_ifsat) */
     return untaken_digest;
@@ -1316,102 +1171,12 @@ static inline uint32_t compute_label_depth(dfsan_label l) {
     return info->depth;
 }
 
-/* Hash a PC address to generate a call site ID (similar to random() in TaintPass.cc) */
-static inline uint32_t hash_pc_to_call_site_id(uint64_t pc) {
-    /* Simple hash function to generate a pseudo-random call site ID */
-    uint32_t h = (uint32_t)(pc & 0xffffffffu);
-    h ^= h >> 16;
-    h *= 0x85ebca6b;
-    h ^= h >> 13;
-    h *= 0xc2b2ae35;
-    h ^= h >> 16;
-    return h;
-}
-
-/* Update context hash on function call (TaintPass.cc style: ctx ^ call_site_id) */
-static inline void update_context_on_call(uint64_t call_pc) {
-    uint32_t call_site_id = hash_pc_to_call_site_id(call_pc);
-    uint32_t old_ctxh = __marco_ctxh;
-    
-    /* Push to call stack */
-    if (__marco_call_depth < CALL_STACK_DEPTH) {
-        __marco_call_stack[__marco_call_depth++] = call_pc;
-    } else {
-        /* Stack overflow: replace oldest entry (simple FIFO) */
-        memmove(__marco_call_stack, __marco_call_stack + 1, 
-                (CALL_STACK_DEPTH - 1) * sizeof(uint64_t));
-        __marco_call_stack[CALL_STACK_DEPTH - 1] = call_pc;
-    }
-    
-    /* Update context hash: XOR with call site ID (TaintPass.cc style) */
-    __marco_ctxh = __marco_ctxh ^ call_site_id;
-    
-    if (qemu_loglevel_mask(CPU_LOG_SYM_BLK_CNT)) {
-        fprintf(stderr, "[ctxh] CALL: func_addr=0x%lx, call_site_id=%u, ctxh: %u -> %u (depth=%u)\n",
-                call_pc, call_site_id, old_ctxh, __marco_ctxh, __marco_call_depth);
-    }
-}
-
-/* Restore context hash on function return (TaintPass.cc style: restore original ctx) */
-static inline void restore_context_on_return(uint64_t ret_pc_unused) {
-    (void)ret_pc_unused;  /* Unused: we use the call stack instead */
-    if (__marco_call_depth > 0) {
-        /* Pop from call stack and restore context */
-        /* The call stack contains the function address (not call site PC) */
-        uint64_t func_addr = __marco_call_stack[--__marco_call_depth];
-        uint32_t call_site_id = hash_pc_to_call_site_id(func_addr);
-        uint32_t old_ctxh = __marco_ctxh;
-        
-        /* Restore context hash: XOR again to remove the call site ID */
-        __marco_ctxh = __marco_ctxh ^ call_site_id;
-        
-        if (qemu_loglevel_mask(CPU_LOG_SYM_BLK_CNT)) {
-            fprintf(stderr, "[ctxh] RET: func_addr=0x%lx, call_site_id=%u, ctxh: %u -> %u (depth=%u)\n",
-                    func_addr, call_site_id, old_ctxh, __marco_ctxh, __marco_call_depth);
-        }
-    }
-}
-
-/* Update context hash based on PC changes (heuristic for call/ret detection) */
-static inline void update_context_from_pc(uint64_t pc) {
-    if (__marco_last_pc == 0) {
-        /* First call: initialize */
-        __marco_last_pc = pc;
-        return;
-    }
-    
-    /* Simple heuristic: detect large PC jumps as potential call/ret */
-    uint64_t pc_diff = (pc > __marco_last_pc) ? (pc - __marco_last_pc) : (__marco_last_pc - pc);
-    
-    /* If PC changed significantly (likely a call/jump), update context */
-    /* Threshold: 0x1000 (4KB) - typical function size is larger than this */
-    /* This is a heuristic - in real implementation, we'd need proper call/ret hooks */
-    if (pc_diff > 0x1000) {
-        /* Large jump: could be a call or return */
-        /* Check if we're returning to a known call site (simple heuristic) */
-        int is_return = 0;
-        if (__marco_call_depth > 0) {
-            /* Check if current PC is near a known call site (within 0x100 bytes) */
-            for (int i = __marco_call_depth - 1; i >= 0; i--) {
-                uint64_t call_site = __marco_call_stack[i];
-                uint64_t ret_diff = (pc > call_site) ? (pc - call_site) : (call_site - pc);
-                if (ret_diff < 0x100) {
-                    /* Likely a return to a known call site */
-                    is_return = 1;
-                    break;
-                }
-            }
-        }
-        
-        if (is_return) {
-            restore_context_on_return(pc);
-        } else {
-            /* Treat as a function call */
-            update_context_on_call(pc);
-        }
-    }
-    
-    __marco_last_pc = pc;
+/* wp2/myfifo live in MARCO_PIPE_DIR (default /tmp), one set per orchestrator lane */
+static const char *marco_pipe_path(const char *name, char *buf, size_t len)
+{
+    const char *dir = getenv("MARCO_PIPE_DIR");
+    snprintf(buf, len, "%s/%s", (dir && dir[0] != '\0') ? dir : "/tmp", name);
+    return buf;
 }
 
 // Initialize Marco pipe for communication
@@ -1446,15 +1211,17 @@ static void init_marco_pipe(void) {
     
     // Marco's solve function reads from /tmp/wp2, not /tmp/pcpipe
     // /tmp/pcpipe is written by Marco's update_graph function after processing
-    __marco_pipe_fd = open("/tmp/wp2", O_WRONLY | O_APPEND);
+    char wp2_path[PATH_MAX];
+    marco_pipe_path("wp2", wp2_path, sizeof(wp2_path));
+    __marco_pipe_fd = open(wp2_path, O_WRONLY | O_APPEND);
     if (__marco_pipe_fd < 0) {
         // Try to create the pipe if it doesn't exist
-        int mkfifo_ret = mkfifo("/tmp/wp2", 0666);
+        int mkfifo_ret = mkfifo(wp2_path, 0666);
         if (mkfifo_ret < 0 && errno != EEXIST) {
-            fprintf(stderr, "[SymFit] ERROR: mkfifo('/tmp/wp2') failed: errno=%d (%s)\n", errno, strerror(errno));
+            fprintf(stderr, "[SymFit] ERROR: mkfifo('%s') failed: errno=%d (%s)\n", wp2_path, errno, strerror(errno));
             fflush(stderr);
         }
-        __marco_pipe_fd = open("/tmp/wp2", O_WRONLY | O_APPEND);
+        __marco_pipe_fd = open(wp2_path, O_WRONLY | O_APPEND);
         /* Debug: log open result */
         static int debug_open_count = 0;
         debug_open_count++;
@@ -1481,10 +1248,12 @@ static void init_marco_pipe(void) {
     
     // Open acknowledgment pipe for reading (only once, persistent)
     if (__marco_ack_fd < 0) {
-        __marco_ack_fd = open("/tmp/myfifo", O_RDONLY | O_NONBLOCK);
+        char ack_path[PATH_MAX];
+        marco_pipe_path("myfifo", ack_path, sizeof(ack_path));
+        __marco_ack_fd = open(ack_path, O_RDONLY | O_NONBLOCK);
         if (__marco_ack_fd < 0) {
-            mkfifo("/tmp/myfifo", 0666);
-            __marco_ack_fd = open("/tmp/myfifo", O_RDONLY | O_NONBLOCK);
+            mkfifo(ack_path, 0666);
+            __marco_ack_fd = open(ack_path, O_RDONLY | O_NONBLOCK);
         }
     }
 }
@@ -1784,15 +1553,18 @@ static void initialize_taint_from_file(void) {
     
     // Reset path-prefix / bitmap state (Marco process restarts per trace)
     __marco_pp_state = 0;
-    __marco_seen_pp_size = 0;
-    __marco_seen_pp_idx = 0;
-    memset(__marco_seen_pp, 0, sizeof(__marco_seen_pp));
+    uint32_t prev_seen_pp = __marco_seen_pp_size;
+    uint32_t prev_dropped_pp = __marco_seen_pp_dropped;
+    uint32_t prev_hits_pp = __marco_seen_pp_hits;
+    double prev_pp_fpr = pp_filter_fpr();
+    pp_filter_reset();
     memset(__marco_bitmap, 0, sizeof(__marco_bitmap));
     memset(__marco_virgin_map, 0, sizeof(__marco_virgin_map));
     memset(__marco_trace_map, 0, sizeof(__marco_trace_map));
     memset(__marco_context_map, 0, sizeof(__marco_context_map));
     __marco_prev_loc = 0;
     __marco_visited_size = 0;
+    memset(__marco_symmem_memo, 0, sizeof(__marco_symmem_memo));
 
     // Clear cached branch dependencies so next trace recomputes them
     if (__marco_branch_deps != NULL) {
@@ -1805,9 +1577,10 @@ static void initialize_taint_from_file(void) {
     
     // Marco-compatible: reset context hash for new trace
     // Marco resets __taint_trace_callstack per trace (starts at 0)
-    __marco_ctxh = 0;
-    __marco_call_depth = 0;
-    __marco_last_pc = 0;
+    if (global_env) {
+        global_env->marco_ctxh = 0;
+        global_env->marco_ctx_depth = 0;
+    }
     
     // Marco-compatible: Close and reopen /tmp/wp2 for each new trace
     // This ensures FastGen's solve() sees EOF after each trace, matching Marco's behavior
@@ -1821,10 +1594,11 @@ static void initialize_taint_from_file(void) {
     FILE *reset_log_fp = fopen("/tmp/symfit_traceid_debug.log", "a");
     if (reset_log_fp) {
         fprintf(reset_log_fp,
-                "[SymFit] RESET TRACE: filename='%s' ctxh=%u pp_state=%lu seen_pp_size=%u branch_orders=%u\n",
-                filename, __marco_ctxh,
+                "[SymFit] RESET TRACE: filename='%s' ctxh=%u pp_state=%lu "
+                "prev_seen_pp=%u dropped=%u hits=%u fpr=%.2e branch_orders=%u\n",
+                filename, global_env ? global_env->marco_ctxh : 0,
                 (unsigned long)__marco_pp_state,
-                __marco_seen_pp_size,
+                prev_seen_pp, prev_dropped_pp, prev_hits_pp, prev_pp_fpr,
                 __marco_branch_orders_count);
         fflush(reset_log_fp);
         fclose(reset_log_fp);
@@ -1833,6 +1607,126 @@ static void initialize_taint_from_file(void) {
     __taint_initialized = 1;
 }
 
+/*
+ * Fork server for FastGen tracking runs (SYMFIT_FORKSRV_SOCKET_PATH).
+ *
+ * Speaks the same socket protocol as Angora's forkcli: FastGen listens,
+ * we connect, and each run is requested with FORKSRV_NEW_CHILD. The request
+ * is followed by a little-endian u32 length and the run's TAINT_OPTIONS, so
+ * per-seed parameters travel over the socket instead of a fresh exec. We
+ * answer with the child pid and later its waitpid() status. A short read
+ * (FastGen's FIN or a closed socket) ends the server.
+ *
+ * Called from linux-user main() right before cpu_loop(): the guest is loaded
+ * but no guest code has run, so the taint state inherited by every child is
+ * pristine and only dfsan's per-run state needs to be rebuilt.
+ */
+#define SYMFIT_FORKSRV_SOCKET_VAR "SYMFIT_FORKSRV_SOCKET_PATH"
+#define SYMFIT_FORKSRV_MAX_OPTIONS 4096
+
+static bool forksrv_read_full(int fd, void *buf, size_t len)
+{
+    char *p = buf;
+    while (len > 0) {
+        ssize_t n = read(fd, p, len);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool forksrv_write_full(int fd, const void *buf, size_t len)
+{
+    const char *p = buf;
+    while (len > 0) {
+        ssize_t n = write(fd, p, len);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        len -= n;
+    }
+    return true;
+}
+
+void symsan_forkserver(void)
+{
+    static const uint8_t new_child[4] = {8, 8, 8, 8};
+    static char options[SYMFIT_FORKSRV_MAX_OPTIONS + 1];
+    struct sockaddr_un addr;
+    const char *path = getenv(SYMFIT_FORKSRV_SOCKET_VAR);
+
+    if (!path || path[0] == '\0') {
+        return;
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    pstrcpy(addr.sun_path, sizeof(addr.sun_path), path);
+    if (sock < 0 || connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        fprintf(stderr, "[SymFit] WARNING: fork server: cannot connect to %s: %s, running once\n",
+                path, strerror(errno));
+        if (sock >= 0) {
+            close(sock);
+        }
+        return;
+    }
+    /* children must not see the variable, or a nested symqemu would connect too */
+    unsetenv(SYMFIT_FORKSRV_SOCKET_VAR);
+    /* mapped here so every child counts into the server's block */
+    marco_metrics_get();
+
+    for (;;) {
+        uint8_t req[4];
+        uint32_t len;
+        int32_t status = 0;
+
+        if (!forksrv_read_full(sock, req, sizeof(req)) ||
+            memcmp(req, new_child, sizeof(req)) != 0 ||
+            !forksrv_read_full(sock, &len, sizeof(len)) ||
+            len > SYMFIT_FORKSRV_MAX_OPTIONS ||
+            !forksrv_read_full(sock, options, len)) {
+            _exit(0);
+        }
+        options[len] = '\0';
+
+        pid_t child = fork();
+        if (child == 0) {
+            close(sock);
+            setenv("TAINT_OPTIONS", options, 1);
+            dfsan_forkserver_reset();
+            marco_count(MM_EXECUTIONS, 1);
+            return;
+        }
+
+        int32_t pid = child;
+        if (!forksrv_write_full(sock, &pid, sizeof(pid))) {
+            _exit(1);
+        }
+        if (child < 0) {
+            continue;
+        }
+        while (waitpid(child, &status, 0) < 0) {
+            if (errno != EINTR) {
+                _exit(1);
+            }
+        }
+        if (!forksrv_write_full(sock, &status, sizeof(status))) {
+            _exit(1);
+        }
+    }
+}
+
 static uint64_t symsan_setcond_internal(CPUArchState *env, uint64_t arg1, uint64_t arg1_label,
                                      uint64_t arg2, uint64_t arg2_label,
                                      int32_t cond, uint64_t result, uint8_t result_bits, uint64_t pc)
@@ -1842,9 +1736,8 @@ static uint64_t symsan_setcond_internal(CPUArchState *env, uint64_t arg1, uint64
     // Then initialize Marco pipe (will reopen /tmp/wp2 if needed)
     init_marco_pipe();
     
-    // Note: Context hash (__marco_ctxh) is updated via HELPER(symsan_notify_call/return)
-    // in TCG translation phase, so we just use the current value here
-    // No need to call update_context_from_pc() - rely on proper call/return hooks
+    // Note: env->marco_ctxh is kept up to date by the call/ret code that
+    // target/i386/translate.c emits inline, so we just use the current value
     
     // Determine predicate (Marco-compatible encoding)
     // IMPORTANT: Marco's logic checks union result, not input labels
@@ -1931,6 +1824,15 @@ static uint64_t symsan_setcond_internal(CPUArchState *env, uint64_t arg1, uint64
         fflush(stderr);
     }
     
+    /* every branch rolls into the path prefix. The filter only feeds the
+     * per-trace statistics: a hit on a symbolic flip is a false positive of
+     * the filter, and FastGen dedups on its own digests, so the record is
+     * always written */
+    uint64_t untaken_digest = roll_in_pp(pc, temp_label, result ? 1 : 0);
+    if (temp_label != 0 && seen_pp_before(untaken_digest)) {
+        __marco_seen_pp_hits++;
+    }
+
     // Always write to /tmp/wp2, even if temp_label==0 (concrete branch)
     // This matches our modification to update_graph() which now accepts label==0 branches
     if (__marco_pipe_fd >= 0) {
@@ -1960,9 +1862,7 @@ static uint64_t symsan_setcond_internal(CPUArchState *env, uint64_t arg1, uint64
             fflush(stderr);
         }
         
-        /* Context hash is now updated via HELPER(symsan_notify_call/return) 
-         * in TCG translation phase, so we just use the current value */
-        uint64_t ctxh_val = __marco_ctxh;
+        uint64_t ctxh_val = env->marco_ctxh;
         uint32_t tkdir = result ? 1 : 0;
         
         /* Marco-compatible: get order for (ctxh, addr) pair
@@ -2060,6 +1960,7 @@ static uint64_t symsan_setcond_internal(CPUArchState *env, uint64_t arg1, uint64
         
         if (n > 0 && n < (int)sizeof(rec)) {
             if (__marco_pipe_fd < 0) {
+                marco_count(MM_BRANCH_WRITE_ERRORS, 1);
                 static int debug_pipe_fd_error_count = 0;
                 if (debug_pipe_fd_error_count++ < 5) {
                     fprintf(stderr, "[SymFit] ERROR: __marco_pipe_fd=%d, cannot write to /tmp/wp2\n", __marco_pipe_fd);
@@ -2068,9 +1969,12 @@ static uint64_t symsan_setcond_internal(CPUArchState *env, uint64_t arg1, uint64
             } else {
                 ssize_t wret = write(__marco_pipe_fd, rec, (size_t)n);
                 if (wret < 0) {
+                    marco_count(MM_BRANCH_WRITE_ERRORS, 1);
                     fprintf(stderr, "[SymFit] ERROR: write to /tmp/wp2 failed: errno=%d (%s)\n", errno, strerror(errno));
                     fflush(stderr);
                 } else {
+                    marco_count(MM_BRANCHES_EMITTED, 1);
+                    if (label) marco_count(MM_BRANCHES_SYMBOLIC, 1);
                     static int debug_write_success_count = 0;
                     if (debug_write_success_count++ < 5) {
                         fprintf(stderr, "[SymFit] Successfully wrote %zd bytes to /tmp/wp2\n", wret);
@@ -2115,6 +2019,164 @@ uint64_t HELPER(symsan_setcond_i64)(CPUArchState *env, uint64_t arg1, uint64_t a
     return symsan_setcond_internal(env, arg1, arg1_label, arg2, arg2_label, cond, result, 64, pc);
 }
 
+/*
+ * Symbolic table lookups. A load whose address is base + zext(idx) * scale,
+ * with idx at most 8 bits wide (table[input[i]] in lexers, CRCs, base64
+ * decoders), becomes a chain of Select nodes over the table contents,
+ *   addr == base ? table[0] : addr == base + scale ? table[1] : ...
+ * instead of pinning the address with an Equal constraint. The table has to
+ * be readable, untainted and span at most MARCO_SYMMEM_MAX bytes (default
+ * 1024, capped at a page, 0 turns this off); anything else is concretized.
+ */
+#define SYMMEM_DEFAULT_MAX 1024
+#define SYMMEM_INDEX_BITS 8
+
+static uint64_t symmem_max(void)
+{
+    static int64_t max = -1;
+    if (max < 0) {
+        max = SYMMEM_DEFAULT_MAX;
+        const char *env = getenv("MARCO_SYMMEM_MAX");
+        if (env && env[0] != '\0') {
+            max = atoll(env);
+            if (max < 0 || max > TARGET_PAGE_SIZE) {
+                fprintf(stderr, "[SymFit] MARCO_SYMMEM_MAX=%s out of range 0..%d, using %d\n",
+                        env, (int)TARGET_PAGE_SIZE, SYMMEM_DEFAULT_MAX);
+                max = SYMMEM_DEFAULT_MAX;
+            }
+        }
+    }
+    return max;
+}
+
+/* split addr_label into base + zext(idx) * scale, 0 if it has another shape */
+static int symmem_table_shape(dfsan_label label, uint64_t *base, uint64_t *scale,
+                              uint32_t *entries)
+{
+    dfsan_label_info *info = dfsan_get_label_info(label);
+    uint64_t b = 0, sc = 1;
+    uint32_t bits;
+
+    while (info->op == Add && (info->l1 == CONST_LABEL || info->l2 == CONST_LABEL)) {
+        if (info->l1 == CONST_LABEL) {
+            b += info->op1.i;
+            label = info->l2;
+        } else {
+            b += info->op2.i;
+            label = info->l1;
+        }
+        info = dfsan_get_label_info(label);
+    }
+    if (info->op == Shl && info->l2 == CONST_LABEL && info->op2.i < 4) {
+        sc = 1ull << info->op2.i;
+        info = dfsan_get_label_info(info->l1);
+    } else if (info->op == Mul && (info->l1 == CONST_LABEL || info->l2 == CONST_LABEL)) {
+        sc = info->l1 == CONST_LABEL ? info->op1.i : info->op2.i;
+        info = dfsan_get_label_info(info->l1 == CONST_LABEL ? info->l2 : info->l1);
+        if (sc == 0 || sc > 16) {
+            return 0;
+        }
+    }
+    while (info->op == ZExt) {
+        info = dfsan_get_label_info(info->l1);
+    }
+    if (info->op == And && info->l2 == CONST_LABEL && info->op2.i != 0) {
+        bits = 64 - __builtin_clzll(info->op2.i);
+    } else if (info->op == And && info->l1 == CONST_LABEL && info->op1.i != 0) {
+        bits = 64 - __builtin_clzll(info->op1.i);
+    } else {
+        bits = info->size;
+    }
+    if (bits == 0 || bits > SYMMEM_INDEX_BITS) {
+        return 0;
+    }
+    *base = b;
+    *scale = sc;
+    *entries = 1u << bits;
+    return 1;
+}
+
+static uint64_t symmem_entry(const uint8_t *p, uint64_t length)
+{
+    uint64_t v = 0;
+    memcpy(&v, p, length);  /* little-endian host and guest */
+    return v;
+}
+
+/* Returns 1 and the label of the loaded value if the table could be modelled */
+static int symmem_load(target_ulong addr, dfsan_label addr_label, uint64_t load_length,
+                       dfsan_label *out)
+{
+    uint64_t base, scale, span, digest;
+    uint32_t entries, k;
+    const uint8_t *host;
+    const uint32_t *shadow;
+
+    if (load_length == 0 || load_length > 8 ||
+        !symmem_table_shape(addr_label, &base, &scale, &entries)) {
+        return 0;
+    }
+    span = (entries - 1) * scale + load_length;
+    if (span > symmem_max() || addr < base || (addr - base) % scale != 0 ||
+        (addr - base) / scale >= entries ||
+        page_check_range(base, span, PAGE_READ) != 0) {
+        return 0;
+    }
+    host = g2h(base);
+    shadow = shadow_for((uint64_t)(uintptr_t)host);
+    digest = 0xcbf29ce484222325ull;
+    for (k = 0; k < span; k++) {
+        if (shadow[k] != CONST_LABEL) {
+            return 0;
+        }
+        digest = (digest ^ host[k]) * 0x100000001b3ull;
+    }
+
+    symmem_memo_t *memo = &__marco_symmem_memo[addr_label & (SYMMEM_MEMO_SIZE - 1)];
+    if (memo->addr_label == addr_label && memo->length == load_length &&
+        memo->digest == digest) {
+        *out = memo->label;
+        return 1;
+    }
+
+    /* built from the last entry backwards, runs of the same value at the end
+     * collapse into the final else */
+    uint16_t size = load_length * 8;
+    uint16_t addr_size = dfsan_get_label_info(addr_label)->size;
+    uint64_t other = symmem_entry(host + (entries - 1) * scale, load_length);
+    dfsan_label chain = CONST_LABEL;
+    for (k = entries - 1; k-- > 0;) {
+        uint64_t v = symmem_entry(host + k * scale, load_length);
+        if (chain == CONST_LABEL && v == other) {
+            continue;
+        }
+        dfsan_label cond = dfsan_union(addr_label, CONST_LABEL, (bveq << 8) | ICmp,
+                                       addr_size, 0, base + k * scale);
+        chain = dfsan_union(cond, chain, Select, size, v,
+                            chain == CONST_LABEL ? other : 0);
+    }
+
+    memo->digest = digest;
+    memo->addr_label = addr_label;
+    memo->length = load_length;
+    memo->label = chain;
+    *out = chain;
+    return 1;
+}
+
+/* The common case of a guest access: no byte in range carries a label.
+ * Checked here instead of going through dfsan_read_label, which may build
+ * union nodes we do not need. */
+static inline bool shadow_is_clear(const void *host_addr, uint64_t length)
+{
+    const uint32_t *ls = shadow_for((uint64_t)(uintptr_t)host_addr);
+    uint32_t acc = 0;
+    for (uint64_t i = 0; i < length; i++) {
+        acc |= ls[i];
+    }
+    return acc == CONST_LABEL;
+}
+
 /* Guest memory opreation */
 static uint64_t symsan_load_guest_internal(CPUArchState *env, target_ulong addr, uint64_t addr_label,
                                      uint64_t load_length, uint8_t result_length)
@@ -2122,22 +2184,21 @@ static uint64_t symsan_load_guest_internal(CPUArchState *env, target_ulong addr,
     void *host_addr = g2h(addr);
     
     if (addr_label) {
+        dfsan_label table_label;
+        if (symmem_load(addr, addr_label, load_length, &table_label)) {
+            return table_label;
+        }
         // fprintf(stderr, "sym load addr 0x%lx eip 0x%lx\n", addr, env->eip);
         dfsan_label addr_label_new = \
             dfsan_union(addr_label, CONST_LABEL, Equal, 64, addr, 0);
         __taint_trace_cmp(addr_label_new, CONST_LABEL, 64, true, Equal, 0, 0, env->eip);
     }
 
-    uint64_t res_label = dfsan_read_label((uint8_t*)host_addr, load_length);
-    
-    // Debug: log memory load label (first 50 times)
-    static int debug_load_count = 0;
-    if (debug_load_count++ < 50) {
-        fprintf(stderr, "[SymFit] DEBUG load_guest: addr=0x%llx, host_addr=%p, load_length=%llu, res_label=%llu\n",
-                (unsigned long long)addr, host_addr, (unsigned long long)load_length, (unsigned long long)res_label);
-        fflush(stderr);
+    uint64_t res_label = CONST_LABEL;
+    if (!shadow_is_clear(host_addr, load_length)) {
+        res_label = dfsan_read_label((uint8_t*)host_addr, load_length);
     }
-    
+
     if (qemu_loglevel_mask(CPU_LOG_SYM_LDST_GUEST) && !noSymbolicData) {
         fprintf(stderr, "[memtrace:symbolic]op: load_guest_i%d addr: 0x%lx host_addr: %p size: %ld memory_expr: %ld\n",
                      result_length*8, addr, host_addr, load_length, res_label);
@@ -2197,7 +2258,12 @@ static void symsan_store_guest_internal(CPUArchState *env, uint64_t value_label,
     //void *host_addr = tlb_vaddr_to_host(env, addr, MMU_DATA_STORE, mmu_idx);
     void *host_addr = g2h(addr);
     assert((uintptr_t)host_addr >= 0x700000040000);
-    dfsan_store_label(value_label, (uint8_t*)host_addr, length);
+    if (value_label == CONST_LABEL) {
+        /* what __taint_union_store does for a concrete value */
+        memset(shadow_for((uint64_t)(uintptr_t)host_addr), 0, length * sizeof(uint32_t));
+    } else {
+        dfsan_store_label(value_label, (uint8_t*)host_addr, length);
+    }
     // g_assert_not_reached();
 
 }
@@ -2239,6 +2305,461 @@ void HELPER(symsan_store_host_i64)(uint64_t value_label,
 }
 
 
+/* MARCO_SUMMARIZE: code to summarize, a comma-separated list of hex PC
+ * ranges (0x7ffff7dd0000-0x7ffff7df0000) and module names. A name matches
+ * the file name of an ELF image or executable file mapping, either exactly
+ * or up to a '.' or '-' ("libc" covers libc.so.6 and libc-2.31.so, not
+ * libcrypto.so). Symbolic TBs starting there keep propagating data labels,
+ * but comparisons give concrete results and no branch records, and memory
+ * addresses are used concretely, without an Equal constraint or a Select
+ * table. Unset, everything is translated with full precision. */
+#define SUMMARIZE_MAX_RANGES 64
+#define SUMMARIZE_MAX_NAMES 16
+
+static struct { uint64_t lo, hi; } summarize_ranges[SUMMARIZE_MAX_RANGES];
+static int summarize_nranges;
+static char *summarize_names[SUMMARIZE_MAX_NAMES];
+static int summarize_nnames;
+
+static void summarize_add_range(uint64_t lo, uint64_t hi)
+{
+    if (summarize_nranges == SUMMARIZE_MAX_RANGES) {
+        fprintf(stderr, "[SymFit] MARCO_SUMMARIZE: more than %d ranges, ignoring 0x%lx-0x%lx\n",
+                SUMMARIZE_MAX_RANGES, (unsigned long)lo, (unsigned long)hi);
+        return;
+    }
+    summarize_ranges[summarize_nranges].lo = lo;
+    summarize_ranges[summarize_nranges].hi = hi;
+    summarize_nranges++;
+}
+
+static void summarize_init(void)
+{
+    static bool done;
+    char *spec, *tok, *save = NULL;
+
+    if (done) {
+        return;
+    }
+    done = true;
+    const char *env = getenv("MARCO_SUMMARIZE");
+    if (!env || env[0] == '\0') {
+        return;
+    }
+    spec = g_strdup(env);
+    for (tok = strtok_r(spec, ",", &save); tok; tok = strtok_r(NULL, ",", &save)) {
+        unsigned long long lo, hi;
+        int end = 0;
+
+        if (sscanf(tok, "%llx-%llx%n", &lo, &hi, &end) == 2 && tok[end] == '\0') {
+            if (lo < hi) {
+                summarize_add_range(lo, hi);
+            }
+        } else if (summarize_nnames < SUMMARIZE_MAX_NAMES) {
+            summarize_names[summarize_nnames++] = g_strdup(tok);
+        } else {
+            fprintf(stderr, "[SymFit] MARCO_SUMMARIZE: more than %d names, ignoring %s\n",
+                    SUMMARIZE_MAX_NAMES, tok);
+        }
+    }
+    g_free(spec);
+}
+
+bool symsan_summarize_pc(uint64_t pc)
+{
+    summarize_init();
+    for (int i = 0; i < summarize_nranges; i++) {
+        if (pc >= summarize_ranges[i].lo && pc < summarize_ranges[i].hi) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* called by the ELF loader and target_mmap for code mapped from a file */
+void symsan_summarize_module(const char *path, uint64_t start, uint64_t end)
+{
+    const char *base = strrchr(path, '/');
+
+    summarize_init();
+    base = base ? base + 1 : path;
+    for (int i = 0; i < summarize_nnames; i++) {
+        size_t len = strlen(summarize_names[i]);
+        if (strncmp(base, summarize_names[i], len) == 0 &&
+            (base[len] == '\0' || base[len] == '.' || base[len] == '-')) {
+            fprintf(stderr, "[SymFit] summarizing %s at 0x%lx-0x%lx\n",
+                    path, (unsigned long)start, (unsigned long)end);
+            summarize_add_range(start, end);
+            return;
+        }
+    }
+}
+
+/* Bulk x86 string instructions.
+ *
+ * rep movs/stos/cmps/scas are translated as one iteration per pass through
+ * the TB, each going through the load/store helpers above, and cmps/scas
+ * leave a branch record for every byte compared. When the count and pointer
+ * registers are concrete, the address size is flat and every byte of the run
+ * is mapped, the helpers below do the whole run at once: data and shadow are
+ * moved with memmove/memset semantics, the registers and flags end up as the
+ * loop would leave them, and 1 is returned so that the translated code
+ * leaves the instruction. On 0 nothing has been touched and the run takes
+ * the per-iteration path. */
+
+#define REP_MEMCMP_MAX 1024 /* data[] in FastGen's cons_type 2 reader */
+
+static inline uint32_t *guest_shadow(target_ulong addr)
+{
+    return shadow_for((uint64_t)(uintptr_t)g2h(addr));
+}
+
+static inline target_ulong rep_mask(uint32_t aflag)
+{
+    return aflag == MO_32 ? 0xffffffffu : (target_ulong)-1;
+}
+
+static inline void rep_set_reg(CPUArchState *env, int reg, target_ulong val,
+                               uint32_t aflag)
+{
+    env->regs[reg] = val & rep_mask(aflag);
+}
+
+/* lowest address of n elements of size bytes walked from addr, if they are
+ * all mapped with prot and do not wrap around the address size */
+static bool rep_range(target_ulong addr, uint64_t n, int size, int df,
+                      uint32_t aflag, int prot, target_ulong *lo)
+{
+    uint64_t len = n * size;
+    target_ulong start;
+
+    if (n > (1ull << 40)) {
+        return false;
+    }
+    if (df > 0) {
+        start = addr;
+    } else {
+        if (addr < (n - 1) * size) {
+            return false;
+        }
+        start = addr - (n - 1) * size;
+    }
+    if (start + len - 1 < start || ((start + len - 1) & ~rep_mask(aflag))) {
+        return false;
+    }
+    if (page_check_range(start, len, prot) != 0) {
+        return false;
+    }
+    *lo = start;
+    return true;
+}
+
+/* input offset of a label that is one raw input byte */
+static inline bool rep_input_byte(dfsan_label label, uint64_t *offset)
+{
+    dfsan_label_info *info;
+
+    if (label == CONST_LABEL) {
+        return false;
+    }
+    info = dfsan_get_label_info(label);
+    if (info->op != 0) {
+        return false;
+    }
+    *offset = info->op1.i;
+    return true;
+}
+
+/* the flags of the last CMP of the run, a - b on bytes; like a translated
+ * CMP, the label of cc_dst is left out until a reader needs it */
+static void rep_set_cmp_flags(CPUArchState *env, uint8_t a, uint8_t b,
+                              dfsan_label lb)
+{
+    env->cc_op = CC_OP_SUBB;
+    env->cc_src = b;
+    env->cc_dst = (target_ulong)a - b;
+    env->shadow_cc_src = lb;
+    env->shadow_cc_dst = CONST_LABEL;
+}
+
+/* A cons_type 2 record: FastGen sets input[offset + i] = data[i] for i < size.
+ * The label field carries the size and the direction field the offset. */
+static void rep_write_memcmp(CPUArchState *env, target_ulong pc,
+                             uint64_t offset, const uint8_t *data, uint32_t size)
+{
+    char rec[128 + REP_MEMCMP_MAX * 4];
+    uint16_t order;
+    int n;
+
+    if (symsan_summarize_pc(pc)) {
+        return;
+    }
+    order = get_branch_order(env->marco_ctxh, pc);
+
+    n = snprintf(rec, sizeof(rec), "%u, %u, %lu, %lu, %lu, %u, %u, %u, %lu,\n",
+                 __marco_queueid, size, (unsigned long)offset, (unsigned long)pc,
+                 (unsigned long)env->marco_ctxh, order, 2, __marco_traceid,
+                 (unsigned long)__marco_max_label);
+    for (uint32_t i = 0; i < size; i++) {
+        n += snprintf(rec + n, sizeof(rec) - n, i ? ",%u" : "%u", data[i]);
+    }
+    rec[n++] = '\n';
+
+    if (__marco_pipe_fd < 0 || write(__marco_pipe_fd, rec, (size_t)n) < 0) {
+        marco_count(MM_BRANCH_WRITE_ERRORS, 1);
+        return;
+    }
+    marco_count(MM_BRANCHES_EMITTED, 1);
+    marco_count(MM_BRANCHES_SYMBOLIC, 1);
+}
+
+uint32_t HELPER(symsan_rep_movs)(CPUArchState *env, uint32_t ot, uint32_t aflag,
+                                 target_ulong pc)
+{
+    target_ulong mask = rep_mask(aflag);
+    uint64_t n = env->regs[R_ECX] & mask;
+    int size = 1 << ot;
+    target_ulong step = (target_ulong)(env->df * size);
+    target_ulong src = env->regs[R_ESI] & mask;
+    target_ulong dst = env->regs[R_EDI] & mask;
+    target_ulong src_lo, dst_lo;
+    uint64_t len = n * size;
+
+    if (env->shadow_regs[R_ECX] || env->shadow_regs[R_ESI] ||
+        env->shadow_regs[R_EDI] ||
+        !rep_range(src, n, size, env->df, aflag, PAGE_READ, &src_lo) ||
+        !rep_range(dst, n, size, env->df, aflag, PAGE_WRITE, &dst_lo)) {
+        return 0;
+    }
+
+    if (dst_lo + len <= src_lo || src_lo + len <= dst_lo) {
+        memmove(g2h(dst_lo), g2h(src_lo), len);
+        memmove(guest_shadow(dst_lo), guest_shadow(src_lo), len * sizeof(uint32_t));
+    } else {
+        /* overlapping runs: what the loop does, one element at a time */
+        for (uint64_t i = 0; i < n; i++) {
+            target_ulong s = src + i * step, d = dst + i * step;
+            memmove(g2h(d), g2h(s), size);
+            memmove(guest_shadow(d), guest_shadow(s), size * sizeof(uint32_t));
+        }
+    }
+
+    rep_set_reg(env, R_ECX, 0, aflag);
+    rep_set_reg(env, R_ESI, src + n * step, aflag);
+    rep_set_reg(env, R_EDI, dst + n * step, aflag);
+    return 1;
+}
+
+uint32_t HELPER(symsan_rep_stos)(CPUArchState *env, uint32_t ot, uint32_t aflag,
+                                 target_ulong pc)
+{
+    target_ulong mask = rep_mask(aflag);
+    uint64_t n = env->regs[R_ECX] & mask;
+    int size = 1 << ot;
+    target_ulong step = (target_ulong)(env->df * size);
+    target_ulong dst = env->regs[R_EDI] & mask;
+    target_ulong val = env->regs[R_EAX];
+    dfsan_label label = env->shadow_regs[R_EAX];
+    target_ulong lo;
+    uint8_t *host;
+    uint32_t *ls;
+
+    if (env->shadow_regs[R_ECX] || env->shadow_regs[R_EDI] ||
+        !rep_range(dst, n, size, env->df, aflag, PAGE_WRITE, &lo)) {
+        return 0;
+    }
+
+    host = g2h(lo);
+    ls = guest_shadow(lo);
+    for (uint64_t i = 0; i < n; i++) {
+        switch (ot) {
+        case MO_8:
+            stb_p(host + i, val);
+            break;
+        case MO_16:
+            stw_le_p(host + i * 2, val);
+            break;
+        case MO_32:
+            stl_le_p(host + i * 4, val);
+            break;
+        default:
+            stq_le_p(host + i * 8, val);
+            break;
+        }
+    }
+    if (label == CONST_LABEL) {
+        memset(ls, 0, n * size * sizeof(uint32_t));
+    } else {
+        /* every element carries the same bytes of RAX's label */
+        dfsan_store_label(label, host, size);
+        for (uint64_t i = 1; i < n; i++) {
+            memcpy(ls + i * size, ls, size * sizeof(uint32_t));
+        }
+    }
+
+    rep_set_reg(env, R_ECX, 0, aflag);
+    rep_set_reg(env, R_EDI, dst + n * step, aflag);
+    return 1;
+}
+
+/* whether the byte at addr may be read; page is the last page found readable */
+static inline bool rep_readable(target_ulong addr, target_ulong *page)
+{
+    target_ulong p = addr & TARGET_PAGE_MASK;
+
+    if (p != *page) {
+        if (page_check_range(p, TARGET_PAGE_SIZE, PAGE_READ) != 0) {
+            return false;
+        }
+        *page = p;
+    }
+    return true;
+}
+
+/* repe cmpsb: compares up to a mismatch. When only one side is symbolic and
+ * it is a run of consecutive input bytes, a mismatch is reported as a single
+ * memcmp record asking for that run to equal the other side, instead of one
+ * branch per byte. A symbolic run that matches all the way, and any other
+ * symbolic bytes, take the per-iteration path.
+ * cmps and scas stop early, so pages are checked as the run reaches them. */
+uint32_t HELPER(symsan_rep_cmpsb)(CPUArchState *env, uint32_t ot, uint32_t aflag,
+                                  target_ulong pc)
+{
+    target_ulong mask = rep_mask(aflag);
+    uint64_t n = env->regs[R_ECX] & mask;
+    target_ulong step = (target_ulong)env->df;
+    target_ulong src = env->regs[R_ESI] & mask;
+    target_ulong dst = env->regs[R_EDI] & mask;
+    target_ulong src_page = 1, dst_page = 1;
+    uint64_t k, m, base = 0, off;
+    int sym_side = -1; /* 0: [ESI], 1: [EDI] */
+    target_ulong a, b;
+
+    if (env->shadow_regs[R_ECX] || env->shadow_regs[R_ESI] ||
+        env->shadow_regs[R_EDI]) {
+        return 0;
+    }
+
+    for (k = 0; k < n; k++) {
+        dfsan_label la, lb;
+        int side;
+
+        a = (src + k * step) & mask;
+        b = (dst + k * step) & mask;
+        if (!rep_readable(a, &src_page) || !rep_readable(b, &dst_page)) {
+            return 0;
+        }
+        /* which side is symbolic, and is it consecutive input */
+        la = *guest_shadow(a);
+        lb = *guest_shadow(b);
+        side = la ? 0 : 1;
+        if (la || lb) {
+            if ((la && lb) || (sym_side >= 0 && side != sym_side) || env->df < 0 ||
+                !rep_input_byte(la | lb, &off) ||
+                (sym_side >= 0 && off != base + k)) {
+                return 0;
+            }
+            if (sym_side < 0) {
+                if (off < k) {
+                    return 0;
+                }
+                sym_side = side;
+                base = off - k;
+            }
+        }
+        if (*(uint8_t *)g2h(a) != *(uint8_t *)g2h(b)) {
+            break;
+        }
+    }
+
+    if (k == n && sym_side >= 0) {
+        /* a symbolic run that matched: there is no memcmp record for making
+         * it differ, the per-iteration branches are what can flip it */
+        return 0;
+    }
+    if (k < n && sym_side >= 0) {
+        target_ulong sym = sym_side ? dst : src;
+        target_ulong con = sym_side ? src : dst;
+        target_ulong *sym_page = sym_side ? &dst_page : &src_page;
+        target_ulong *con_page = sym_side ? &src_page : &dst_page;
+        uint8_t data[REP_MEMCMP_MAX];
+
+        /* as far as the symbolic side stays consecutive input */
+        for (m = 0; m < n && m < REP_MEMCMP_MAX; m++) {
+            if (!rep_readable((sym + m) & mask, sym_page) ||
+                !rep_readable((con + m) & mask, con_page) ||
+                !rep_input_byte(*guest_shadow((sym + m) & mask), &off) ||
+                off != base + m) {
+                break;
+            }
+            data[m] = *(uint8_t *)g2h((con + m) & mask);
+        }
+        if (m <= k) {
+            return 0;
+        }
+        rep_write_memcmp(env, pc, base, data, (uint32_t)m);
+    }
+    if (k == n) {
+        k = n - 1;
+    }
+
+    a = (src + k * step) & mask;
+    b = (dst + k * step) & mask;
+    rep_set_cmp_flags(env, *(uint8_t *)g2h(a), *(uint8_t *)g2h(b),
+                      dfsan_read_label(g2h(b), 1));
+    rep_set_reg(env, R_ECX, n - (k + 1), aflag);
+    rep_set_reg(env, R_ESI, src + (k + 1) * step, aflag);
+    rep_set_reg(env, R_EDI, dst + (k + 1) * step, aflag);
+    return 1;
+}
+
+/* repne scasb: scans for AL. The strlen-style summary is the byte that ended
+ * the scan: when it is an input byte, one memcmp record of size 1 replaces it
+ * so that the scan runs past it. */
+uint32_t HELPER(symsan_rep_scasb)(CPUArchState *env, uint32_t ot, uint32_t aflag,
+                                  target_ulong pc)
+{
+    target_ulong mask = rep_mask(aflag);
+    uint64_t n = env->regs[R_ECX] & mask;
+    target_ulong step = (target_ulong)env->df;
+    target_ulong dst = env->regs[R_EDI] & mask;
+    uint8_t al = env->regs[R_EAX];
+    target_ulong page = 1, b = 0;
+    dfsan_label lb;
+    uint64_t k, off;
+
+    if (env->shadow_regs[R_ECX] || env->shadow_regs[R_EDI] ||
+        env->shadow_regs[R_EAX]) {
+        return 0;
+    }
+
+    for (k = 0; k < n; k++) {
+        b = (dst + k * step) & mask;
+        if (!rep_readable(b, &page)) {
+            return 0;
+        }
+        lb = *guest_shadow(b);
+        if (lb && !rep_input_byte(lb, &off)) {
+            return 0;
+        }
+        if (*(uint8_t *)g2h(b) == al) {
+            if (rep_input_byte(lb, &off)) {
+                uint8_t past = al ? al ^ 1 : 'A';
+                rep_write_memcmp(env, pc, off, &past, 1);
+            }
+            break;
+        }
+    }
+    if (k == n) {
+        k = n - 1;
+    }
+
+    rep_set_cmp_flags(env, al, *(uint8_t *)g2h(b), dfsan_read_label(g2h(b), 1));
+    rep_set_reg(env, R_ECX, n - (k + 1), aflag);
+    rep_set_reg(env, R_EDI, dst + (k + 1) * step, aflag);
+    return 1;
+}
+
 // concrete mode
 /* Monitor load in concrete mode, if load symbolic data, switch to symbolic mode
  * currently, we do this in the translation backend.
@@ -2246,8 +2767,7 @@ void HELPER(symsan_store_host_i64)(uint64_t value_label,
 void HELPER(symsan_check_load_guest)(CPUArchState *env, target_ulong addr, uint64_t length) {
     void *host_addr = g2h(addr);
     assert((uintptr_t)host_addr >= 0x700000040000);
-    uint32_t res_label = dfsan_read_label((uint8_t*)host_addr, length);
-    if (res_label != 0) {
+    if (!shadow_is_clear(host_addr, length)) {
         if (qemu_loglevel_mask(CPU_LOG_SYM_LDST_GUEST) && !noSymbolicData) {
             // fprintf(stderr, "[memtrace:switch] op: load_guest addr: 0x%lx host_addr %p mode: concrete\n",
             //                         addr, host_addr);
@@ -2256,6 +2776,15 @@ void HELPER(symsan_check_load_guest)(CPUArchState *env, target_ulong addr, uint6
         raise_exception_err_ra(env, EXCP_SWITCH, 0, GETPC());
     }
 }
+/* The same check for a load whose insn has a switch exit: no exception,
+ * the TB leaves through the exit when this returns 1. */
+uint32_t HELPER(symsan_check_load_guest_exit)(target_ulong addr, uint64_t length) {
+    if (shadow_is_clear(g2h(addr), length)) {
+        return 0;
+    }
+    second_ccache_flag = 1;
+    return 1;
+}
 void HELPER(symsan_check_store_guest)(target_ulong addr, uint64_t length){
     assert(second_ccache_flag != 1);
     uint32_t value_label = 0;
@@ -2267,6 +2796,31 @@ void HELPER(symsan_check_store_guest)(target_ulong addr, uint64_t length){
     dfsan_store_label(value_label, (uint8_t*)host_addr, length);
 }
 
+/* Whether a cc shadow that env->cc_op still reads carries a label. As with
+ * cc_op_live in target/i386/translate.c, the other ones are dead: a label
+ * left there by an earlier operation does not keep the flags symbolic. */
+static bool cc_shadow_live(CPUArchState *env)
+{
+    switch (env->cc_op) {
+    case CC_OP_CLR:
+        return false;
+    case CC_OP_EFLAGS:
+    case CC_OP_POPCNT:
+        return env->shadow_cc_src;
+    case CC_OP_LOGICB ... CC_OP_LOGICQ:
+        return env->shadow_cc_dst;
+    case CC_OP_ADOX:
+        return env->shadow_cc_src || env->shadow_cc_src2;
+    case CC_OP_DYNAMIC:
+    case CC_OP_ADCB ... CC_OP_ADCQ:
+    case CC_OP_SBBB ... CC_OP_SBBQ:
+    case CC_OP_ADCOX:
+        return env->shadow_cc_dst || env->shadow_cc_src || env->shadow_cc_src2;
+    default:
+        return env->shadow_cc_dst || env->shadow_cc_src;
+    }
+}
+
 /* Check the register status at the end of one basic block in symbolic mode
  * if there is no symbolic registers, switch to concrete mode
  */
@@ -2283,7 +2837,7 @@ void HELPER(symsan_check_state_switch)(CPUArchState *env) {
         //if (!noSymbolicData) fprintf(stderr, "block 0x%lx state symbolic\n", env->eip);
         return;
     }
-    if (env->shadow_cc_dst || env->shadow_cc_src || env->shadow_cc_src2) {
+    if (cc_shadow_live(env)) {
         symbolic_flag = 1;
     }
     if (!symbolic_flag && sse_operation) {
@@ -2316,7 +2870,7 @@ void HELPER(symsan_check_state)(CPUArchState *env) {
         second_ccache_flag = 1;
         return;
     }
-    if (env->shadow_cc_dst || env->shadow_cc_src || env->shadow_cc_src2) {
+    if (cc_shadow_live(env)) {
         symbolic_flag = 1;
     }
     if (!symbolic_flag && sse_operation) {
@@ -2334,7 +2888,9 @@ void HELPER(symsan_check_state)(CPUArchState *env) {
     second_ccache_flag = symbolic_flag;
 }
 
-void HELPER(symsan_check_state_no_sse)(CPUArchState *env) {
+/* Returns the new mode; the caller's exit goes on in the concrete code
+ * cache when it is 0. */
+uint32_t HELPER(symsan_check_state_no_sse)(CPUArchState *env) {
     int symbolic_flag = 0;
     for (int i=0; i<CPU_NB_REGS;i++) {
         if (env->shadow_regs[i]){
@@ -2345,30 +2901,13 @@ void HELPER(symsan_check_state_no_sse)(CPUArchState *env) {
     if (symbolic_flag) {
         second_ccache_flag = 1;
         //if (!noSymbolicData) fprintf(stderr, "block 0x%lx state symbolic\n", env->eip);
-        return;
+        return 1;
     }
-    if (env->shadow_cc_dst || env->shadow_cc_src || env->shadow_cc_src2) {
+    if (cc_shadow_live(env)) {
         symbolic_flag = 1;
     }
     second_ccache_flag = symbolic_flag;
     // if (!noSymbolicData) fprintf(stderr, "block 0x%lx state %s\n", env->eip, second_ccache_flag?"symbolic":"concrete");
-    if (second_ccache_flag == 0) {
-        CPUState *cs = env_cpu(env);
-        cpu_loop_exit_noexc(cs);
-    }
-}
-
-/* Helper function to notify function call (called from TCG translation) */
-void HELPER(symsan_notify_call)(uint64_t call_pc)
-{
-    /* Update context hash on function call (TaintPass.cc style) */
-    update_context_on_call(call_pc);
-}
-
-/* Helper function to notify function return (called from TCG translation) */
-void HELPER(symsan_notify_return)(uint64_t ret_pc)
-{
-    /* Restore context hash on function return (TaintPass.cc style) */
-    restore_context_on_return(ret_pc);
+    return second_ccache_flag;
 }
 
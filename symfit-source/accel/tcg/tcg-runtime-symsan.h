@@ -88,16 +88,22 @@ DEF_HELPER_FLAGS_5(symsan_store_guest_i64, TCG_CALL_NO_RWG, void,
                     env, i64, dh_alias_tl, i64, i64)
 
 
-DEF_HELPER_FLAGS_3(symsan_check_load_guest, TCG_CALL_NO_RWG, void,
+DEF_HELPER_FLAGS_3(symsan_check_load_guest, TCG_CALL_NO_WG, void,
                     env, dh_alias_tl, i64)
+DEF_HELPER_FLAGS_2(symsan_check_load_guest_exit, TCG_CALL_NO_RWG, i32,
+                    dh_alias_tl, i64)
 DEF_HELPER_FLAGS_2(symsan_check_store_guest, TCG_CALL_NO_RWG, void,
                     dh_alias_tl, i64)
 
+/* Whole rep string runs; they write the registers and flags */
+DEF_HELPER_4(symsan_rep_movs, i32, env, i32, i32, dh_alias_tl)
+DEF_HELPER_4(symsan_rep_stos, i32, env, i32, i32, dh_alias_tl)
+DEF_HELPER_4(symsan_rep_cmpsb, i32, env, i32, i32, dh_alias_tl)
+DEF_HELPER_4(symsan_rep_scasb, i32, env, i32, i32, dh_alias_tl)
+
 DEF_HELPER_1(symsan_check_state, void, env)
 DEF_HELPER_1(symsan_check_state_switch, void, env)
-DEF_HELPER_1(symsan_check_state_no_sse, void, env)
+DEF_HELPER_1(symsan_check_state_no_sse, i32, env)
 
 /* Context tracking */
-// DEF_HELPER_FLAGS_1(symsan_notify_call, TCG_CALL_NO_RWG, void, i64)
-// DEF_HELPER_FLAGS_1(symsan_notify_ret, TCG_CALL_NO_RWG, void, i64)
 // DEF_HELPER_FLAGS_1(symsan_notify_basic_block, TCG_CALL_NO_RWG, void, i64)
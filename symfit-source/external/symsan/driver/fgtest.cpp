@@ -4,6 +4,7 @@
 
 #include "dfsan/dfsan.h"
 #include "afl_trace_map.h"
+#include "marco_metrics.h"
 #include <z3++.h>
 
 #include <unordered_map>
@@ -236,6 +237,19 @@ static z3::expr serialize(dfsan_label label, std::unordered_set<u32> &deps) {
     z3::expr e = serialize(info->l2, deps);
     tsize_cache[label] = tsize_cache[info->l2]; // lazy init
     return cache_expr(label, -e, deps);
+  } else if (info->op == BSwap) {
+    // op2 low bytes reversed, the lowest one ends up on top
+    z3::expr base = serialize(info->l1, deps);
+    u32 bytes = info->op2.i;
+    z3::expr out = base.extract(7, 0);
+    for (u32 i = 1; i < bytes; i++) {
+      out = z3::concat(out, base.extract(i * 8 + 7, i * 8));
+    }
+    if (bytes * 8 < info->size) {
+      out = z3::zext(out, info->size - bytes * 8);
+    }
+    tsize_cache[label] = tsize_cache[info->l1]; // lazy init
+    return cache_expr(label, out, deps);
   }
   // higher-order
   else if (info->op == fmemcmp) {
@@ -283,6 +297,18 @@ static z3::expr serialize(dfsan_label label, std::unordered_set<u32> &deps) {
                  __z3_context.bv_val((uint64_t)info->op1.i, info->size);
     tsize_cache[label] = tsize_cache[info->l1]; // lazy init
     return cache_expr(label, e, deps);
+  } else if (info->op == Select) {
+    // table lookup: l1 ? op1 : (l2 or op2), the taken side is always concrete
+    z3::expr cond = serialize(info->l1, deps);
+    z3::expr other = __z3_context.bv_val((uint64_t)info->op2.i, info->size);
+    if (info->l2 >= CONST_OFFSET) {
+      std::unordered_set<u32> deps2;
+      other = serialize(info->l2, deps2);
+      deps.insert(deps2.begin(), deps2.end());
+    }
+    tsize_cache[label] = tsize_cache[info->l1] + tsize_cache[info->l2]; // lazy init
+    z3::expr e = z3::ite(cond, __z3_context.bv_val((uint64_t)info->op1.i, info->size), other);
+    return cache_expr(label, e, deps);
   }
 
   // common ops
@@ -363,6 +389,13 @@ static z3::expr serialize(dfsan_label label, std::unordered_set<u32> &deps) {
     case ICmp:    return cache_expr(label, get_cmd(op1, op2, info->op >> 8), deps);
     // concat
     case Concat:  return cache_expr(label, z3::concat(op2, op1), deps); // little endian
+    // rotates and funnel shift, amounts modulo the width
+    case RotL:    return cache_expr(label, z3::expr(__z3_context, Z3_mk_ext_rotate_left(__z3_context, op1, op2)), deps);
+    case RotR:    return cache_expr(label, z3::expr(__z3_context, Z3_mk_ext_rotate_right(__z3_context, op1, op2)), deps);
+    case FunnelShift: {
+      u32 ofs = info->op >> 8;
+      return cache_expr(label, z3::concat(op1, op2).extract(ofs + info->size - 1, ofs), deps);
+    }
     default:
       AOUT("FATAL: unsupported op: %u\n", info->op);
       throw z3::exception("unsupported operator");
@@ -451,6 +484,19 @@ static z3::expr serialize_simple(dfsan_label label) {
     z3::expr e = serialize_simple(info->l2);
     tsize_cache[label] = tsize_cache[info->l2]; // lazy init
     return cache_expr_only(label, -e);
+  } else if (info->op == BSwap) {
+    // op2 low bytes reversed, the lowest one ends up on top
+    z3::expr base = serialize_simple(info->l1);
+    u32 bytes = info->op2.i;
+    z3::expr out = base.extract(7, 0);
+    for (u32 i = 1; i < bytes; i++) {
+      out = z3::concat(out, base.extract(i * 8 + 7, i * 8));
+    }
+    if (bytes * 8 < info->size) {
+      out = z3::zext(out, info->size - bytes * 8);
+    }
+    tsize_cache[label] = tsize_cache[info->l1]; // lazy init
+    return cache_expr_only(label, out);
   }
   // higher-order
   else if (info->op == fmemcmp) {
@@ -498,6 +544,16 @@ static z3::expr serialize_simple(dfsan_label label) {
                  __z3_context.bv_val((uint64_t)info->op1.i, info->size);
     tsize_cache[label] = tsize_cache[info->l1]; // lazy init
     return cache_expr_only(label, e);
+  } else if (info->op == Select) {
+    // table lookup: l1 ? op1 : (l2 or op2), the taken side is always concrete
+    z3::expr cond = serialize_simple(info->l1);
+    z3::expr other = __z3_context.bv_val((uint64_t)info->op2.i, info->size);
+    if (info->l2 >= CONST_OFFSET) {
+      other = serialize_simple(info->l2);
+    }
+    tsize_cache[label] = tsize_cache[info->l1] + tsize_cache[info->l2]; // lazy init
+    z3::expr e = z3::ite(cond, __z3_context.bv_val((uint64_t)info->op1.i, info->size), other);
+    return cache_expr_only(label, e);
   }
 
   // common ops
@@ -577,6 +633,13 @@ static z3::expr serialize_simple(dfsan_label label) {
     case ICmp:    return cache_expr_only(label, get_cmd(op1, op2, info->op >> 8));
     // concat
     case Concat:  return cache_expr_only(label, z3::concat(op2, op1)); // little endian
+    // rotates and funnel shift, amounts modulo the width
+    case RotL:    return cache_expr_only(label, z3::expr(__z3_context, Z3_mk_ext_rotate_left(__z3_context, op1, op2)));
+    case RotR:    return cache_expr_only(label, z3::expr(__z3_context, Z3_mk_ext_rotate_right(__z3_context, op1, op2)));
+    case FunnelShift: {
+      u32 ofs = info->op >> 8;
+      return cache_expr_only(label, z3::concat(op1, op2).extract(ofs + info->size - 1, ofs));
+    }
     default:
       AOUT("FATAL: unsupported op: %u\n", info->op);
       throw z3::exception("unsupported operator");
@@ -616,7 +679,8 @@ static void _get_input_deps(dfsan_label label, std::unordered_set<u32> &deps) {
     }
     cache_expr_deps(label, deps);
     return;
-  } else if (info->op == ZExt || info->op == SExt || info->op == Trunc || info->op == Extract) {
+  } else if (info->op == ZExt || info->op == SExt || info->op == Trunc || info->op == Extract ||
+             info->op == BSwap) {
     _get_input_deps(info->l1, deps);
     cache_expr_deps(label, deps);
     return;
@@ -752,7 +816,9 @@ static bool __solve_expr(z3::expr &e) {
   opt_solver.add(e);
   // fprintf(stderr, "\n%s\n", __z3_solver.to_smt2().c_str());
   // return false;
+  uint64_t start = marco_metrics_now();
   z3::check_result res = opt_solver.check();
+  marco_observe(MH_SOLVER_CHECK_US, marco_metrics_now() - start);
   if (res == z3::sat) {
     // optimistic sat, check nested
     __z3_solver.push();
@@ -760,12 +826,16 @@ static bool __solve_expr(z3::expr &e) {
     // if (sym_count++ < 1000)
       // fprintf(stderr, "\n%s\n", __z3_solver.to_smt2().c_str());
       // return false;
+    start = marco_metrics_now();
     res = __z3_solver.check();
+    marco_observe(MH_SOLVER_CHECK_US, marco_metrics_now() - start);
     if (res == z3::sat) {
       z3::model m = __z3_solver.get_model();
       generate_input(m);
+      marco_count(MM_SOLVER_SAT, 1);
       ret = true;
     } else {
+      marco_count(MM_SOLVER_OPTIMISTIC, 1);
     #if OPTIMISTIC
       z3::model m = opt_solver.get_model();
       generate_input(m);
@@ -773,6 +843,8 @@ static bool __solve_expr(z3::expr &e) {
     }
     // reset
     __z3_solver.pop();
+  } else {
+    marco_count(MM_SOLVER_UNSAT, 1);
   }
   return ret;
 }
@@ -1119,9 +1191,12 @@ int main(int argc, char* const argv[]) {
   }
   }
 
-  // setup shmem and pipe
-  int shmid = shmget(IPC_PRIVATE, 0xc00000000,
-    O_CREAT | SHM_NORESERVE | S_IRUSR | S_IWUSR);
+  // setup shmem and pipe; under the orchestrator the lane's union table is
+  // shared with its FastGen instance and owned by the orchestrator
+  const char *lane_shm = getenv("MARCO_SHM_ID");
+  bool own_shm = !(lane_shm && lane_shm[0] != '\0');
+  int shmid = own_shm ? shmget(IPC_PRIVATE, 0xc00000000,
+    O_CREAT | SHM_NORESERVE | S_IRUSR | S_IWUSR) : atoi(lane_shm);
   if (shmid == -1) {
     fprintf(stderr, "Failed to get shmid: %s\n", strerror(errno));
     exit(1);
@@ -1262,7 +1337,8 @@ int main(int argc, char* const argv[]) {
 
   // Clean up shared memory to prevent resource leaks
   shmdt(__dfsan_label_info);    // Detach from shared memory
-  shmctl(shmid, IPC_RMID, NULL); // Mark shared memory segment for deletion
+  if (own_shm)
+    shmctl(shmid, IPC_RMID, NULL); // Mark shared memory segment for deletion
 
   exit(0);
 }
@@ -31,6 +31,8 @@
 #include "taint_allocator.h"
 #include "union_util.h"
 #include "union_hashtable.h"
+#include "union_simplify.h"
+#include "marco_metrics.h"
 
 #include <stdio.h>
 #include <stdlib.h>
@@ -180,6 +182,13 @@ dfsan_label __taint_union(dfsan_label l1, dfsan_label l2, u16 op, u16 size,
   if (l1 == 0 && l2 < CONST_OFFSET && op != fsize && op != Alloca) return 0;
   if (l1 == kInitializingLabel || l2 == kInitializingLabel) return kInitializingLabel;
 
+  // drop nodes that are an operand, a constant or an existing sub-expression
+  // in disguise, before they take a label
+  if (flags().simplify) {
+    dfsan_label simplified;
+    if (__taint::simplify(l1, l2, op, size, op1, op2, simplified)) return simplified;
+  }
+
   // special handling for bounds
   // if (get_label_info(l1)->op == Alloca || get_label_info(l2)->op == Alloca) {
   //   // propagate if it's casting op
@@ -210,6 +219,7 @@ dfsan_label __taint_union(dfsan_label l1, dfsan_label l2, u16 op, u16 size,
   if (res != __taint::none()) {
     dfsan_label label = *res;
     AOUT("%u found\n", label);
+    marco_count(MM_UNIONS_DEDUPED, 1);
     return label;
   }
   // for debugging
@@ -225,6 +235,7 @@ dfsan_label __taint_union(dfsan_label l1, dfsan_label l2, u16 op, u16 size,
 
   internal_memcpy(&__dfsan_label_info[label], &label_info, sizeof(dfsan_label_info));
   __union_table.insert(&__dfsan_label_info[label], label);
+  marco_count(MM_UNIONS_CREATED, 1);
   return label;
 }
 
@@ -847,6 +858,35 @@ static void dfsan_init(int argc, char **argv, char **envp) {
   AddDieCallback(dfsan_fini);
 }
 
+// Called in a fork-server child once TAINT_OPTIONS holds the options of the
+// new run. Shadow memory and the union hash are private copies of the idle
+// server, so they are still clean; only the label counter, the taint file
+// and the solver flags have to be brought up again.
+extern "C" SANITIZER_INTERFACE_ATTRIBUTE void
+dfsan_forkserver_reset(void) {
+  int old_shm_id = flags().shm_id;
+  InitializeFlags();
+  print_debug = flags().debug;
+
+  if (flags().shm_id != old_shm_id && flags().shm_id != -1) {
+    void *ret = shmat(flags().shm_id, (void *)UnionTableAddr(), SHM_REMAP);
+    if (ret == (void*)-1) {
+      Printf("FATAL: error mapping shared union table\n");
+      Die();
+    }
+  }
+
+  if (tainted.buf) {
+    UnmapOrDie(tainted.buf, tainted.buf_size);
+  }
+  internal_memset(&tainted, 0, sizeof(tainted));
+  atomic_store(&__dfsan_last_label, 0, memory_order_relaxed);
+
+  InitializeTaintFile();
+
+  InitializeSolver();
+}
+
 static inline dfsan_label get_label_for(int fd, off_t offset) {
   // check if fd is stdin, if so, the label hasn't been pre-allocated
   if (is_stdin_taint()) return dfsan_create_label(offset);
@@ -161,6 +161,11 @@ enum operators {
   fsize     = last_llvm_op + 8,
   Ite       = last_llvm_op + 9,
   Equal     = last_llvm_op + 10,
+  // bit permutations, kept as single nodes instead of shift/mask ladders
+  BSwap     = last_llvm_op + 11, // op2: bytes swapped, zero extended to size
+  RotL      = last_llvm_op + 12,
+  RotR      = last_llvm_op + 13,
+  FunnelShift = last_llvm_op + 14, // (l1:l2) >> ofs, ofs in the high byte like ICmp
 };
 
 enum predicate {
@@ -0,0 +1,363 @@
+#include "union_simplify.h"
+#include "marco_metrics.h"
+
+using namespace __dfsan;
+
+namespace __taint {
+
+enum step { kKeep, kRewritten, kFolded };
+
+// a rewritten node goes through the rules again, a few times at most
+static const int kMaxRounds = 4;
+
+static inline u64 width_mask(u16 size) {
+  return size >= 64 ? ~0ULL : (1ULL << size) - 1;
+}
+
+static inline u16 size_of(dfsan_label label) {
+  return get_label_info(label)->size;
+}
+
+// ZExt/SExt with size the result width and op2 the number of bits added
+static inline bool is_ext(const dfsan_label_info *info) {
+  return (info->op == ZExt || info->op == SExt) && info->l1 >= CONST_OFFSET &&
+         info->op2.i == (u64)(info->size - size_of(info->l1));
+}
+
+// Extract of size bits at offset op2, op1 either 0 or the top bit
+static inline bool extract_ok(dfsan_label l1, u64 op1, u64 op2, u16 size) {
+  return l1 >= CONST_OFFSET && (op1 == 0 || op1 == op2 + size - 1) &&
+         op2 + size <= size_of(l1);
+}
+
+static inline bool is_extract(const dfsan_label_info *info) {
+  return info->op == Extract &&
+         extract_ok(info->l1, info->op1.i, info->op2.i, info->size);
+}
+
+// width of the low half of a Concat, either half may be concrete
+static inline u16 concat_low_size(const dfsan_label_info *info) {
+  return info->l1 ? size_of(info->l1) : info->size - size_of(info->l2);
+}
+
+#define FOLD_CONST(counter)                                   \
+  do { out = CONST_LABEL; rule = counter; return kFolded; } while (false)
+
+#define FOLD_TO(label, counter)                               \
+  do {                                                        \
+    if (size_of(label) == size) {                             \
+      out = label; rule = counter; return kFolded;            \
+    }                                                         \
+  } while (false)
+
+#define REWRITTEN(counter)                                    \
+  do { rule = counter; return kRewritten; } while (false)
+
+static step simplify_binary(dfsan_label &l1, dfsan_label &l2, u16 &op, u16 &size,
+                            u64 &op1, u64 &op2, dfsan_label &out,
+                            marco_counter &rule) {
+  const u64 m = width_mask(size);
+  // commutative ops have the concrete operand, if any, on the left
+  const u64 c1 = op1 & m;
+  const u64 c2 = op2 & m;
+  dfsan_label_info *inner;
+
+  switch (op) {
+    case Add:
+      if (l1 != CONST_LABEL) return kKeep;
+      if (c1 == 0) FOLD_TO(l2, MM_SIMPLIFY_IDENTITY);
+      inner = get_label_info(l2);
+      if (inner->size != size) return kKeep;
+      if (inner->op == Add && inner->l1 == CONST_LABEL) {
+        op1 = (c1 + inner->op1.i) & m;
+        l2 = inner->l2;
+        REWRITTEN(MM_SIMPLIFY_REASSOC);
+      }
+      if (inner->op == Sub && inner->l1 >= CONST_OFFSET && inner->l2 == CONST_LABEL) {
+        op1 = (c1 - inner->op2.i) & m;
+        l2 = inner->l1;
+        REWRITTEN(MM_SIMPLIFY_REASSOC);
+      }
+      return kKeep;
+
+    case Sub:
+      if (l1 == l2) FOLD_CONST(MM_SIMPLIFY_FOLDED);
+      if (l2 != CONST_LABEL) return kKeep;
+      if (c2 == 0) FOLD_TO(l1, MM_SIMPLIFY_IDENTITY);
+      inner = get_label_info(l1);
+      if (inner->size != size) return kKeep;
+      if (inner->op == Sub && inner->l1 >= CONST_OFFSET && inner->l2 == CONST_LABEL) {
+        op2 = (c2 + inner->op2.i) & m;
+        l1 = inner->l1;
+        REWRITTEN(MM_SIMPLIFY_REASSOC);
+      }
+      if (inner->op == Add && inner->l1 == CONST_LABEL) {
+        // (c + x) - c2 => (c - c2) + x
+        op = Add;
+        op1 = (inner->op1.i - c2) & m;
+        op2 = 0;
+        l1 = CONST_LABEL;
+        l2 = inner->l2;
+        REWRITTEN(MM_SIMPLIFY_REASSOC);
+      }
+      return kKeep;
+
+    case Mul:
+      if (l1 != CONST_LABEL) return kKeep;
+      if (c1 == 0) FOLD_CONST(MM_SIMPLIFY_FOLDED);
+      if (c1 == 1) FOLD_TO(l2, MM_SIMPLIFY_IDENTITY);
+      inner = get_label_info(l2);
+      if (inner->size == size && inner->op == Mul && inner->l1 == CONST_LABEL) {
+        op1 = (c1 * inner->op1.i) & m;
+        l2 = inner->l2;
+        REWRITTEN(MM_SIMPLIFY_REASSOC);
+      }
+      return kKeep;
+
+    case UDiv:
+    case SDiv:
+      if (l2 == CONST_LABEL && c2 == 1) FOLD_TO(l1, MM_SIMPLIFY_IDENTITY);
+      return kKeep;
+
+    case URem:
+    case SRem:
+      if (l2 == CONST_LABEL && c2 == 1) FOLD_CONST(MM_SIMPLIFY_FOLDED);
+      return kKeep;
+
+    case And:
+      if (l1 == l2) FOLD_TO(l1, MM_SIMPLIFY_IDENTITY);
+      if (l1 != CONST_LABEL) return kKeep;
+      if (c1 == 0) FOLD_CONST(MM_SIMPLIFY_FOLDED);
+      if (c1 == m) FOLD_TO(l2, MM_SIMPLIFY_IDENTITY);
+      inner = get_label_info(l2);
+      if (inner->size != size) return kKeep;
+      if (inner->op == ZExt && is_ext(inner)) {
+        // the mask keeps every bit the extension did not clear
+        u64 low = width_mask(size_of(inner->l1));
+        if ((c1 & low) == low) FOLD_TO(l2, MM_SIMPLIFY_IDENTITY);
+      }
+      if (inner->op == And && inner->l1 == CONST_LABEL) {
+        op1 = c1 & inner->op1.i;
+        l2 = inner->l2;
+        REWRITTEN(MM_SIMPLIFY_REASSOC);
+      }
+      return kKeep;
+
+    case Or:
+      if (l1 == l2) FOLD_TO(l1, MM_SIMPLIFY_IDENTITY);
+      if (l1 != CONST_LABEL) return kKeep;
+      if (c1 == 0) FOLD_TO(l2, MM_SIMPLIFY_IDENTITY);
+      if (c1 == m) FOLD_CONST(MM_SIMPLIFY_FOLDED);
+      inner = get_label_info(l2);
+      if (inner->size == size && inner->op == Or && inner->l1 == CONST_LABEL) {
+        op1 = (c1 | inner->op1.i) & m;
+        l2 = inner->l2;
+        REWRITTEN(MM_SIMPLIFY_REASSOC);
+      }
+      return kKeep;
+
+    case Xor:
+      if (l1 == l2) FOLD_CONST(MM_SIMPLIFY_FOLDED);
+      if (l1 != CONST_LABEL) return kKeep;
+      if (c1 == 0) FOLD_TO(l2, MM_SIMPLIFY_IDENTITY);
+      inner = get_label_info(l2);
+      if (inner->size == size && inner->op == Xor && inner->l1 == CONST_LABEL) {
+        op1 = (c1 ^ inner->op1.i) & m;
+        l2 = inner->l2;
+        REWRITTEN(MM_SIMPLIFY_REASSOC);
+      }
+      return kKeep;
+
+    case Shl:
+    case LShr:
+    case AShr:
+      if (l1 == CONST_LABEL) {
+        if (c1 == 0) FOLD_CONST(MM_SIMPLIFY_FOLDED);
+        return kKeep;
+      }
+      if (l2 != CONST_LABEL) return kKeep;
+      if (op2 == 0) FOLD_TO(l1, MM_SIMPLIFY_IDENTITY);
+      if (op != AShr && op2 >= size) FOLD_CONST(MM_SIMPLIFY_FOLDED);
+      inner = get_label_info(l1);
+      if (inner->size == size && inner->op == op && inner->l1 >= CONST_OFFSET &&
+          inner->l2 == CONST_LABEL && inner->op2.i < size && op2 < size) {
+        u64 total = op2 + inner->op2.i;
+        if (total >= size) {
+          if (op != AShr) FOLD_CONST(MM_SIMPLIFY_FOLDED);
+          total = size - 1; // only sign bits left
+        }
+        op2 = total;
+        l1 = inner->l1;
+        REWRITTEN(MM_SIMPLIFY_REASSOC);
+      }
+      return kKeep;
+
+    case RotL:
+    case RotR:
+      if (l2 == CONST_LABEL && size && op2 % size == 0) FOLD_TO(l1, MM_SIMPLIFY_IDENTITY);
+      return kKeep;
+
+    default:
+      return kKeep;
+  }
+}
+
+static step simplify_unary(dfsan_label &l1, dfsan_label &l2, u16 &op, u16 &size,
+                           u64 &op1, u64 &op2, dfsan_label &out,
+                           marco_counter &rule) {
+  dfsan_label_info *inner;
+
+  switch (op) {
+    case Not:
+    case Neg:
+      // the operand is on the right
+      if (l2 < CONST_OFFSET) return kKeep;
+      inner = get_label_info(l2);
+      if (inner->op == op && inner->l2 >= CONST_OFFSET) FOLD_TO(inner->l2, MM_SIMPLIFY_IDENTITY);
+      return kKeep;
+
+    case ZExt:
+    case SExt: {
+      if (l1 < CONST_OFFSET || op2 != (u64)(size - size_of(l1))) return kKeep;
+      if (op2 == 0) FOLD_TO(l1, MM_SIMPLIFY_CAST);
+      inner = get_label_info(l1);
+      // ext(ext(y)) => ext(y), a sign extension of a zero extension is one too
+      if (is_ext(inner) && inner->op2.i != 0 && (inner->op == ZExt || inner->op == op)) {
+        op = inner->op;
+        l1 = inner->l1;
+        op2 = size - size_of(l1);
+        REWRITTEN(MM_SIMPLIFY_CAST);
+      }
+      return kKeep;
+    }
+
+    case Trunc: {
+      if (l1 < CONST_OFFSET || op2 != size || size > size_of(l1)) return kKeep;
+      if (size == size_of(l1)) FOLD_TO(l1, MM_SIMPLIFY_CAST);
+      inner = get_label_info(l1);
+      if (is_ext(inner)) {
+        dfsan_label y = inner->l1;
+        u16 k = size_of(y);
+        if (k == size) FOLD_TO(y, MM_SIMPLIFY_CAST);
+        if (k < size) {
+          // still wider than the original value
+          op = inner->op;
+          op2 = size - k;
+        }
+        l1 = y;
+        REWRITTEN(MM_SIMPLIFY_CAST);
+      }
+      if (inner->op == Trunc && inner->l1 >= CONST_OFFSET && inner->op2.i == inner->size) {
+        l1 = inner->l1;
+        REWRITTEN(MM_SIMPLIFY_CAST);
+      }
+      if (inner->op == Concat && size <= concat_low_size(inner)) {
+        if (inner->l1 == CONST_LABEL) FOLD_CONST(MM_SIMPLIFY_EXTRACT);
+        l1 = inner->l1;
+        REWRITTEN(MM_SIMPLIFY_EXTRACT);
+      }
+      return kKeep;
+    }
+
+    case Extract: {
+      if (!extract_ok(l1, op1, op2, size)) return kKeep;
+      if (op2 == 0 && size == size_of(l1)) FOLD_TO(l1, MM_SIMPLIFY_EXTRACT);
+      inner = get_label_info(l1);
+      u64 off = op2;
+      if (is_extract(inner)) {
+        off += inner->op2.i;
+        l1 = inner->l1;
+      } else if (inner->op == Concat) {
+        u16 low = concat_low_size(inner);
+        if (off + size <= low) {
+          if (inner->l1 == CONST_LABEL) FOLD_CONST(MM_SIMPLIFY_EXTRACT);
+          l1 = inner->l1;
+        } else if (off >= low) {
+          if (inner->l2 == CONST_LABEL) FOLD_CONST(MM_SIMPLIFY_EXTRACT);
+          l1 = inner->l2;
+          off -= low;
+        } else {
+          return kKeep;
+        }
+      } else if (is_ext(inner)) {
+        u16 k = size_of(inner->l1);
+        if (inner->op == ZExt && off >= k) FOLD_CONST(MM_SIMPLIFY_EXTRACT);
+        if (off + size > k) return kKeep;
+        l1 = inner->l1;
+      } else {
+        return kKeep;
+      }
+      op2 = off;
+      if (op1) op1 = off + size - 1;
+      REWRITTEN(MM_SIMPLIFY_EXTRACT);
+    }
+
+    case Concat: {
+      // Concat(Extract(y, o), Extract(y, o + s1)) => Extract(y, o)
+      if (l1 < CONST_OFFSET || l2 < CONST_OFFSET) return kKeep;
+      dfsan_label_info *lo = get_label_info(l1);
+      dfsan_label_info *hi = get_label_info(l2);
+      if (!is_extract(lo) || !is_extract(hi) || lo->l1 != hi->l1 ||
+          hi->op2.i != lo->op2.i + lo->size || lo->size + hi->size != size) {
+        return kKeep;
+      }
+      op = Extract;
+      op1 = lo->op1.i ? lo->op2.i + size - 1 : 0;
+      op2 = lo->op2.i;
+      l1 = lo->l1;
+      l2 = CONST_LABEL;
+      REWRITTEN(MM_SIMPLIFY_EXTRACT);
+    }
+
+    case BSwap:
+      if (l1 < CONST_OFFSET) return kKeep;
+      inner = get_label_info(l1);
+      if (inner->op == BSwap && inner->op2.i == op2 && inner->size == size &&
+          inner->l1 >= CONST_OFFSET) {
+        FOLD_TO(inner->l1, MM_SIMPLIFY_IDENTITY);
+      }
+      return kKeep;
+
+    default:
+      return kKeep;
+  }
+}
+
+#undef FOLD_CONST
+#undef FOLD_TO
+#undef REWRITTEN
+
+static step simplify_once(dfsan_label &l1, dfsan_label &l2, u16 &op, u16 &size,
+                          u64 &op1, u64 &op2, dfsan_label &out,
+                          marco_counter &rule) {
+  if ((op & 0xff) == ICmp) {
+    // x cmp x
+    if (l1 == l2) {
+      out = CONST_LABEL;
+      rule = MM_SIMPLIFY_FOLDED;
+      return kFolded;
+    }
+    return kKeep;
+  }
+  switch (op) {
+    case Not: case Neg: case ZExt: case SExt: case Trunc:
+    case Extract: case Concat: case BSwap:
+      return simplify_unary(l1, l2, op, size, op1, op2, out, rule);
+    default:
+      return simplify_binary(l1, l2, op, size, op1, op2, out, rule);
+  }
+}
+
+bool simplify(dfsan_label &l1, dfsan_label &l2, u16 &op, u16 &size,
+              u64 &op1, u64 &op2, dfsan_label &out) {
+  for (int round = 0; round < kMaxRounds; round++) {
+    marco_counter rule = MM_NUM_COUNTERS;
+    step s = simplify_once(l1, l2, op, size, op1, op2, out, rule);
+    if (s == kKeep) return false;
+    marco_count(rule, 1);
+    if (s == kFolded) return true;
+  }
+  return false;
+}
+
+} // namespace
@@ -0,0 +1,31 @@
+#ifndef UNION_SIMPLIFY_H
+#define UNION_SIMPLIFY_H
+
+#include "sanitizer_common/sanitizer_internal_defs.h"
+#include "dfsan.h"
+
+using __sanitizer::u16;
+using __sanitizer::u64;
+
+namespace __taint {
+
+/**
+ * Peephole rules applied by __taint_union before a node is hashed.
+ *
+ * Returns true when the node is redundant, with out set to the label that
+ * stands for it: one of its operands, an existing sub-expression, or
+ * CONST_LABEL when the value no longer depends on the input. Otherwise the
+ * operands may have been rewritten into a cheaper equivalent node (constant
+ * chains re-associated, nested extensions and extracts collapsed) and the
+ * caller creates that one instead.
+ *
+ * Concrete operands are only trusted on the side whose label is 0, and
+ * casts/extracts are only touched when their width fields agree with each
+ * other, so nodes built with the older encodings are left as they are.
+ */
+bool simplify(dfsan_label &l1, dfsan_label &l2, u16 &op, u16 &size,
+              u64 &op1, u64 &op2, dfsan_label &out);
+
+} // namespace
+
+#endif // UNION_SIMPLIFY_H
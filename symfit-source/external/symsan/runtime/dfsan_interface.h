@@ -47,6 +47,11 @@ enum operators {
   fsize     = last_llvm_op + 8,
   Ite       = last_llvm_op + 9,
   Equal     = last_llvm_op + 10,
+  // bit permutations, kept as single nodes instead of shift/mask ladders
+  BSwap     = last_llvm_op + 11, // op2: bytes swapped, zero extended to size
+  RotL      = last_llvm_op + 12,
+  RotR      = last_llvm_op + 13,
+  FunnelShift = last_llvm_op + 14, // (l1:l2) >> ofs, ofs in the high byte like ICmp
 };
 
 enum predicate {
@@ -115,6 +120,9 @@ void dfsan_dump_labels(int fd);
 
 void dfsan_init_qemu(void);
 
+/// Re-reads TAINT_OPTIONS and re-labels the taint file in a fork-server child.
+void dfsan_forkserver_reset(void);
+
 void dfsan_unimplemented(char *fname);
 
 dfsan_label __taint_trace_cmp(dfsan_label l1, dfsan_label l2, u8 size, u64 result, u32 predicate,
@@ -191,9 +191,34 @@ static z3::expr serialize(dfsan_label label, std::unordered_set<u32> &deps) {
     z3::expr e = serialize(info->l2, deps);
     tsize_cache[label] = tsize_cache[info->l2]; // lazy init
     return cache_expr(label, -e, deps);
+  } else if (info->op == BSwap) {
+    // op2 low bytes reversed, the lowest one ends up on top
+    z3::expr base = serialize(info->l1, deps);
+    u32 bytes = info->op2.i;
+    z3::expr out = base.extract(7, 0);
+    for (u32 i = 1; i < bytes; i++) {
+      out = z3::concat(out, base.extract(i * 8 + 7, i * 8));
+    }
+    if (bytes * 8 < info->size) {
+      out = z3::zext(out, info->size - bytes * 8);
+    }
+    tsize_cache[label] = tsize_cache[info->l1]; // lazy init
+    return cache_expr(label, out, deps);
   } else if (info->op == IntToPtr) {
     z3::expr e = serialize(info->l1, deps);
     return cache_expr(label, e, deps);
+  } else if (info->op == Select) {
+    // table lookup: l1 ? op1 : (l2 or op2), the taken side is always concrete
+    z3::expr cond = serialize(info->l1, deps);
+    z3::expr other = __z3_context.bv_val((uint64_t)info->op2.i, info->size);
+    if (info->l2 >= CONST_OFFSET) {
+      std::unordered_set<u32> deps2;
+      other = serialize(info->l2, deps2);
+      deps.insert(deps2.begin(), deps2.end());
+    }
+    tsize_cache[label] = tsize_cache[info->l1] + tsize_cache[info->l2]; // lazy init
+    z3::expr e = z3::ite(cond, __z3_context.bv_val((uint64_t)info->op1.i, info->size), other);
+    return cache_expr(label, e, deps);
   }
   // higher-order
   else if (info->op == fmemcmp) {
@@ -270,6 +295,13 @@ static z3::expr serialize(dfsan_label label, std::unordered_set<u32> &deps) {
     case ICmp:    return cache_expr(label, get_cmd(op1, op2, info->op >> 8), deps);
     // concat
     case Concat:  return cache_expr(label, z3::concat(op2, op1), deps); // little endian
+    // rotates and funnel shift, amounts modulo the width
+    case RotL:    return cache_expr(label, z3::expr(__z3_context, Z3_mk_ext_rotate_left(__z3_context, op1, op2)), deps);
+    case RotR:    return cache_expr(label, z3::expr(__z3_context, Z3_mk_ext_rotate_right(__z3_context, op1, op2)), deps);
+    case FunnelShift: {
+      u32 ofs = info->op >> 8;
+      return cache_expr(label, z3::concat(op1, op2).extract(ofs + info->size - 1, ofs), deps);
+    }
     default:
       Printf("FATAL: unsupported op: %u\n", info->op);
       throw z3::exception("unsupported operator");
@@ -9,6 +9,7 @@
 #include "disas/disas.h"
 #include "qemu/path.h"
 #include "qemu/guest-random.h"
+#include "tcg.h"
 
 #ifdef _ARCH_PPC64
 #undef ARCH_DLINFO
@@ -2506,6 +2507,10 @@ static void load_elf_image(const char *image_name, int image_fd,
         info->brk = info->end_code;
     }
 
+    if (info->start_code < info->end_code) {
+        symsan_summarize_module(image_name, info->start_code, info->end_code);
+    }
+
     if (qemu_log_enabled()) {
         load_symbols(ehdr, image_fd, load_bias);
     }
@@ -49,6 +49,9 @@
 #include "RuntimeCommon.h"
 #include "dfsan_interface.h"
 
+/* tcg-runtime-symsan.c */
+extern void symsan_forkserver(void);
+
 char *exec_path;
 CPUArchState *global_env;
 int singlestep;
@@ -844,6 +847,8 @@ int main(int argc, char **argv, char **envp)
         }
         gdb_handlesig(cpu, 0);
     }
+    /* returns in each forked child when FastGen drives us as a fork server */
+    symsan_forkserver();
     cpu_loop(env);
     /* never exits */
     return 0;
@@ -19,6 +19,7 @@
 #include "qemu/osdep.h"
 
 #include "qemu.h"
+#include "tcg.h"
 
 //#define DEBUG_MMAP
 
@@ -363,6 +364,21 @@ abi_ulong mmap_find_vma(abi_ulong start, abi_ulong size, abi_ulong align)
 }
 
 /* NOTE: all the constants are the HOST ones */
+/* Code mapped from a file, e.g. a shared library loaded by ld.so, may be a
+   module MARCO_SUMMARIZE names.  */
+static void summarize_file_mapping(int fd, abi_ulong start, abi_ulong len)
+{
+    char link[64], path[PATH_MAX];
+    ssize_t n;
+
+    snprintf(link, sizeof(link), "/proc/self/fd/%d", fd);
+    n = readlink(link, path, sizeof(path) - 1);
+    if (n > 0) {
+        path[n] = '\0';
+        symsan_summarize_module(path, start, start + len);
+    }
+}
+
 abi_long target_mmap(abi_ulong start, abi_ulong len, int prot,
                      int flags, int fd, abi_ulong offset)
 {
@@ -574,6 +590,9 @@ abi_long target_mmap(abi_ulong start, abi_ulong len, int prot,
     page_dump(stdout);
     printf("\n");
 #endif
+    if ((prot & PROT_EXEC) && !(flags & MAP_ANONYMOUS) && fd >= 0) {
+        summarize_file_mapping(fd, start, len);
+    }
     tb_invalidate_phys_range(start, start + len);
     mmap_unlock();
     return start;
@@ -973,6 +973,9 @@ typedef struct {
 #define CPU_NB_REGS CPU_NB_REGS32
 #endif
 
+/* saved ctx hashes; deeper calls wrap around and overwrite the oldest */
+#define MARCO_CTX_STACK_DEPTH 64
+
 #define MAX_FIXED_COUNTERS 3
 #define MAX_GP_COUNTERS    (MSR_IA32_PERF_STATUS - MSR_P6_EVNTSEL0)
 
@@ -1153,6 +1156,10 @@ typedef struct CPUX86State {
     target_ulong shadow_cc_dst;
     target_ulong shadow_cc_src;
     target_ulong shadow_cc_src2;
+    /* calling-context hash for branch records, kept by call/ret in TCG */
+    uint32_t marco_ctxh;
+    uint32_t marco_ctx_depth;
+    uint32_t marco_ctx_stack[MARCO_CTX_STACK_DEPTH];
 
     target_ulong eip;
     target_ulong eflags; /* eflags register. During CPU emulation, CC
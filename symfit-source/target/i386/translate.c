@@ -81,6 +81,15 @@ static TCGv_i64 cpu_bndu[4];
 
 #include "exec/gen-icount.h"
 
+/* Concrete mode: where an insn whose load finds labelled bytes leaves the
+ * TB to restart in the symbolic code cache (see gen_switch_exits). */
+typedef struct SwitchExit {
+    TCGLabel *label;
+    target_ulong pc;
+    CCOp cc_op;
+    struct SwitchExit *next;
+} SwitchExit;
+
 typedef struct DisasContext {
     DisasContextBase base;
 
@@ -105,6 +114,7 @@ typedef struct DisasContext {
     int ss32;   /* 32 bit stack segment */
     CCOp cc_op;  /* current CC operation */
     bool cc_op_dirty;
+    bool cc_dst_lazy; /* symbolic mode: cc_dst of a CMP has no label yet */
 #ifdef TARGET_X86_64
     bool x86_64_hregs;
 #endif
@@ -142,6 +152,8 @@ typedef struct DisasContext {
     TCGv_i32 tmp3_i32;
     TCGv_i64 tmp1_i64;
 
+    SwitchExit *switch_exits;
+
     sigjmp_buf jmpbuf;
 } DisasContext;
 
@@ -235,6 +247,8 @@ static void set_cc_op(DisasContext *s, CCOp op)
 {
     int dead;
 
+    /* whatever set the flags also wrote cc_dst */
+    s->cc_dst_lazy = false;
     if (s->cc_op == op) {
         return;
     }
@@ -276,6 +290,28 @@ static void gen_update_cc_op(DisasContext *s)
     }
 }
 
+/* In symbolic mode a CMP only records its operands: cc_dst gets its value
+   but not the label of the Sub, which is built here for the few readers
+   that cannot work from cc_srcT and cc_src.  Flags read by nothing, or
+   only by helpers whose results are concrete anyway, never pay for it.  */
+static void gen_cc_dst_label(DisasContext *s)
+{
+    if (s->cc_dst_lazy) {
+        s->cc_dst_lazy = false;
+        tcg_gen_sub_tl(cpu_cc_dst, s->cc_srcT, cpu_cc_src);
+    }
+}
+
+/* a sub that leaves the label of ret alone */
+static inline void gen_sub_nosym_tl(TCGv ret, TCGv arg1, TCGv arg2)
+{
+#ifdef TARGET_X86_64
+    tcg_gen_op3_i64(INDEX_op_sub_i64, ret, arg1, arg2);
+#else
+    tcg_gen_op3_i32(INDEX_op_sub_i32, ret, arg1, arg2);
+#endif
+}
+
 #ifdef TARGET_X86_64
 
 #define NB_OP_SIZES 4
@@ -841,7 +877,10 @@ static CCPrepare gen_prepare_eflags_s(DisasContext *s, TCGv reg)
     default:
         {
             TCGMemOp size = (s->cc_op - CC_OP_ADDB) & 3;
-            TCGv t0 = gen_ext_tl(reg, cpu_cc_dst, size, true);
+            TCGv t0;
+
+            gen_cc_dst_label(s);
+            t0 = gen_ext_tl(reg, cpu_cc_dst, size, true);
             return (CCPrepare) { .cond = TCG_COND_LT, .reg = t0, .mask = -1 };
         }
     }
@@ -883,6 +922,19 @@ static CCPrepare gen_prepare_eflags_z(DisasContext *s, TCGv reg)
     case CC_OP_POPCNT:
         return (CCPrepare) { .cond = TCG_COND_EQ, .reg = cpu_cc_src,
                              .mask = -1 };
+    case CC_OP_SUBB ... CC_OP_SUBQ:
+        if (s->cc_dst_lazy) {
+            /* (DATA_TYPE)CC_SRCT == (DATA_TYPE)CC_SRC, without the Sub */
+            TCGMemOp size = s->cc_op - CC_OP_SUBB;
+            TCGv t1 = gen_ext_tl(s->tmp0, cpu_cc_src, size, false);
+            TCGv t0 = t1 == cpu_cc_src ? s->tmp0 : reg;
+
+            tcg_gen_mov_tl(t0, s->cc_srcT);
+            gen_extu(size, t0);
+            return (CCPrepare) { .cond = TCG_COND_EQ, .reg = t0,
+                                 .reg2 = t1, .mask = -1, .use_reg2 = true };
+        }
+        /* FALLTHRU */
     default:
         {
             TCGMemOp size = (s->cc_op - CC_OP_ADDB) & 3;
@@ -1168,15 +1220,45 @@ static inline void gen_outs(DisasContext *s, TCGMemOp ot)
     }
 }
 
+typedef void (*gen_rep_bulk_fn)(TCGv_i32, TCGv_ptr, TCGv_i32, TCGv_i32, TCGv);
+
+/* In symbolic mode a whole rep run can be done by one symsan_rep_* helper,
+   which returns nonzero when it did; the instruction is then left through
+   l2. Only flat addressing without a segment override is handled there. */
+static void gen_rep_bulk(DisasContext *s, gen_rep_bulk_fn fn, TCGMemOp ot,
+                         target_ulong cur_eip, TCGLabel *l2)
+{
+    TCGv_i32 done, t_ot, t_aflag, zero;
+    TCGv pc;
+
+    if (!fn || !second_ccache_flag || s->override >= 0 || s->addseg ||
+        s->aflag == MO_16) {
+        return;
+    }
+    done = tcg_temp_new_i32();
+    t_ot = tcg_const_i32(ot);
+    t_aflag = tcg_const_i32(s->aflag);
+    pc = tcg_const_tl(cur_eip + s->cs_base);
+    fn(done, cpu_env, t_ot, t_aflag, pc);
+    zero = tcg_const_i32(0);
+    tcg_gen_brcond_nosym_i32(TCG_COND_NE, done, zero, l2);
+    tcg_temp_free_i32(zero);
+    tcg_temp_free(pc);
+    tcg_temp_free_i32(t_aflag);
+    tcg_temp_free_i32(t_ot);
+    tcg_temp_free_i32(done);
+}
+
 /* same method as Valgrind : we generate jumps to current or next
    instruction */
-#define GEN_REPZ(op)                                                          \
+#define GEN_REPZ(op, bulk)                                                    \
 static inline void gen_repz_ ## op(DisasContext *s, TCGMemOp ot,              \
                                  target_ulong cur_eip, target_ulong next_eip) \
 {                                                                             \
     TCGLabel *l2;                                                             \
     gen_update_cc_op(s);                                                      \
     l2 = gen_jz_ecx_string(s, next_eip);                                      \
+    gen_rep_bulk(s, bulk, ot, cur_eip, l2);                                   \
     gen_ ## op(s, ot);                                                        \
     gen_op_add_reg_im(s, s->aflag, R_ECX, -1);                                \
     /* a loop would cause two single step exceptions if ECX = 1               \
@@ -1186,7 +1268,8 @@ static inline void gen_repz_ ## op(DisasContext *s, TCGMemOp ot,              \
     gen_jmp(s, cur_eip);                                                      \
 }
 
-#define GEN_REPZ2(op)                                                         \
+/* bulk is only used for byte runs with the given repz/repnz prefix */
+#define GEN_REPZ2(op, bulk, bulk_nz)                                          \
 static inline void gen_repz_ ## op(DisasContext *s, TCGMemOp ot,              \
                                    target_ulong cur_eip,                      \
                                    target_ulong next_eip,                     \
@@ -1195,6 +1278,8 @@ static inline void gen_repz_ ## op(DisasContext *s, TCGMemOp ot,              \
     TCGLabel *l2;                                                             \
     gen_update_cc_op(s);                                                      \
     l2 = gen_jz_ecx_string(s, next_eip);                                      \
+    gen_rep_bulk(s, ot == MO_8 && nz == bulk_nz ? bulk : NULL,                \
+                 ot, cur_eip, l2);                                            \
     gen_ ## op(s, ot);                                                        \
     gen_op_add_reg_im(s, s->aflag, R_ECX, -1);                                \
     gen_update_cc_op(s);                                                      \
@@ -1204,13 +1289,13 @@ static inline void gen_repz_ ## op(DisasContext *s, TCGMemOp ot,              \
     gen_jmp(s, cur_eip);                                                      \
 }
 
-GEN_REPZ(movs)
-GEN_REPZ(stos)
-GEN_REPZ(lods)
-GEN_REPZ(ins)
-GEN_REPZ(outs)
-GEN_REPZ2(scas)
-GEN_REPZ2(cmps)
+GEN_REPZ(movs, gen_helper_symsan_rep_movs)
+GEN_REPZ(stos, gen_helper_symsan_rep_stos)
+GEN_REPZ(lods, NULL)
+GEN_REPZ(ins, NULL)
+GEN_REPZ(outs, NULL)
+GEN_REPZ2(scas, gen_helper_symsan_rep_scasb, 1)
+GEN_REPZ2(cmps, gen_helper_symsan_rep_cmpsb, 0)
 
 static void gen_helper_fp_arith_ST0_FT0(int op)
 {
@@ -1388,8 +1473,16 @@ static void gen_op(DisasContext *s1, int op, TCGMemOp ot, int d)
     case OP_CMPL:
         tcg_gen_mov_tl(cpu_cc_src, s1->T1);
         tcg_gen_mov_tl(s1->cc_srcT, s1->T0);
-        tcg_gen_sub_tl(cpu_cc_dst, s1->T0, s1->T1);
-        set_cc_op(s1, CC_OP_SUBB + ot);
+        if (second_ccache_flag) {
+            /* the value now, the label in gen_cc_dst_label */
+            tcg_gen_movi_tl(cpu_cc_dst, 0);
+            gen_sub_nosym_tl(cpu_cc_dst, s1->T0, s1->T1);
+            set_cc_op(s1, CC_OP_SUBB + ot);
+            s1->cc_dst_lazy = true;
+        } else {
+            tcg_gen_sub_tl(cpu_cc_dst, s1->T0, s1->T1);
+            set_cc_op(s1, CC_OP_SUBB + ot);
+        }
         break;
     }
 }
@@ -2399,6 +2492,112 @@ static inline void gen_pop_update(DisasContext *s, TCGMemOp ot)
     gen_stack_update(s, 1 << ot);
 }
 
+/*
+ * Calling-context hash for the branch records (env->marco_ctxh). A call
+ * saves the current hash on the shadow stack in env and xors in a constant
+ * derived from the return address at translate time; ret restores the saved
+ * hash. Both are a handful of inline ops, no helper call. They are emitted
+ * as raw ops and _nosym loads/stores so that symbolic mode does not
+ * instrument them.
+ */
+static uint32_t marco_call_site_id(target_ulong next_eip)
+{
+    uint32_t h = (uint32_t)next_eip;
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+    return h;
+}
+
+/* slot = env + (depth % MARCO_CTX_STACK_DEPTH) * 4 */
+static void gen_marco_ctx_slot(TCGv_ptr slot, TCGv_i32 depth)
+{
+    TCGv_i32 idx = tcg_temp_new_i32();
+    TCGv_i32 mask = tcg_const_i32(MARCO_CTX_STACK_DEPTH - 1);
+    TCGv_i32 two = tcg_const_i32(2);
+
+    tcg_gen_op3_i32(INDEX_op_and_i32, idx, depth, mask);
+    tcg_gen_op3_i32(INDEX_op_shl_i32, idx, idx, two);
+    /* raw ops: tcg_gen_ext_i32_ptr/tcg_gen_add_ptr would emit symsan
+     * helpers on env in the second code cache */
+#if TCG_TARGET_REG_BITS == 32
+    tcg_gen_op3(INDEX_op_add_i32, tcgv_ptr_arg(slot), tcgv_ptr_arg(cpu_env),
+                tcgv_i32_arg(idx));
+#else
+    tcg_gen_op2(INDEX_op_ext_i32_i64, tcgv_ptr_arg(slot), tcgv_i32_arg(idx));
+    tcg_gen_op3(INDEX_op_add_i64, tcgv_ptr_arg(slot), tcgv_ptr_arg(cpu_env),
+                tcgv_ptr_arg(slot));
+#endif
+
+    tcg_temp_free_i32(two);
+    tcg_temp_free_i32(mask);
+    tcg_temp_free_i32(idx);
+}
+
+static void gen_marco_ctx_call(DisasContext *s, target_ulong next_eip)
+{
+    TCGv_i32 ctxh = tcg_temp_new_i32();
+    TCGv_i32 depth = tcg_temp_new_i32();
+    TCGv_i32 t = tcg_const_i32(1);
+    TCGv_ptr slot = tcg_temp_new_ptr();
+
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_ld_i32, ctxh, cpu_env,
+                              offsetof(CPUX86State, marco_ctxh));
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_ld_i32, depth, cpu_env,
+                              offsetof(CPUX86State, marco_ctx_depth));
+    gen_marco_ctx_slot(slot, depth);
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_st_i32, ctxh, slot,
+                              offsetof(CPUX86State, marco_ctx_stack));
+    tcg_gen_op3_i32(INDEX_op_add_i32, depth, depth, t);
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_st_i32, depth, cpu_env,
+                              offsetof(CPUX86State, marco_ctx_depth));
+    tcg_gen_movi_i32(t, marco_call_site_id(next_eip));
+    tcg_gen_op3_i32(INDEX_op_xor_i32, ctxh, ctxh, t);
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_st_i32, ctxh, cpu_env,
+                              offsetof(CPUX86State, marco_ctxh));
+
+    tcg_temp_free_ptr(slot);
+    tcg_temp_free_i32(t);
+    tcg_temp_free_i32(depth);
+    tcg_temp_free_i32(ctxh);
+}
+
+/* a ret with nothing on the shadow stack leaves the hash alone */
+static void gen_marco_ctx_ret(DisasContext *s)
+{
+    TCGv_i32 ctxh = tcg_temp_new_i32();
+    TCGv_i32 depth = tcg_temp_new_i32();
+    TCGv_i32 popped = tcg_temp_new_i32();
+    TCGv_i32 saved = tcg_temp_new_i32();
+    TCGv_i32 zero = tcg_const_i32(0);
+    TCGv_ptr slot = tcg_temp_new_ptr();
+
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_ld_i32, ctxh, cpu_env,
+                              offsetof(CPUX86State, marco_ctxh));
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_ld_i32, depth, cpu_env,
+                              offsetof(CPUX86State, marco_ctx_depth));
+    tcg_gen_op4i_i32(INDEX_op_setcond_i32, popped, depth, zero, TCG_COND_NE);
+    tcg_gen_op3_i32(INDEX_op_sub_i32, depth, depth, popped);
+    gen_marco_ctx_slot(slot, depth);
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_ld_i32, saved, slot,
+                              offsetof(CPUX86State, marco_ctx_stack));
+    tcg_gen_op6i_i32(INDEX_op_movcond_i32, ctxh, popped, zero, saved, ctxh,
+                     TCG_COND_NE);
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_st_i32, depth, cpu_env,
+                              offsetof(CPUX86State, marco_ctx_depth));
+    tcg_gen_ldst_op_nosym_i32(INDEX_op_st_i32, ctxh, cpu_env,
+                              offsetof(CPUX86State, marco_ctxh));
+
+    tcg_temp_free_ptr(slot);
+    tcg_temp_free_i32(zero);
+    tcg_temp_free_i32(saved);
+    tcg_temp_free_i32(popped);
+    tcg_temp_free_i32(depth);
+    tcg_temp_free_i32(ctxh);
+}
+
 static inline void gen_stack_A0(DisasContext *s)
 {
     gen_lea_v_seg(s, s->ss32 ? MO_32 : MO_16, cpu_regs[R_ESP], R_SS, -1);
@@ -2630,6 +2829,53 @@ static void gen_jr(DisasContext *s, TCGv dest)
     do_gen_eob_worker(s, false, false, true);
 }
 
+/* Concrete mode: give the next insn a switch exit, which the loads it
+ * emits branch to (tcg-op.c). It is only kept if one of them did. */
+static void gen_switch_exit_start(DisasContext *s)
+{
+    if (!second_ccache_flag && TCG_TARGET_HAS_brcond_exit) {
+        tcg_ctx->switch_exit = gen_new_label();
+    }
+}
+
+static void gen_switch_exit_end(DisasContext *s, target_ulong pc, CCOp cc_op)
+{
+    TCGLabel *l = tcg_ctx->switch_exit;
+    SwitchExit *e;
+
+    tcg_ctx->switch_exit = NULL;
+    if (l && l->refs) {
+        e = tcg_malloc(sizeof(*e));
+        e->label = l;
+        e->pc = pc;
+        e->cc_op = cc_op;
+        e->next = s->switch_exits;
+        s->switch_exits = e;
+    }
+}
+
+/* The exits come after the end of the TB. Like cpu_restore_state for
+   EXCP_SWITCH they go back to the start of the insn, with the cc_op it
+   began with, then look the insn up again: second_ccache_flag is set by
+   now, so that finds the symbolic TB without leaving the generated code. */
+static void gen_switch_exits(DisasContext *s)
+{
+    SwitchExit *e;
+
+    for (e = s->switch_exits; e; e = e->next) {
+        gen_set_label(e->label);
+        if (e->cc_op != CC_OP_DYNAMIC) {
+            tcg_gen_movi_i32(cpu_cc_op, e->cc_op);
+        }
+        gen_jmp_im(s, e->pc - s->cs_base);
+        if (s->jmp_opt) {
+            tcg_gen_lookup_and_goto_ptr();
+        } else {
+            tcg_gen_exit_tb(NULL, 0);
+        }
+    }
+}
+
 /* generate a jump to eip. No segment change must happen before as a
    direct call to the next block may occur */
 static void gen_jmp_tb(DisasContext *s, target_ulong eip, int tb_num)
@@ -5065,8 +5311,8 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
             }
             next_eip = s->pc - s->cs_base;
             tcg_gen_movi_tl(s->T1, next_eip);
-            // gen_helper_symsan_notify_call(s->T1);
             gen_push_v(s, s->T1);
+            gen_marco_ctx_call(s, next_eip);
             gen_op_jmp_v(s->T0);
             gen_bnd_jmp(s);
             gen_jr(s, s->T0);
@@ -6522,9 +6768,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
         val = x86_ldsw_code(env, s);
         ot = gen_pop_T0(s);
         gen_stack_update(s, val + (1 << ot));
-        //if(second_ccache_flag) {
-            // gen_helper_symsan_notify_return(s->T0);
-        //}
+        gen_marco_ctx_ret(s);
         /* Note that gen_pop_T0 uses a zero-extending load.  */
         gen_op_jmp_v(s->T0);
         gen_bnd_jmp(s);
@@ -6538,9 +6782,7 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
         }
         ot = gen_pop_T0(s);
         gen_pop_update(s, ot);
-        //if(second_ccache_flag) {
-            // gen_helper_symsan_notify_return(s->T0);
-        //}
+        gen_marco_ctx_ret(s);
         /* Note that gen_pop_T0 uses a zero-extending load.  */
         gen_op_jmp_v(s->T0);
         gen_bnd_jmp(s);
@@ -6608,8 +6850,8 @@ static target_ulong disas_insn(DisasContext *s, CPUState *cpu)
                 tval &= 0xffffffff;
             }
             tcg_gen_movi_tl(s->T0, next_eip);
-            // gen_helper_symsan_notify_call(s->T0);
             gen_push_v(s, s->T0);
+            gen_marco_ctx_call(s, next_eip);
             gen_bnd_jmp(s);
             gen_jmp(s, tval);
         }
@@ -8503,6 +8745,7 @@ static void i386_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cpu)
     dc->tf = (flags >> TF_SHIFT) & 1;
     dc->cc_op = CC_OP_DYNAMIC;
     dc->cc_op_dirty = false;
+    dc->cc_dst_lazy = false;
     dc->cs_base = cs_base;
     dc->popl_esp_hack = 0;
     /* select memory access functions */
@@ -8552,6 +8795,7 @@ static void i386_tr_init_disas_context(DisasContextBase *dcbase, CPUState *cpu)
     dc->ptr0 = tcg_temp_new_ptr();
     dc->ptr1 = tcg_temp_new_ptr();
     dc->cc_srcT = tcg_temp_local_new();
+    dc->switch_exits = NULL;
 }
 
 static void i386_tr_tb_start(DisasContextBase *db, CPUState *cpu)
@@ -8588,7 +8832,13 @@ static bool i386_tr_breakpoint_check(DisasContextBase *dcbase, CPUState *cpu,
 static void i386_tr_translate_insn(DisasContextBase *dcbase, CPUState *cpu)
 {
     DisasContext *dc = container_of(dcbase, DisasContext, base);
-    target_ulong pc_next = disas_insn(dc, cpu);
+    target_ulong pc_start = dc->base.pc_next;
+    CCOp cc_op = dc->cc_op;
+    target_ulong pc_next;
+
+    gen_switch_exit_start(dc);
+    pc_next = disas_insn(dc, cpu);
+    gen_switch_exit_end(dc, pc_start, cc_op);
 
     if (dc->tf || (dc->base.tb->flags & HF_INHIBIT_IRQ_MASK)) {
         /* if single step mode, we generate only one instruction and
@@ -8624,6 +8874,7 @@ static void i386_tr_tb_stop(DisasContextBase *dcbase, CPUState *cpu)
         gen_jmp_im(dc, dc->base.pc_next - dc->cs_base);
         gen_eob(dc);
     }
+    gen_switch_exits(dc);
 }
 
 static void i386_tr_disas_log(const DisasContextBase *dcbase,
@@ -8652,6 +8903,8 @@ void gen_intermediate_code(CPUState *cpu, TranslationBlock *tb, int max_insns)
     tcg_ctx->cur_pc = &dc.pc;
     tcg_ctx->cur_cs_base = &dc.cs_base;
     tcg_ctx->cur_pc_start = &dc.pc_start;  /* Point to instruction start PC */
+    tcg_ctx->summarize = second_ccache_flag && symsan_summarize_pc(tb->pc);
+    tcg_ctx->switch_exit = NULL;
     translator_loop(&i386_tr_ops, &dc.base, cpu, tb, max_insns);
 }
 
@@ -2487,6 +2487,7 @@ static inline void tcg_out_op(TCGContext *s, TCGOpcode opc,
         break;
 
     case INDEX_op_brcond_i32:
+    case INDEX_op_brcond_exit_i32:
         tcg_out_brcond32(s, a2, a0, a1, const_args[1], arg_label(args[3]), 0);
         break;
     case INDEX_op_setcond_i32:
@@ -3071,6 +3072,7 @@ static const TCGTargetOpDef *tcg_target_op_def(TCGOpcode op)
 
     case INDEX_op_brcond_i32:
     case INDEX_op_brcond_i64:
+    case INDEX_op_brcond_exit_i32:
         return &r_re;
 
     case INDEX_op_bswap16_i32:
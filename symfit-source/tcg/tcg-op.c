@@ -431,7 +431,10 @@ void tcg_gen_setcond_i32(TCGCond cond, TCGv_i32 ret,
         tcg_gen_movi_i32(ret, 0);
     } else {
         tcg_gen_op4i_i32(INDEX_op_setcond_i32, ret, arg1, arg2, cond);
-        if(second_ccache_flag) {
+        if (second_ccache_flag && tcg_ctx->summarize) {
+            /* summarized code: a concrete result, no branch record */
+            tcg_gen_op2i_i64(INDEX_op_movi_i64, tcgv_i32_expr_num(ret), 0);
+        } else if(second_ccache_flag) {
             TCGv_i32 cond_temp = tcg_const_i32(cond);
             // Get PC at instruction start (not current PC which may be updated during translation)
             // This ensures each branch gets the correct PC of the instruction where the branch occurs
@@ -1902,7 +1905,9 @@ void tcg_gen_setcond_i64(TCGCond cond, TCGv_i64 ret,
         } else {
             tcg_gen_op4i_i64(INDEX_op_setcond_i64, ret, arg1, arg2, cond);
         }
-        if(second_ccache_flag) {
+        if (second_ccache_flag && tcg_ctx->summarize) {
+            tcg_gen_op2i_i64(INDEX_op_movi_i64, tcgv_i64_expr_num(ret), 0);
+        } else if(second_ccache_flag) {
             TCGv_i32 cond_temp = tcg_const_i32(cond);
             // Get PC at instruction start (not current PC which may be updated during translation)
             // This ensures each branch gets the correct PC of the instruction where the branch occurs
@@ -3316,6 +3321,30 @@ void tcg_gen_extr32_i64(TCGv_i64 lo, TCGv_i64 hi, TCGv_i64 arg)
 
 /* QEMU specific operations.  */
 
+/* Leaving a symbolic TB once no register or live flag carries a label:
+ * go on in the concrete code cache right away. The lookup does not link
+ * this TB to the concrete one, which the exit_tb below would. */
+static void gen_symsan_exit_concrete(void)
+{
+    TCGLabel *stay = gen_new_label();
+    TCGv_i32 sym = tcg_temp_new_i32();
+    TCGv_i32 zero = tcg_const_i32(0);
+
+    gen_helper_symsan_check_state_no_sse(sym, cpu_env);
+    tcg_gen_brcond_nosym_i32(TCG_COND_NE, sym, zero, stay);
+    tcg_temp_free_i32(zero);
+    tcg_temp_free_i32(sym);
+    if (TCG_TARGET_HAS_goto_ptr && !qemu_loglevel_mask(CPU_LOG_TB_NOCHAIN)) {
+        TCGv_ptr ptr = tcg_temp_new_ptr();
+        gen_helper_lookup_tb_ptr(ptr, cpu_env);
+        tcg_gen_op1i(INDEX_op_goto_ptr, tcgv_ptr_arg(ptr));
+        tcg_temp_free_ptr(ptr);
+    } else {
+        tcg_gen_op1i(INDEX_op_exit_tb, 0);
+    }
+    gen_set_label(stay);
+}
+
 void tcg_gen_exit_tb(TranslationBlock *tb, unsigned idx)
 {
     uintptr_t val = (uintptr_t)tb + idx;
@@ -3336,11 +3365,9 @@ void tcg_gen_exit_tb(TranslationBlock *tb, unsigned idx)
         /* This is an exit via the exitreq label.  */
         tcg_debug_assert(idx == TB_EXIT_REQUESTED);
     }
-    if(second_ccache_flag) {
-    //     if (sse_operation)
-    //         gen_helper_symsan_check_state(cpu_env);
-    //     else
-            gen_helper_symsan_check_state_no_sse(cpu_env);
+    /* An exit request leaves env->eip behind; cpu_exec restores it. */
+    if (second_ccache_flag && (tb == NULL || idx <= TB_EXIT_IDXMAX)) {
+        gen_symsan_exit_concrete();
     }
     tcg_gen_op1i(INDEX_op_exit_tb, val);
 }
@@ -3460,6 +3487,81 @@ static void tcg_gen_req_mo(TCGBar type)
     }
 }
 
+/* Shadow labels of guest memory, one dfsan_label per byte; matches
+ * shadow_for() in accel/tcg/tcg-runtime-symsan.c */
+#define SYMSAN_SHADOW_MASK (~0x700000000000ULL)
+
+/* The label passed with a guest address. In summarized code the address
+ * is used concretely: label 0, so no Equal constraint and no Select table. */
+static TCGv_i64 gen_addr_label(TCGv addr)
+{
+    return tcg_ctx->summarize ? tcg_const_i64(0) : tcgv_i64_expr_num(addr);
+}
+
+static void gen_addr_label_free(TCGv_i64 label)
+{
+    if (tcg_ctx->summarize) {
+        tcg_temp_free_i64(label);
+    }
+}
+
+/* A concrete mode load of labelled bytes restarts its insn in the symbolic
+ * code cache. When the translator gave the insn a switch exit, the TB jumps
+ * there; brcond_exit does not end the basic block, so the temps the insn
+ * keeps across the load stay live. Otherwise the helper raises EXCP_SWITCH. */
+static void gen_symsan_check_load(TCGv addr, TCGv_i64 load_size)
+{
+    TCGLabel *l = tcg_ctx->switch_exit;
+
+    if (TCG_TARGET_HAS_brcond_exit && l) {
+        TCGv_i32 hit = tcg_temp_new_i32();
+        TCGv_i32 zero = tcg_const_i32(0);
+
+        gen_helper_symsan_check_load_guest_exit(hit, addr, load_size);
+        l->refs++;
+        tcg_gen_op4ii_i32(INDEX_op_brcond_exit_i32, hit, zero,
+                          TCG_COND_NE, label_arg(l));
+        tcg_temp_free_i32(zero);
+        tcg_temp_free_i32(hit);
+    } else {
+        gen_helper_symsan_check_load_guest(cpu_env, addr, load_size);
+    }
+}
+
+/* A concrete mode store only has to clear the labels of the bytes it wrote,
+ * which needs neither a helper call nor a branch. */
+static void gen_symsan_clear_shadow(TCGv addr, TCGMemOp memop)
+{
+#ifdef CONFIG_USER_ONLY
+    int len = (1 << (memop & MO_SIZE)) * sizeof(uint32_t);
+    TCGv_i64 t = tcg_temp_new_i64();
+    TCGv_i64 zero = tcg_const_i64(0);
+    TCGv_ptr shadow = tcg_temp_new_ptr();
+    int ofs;
+
+    tcg_gen_extu_tl_i64(t, addr);
+    tcg_gen_addi_i64(t, t, guest_base);
+    tcg_gen_andi_i64(t, t, SYMSAN_SHADOW_MASK);
+    tcg_gen_shli_i64(t, t, 2);
+    tcg_gen_trunc_i64_ptr(shadow, t);
+    if (len < 8) {
+        tcg_gen_st32_i64(zero, shadow, 0);
+    } else {
+        for (ofs = 0; ofs < len; ofs += 8) {
+            tcg_gen_st_i64(zero, shadow, ofs);
+        }
+    }
+
+    tcg_temp_free_ptr(shadow);
+    tcg_temp_free_i64(zero);
+    tcg_temp_free_i64(t);
+#else
+    TCGv_i64 store_size = tcg_const_i64(1 << (memop & MO_SIZE));
+    gen_helper_symsan_check_store_guest(addr, store_size);
+    tcg_temp_free_i64(store_size);
+#endif
+}
+
 void tcg_gen_qemu_ld_i32(TCGv_i32 val, TCGv addr, TCGArg idx, TCGMemOp memop)
 {
     TCGMemOp orig_memop;
@@ -3488,10 +3590,12 @@ void tcg_gen_qemu_ld_i32(TCGv_i32 val, TCGv addr, TCGArg idx, TCGMemOp memop)
         /*gen_helper_sym_load_guest_i32(tcgv_i32_expr(val), cpu_env,
                                   addr, tcgv_i64_expr(addr),
                                   load_size);*/
-        gen_helper_symsan_load_guest_i32(shadow_i32(val), cpu_env, addr, tcgv_i64_expr_num(addr), load_size);
+        TCGv_i64 alabel = gen_addr_label(addr);
+        gen_helper_symsan_load_guest_i32(shadow_i32(val), cpu_env, addr, alabel, load_size);
+        gen_addr_label_free(alabel);
     } else {
         // gen_helper_sym_check_load_guest(cpu_env, addr, load_size);
-        gen_helper_symsan_check_load_guest(cpu_env, addr, load_size);
+        gen_symsan_check_load(addr, load_size);
     }
     tcg_temp_free_i64(load_size);
 
@@ -3545,15 +3649,16 @@ void tcg_gen_qemu_st_i32(TCGv_i32 val, TCGv addr, TCGArg idx, TCGMemOp memop)
      * operation ensures that the target address is in the TLB. */
 
     if(second_ccache_flag) {
+        TCGv_i64 alabel = gen_addr_label(addr);
+
         store_size = tcg_const_i64(1 << (memop & MO_SIZE));
         // gen_helper_sym_store_guest_i32(cpu_env, val, tcgv_i32_expr(val), addr, tcgv_i64_expr(addr), store_size);
-        gen_helper_symsan_store_guest_i32(cpu_env, tcgv_i32_expr_num(val), addr, tcgv_i64_expr_num(addr), store_size);
+        gen_helper_symsan_store_guest_i32(cpu_env, tcgv_i32_expr_num(val), addr, alabel, store_size);
+        gen_addr_label_free(alabel);
         tcg_temp_free_i64(store_size);
     } else {
-        store_size = tcg_const_i64(1 << (memop & MO_SIZE));
         //gen_helper_sym_check_store_guest_i32(cpu_env, addr, store_size);
-        gen_helper_symsan_check_store_guest(addr, store_size);
-        tcg_temp_free_i64(store_size);
+        gen_symsan_clear_shadow(addr, memop);
     }
 
     if (swap) {
@@ -3595,9 +3700,12 @@ void tcg_gen_qemu_ld_i64(TCGv_i64 val, TCGv addr, TCGArg idx, TCGMemOp memop)
      * operation ensures that the target address is in the TLB. */
     load_size = tcg_const_i64(1 << (memop & MO_SIZE));
     if(!second_ccache_flag) {
-        gen_helper_symsan_check_load_guest(cpu_env, addr, load_size);
+        gen_symsan_check_load(addr, load_size);
     } else {
-        gen_helper_symsan_load_guest_i64(tcgv_i64_expr_num(val), cpu_env, addr, tcgv_i64_expr_num(addr), load_size);    }
+        TCGv_i64 alabel = gen_addr_label(addr);
+        gen_helper_symsan_load_guest_i64(tcgv_i64_expr_num(val), cpu_env, addr, alabel, load_size);
+        gen_addr_label_free(alabel);
+    }
     tcg_temp_free_i64(load_size);
 
     if ((orig_memop ^ memop) & MO_BSWAP) {
@@ -3664,17 +3772,18 @@ void tcg_gen_qemu_st_i64(TCGv_i64 val, TCGv addr, TCGArg idx, TCGMemOp memop)
     /* Perform the symbolic memory access. Doing so _after_ the concrete
      * operation ensures that the target address is in the TLB. */
     if(second_ccache_flag) {
+        TCGv_i64 alabel = gen_addr_label(addr);
+
         store_size = tcg_const_i64(1 << (memop & MO_SIZE));
         /*gen_helper_sym_store_guest_i64(cpu_env, val, tcgv_i64_expr(val),
                                        addr, tcgv_i64_expr(addr),
                                        store_size);*/
-        gen_helper_symsan_store_guest_i64(cpu_env, shadow_i64(val), addr, tcgv_i64_expr_num(addr), store_size);
+        gen_helper_symsan_store_guest_i64(cpu_env, shadow_i64(val), addr, alabel, store_size);
+        gen_addr_label_free(alabel);
         tcg_temp_free_i64(store_size);
     } else {
-        store_size = tcg_const_i64(1 << (memop & MO_SIZE));
         //gen_helper_sym_check_store_guest_i64(cpu_env, addr, store_size);
-        gen_helper_symsan_check_store_guest(addr, store_size);
-        tcg_temp_free_i64(store_size);
+        gen_symsan_clear_shadow(addr, memop);
     }
 
     if (swap) {
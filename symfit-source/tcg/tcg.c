@@ -1504,6 +1504,8 @@ bool tcg_op_supported(TCGOpcode op)
 
     case INDEX_op_goto_ptr:
         return TCG_TARGET_HAS_goto_ptr;
+    case INDEX_op_brcond_exit_i32:
+        return TCG_TARGET_HAS_brcond_exit;
 
     case INDEX_op_mov_i32:
     case INDEX_op_movi_i32:
@@ -2151,6 +2153,7 @@ static void tcg_dump_ops(TCGContext *s, bool have_prefs)
             }
             switch (c) {
             case INDEX_op_brcond_i32:
+            case INDEX_op_brcond_exit_i32:
             case INDEX_op_setcond_i32:
             case INDEX_op_movcond_i32:
             case INDEX_op_brcond2_i32:
@@ -2196,6 +2199,7 @@ static void tcg_dump_ops(TCGContext *s, bool have_prefs)
             case INDEX_op_set_label:
             case INDEX_op_br:
             case INDEX_op_brcond_i32:
+            case INDEX_op_brcond_exit_i32:
             case INDEX_op_brcond_i64:
             case INDEX_op_brcond2_i32:
                 col += qemu_log("%s$L%d", k ? "," : "",
@@ -2397,6 +2401,7 @@ void tcg_op_remove(TCGContext *s, TCGOp *op)
         label->refs--;
         break;
     case INDEX_op_brcond_i32:
+    case INDEX_op_brcond_exit_i32:
     case INDEX_op_brcond_i64:
         label = arg_label(op->args[3]);
         label->refs--;
@@ -200,6 +200,9 @@ typedef uint64_t TCGRegSet;
 #ifndef TCG_TARGET_HAS_v256
 #define TCG_TARGET_HAS_v256             0
 #endif
+#ifndef TCG_TARGET_HAS_brcond_exit
+#define TCG_TARGET_HAS_brcond_exit      0
+#endif
 
 #ifndef TARGET_INSN_START_EXTRA_WORDS
 # define TARGET_INSN_START_WORDS 1
@@ -480,6 +483,9 @@ extern int fake_flag;
 extern target_ulong symbolic_count;
 extern target_ulong concrete_count;
 #endif
+/* MARCO_SUMMARIZE ranges, tcg-runtime-symsan.c */
+bool symsan_summarize_pc(uint64_t pc);
+void symsan_summarize_module(const char *path, uint64_t start, uint64_t end);
 /* call flags */
 /* Helper does not read globals (either directly or through an exception). It
    implies TCG_CALL_NO_WRITE_GLOBALS. */
@@ -760,6 +766,9 @@ struct TCGContext {
     target_ulong *cur_pc;
     target_ulong *cur_cs_base;
     target_ulong *cur_pc_start;  /* PC at instruction start (for accurate branch PC) */
+    bool summarize;  /* symbolic TB in a MARCO_SUMMARIZE range */
+    TCGLabel *switch_exit;  /* concrete TB: exit of the current insn into
+                               the symbolic code cache, or NULL */
 };
 
 extern TCGContext tcg_init_ctx;
@@ -303,6 +303,29 @@ echo "  MARCO_QUEUEID and MARCO_TRACEID will be set per-seed from filename"
 echo "  SYMCC_AFL_COVERAGE_MAP=$SYMCC_AFL_COVERAGE_MAP"
 echo ""
 
+# MARCO_WORKERS>1: hand the seeds to the parallel orchestrator instead of the
+# serial loop below; each worker gets its own FastGen/scheduler lane under
+# $OUTPUT_DIR/laneN, pinned to CPU MARCO_FIRST_CPU+N
+if [ "${MARCO_WORKERS:-1}" -gt 1 ]; then
+  MARCO_ORCH_SRC="$MARCO_SYMFIT_ROOT/marco/src/orchestrator"
+  MARCO_ORCH="$MARCO_ORCH_SRC/build/marco_orch"
+  if [ ! -x "$MARCO_ORCH" ]; then
+    echo "Building orchestrator..."
+    cmake -S "$MARCO_ORCH_SRC" -B "$MARCO_ORCH_SRC/build" > "$LOG_DIR/orch_build.log" 2>&1 && \
+      cmake --build "$MARCO_ORCH_SRC/build" >> "$LOG_DIR/orch_build.log" 2>&1 || {
+        echo "ERROR: orchestrator build failed, see $LOG_DIR/orch_build.log"; exit 1; }
+  fi
+  export LD_LIBRARY_PATH="/lib/x86_64-linux-gnu:$SYM_RUNTIME_LIB:$HOME/lib:${LD_LIBRARY_PATH:-}"
+  export TARGET_BASE_ADDR="${TARGET_BASE_ADDR:-}" TARGET_SIZE="${TARGET_SIZE:-}"
+  export RUST_BACKTRACE=1 RUST_LOG=info
+  echo "Starting orchestrator with $MARCO_WORKERS workers..."
+  exec "$MARCO_ORCH" -j "$MARCO_WORKERS" -c "${MARCO_FIRST_CPU:-0}" \
+    -o "$OUTPUT_DIR" -i "$INPUT_DIR" -t "$TARGET_PROGRAM" \
+    --fastgen "$MARCO_FASTGEN" --scheduler "$MARCO_SCHEDULER" \
+    --fgtest "$SYMFIT_FGTEST" --qemu "$SYMFIT_QEMU" \
+    -T 15 -R "${MAX_RUNTIME:-0}" -- -d 0 -m 2
+fi
+
 # Start order: FastGen -> Scheduler -> SymFit (per-seed)
 # Start FastGen first to open /tmp/myfifo read end
 # Ensure /tmp/wp2 exists (created as FIFO); do NOT keep a persistent writer,